@@ -0,0 +1,351 @@
+/*******************************************************************************
+* File:       bench_cas.c
+* Version:    0.1
+* Purpose:    Benchmark of contended counters on server.c: read-modify-write
+*             under a client-side lock against optimistic GETV & CAS
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      -t threads, each with its own connection, each add 1 to a
+              counter picked from -k of them, -n times over, three ways:
+
+                  none - GET, add 1, STORE, with nothing stopping two threads
+                         from doing it at once (so updates get lost)
+                  lock - the same, holding a lock on the counter throughout.
+                         The lock is a pthread mutex, which is as cheap as a
+                         lock can be; a lock service shared between machines
+                         would add its own round trips on top.
+                  cas  - GETV, add 1, CAS with the version read, & start over
+                         if someone else got there first
+
+              For each, it prints the increments per second, how many of them
+              went missing from the counters at the end, & (for cas) how many
+              times a thread had to start over per increment.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2 -pthread`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SERVER "localhost"
+#define PORT "3331"
+#define MAXCOUNTERS 1024 // most counters (-k)
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "kvclient.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// the ways of adding 1 to a counter
+#define SCHEME_NONE 0
+#define SCHEME_LOCK 1
+#define SCHEME_CAS  2
+
+// one thread's share of a run
+struct runner {
+	pthread_t thread;
+	int       scheme;     // SCHEME_*
+	unsigned  seed;       // for picking counters
+	size_t    retries;    // CASes that found someone had got there first
+	int       failed;     // did a request fail outright?
+};
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+int numThreads = 8;      // -t
+int increments = 5000;   // -n (per thread)
+int numCounters = 1;     // -k
+
+char* schemeNames[] = { "none", "lock", "cas" };
+pthread_mutex_t locks[MAXCOUNTERS]; // SCHEME_LOCK: one per counter
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    now
+* Purpose: Reads a monotonic clock
+* Input:   none
+* Output:  the time in seconds
+*******************************************************************************/
+double now(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+/*******************************************************************************
+* Name:    increment
+* Purpose: Adds 1 to a counter, one of the three ways
+* Input:   kc - the connection
+*          r  - the thread doing it
+*          n  - the counter's number
+* Output:  KV_OK or KV_ERROR
+*******************************************************************************/
+int increment( struct kvconn* kc, struct runner* r, int n ){
+
+	// VARIABLE DEFINITIONS
+	char key[32], num[32];
+	size_t keyLen = snprintf( key, sizeof(key), "counter%d", n );
+	char* val;
+	size_t valLen;
+	uint64_t version;
+	int status;
+
+	// optimistic: read the version & write only if it hasn't moved on
+	if( r->scheme == SCHEME_CAS ){
+
+		while( 1 ){
+
+			status = kvGetV( kc, key, keyLen, &val, &valLen, &version );
+			if( status != KV_OK )
+				return KV_ERROR;
+
+			snprintf( num, sizeof(num), "%llu", strtoull( val, NULL, 10 ) + 1 );
+			free( val );
+
+			status = kvCas( kc, key, keyLen, num, strlen(num), &version );
+			if( status != KV_CONFLICT )
+				return status;
+
+			r->retries++;
+
+		}
+
+	}
+
+	if( r->scheme == SCHEME_LOCK )
+		pthread_mutex_lock( &locks[n] );
+
+	status = kvGet( kc, key, keyLen, &val, &valLen );
+	if( status == KV_OK ){
+		snprintf( num, sizeof(num), "%llu", strtoull( val, NULL, 10 ) + 1 );
+		free( val );
+		status = kvStore( kc, key, keyLen, num, strlen(num) );
+	}
+
+	if( r->scheme == SCHEME_LOCK )
+		pthread_mutex_unlock( &locks[n] );
+
+	return status == KV_OK ? KV_OK : KV_ERROR;
+
+}
+
+/*******************************************************************************
+* Name:    runThread
+* Purpose: One thread of a run: increments counters picked at random
+* Input:   arg - the thread's struct runner
+* Output:  NULL
+*******************************************************************************/
+void* runThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct runner* r = arg;
+	struct kvconn kc;
+
+	if( kvConnect( &kc, SERVER, PORT ) != KV_OK ){
+		r->failed = 1;
+		return NULL;
+	}
+
+	for( int i = 0; i < increments && !r->failed; i++ )
+		if( increment( &kc, r, rand_r( &r->seed ) % numCounters ) != KV_OK )
+			r->failed = 1;
+
+	kvClose( &kc );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    setCounters
+* Purpose: Sets every counter to 0, or adds them up
+* Input:   kc  - a connection
+*          sum - NULL to zero them, else set to their total
+* Output:  none (exit()s the program on failure)
+*******************************************************************************/
+void setCounters( struct kvconn* kc, unsigned long long* sum ){
+
+	// VARIABLE DEFINITIONS
+	char key[32];
+	size_t keyLen;
+	char* val;
+	size_t valLen;
+	int status;
+
+	if( sum != NULL )
+		*sum = 0;
+
+	for( int n = 0; n < numCounters; n++ ){
+
+		keyLen = snprintf( key, sizeof(key), "counter%d", n );
+
+		if( sum == NULL )
+			status = kvStore( kc, key, keyLen, "0", 1 );
+		else if( (status = kvGet( kc, key, keyLen, &val, &valLen )) == KV_OK ){
+			*sum += strtoull( val, NULL, 10 );
+			free( val );
+		}
+
+		if( status != KV_OK ){
+			fprintf( stderr, "bench_cas: the server failed us\n" );
+			exit(1);
+		}
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    run
+* Purpose: Runs every thread's increments one of the three ways & reports
+* Input:   kc     - a connection (for setting up & checking the counters)
+*          scheme - which way (SCHEME_*)
+* Output:  none. the results are printed directly to Standard Out
+*******************************************************************************/
+void run( struct kvconn* kc, int scheme ){
+
+	// VARIABLE DEFINITIONS
+	struct runner* runners = calloc( numThreads, sizeof(struct runner) );
+	unsigned long long total, expected = (unsigned long long)numThreads *
+	 increments;
+	size_t retries = 0;
+	double start, elapsed;
+
+	if( runners == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+
+	setCounters( kc, NULL );
+
+	start = now();
+
+	for( int i = 0; i < numThreads; i++ ){
+		runners[i].scheme = scheme;
+		runners[i].seed = i + 1;
+		if( pthread_create( &runners[i].thread, NULL, runThread,
+		 &runners[i] ) != 0 ){
+			perror( "pthread_create" );
+			exit(1);
+		}
+	}
+
+	for( int i = 0; i < numThreads; i++ ){
+		pthread_join( runners[i].thread, NULL );
+		retries += runners[i].retries;
+		if( runners[i].failed ){
+			fprintf( stderr, "bench_cas: a request failed\n" );
+			exit(1);
+		}
+	}
+
+	elapsed = now() - start;
+
+	setCounters( kc, &total );
+
+	printf( "%-6s %12.0f %12llu %11.2f%% %14.3f\n", schemeNames[scheme],
+	 expected / elapsed, expected - total,
+	 100.0 * ( expected - total ) / expected, (double)retries / expected );
+
+	free( runners );
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-t threads] [-n increments] [-k counters]\n",
+	 name );
+	fprintf( stderr, "  -t  number of threads, each with its own connection "
+	 "(default: 8)\n" );
+	fprintf( stderr, "  -n  increments per thread (default: 5000)\n" );
+	fprintf( stderr, "  -k  number of counters they're spread over (default: 1; "
+	 "at most %d)\n", MAXCOUNTERS );
+	exit(1);
+
+}
+
+/*******************************************************************************
+* Name:    main
+* Purpose: Runs the benchmark each way
+* Input:   argc - number of command line arguments
+*          argv - the command line arguments
+* Output:  0
+*******************************************************************************/
+int main( int argc, char* argv[] ){
+
+	// VARIABLE DEFINITIONS
+	int opt;
+	struct kvconn kc;
+
+	while( (opt = getopt( argc, argv, "t:n:k:" )) != -1 ){
+		switch( opt ){
+			case 't':
+				numThreads = atoi( optarg );
+				break;
+			case 'n':
+				increments = atoi( optarg );
+				break;
+			case 'k':
+				numCounters = atoi( optarg );
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	if( numThreads < 1 || increments < 1 || numCounters < 1 ||
+	 numCounters > MAXCOUNTERS )
+		usage( argv[0] );
+
+	for( int i = 0; i < numCounters; i++ )
+		pthread_mutex_init( &locks[i], NULL );
+
+	if( kvConnect( &kc, SERVER, PORT ) != KV_OK ){
+		fprintf( stderr, "bench_cas: failed to connect\n" );
+		exit(1);
+	}
+
+	printf( "%d threads, %d increments each, over %d counter(s)\n",
+	 numThreads, increments, numCounters );
+	printf( "%-6s %12s %12s %12s %14s\n", "scheme", "incr/s", "lost",
+	 "lost %", "retries/incr" );
+
+	run( &kc, SCHEME_NONE );
+	run( &kc, SCHEME_LOCK );
+	run( &kc, SCHEME_CAS );
+
+	kvClose( &kc );
+	return 0;
+
+}
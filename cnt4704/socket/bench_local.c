@@ -0,0 +1,249 @@
+/*******************************************************************************
+* File:       bench_local.c
+* Version:    0.1
+* Purpose:    Benchmark of a client on the server's own host: the latency of
+*             small requests over loopback TCP, the server's Unix socket, &
+*             shared memory
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Start the server first, with its Unix socket, e.g.:
+
+                  ./server -U /tmp/kvserver.sock
+
+              Over each transport in turn, one connection makes -n STOREs of
+              -s bytes to one key, & then -n GETs of it, one at a time (each
+              waits on the last's response), after WARMUP of each that aren't
+              counted. It prints each one's p50/p99/max latency & the requests
+              per second that makes.
+
+              Shared memory only works with a server using epoll (not -u);
+              with io_uring, that line says it was refused.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2 -pthread`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SERVER "localhost"
+#define PORT "3331"                // default for -p
+#define LOCALPATH "/tmp/kvserver.sock" // default for -U
+#define KEY "bench_local"
+#define WARMUP 1000                // requests of each kind before timing
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kvclient.h"
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+char* port = PORT;          // -p
+char* localPath = LOCALPATH; // -U
+int numReqs = 100000;       // -n
+int valSize = 32;           // -s
+
+char* val;                  // the value STOREd
+double* lats;               // one run's latencies, in seconds
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    now
+* Purpose: Reads a monotonic clock
+* Input:   none
+* Output:  the time in seconds
+*******************************************************************************/
+double now(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+/*******************************************************************************
+* Name:    compare
+* Purpose: Compares two doubles, for qsort()
+* Input:   a, b - the doubles
+* Output:  <0, 0 or >0
+*******************************************************************************/
+int compare( const void* a, const void* b ){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return ( x > y ) - ( x < y );
+
+}
+
+/*******************************************************************************
+* Name:    request
+* Purpose: Makes one GET or STORE of KEY
+* Input:   kc    - the connection
+*          store - 1 for a STORE, 0 for a GET
+* Output:  none (exit()s the program on failure)
+*******************************************************************************/
+void request( struct kvconn* kc, int store ){
+
+	// VARIABLE DEFINITIONS
+	char* got;
+	size_t gotLen;
+	int status;
+
+	if( store )
+		status = kvStore( kc, KEY, strlen( KEY ), val, valSize );
+	else {
+		status = kvGet( kc, KEY, strlen( KEY ), &got, &gotLen );
+		free( got );
+	}
+
+	if( status != KV_OK ){
+		fprintf( stderr, "bench_local: a %s failed\n",
+		 store ? "STORE" : "GET" );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    run
+* Purpose: Times -n STOREs & then -n GETs over one connection, & prints them
+* Input:   kc   - the connection
+*          name - what it's over
+* Output:  none
+*******************************************************************************/
+void run( struct kvconn* kc, char* name ){
+
+	// VARIABLE DEFINITIONS
+	double start, total;
+
+	for( int store = 1; store >= 0; store-- ){
+
+		for( int i = 0; i < WARMUP; i++ )
+			request( kc, store );
+
+		total = now();
+		for( int i = 0; i < numReqs; i++ ){
+			start = now();
+			request( kc, store );
+			lats[i] = now() - start;
+		}
+		total = now() - total;
+
+		qsort( lats, numReqs, sizeof(double), compare );
+		printf( "%-12s %-5s  p50 %7.2f us  p99 %7.2f us  max %8.2f us  "
+		 "%8.0f req/s\n", name, store ? "STORE" : "GET",
+		 lats[ numReqs / 2 ] * 1e6, lats[ (size_t)( numReqs * 0.99 ) ] * 1e6,
+		 lats[ numReqs - 1 ] * 1e6, numReqs / total );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-p port] [-U path] [-n requests] "
+	 "[-s bytes]\n", name );
+	fprintf( stderr, "  -p  the server's port (default: %s)\n", PORT );
+	fprintf( stderr, "  -U  the server's Unix socket (default: %s)\n",
+	 LOCALPATH );
+	fprintf( stderr, "  -n  requests of each kind to time (default: "
+	 "100000)\n" );
+	fprintf( stderr, "  -s  bytes in the value (default: 32)\n" );
+	exit(1);
+
+}
+
+/*******************************************************************************
+* Name:    main
+* Purpose: Runs the benchmark over each transport in turn
+* Input:   argc - number of command line arguments
+*          argv - the command line arguments
+* Output:  0 on success, else 1
+*******************************************************************************/
+int main( int argc, char* argv[] ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn kc;
+	int opt;
+
+	while( (opt = getopt( argc, argv, "p:U:n:s:" )) != -1 ){
+		switch( opt ){
+			case 'p':
+				port = optarg;
+				break;
+			case 'U':
+				localPath = optarg;
+				break;
+			case 'n':
+				numReqs = atoi( optarg );
+				break;
+			case 's':
+				valSize = atoi( optarg );
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	if( numReqs < 1 || valSize < 1 )
+		usage( argv[0] );
+
+	val = malloc( valSize );
+	lats = calloc( numReqs, sizeof(double) );
+	if( val == NULL || lats == NULL ){
+		perror( "malloc" );
+		exit(1);
+	}
+	memset( val, 'v', valSize );
+
+	printf( "%d requests of each kind, one at a time, %d byte value\n",
+	 numReqs, valSize );
+
+	if( kvConnect( &kc, SERVER, port ) != KV_OK ){
+		fprintf( stderr, "bench_local: failed to connect over TCP\n" );
+		exit(1);
+	}
+	run( &kc, "tcp loopback" );
+	kvClose( &kc );
+
+	if( kvConnectLocal( &kc, localPath, 0 ) != KV_OK ){
+		fprintf( stderr, "bench_local: failed to connect to %s\n", localPath );
+		exit(1);
+	}
+	run( &kc, "unix socket" );
+	kvClose( &kc );
+
+	if( kvConnectLocal( &kc, localPath, 1 ) != KV_OK ){
+		printf( "%-12s refused\n", "shm" );
+		return 1;
+	}
+	run( &kc, "shm" );
+	kvClose( &kc );
+
+	return 0;
+
+}
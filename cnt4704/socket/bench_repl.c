@@ -0,0 +1,404 @@
+/*******************************************************************************
+* File:       bench_repl.c
+* Version:    0.1
+* Purpose:    Benchmark of server.c's replication: STOREs to a primary as fast
+*             as it takes them, while watching how soon each shows up on a
+*             replica
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Start the two servers first, e.g. on one machine:
+
+                  ./server -R 3341
+                  ./server -P 3332 -r localhost:3341
+
+              A writer STOREs -n values of -s bytes, spread over -k keys, to
+              the primary, -b at a time pipelined on one connection; the last
+              STORE of each group sets the key bench_repl:seq to the group's
+              number. Meanwhile a prober GETs bench_repl:seq from the replica
+              over & over, & each time it finds a newer group, takes the lag
+              to be how long ago the primary answered that group's STOREs (0
+              if the replica had it first).
+
+              It prints the STOREs per second, the lag's p50/p99/max, how long
+              after the last STORE the replica caught up, & then GETs every
+              key from both servers & counts any that differ.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2 -pthread`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SERVER "localhost"
+#define PORT "3331"          // the primary's (default for -p)
+#define REPLICAPORT "3332"   // the replica's (default for -r)
+#define SEQKEY "bench_repl:seq"
+#define CATCHUP 30           // seconds to wait for the replica to catch up
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "kvclient.h"
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+char* primaryPort = PORT;   // -p
+char* replicaPort = REPLICAPORT; // -r
+int numStores = 200000;     // -n
+int groupSize = 64;         // -b
+int valSize = 100;          // -s
+int numKeys = 10000;        // -k
+
+int numGroups;
+uint64_t* acked;            // when the primary answered each group, in ns
+                            // (atomic; 0 until it has)
+int writerDone;             // 1 once the writer is finished (atomic)
+double writerEnd;           // ...& when
+int failed;                 // did a request fail outright? (atomic)
+
+double* lags;               // the prober's lag samples, in seconds
+size_t numLags;
+double caughtUp;            // when the replica had the last group (0 = never)
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    now
+* Purpose: Reads a monotonic clock
+* Input:   none
+* Output:  the time in seconds
+*******************************************************************************/
+double now(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+/*******************************************************************************
+* Name:    writeThread
+* Purpose: STOREs every value to the primary, a pipelined group at a time
+* Input:   arg - unused
+* Output:  NULL
+*******************************************************************************/
+void* writeThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn kc;
+	struct kvreq* reqs = calloc( groupSize, sizeof(struct kvreq) );
+	struct kvreq** ptrs = calloc( groupSize, sizeof(struct kvreq*) );
+	char* keys = calloc( groupSize, 32 );
+	char* vals = calloc( groupSize, valSize );
+	char seq[32];
+	int n;
+
+	(void)arg;
+
+	if( reqs == NULL || ptrs == NULL || keys == NULL || vals == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+
+	if( kvConnect( &kc, SERVER, primaryPort ) != KV_OK ){
+		fprintf( stderr, "bench_repl: failed to connect to the primary\n" );
+		exit(1);
+	}
+
+	for( int g = 0; g < numGroups && !failed; g++ ){
+
+		for( int j = 0; j < groupSize; j++ ){
+
+			n = g * groupSize + j;
+			ptrs[j] = &reqs[j];
+			reqs[j].op = KV_STORE;
+
+			// the last of each group is its number
+			if( j == groupSize - 1 ){
+				reqs[j].key = SEQKEY;
+				reqs[j].keyLen = strlen( SEQKEY );
+				reqs[j].data = seq;
+				reqs[j].dataLen = snprintf( seq, sizeof(seq), "%d", g );
+				continue;
+			}
+
+			reqs[j].key = keys + j * 32;
+			reqs[j].keyLen = snprintf( reqs[j].key, 32, "bench_repl:%d",
+			 n % numKeys );
+			reqs[j].data = vals + j * valSize;
+			reqs[j].dataLen = valSize;
+			memset( reqs[j].data, 'a' + n % 26, valSize );
+			snprintf( reqs[j].data, valSize, "%d", n );
+
+		}
+
+		if( kvRun( &kc, ptrs, groupSize ) != KV_OK )
+			__atomic_store_n( &failed, 1, __ATOMIC_RELAXED );
+		for( int j = 0; j < groupSize; j++ )
+			if( reqs[j].status != KV_OK )
+				__atomic_store_n( &failed, 1, __ATOMIC_RELAXED );
+
+		__atomic_store_n( &acked[g], (uint64_t)( now() * 1e9 ), __ATOMIC_RELEASE );
+
+	}
+
+	writerEnd = now();
+	__atomic_store_n( &writerDone, 1, __ATOMIC_RELEASE );
+
+	kvClose( &kc );
+	free( reqs );
+	free( ptrs );
+	free( keys );
+	free( vals );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    probeThread
+* Purpose: Watches the replica for each newer group, until it has the last one
+*          (or has had CATCHUP seconds since the writer finished)
+* Input:   arg - unused
+* Output:  NULL
+*******************************************************************************/
+void* probeThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn kc;
+	char* val;
+	size_t valLen;
+	int status, g, last = -1;
+	double t, when;
+
+	(void)arg;
+
+	if( kvConnect( &kc, SERVER, replicaPort ) != KV_OK ){
+		fprintf( stderr, "bench_repl: failed to connect to the replica\n" );
+		exit(1);
+	}
+
+	while( last < numGroups - 1 && !__atomic_load_n( &failed, __ATOMIC_RELAXED ) ){
+
+		status = kvGet( &kc, SEQKEY, strlen( SEQKEY ), &val, &valLen );
+		t = now();
+
+		if( status == KV_ERROR ){
+			__atomic_store_n( &failed, 1, __ATOMIC_RELAXED );
+			break;
+		}
+
+		g = status == KV_OK ? atoi( val ) : -1;
+		free( val );
+
+		// (a group from an earlier run counts as nothing yet)
+		if( g > last && g < numGroups &&
+		 ( g == 0 || __atomic_load_n( &acked[g-1], __ATOMIC_ACQUIRE ) > 0 ) ){
+			when = __atomic_load_n( &acked[g], __ATOMIC_ACQUIRE ) / 1e9;
+			lags[numLags++] = when > 0 && t > when ? t - when : 0;
+			last = g;
+		}
+
+		if( __atomic_load_n( &writerDone, __ATOMIC_ACQUIRE ) &&
+		 t - writerEnd > CATCHUP )
+			break;
+
+	}
+
+	if( last == numGroups - 1 )
+		caughtUp = now();
+
+	kvClose( &kc );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    compare
+* Purpose: Compares two doubles, for qsort()
+* Input:   a, b - the doubles
+* Output:  <0, 0 or >0
+*******************************************************************************/
+int compare( const void* a, const void* b ){
+
+	double x = *(const double*)a, y = *(const double*)b;
+	return ( x > y ) - ( x < y );
+
+}
+
+/*******************************************************************************
+* Name:    verify
+* Purpose: GETs every key from both servers & counts the ones that differ
+* Input:   none
+* Output:  the number of keys that differ (exit()s on failure)
+*******************************************************************************/
+int verify(){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn p, r;
+	char key[32];
+	size_t keyLen, pLen, rLen;
+	char *pVal, *rVal;
+	int pStatus, rStatus, differ = 0;
+
+	if( kvConnect( &p, SERVER, primaryPort ) != KV_OK ||
+	 kvConnect( &r, SERVER, replicaPort ) != KV_OK ){
+		fprintf( stderr, "bench_repl: failed to connect\n" );
+		exit(1);
+	}
+
+	for( int n = 0; n < numKeys; n++ ){
+
+		keyLen = snprintf( key, sizeof(key), "bench_repl:%d", n );
+		pStatus = kvGet( &p, key, keyLen, &pVal, &pLen );
+		rStatus = kvGet( &r, key, keyLen, &rVal, &rLen );
+
+		if( pStatus == KV_ERROR || rStatus == KV_ERROR ){
+			fprintf( stderr, "bench_repl: a GET failed\n" );
+			exit(1);
+		}
+
+		if( pStatus != rStatus || pLen != rLen ||
+		 ( pLen > 0 && memcmp( pVal, rVal, pLen ) != 0 ) )
+			differ++;
+
+		free( pVal );
+		free( rVal );
+
+	}
+
+	kvClose( &p );
+	kvClose( &r );
+	return differ;
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-p port] [-r port] [-n stores] [-b group] "
+	 "[-s bytes] [-k keys]\n", name );
+	fprintf( stderr, "  -p  the primary's port (default: %s)\n", PORT );
+	fprintf( stderr, "  -r  the replica's port (default: %s)\n", REPLICAPORT );
+	fprintf( stderr, "  -n  STOREs to make (default: 200000)\n" );
+	fprintf( stderr, "  -b  STOREs pipelined at a time (default: 64)\n" );
+	fprintf( stderr, "  -s  bytes per value (default: 100)\n" );
+	fprintf( stderr, "  -k  keys they're spread over (default: 10000)\n" );
+	exit(1);
+
+}
+
+/*******************************************************************************
+* Name:    main
+* Purpose: Runs the writer & the prober, & reports
+* Input:   argc - number of command line arguments
+*          argv - the command line arguments
+* Output:  0 if the replica caught up with no keys differing, else 1
+*******************************************************************************/
+int main( int argc, char* argv[] ){
+
+	// VARIABLE DEFINITIONS
+	pthread_t writer, prober;
+	double start, elapsed;
+	int opt, differ;
+
+	while( (opt = getopt( argc, argv, "p:r:n:b:s:k:" )) != -1 ){
+		switch( opt ){
+			case 'p':
+				primaryPort = optarg;
+				break;
+			case 'r':
+				replicaPort = optarg;
+				break;
+			case 'n':
+				numStores = atoi( optarg );
+				break;
+			case 'b':
+				groupSize = atoi( optarg );
+				break;
+			case 's':
+				valSize = atoi( optarg );
+				break;
+			case 'k':
+				numKeys = atoi( optarg );
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	if( numStores < 1 || groupSize < 2 || valSize < 16 || numKeys < 1 )
+		usage( argv[0] );
+
+	numGroups = ( numStores + groupSize - 1 ) / groupSize;
+	acked = calloc( numGroups, sizeof(uint64_t) );
+	lags = calloc( numGroups, sizeof(double) );
+	if( acked == NULL || lags == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+
+	start = now();
+	if( pthread_create( &prober, NULL, probeThread, NULL ) != 0 ||
+	 pthread_create( &writer, NULL, writeThread, NULL ) != 0 ){
+		perror( "pthread_create" );
+		exit(1);
+	}
+
+	pthread_join( writer, NULL );
+	pthread_join( prober, NULL );
+
+	if( failed ){
+		fprintf( stderr, "bench_repl: a request failed\n" );
+		exit(1);
+	}
+
+	elapsed = writerEnd - start;
+	printf( "%d STOREs of %d bytes over %d keys, %d at a time: %.0f STOREs/s "
+	 "(%.1f MB/s)\n", numGroups * groupSize, valSize, numKeys, groupSize,
+	 numGroups * groupSize / elapsed,
+	 (double)numGroups * groupSize * valSize / 1e6 / elapsed );
+
+	qsort( lags, numLags, sizeof(double), compare );
+	if( numLags > 0 )
+		printf( "replica lag over %zu samples: p50 %.3f ms, p99 %.3f ms, max "
+		 "%.3f ms\n", numLags, lags[ numLags / 2 ] * 1e3,
+		 lags[ (size_t)( numLags * 0.99 ) ] * 1e3, lags[ numLags - 1 ] * 1e3 );
+
+	if( caughtUp == 0 ){
+		printf( "the replica never caught up\n" );
+		return 1;
+	}
+	printf( "the replica caught up %.3f ms after the last STORE\n",
+	 ( caughtUp > writerEnd ? caughtUp - writerEnd : 0 ) * 1e3 );
+
+	differ = verify();
+	printf( "%d of %d keys differ between the primary & the replica\n", differ,
+	 numKeys );
+
+	return differ == 0 ? 0 : 1;
+
+}
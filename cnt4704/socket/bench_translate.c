@@ -0,0 +1,211 @@
+/*******************************************************************************
+* File:       bench_translate.c
+* Version:    0.1
+* Purpose:    Microbenchmark of the TRANSLATE kernels in translate.h, against
+*             the original strToUpper() from server.c
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Prints the throughput (MB/s) of each version for a range of
+              buffer sizes. The original strToUpper() calls strlen() on every
+              iteration, so it is quadratic; it is only run on the sizes where
+              it finishes in a reasonable time.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define MINSECS 0.2         // how long to run each measurement for (at least)
+#define MAXORIGINAL 16384   // largest size to run the quadratic original on
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+
+#include "translate.h"
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    strToUpper
+* Purpose: The original TRANSLATE from server.c, unchanged
+* Input:   s - our string to convert
+* Output:  none (s is a pointer, so it is edited directly)
+*******************************************************************************/
+void strToUpper( char* s ){
+	for( size_t i = 0; i<strlen(s); i++ )
+		s[i] = toupper( s[i] );
+}
+
+/*******************************************************************************
+* Name:    original
+* Purpose: Wraps strToUpper() to look like the other versions (it works in
+*          place on a null terminated string)
+* Input:   dst - where to write the converted bytes
+*          src - the bytes to convert
+*          len - the number of bytes to convert
+* Output:  none (dst is a pointer, so it is edited directly)
+*******************************************************************************/
+void original( char* dst, char* src, size_t len ){
+	memcpy( dst, src, len );
+	dst[len] = '\0';
+	strToUpper( dst );
+}
+
+/*******************************************************************************
+* Name:    now
+* Purpose: Reads a monotonic clock
+* Input:   none
+* Output:  the time in seconds
+*******************************************************************************/
+double now(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+/*******************************************************************************
+* Name:    measure
+* Purpose: Runs one version over one buffer size for at least MINSECS
+* Input:   fn  - the version to run
+*          dst - the output buffer
+*          src - the input buffer
+*          len - the number of bytes to convert each time
+* Output:  the throughput in MB/s
+*******************************************************************************/
+double measure( void (*fn)( char*, char*, size_t ), char* dst, char* src, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	double start, elapsed;
+	long iterations = 0;
+
+	start = now();
+	do{
+		fn( dst, src, len );
+		iterations++;
+		elapsed = now() - start;
+	} while( elapsed < MINSECS );
+
+	// make sure the compiler can't throw the work away
+	if( dst[ len / 2 ] == '\1' )
+		printf( "!" );
+
+	return (double)len * iterations / elapsed / 1e6;
+
+}
+
+/*******************************************************************************
+                                   MAIN BODY
+*******************************************************************************/
+
+int main(){
+
+	/***********************
+	* VARIABLE DEFINITIONS *
+	***********************/
+
+	size_t sizes[] = { 16, 100, 1024, 16384, 1024*1024, 16*1024*1024 };
+	int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+	size_t maxSize = sizes[ numSizes-1 ];
+	char* src;
+	char* dst;
+	char* check;
+
+	src = malloc( maxSize + 1 );
+	dst = malloc( maxSize + 1 );
+	check = malloc( maxSize + 1 );
+	if( src == NULL || dst == NULL || check == NULL ){
+		perror( "malloc" );
+		exit(1);
+	}
+
+	// printable text with a mix of cases (no null bytes, for strToUpper())
+	srand( 3331 );
+	for( size_t i = 0; i < maxSize; i++ )
+		src[i] = ' ' + rand() % 95;
+
+	translateInit();
+
+	/**************
+	* CORRECTNESS *
+	**************/
+
+	// every version must agree with the original, byte for byte
+	original( check, src, MAXORIGINAL );
+	translateScalar( dst, src, MAXORIGINAL );
+	if( memcmp( dst, check, MAXORIGINAL ) != 0 ){
+		fprintf( stderr, "scalar version is wrong!\n" );
+		exit(1);
+	}
+	translate( dst + 1, src + 1, MAXORIGINAL - 1 ); // (an unaligned start)
+	if( memcmp( dst + 1, check + 1, MAXORIGINAL - 1 ) != 0 ){
+		fprintf( stderr, "%s version is wrong!\n", translateName );
+		exit(1);
+	}
+
+	/*************
+	* THROUGHPUT *
+	*************/
+
+	printf( "%10s %12s %12s %12s %12s %12s\n", "bytes", "original",
+	 "scalar", "sse2", "avx2", "dispatched" );
+
+	for( int i = 0; i < numSizes; i++ ){
+
+		printf( "%10zu ", sizes[i] );
+
+		if( sizes[i] <= MAXORIGINAL )
+			printf( "%12.1f ", measure( original, dst, src, sizes[i] ) );
+		else
+			printf( "%12s ", "-" );
+
+		printf( "%12.1f ", measure( translateScalar, dst, src, sizes[i] ) );
+
+#ifdef TRANSLATE_X86
+		if( __builtin_cpu_supports( "sse2" ) )
+			printf( "%12.1f ", measure( translateSSE2, dst, src, sizes[i] ) );
+		else
+			printf( "%12s ", "-" );
+
+		if( __builtin_cpu_supports( "avx2" ) )
+			printf( "%12.1f ", measure( translateAVX2, dst, src, sizes[i] ) );
+		else
+			printf( "%12s ", "-" );
+#else
+		printf( "%12s %12s ", "-", "-" );
+#endif
+
+		printf( "%12.1f\n", measure( translate, dst, src, sizes[i] ) );
+
+	}
+
+	printf( "(MB/s; dispatched = %s)\n", translateName );
+
+	/***********
+	* CLEANUP! *
+	***********/
+
+	free( src );
+	free( dst );
+	free( check );
+	return 0;
+
+}
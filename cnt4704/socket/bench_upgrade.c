@@ -0,0 +1,454 @@
+/*******************************************************************************
+* File:       bench_upgrade.c
+* Version:    0.1
+* Purpose:    Benchmark of server.c's upgrades (SIGHUP): keeps connecting,
+*             STOREing & GETting through one, & counts every connection that
+*             was refused & every request that failed
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      -t threads each connect, STORE a value, GET it back & close, over
+              & over, for -d seconds; -c more each keep one connection & GET
+              over it, reconnecting whenever it's closed. After -u seconds it
+              sends SIGHUP to the server with pid -k (or leave -k out & send it
+              yourself), e.g.:
+
+                  ./server -d data &
+                  ./bench_upgrade -k $!
+
+              It prints how many connections were refused (the server wasn't
+              listening) or failed some other way, how many requests failed on
+              a connection that was made, how many times the -c threads had
+              their connections closed under them, the slowest cycle, & the
+              cycles completed in each 100 ms. Then it GETs the last value each
+              -t thread STOREd under each of its keys, to check that the new
+              server has every STORE the old one took.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2 -pthread`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SERVER "localhost"
+#define PORT "3331"
+#define KEYSPER 1000     // keys each -t thread cycles through
+#define SLOTMS 100       // milliseconds per slot of the timeline
+#define MAXSLOTS 6000    // most slots (so -d is at most 10 minutes)
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "kvclient.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one thread's share of the run
+struct runner {
+	pthread_t thread;
+	int       id;
+	int       persistent; // 1 for a -c thread, 0 for a -t thread
+	size_t    cycles;     // connect, STORE & GET, close (or just a GET, -c)
+	size_t    refused;    // connect()s refused
+	size_t    connFailed; // connect()s that failed some other way (or got no
+	                      // greeting)
+	size_t    reqFailed;  // requests that failed on a connection we had
+	size_t    reconnects; // times a -c thread's connection was closed on it
+	double    slowest;    // the longest a cycle took, in seconds
+	unsigned* last;       // the last value STOREd under each key (0 = none)
+};
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+char* port = PORT;      // -p
+int numThreads = 8;     // -t
+int numPersistent = 2;  // -c
+double duration = 6;    // -d
+double upgradeAt = 2;   // -u
+pid_t serverPid = 0;    // -k
+
+struct sockaddr_storage serverAddr;
+socklen_t serverAddrLen;
+
+double start;
+int stopping;                 // 1 once the run is over (atomic)
+size_t timeline[MAXSLOTS];    // cycles completed in each slot (atomic)
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    now
+* Purpose: Reads a monotonic clock
+* Input:   none
+* Output:  the time in seconds
+*******************************************************************************/
+double now(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+
+}
+
+/*******************************************************************************
+* Name:    connectTo
+* Purpose: Connects to the server & reads its greeting, counting why if that
+*          fails
+* Input:   kc - the connection to set up
+*          r  - the thread connecting
+* Output:  KV_OK or KV_ERROR
+*******************************************************************************/
+int connectTo( struct kvconn* kc, struct runner* r ){
+
+	// VARIABLE DEFINITIONS
+	int fd = socket( serverAddr.ss_family, SOCK_STREAM, 0 );
+
+	if( fd == -1 ){
+		perror( "socket" );
+		exit(1);
+	}
+
+	if( connect( fd, (struct sockaddr*)&serverAddr, serverAddrLen ) == -1 ){
+		if( errno == ECONNREFUSED )
+			r->refused++;
+		else
+			r->connFailed++;
+		close( fd );
+		return KV_ERROR;
+	}
+
+	if( kvAttach( kc, fd ) != KV_OK ){
+		r->connFailed++;
+		return KV_ERROR;
+	}
+
+	return KV_OK;
+
+}
+
+/*******************************************************************************
+* Name:    cycle
+* Purpose: One -t cycle: connects, STOREs the next value under one of our
+*          keys, GETs it back & closes
+* Input:   r - the thread
+*          n - the cycle's number (from 1)
+* Output:  none (the outcome is counted in r)
+*******************************************************************************/
+void cycle( struct runner* r, unsigned n ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn kc;
+	char key[64], val[32], *got;
+	size_t keyLen, valLen, gotLen;
+	int k = n % KEYSPER;
+
+	if( connectTo( &kc, r ) != KV_OK )
+		return;
+
+	keyLen = snprintf( key, sizeof(key), "bench_upgrade:%d:%d", r->id, k );
+	valLen = snprintf( val, sizeof(val), "%u", n );
+
+	if( kvStore( &kc, key, keyLen, val, valLen ) != KV_OK ){
+		r->reqFailed++;
+		kvClose( &kc );
+		return;
+	}
+	r->last[k] = n;
+
+	if( kvGet( &kc, key, keyLen, &got, &gotLen ) != KV_OK ||
+	 gotLen != valLen || memcmp( got, val, valLen ) != 0 )
+		r->reqFailed++;
+	else
+		r->cycles++;
+	free( got );
+
+	kvClose( &kc );
+
+}
+
+/*******************************************************************************
+* Name:    runThread
+* Purpose: One thread of the run: -t cycles, or -c GETs on one connection
+* Input:   arg - the thread's struct runner
+* Output:  NULL
+*******************************************************************************/
+void* runThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct runner* r = arg;
+	struct kvconn kc;
+	int connected = 0;
+	double t, took;
+	size_t before;
+	char* val;
+	size_t valLen;
+	int slot;
+
+	for( unsigned n = 1; !__atomic_load_n( &stopping, __ATOMIC_RELAXED ); n++ ){
+
+		t = now();
+		before = r->cycles;
+
+		if( !r->persistent )
+			cycle( r, n );
+
+		// a -c thread's connection closed under it is only a reconnect, but
+		// the GET it was making when that happened has failed
+		else {
+			if( !connected && connectTo( &kc, r ) == KV_OK )
+				connected = 1;
+			if( connected && kvGet( &kc, "", 0, &val, &valLen ) == KV_OK ){
+				free( val );
+				r->cycles++;
+			} else if( connected ){
+				kvClose( &kc );
+				connected = 0;
+				r->reconnects++;
+			}
+		}
+
+		took = now() - t;
+		if( took > r->slowest )
+			r->slowest = took;
+
+		slot = ( now() - start ) * 1000 / SLOTMS;
+		if( r->cycles > before && slot < MAXSLOTS )
+			__atomic_fetch_add( &timeline[slot], 1, __ATOMIC_RELAXED );
+
+	}
+
+	if( connected )
+		kvClose( &kc );
+
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    verify
+* Purpose: GETs the last value each -t thread STOREd under each of its keys
+* Input:   runners - every thread
+* Output:  the number of keys that didn't have it
+*******************************************************************************/
+size_t verify( struct runner* runners ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn kc;
+	char key[64], val[32], *got;
+	size_t keyLen, valLen, gotLen, wrong = 0;
+
+	if( kvConnect( &kc, SERVER, port ) != KV_OK ){
+		fprintf( stderr, "bench_upgrade: failed to connect to check the "
+		 "keys\n" );
+		exit(1);
+	}
+
+	for( int i = 0; i < numThreads; i++ ){
+		for( int k = 0; k < KEYSPER; k++ ){
+
+			if( runners[i].last[k] == 0 )
+				continue;
+
+			keyLen = snprintf( key, sizeof(key), "bench_upgrade:%d:%d", i, k );
+			valLen = snprintf( val, sizeof(val), "%u", runners[i].last[k] );
+
+			if( kvGet( &kc, key, keyLen, &got, &gotLen ) != KV_OK ||
+			 gotLen != valLen || memcmp( got, val, valLen ) != 0 )
+				wrong++;
+			free( got );
+
+		}
+	}
+
+	kvClose( &kc );
+	return wrong;
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-p port] [-t threads] [-c threads] "
+	 "[-d secs] [-u secs] [-k pid]\n", name );
+	fprintf( stderr, "  -p  the server's port (default: %s)\n", PORT );
+	fprintf( stderr, "  -t  threads connecting, STOREing & GETting & closing, "
+	 "over & over (default: 8)\n" );
+	fprintf( stderr, "  -c  threads GETting over one connection each "
+	 "(default: 2)\n" );
+	fprintf( stderr, "  -d  seconds to run for (default: 6)\n" );
+	fprintf( stderr, "  -u  seconds in to send the server SIGHUP (default: "
+	 "2)\n" );
+	fprintf( stderr, "  -k  the server's pid (default: don't send it "
+	 "anything)\n" );
+	exit(1);
+
+}
+
+/*******************************************************************************
+* Name:    main
+* Purpose: Runs every thread, upgrading the server part way through, &
+*          reports
+* Input:   argc - number of command line arguments
+*          argv - the command line arguments
+* Output:  0 if nothing was refused or failed, else 1
+*******************************************************************************/
+int main( int argc, char* argv[] ){
+
+	// VARIABLE DEFINITIONS
+	struct addrinfo hints, *servinfo;
+	struct runner* runners;
+	struct runner total;
+	int opt, status, slots, upgraded = 0;
+	size_t wrong, least = (size_t)-1;
+	int leastSlot = 0;
+
+	while( (opt = getopt( argc, argv, "p:t:c:d:u:k:" )) != -1 ){
+		switch( opt ){
+			case 'p':
+				port = optarg;
+				break;
+			case 't':
+				numThreads = atoi( optarg );
+				break;
+			case 'c':
+				numPersistent = atoi( optarg );
+				break;
+			case 'd':
+				duration = atof( optarg );
+				break;
+			case 'u':
+				upgradeAt = atof( optarg );
+				break;
+			case 'k':
+				serverPid = atoi( optarg );
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	if( numThreads < 1 || numPersistent < 0 || duration <= 0 ||
+	 duration * 1000 / SLOTMS > MAXSLOTS || upgradeAt < 0 || serverPid < 0 )
+		usage( argv[0] );
+
+	// (resolved once, so that every connect() is just a connect())
+	memset( &hints, 0, sizeof(hints) );
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	status = getaddrinfo( SERVER, port, &hints, &servinfo );
+	if( status != 0 ){
+		fprintf( stderr, "getaddrinfo error: %s\n", gai_strerror(status) );
+		exit(1);
+	}
+	memcpy( &serverAddr, servinfo->ai_addr, servinfo->ai_addrlen );
+	serverAddrLen = servinfo->ai_addrlen;
+	freeaddrinfo( servinfo );
+
+	runners = calloc( numThreads + numPersistent, sizeof(struct runner) );
+	if( runners == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+
+	start = now();
+
+	for( int i = 0; i < numThreads + numPersistent; i++ ){
+		runners[i].id = i;
+		runners[i].persistent = i >= numThreads;
+		runners[i].last = calloc( KEYSPER, sizeof(unsigned) );
+		if( runners[i].last == NULL ){
+			perror( "calloc" );
+			exit(1);
+		}
+		if( pthread_create( &runners[i].thread, NULL, runThread,
+		 &runners[i] ) != 0 ){
+			perror( "pthread_create" );
+			exit(1);
+		}
+	}
+
+	while( now() - start < duration ){
+		if( serverPid != 0 && !upgraded && now() - start >= upgradeAt ){
+			if( kill( serverPid, SIGHUP ) == -1 ){
+				perror( "kill" );
+				exit(1);
+			}
+			upgraded = 1;
+		}
+		usleep( 1000 );
+	}
+
+	__atomic_store_n( &stopping, 1, __ATOMIC_RELAXED );
+
+	memset( &total, 0, sizeof(total) );
+	for( int i = 0; i < numThreads + numPersistent; i++ ){
+		pthread_join( runners[i].thread, NULL );
+		total.refused += runners[i].refused;
+		total.connFailed += runners[i].connFailed;
+		total.reqFailed += runners[i].reqFailed;
+		total.reconnects += runners[i].reconnects;
+		if( !runners[i].persistent )
+			total.cycles += runners[i].cycles;
+		if( runners[i].slowest > total.slowest )
+			total.slowest = runners[i].slowest;
+	}
+
+	printf( "%d threads connecting & closing, %d keeping a connection, for "
+	 "%.1f seconds", numThreads, numPersistent, duration );
+	if( upgraded )
+		printf( " (SIGHUP at %.1f)", upgradeAt );
+	printf( "\n" );
+	printf( "cycles: %zu (%.0f/s)\n", total.cycles, total.cycles / duration );
+	printf( "connections refused: %zu, failed otherwise: %zu\n", total.refused,
+	 total.connFailed );
+	printf( "requests failed: %zu; connections closed under -c threads: %zu\n",
+	 total.reqFailed, total.reconnects );
+	printf( "slowest cycle: %.1f ms\n", total.slowest * 1000 );
+
+	// the timeline, 10 slots to a line (leaving off the last, partial, one)
+	slots = duration * 1000 / SLOTMS;
+	printf( "cycles completed per %d ms:", SLOTMS );
+	for( int i = 0; i < slots; i++ ){
+		if( i % 10 == 0 )
+			printf( "\n  %5.1fs", i * SLOTMS / 1000.0 );
+		printf( " %6zu", timeline[i] );
+		if( timeline[i] < least ){
+			least = timeline[i];
+			leastSlot = i;
+		}
+	}
+	printf( "\nfewest in a slot: %zu (at %.1fs)\n", least,
+	 leastSlot * SLOTMS / 1000.0 );
+
+	wrong = verify( runners );
+	printf( "keys without their last value: %zu\n", wrong );
+
+	return total.refused || total.connFailed || total.reqFailed || wrong;
+
+}
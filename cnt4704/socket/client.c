@@ -1,12 +1,13 @@
 /*******************************************************************************
 * File:       client.c
-* Version:    0.7
-* Purpose:    Connects to server.c & implements TRANSLATE, GET, STORE, & EXIT
+* Version:    0.10
+* Purpose:    Connects to server.c & implements TRANSLATE, GET, STORE, CAS, &
+*             EXIT
 * Author:     Michael Altfield <maltfield@knights.ucf.edu>
 * Course:     CNT4707
 * Assignment: 1
 * Created:    2011-10-01
-* Updated:    2011-10-05
+* Updated:    2026-10-18
 * Notes:      Much of this code's base was obtained/modified using:
               http://beej.us/guide/bgnet/
 *******************************************************************************/
@@ -36,6 +37,8 @@
 
 #include <arpa/inet.h>
 
+#include "common.h"
+
 /*******************************************************************************
                            GLOBAL VARIABLE DEFINITIONS                      
 *******************************************************************************/
@@ -46,62 +49,21 @@
                                    FUNCTIONS                                    
 *******************************************************************************/
 
-// TODO: wrap common functions in header file
-
-// get sockaddr, IPv4 or IPv6:
-void *get_in_addr(struct sockaddr *sa)
-{
-    if (sa->sa_family == AF_INET) {
-        return &(((struct sockaddr_in*)sa)->sin_addr);
-    }
-
-    return &(((struct sockaddr_in6*)sa)->sin6_addr);
-}
-
-/*******************************************************************************
-* Name:    sendH
-* Purpose: Helper function to send string data to server
-* Input:   sockfd - socket file descriptor
-*          s      - string to send
-* Output:  none (perror() & exit() program on fail)
-*******************************************************************************/
-void sendH( int sockfd, char* s ){
-
-	// VARIABLE DEFINITIONS
-	int status;
-
-	status = send( sockfd, s, strlen(s), 0 );
-
-	// did the send() succeed?
-	if( status == -1){
-		// there was an error sending; error & exit.
-		perror("send");
-		exit(1);
-	}
-
-}
-
 /*******************************************************************************
-* Name:    recvH
-* Purpose: Helper function to recieve string data from server
-* Input:   sockfd - socket file descriptor
-*          buf    - buffer to store the string data recieved from the server
-* Output:  none (perror() & exit() program on fail)
+* Name:    isCommand
+* Purpose: Checks whether a line of user input is the given command, either on
+*          its own or followed by a key (as in "STORE somekey")
+* Input:   line - the user's input
+*          cmd  - the command name to compare against
+* Output:  1 if the line is the command, 0 otherwise
 *******************************************************************************/
-void recvH( int sockfd, char* buf ){
+int isCommand( char* line, char* cmd ){
 
 	// VARIABLE DEFINITIONS
-	int numbytes;
+	size_t len = strlen(cmd);
 
-	numbytes = recv( sockfd, buf, MAXDATASIZE-1, 0);
-
-	// did the recv() succeed?
-	if( numbytes == -1 ){
-		perror( "recv" );
-		exit(1);
-	}
-
-	buf[numbytes] = '\0';
+	return strncmp( line, cmd, len ) == 0 &&
+	 ( line[len] == '\0' || line[len] == ' ' );
 
 }
 
@@ -181,113 +143,159 @@ void printServerResp( char* s ){
 }
 
 /*******************************************************************************
-                                   MAIN BODY                                    
+* Name:    runBatch
+* Purpose: Non-interactive, pipelined mode. Reads the same input as the
+*          interactive loop (a command per line; the data for TRANSLATE & STORE
+*          on the following lines, ended by "."), but sends every command in
+*          one go & only then reads all of the server's responses.
+* Input:   sockfd - socket file descriptor
+*          in     - the socket's ring buffer
+* Output:  none. the server's responses are printed directly to Standard Out
 *******************************************************************************/
+void runBatch( int sockfd, struct ring* in ){
 
-int main(){
+	// VARIABLE DEFINITIONS
+	char* line = NULL;      // one line of input (getline()'d)
+	size_t lineCap = 0;
+	ssize_t lineLen;
+	char* out = NULL;       // every frame we're going to send
+	size_t outLen = 0, outCap = 0;
+	char* data = NULL;      // the data for one TRANSLATE or STORE
+	size_t dataLen, dataCap = 0;
+	int numFrames = 0;      // the server sends one response per frame
+
+	while( (lineLen = getline( &line, &lineCap, stdin )) != -1 ){
+
+		// chop off the newline & skip blank lines
+		if( lineLen > 0 && line[lineLen-1] == '\n' )
+			line[--lineLen] = '\0';
+		if( lineLen == 0 )
+			continue;
 
-	/***********************
-	* VARIABLE DEFINITIONS *
-	***********************/
+		appendFrame( &out, &outLen, &outCap, line, lineLen );
+		numFrames++;
 
-	int status; // generic varaible for all function call's return status
-	struct addrinfo hints, *servinfo, *p;
-	int sockfd, numbytes;
-	char buf[MAXDATASIZE];
-	char s[INET6_ADDRSTRLEN]; // TODO to IPv4
-	memset( &hints, 0, sizeof(hints) ); // make struct empty
-	hints.ai_family = AF_INET;          // IPv4 only
-	hints.ai_socktype = SOCK_STREAM;    // TCP
+		// do TRANSLATE, STORE & CAS have data lines following them?
+		if( isCommand( line, "TRANSLATE" ) || isCommand( line, "STORE" ) ||
+		 isCommand( line, "STOREX" ) || isCommand( line, "CAS" ) ){
 
-	int sentinel;     // used to exit loops
+			// collect lines up until the "." (joined by newlines, like getLines())
+			dataLen = 0;
+			while( (lineLen = getline( &line, &lineCap, stdin )) != -1 ){
 
-	/****************
-	* getaddrinfo() *
-	****************/
+				if( strcmp( line, ".\n" ) == 0 || strcmp( line, "." ) == 0 )
+					break;
+				if( strcmp( line, "\n" ) == 0 )
+					continue;
 
-	status = getaddrinfo(SERVER, PORT, &hints, &servinfo);
+				appendBytes( &data, &dataLen, &dataCap, line, lineLen );
 
-	// were there errors?
-	if( status != 0 ){
-		// there were errors; alert & exit.
-		fprintf( stderr, "getaddrinfo error: %s\n", gai_strerror(status) );
-		exit(1);
-	}
+			}
 
-	// loop through getaddrinfo()'s results = servinfo
-	for( p = servinfo; p != NULL; p = p->ai_next ){
-		// try to establish a connection with this iteration's addrinfo
+			// delete the last newline, just like getLines() does
+			if( dataLen > 0 && data[dataLen-1] == '\n' )
+				dataLen--;
 
-		/***********
-		* socket() *
-		***********/
+			appendFrame( &out, &outLen, &outCap, data, dataLen );
+			numFrames++;
 
-		sockfd = socket(
-		 servinfo-> ai_family, servinfo->ai_socktype, servinfo->ai_protocol
-		);
+		}
 
-		// could we establish a socket?
-		if( sockfd == -1 ){
-			// socket creation failed
+		// the server hangs up after EXIT, so there's no point sending more
+		if( strcmp( line, "EXIT" ) == 0 )
+			break;
 
-			perror( "client: socket" );
+	}
 
-			// try the next iteration's addrinfo
-			continue;
+	// send all of our commands at once...
+	sendAll( sockfd, out, outLen );
 
+	// ...& then collect all of the responses
+	for( int i = 0; i < numFrames; i++ ){
+
+		// VARIABLE DEFINITIONS
+		char* resp;
+		uint32_t len;
+		char* s;
+
+		recvFrame( sockfd, in, &resp, &len );
+
+		s = malloc( len + 1 );
+		if( s == NULL ){
+			perror( "malloc" );
+			exit(1);
 		}
+		memcpy( s, resp, len );
+		s[len] = '\0';
+		ringConsume( in, len );
 
-		// If we made it this far, the socket has been successfully established.
-		// Now try to establish a connection on the established socket.
+		if( len > 0 )
+			printServerResp( s );
+		else
+			printf( "s: \n" );
 
-		/************
-		* connect() *
-		************/
+		free( s );
 
-		status = connect( sockfd, servinfo->ai_addr, servinfo->ai_addrlen );
+	}
 
-		// could we connect on the new socket?
-		if( status  == -1 ){
-			// we could not connect on the new socket, so close it & error.
+	free( line );
+	free( out );
+	free( data );
 
-			close( sockfd );
-			perror( "client: connect" );
+}
 
-			// now try the next iteration's addrinfo
-			continue;
+/*******************************************************************************
+                                   MAIN BODY                                    
+*******************************************************************************/
 
-		}
+int main( int argc, char* argv[] ){
 
-		// If we made it this far, the connection on the socket is working.
+	/***********************
+	* VARIABLE DEFINITIONS *
+	***********************/
 
-		// break free from this for loop; we don't need to try any other addrinfos
-		break;
+	int status; // generic varaible for all function call's return status
+	int sockfd;
+	char buf[MAXDATASIZE];
+	char s[INET6_ADDRSTRLEN]; // TODO to IPv4
+	struct ring in = { 0 };   // frames recieved from the server
+
+	int sentinel;     // used to exit loops
+	int batch = 0;    // pipeline commands from stdin rather than prompting?
+	int opt;
+
+	/********************
+	* COMMAND LINE ARGS *
+	********************/
+
+	while( (opt = getopt( argc, argv, "b" )) != -1 ){
+		switch( opt ){
+			case 'b':
+				batch = 1;
+				break;
+			default:
+				fprintf( stderr, "usage: %s [-b]\n", argv[0] );
+				fprintf( stderr, "  -b  batch mode: pipeline every command from stdin\n" );
+				exit(1);
+		}
+	}
 
-	} // end for each getaddrinfo() result
+	/************
+	* connect() *
+	************/
 
-	// is p pointing to NULL?
-	if( p == NULL ){
-		// p is pointing to null, which means we iterated through all of the
-		// getaddrinfo() results (trying to connect at each iteration), and made
-		// it to the end of the results, still without a connection.
+	sockfd = connectServer( SERVER, PORT, s, sizeof(s) );
 
+	// did we fail to connect to any of the server's addresses?
+	if( sockfd == -1 ){
 		fprintf( stderr, "client: failed to connect\n" );
 		return 2;
 	}
 
-	inet_ntop(
-	 p->ai_family, &( ( (struct sockaddr_in*)p->ai_addr)->sin_addr), s, sizeof(s)
-	);
 	printf( "client: connecting to %s\n", s );
 
-	// get the number of bytes recieved
-	numbytes = recv( sockfd, buf, MAXDATASIZE-1, 0);
-	if( numbytes == -1 ){
-		perror( "recv" );
-		exit(1);
-	}
-
-	buf[numbytes] = '\0';
+	// get the server's greeting
+	recvH( sockfd, &in, buf, sizeof(buf) );
 
 	/**********************
 	* OUTPUT DATA TO USER *
@@ -295,6 +303,24 @@ int main(){
 
 	printf( "client: recieved '%s'\n", buf );
 
+	// did the server turn us away?
+	if( strncmp( buf, "503", 3 ) == 0 ){
+		ringFree( &in );
+		close(sockfd);
+		return 2;
+	}
+
+	/*************
+	* BATCH MODE *
+	*************/
+
+	if( batch ){
+		runBatch( sockfd, &in );
+		ringFree( &in );
+		close(sockfd);
+		return 0;
+	}
+
 	/*******************
 	* INTERACTIVE LOOP *
 	*******************/
@@ -305,18 +331,27 @@ int main(){
 	do{
 
 		// DECLARE VARIABLES
-		char command[10]; // store user inputted command
+		char command[MAXDATASIZE]; // store user inputted command (& maybe key)
 		char resp[100];   // store user inputted response
 
 		// prompt the user for the command to send to the server
 		printf( "c: " );
-		scanf( "%s", (char *)&command );
+
+		// read the whole line, so that GET & STORE can be given a key; if stdin
+		// runs out, say goodbye to the server properly
+		if( fgets( command, sizeof(command), stdin ) == NULL )
+			strcpy( command, "EXIT" );
+		command[ strcspn( command, "\n" ) ] = '\0';
+
+		// skip blank lines
+		if( command[0] == '\0' )
+			continue;
 
 		// send command to server
 		sendH( sockfd, command );
 
 		// get server's response & print to user
-		recvH( sockfd, buf );
+		recvH( sockfd, &in, buf, sizeof(buf) );
 		printf( "s: %s\n", buf );
 
 		/************
@@ -338,18 +373,19 @@ int main(){
 			// send the user's inputted data to the server
 			sendH( sockfd, resp );
 
-			recvH( sockfd, buf );   // get the TRANSLATE'd data
+			recvH( sockfd, &in, buf, sizeof(buf) );   // get the TRANSLATE'd data
 			printServerResp( buf ); // print the server's response
 
 			continue;
 		}
 
-		/********
-		* STORE *
-		********/
+		/**********************
+		* STORE, STOREX & CAS *
+		**********************/
 
-		status = strcmp( command, "STORE" );
-		if( status == 0 ){
+		status = isCommand( command, "STORE" ) || isCommand( command, "STOREX" ) ||
+		 isCommand( command, "CAS" );
+		if( status == 1 ){
 
 			status = strcmp( buf, OK );
 			// did the server respond with an OK?
@@ -363,7 +399,7 @@ int main(){
 			// send the user's inputted data to the server
 			sendH( sockfd, resp );
 
-			recvH( sockfd, buf );   // get the server's response
+			recvH( sockfd, &in, buf, sizeof(buf) );   // get the server's response
 			printServerResp( buf );
 
 			continue;
@@ -375,8 +411,7 @@ int main(){
 
 		status = strcmp( command, "EXIT" );
 		if( status == 0 ){
-			sendH( sockfd, command );
-			recvH( sockfd, buf );
+			// the server already OK'd our EXIT above
 			sentinel = 1;
 		}
 
@@ -386,7 +421,7 @@ int main(){
 	* CLEANUP! *
 	***********/
 
-	freeaddrinfo(servinfo);
+	ringFree( &in );
 	close(sockfd);
 	return 0;
 
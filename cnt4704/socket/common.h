@@ -0,0 +1,744 @@
+/*******************************************************************************
+* File:       common.h
+* Version:    0.4
+* Purpose:    Functions shared by server.c, client.c & loadgen.c: connecting,
+*             length-prefixed framing of every message, & the ring buffer
+*             that reassembles frames
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      TCP is a byte stream, not a message stream: one recv() can return
+              half of a message, or several messages glued together. So every
+              message on the wire is a frame: a 4 byte length (network byte
+              order) followed by exactly that many bytes of payload.
+
+              Each end of a connection recv()s into a ring buffer, which holds
+              partial frames until the rest arrives & lets us pick every
+              complete frame out of a single recv().
+*******************************************************************************/
+
+#ifndef COMMON_H
+#define COMMON_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define FRAMEHDRSIZE 4                // size of the length that prefixes frames
+#define MAXFRAMESIZE (64*1024*1024)  // largest frame payload we'll accept
+#define RINGSIZE 4096                 // initial ring buffer size (power of 2)
+#define MISSING 0xffffffff            // MGET's length for a key that isn't there
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// a ring buffer of bytes recieved from a socket. head & tail only ever count
+// up; we mask them with (cap-1) to find where they point within buf.
+struct ring {
+	char*  buf;  // the bytes themselves (NULL until the first ringRecv())
+	size_t cap;  // size of buf; always a power of two
+	size_t head; // total number of bytes consumed from this ring
+	size_t tail; // total number of bytes recieved into this ring
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+// get sockaddr, IPv4 or IPv6:
+static inline void *get_in_addr(struct sockaddr *sa)
+{
+    if (sa->sa_family == AF_INET) {
+        return &(((struct sockaddr_in*)sa)->sin_addr);
+    }
+
+    return &(((struct sockaddr_in6*)sa)->sin6_addr);
+}
+
+/*******************************************************************************
+* Name:    connectServer
+* Purpose: Connects a TCP socket to the server
+* Input:   host     - the server's hostname
+*          port     - the server's port
+*          addr     - where to write the address we connected to (for logging)
+*          addrSize - the size of addr
+* Output:  the connected socket, or -1 if we couldn't connect
+*******************************************************************************/
+static inline int connectServer( char* host, char* port, char* addr,
+ size_t addrSize ){
+
+	// VARIABLE DEFINITIONS
+	struct addrinfo hints, *servinfo, *p;
+	int status;
+	int sockfd = -1;
+
+	memset( &hints, 0, sizeof(hints) ); // make struct empty
+	hints.ai_family = AF_INET;          // IPv4 only
+	hints.ai_socktype = SOCK_STREAM;    // TCP
+
+	/****************
+	* getaddrinfo() *
+	****************/
+
+	status = getaddrinfo( host, port, &hints, &servinfo );
+
+	// were there errors?
+	if( status != 0 ){
+		fprintf( stderr, "getaddrinfo error: %s\n", gai_strerror(status) );
+		return -1;
+	}
+
+	// loop through getaddrinfo()'s results = servinfo
+	for( p = servinfo; p != NULL; p = p->ai_next ){
+
+		sockfd = socket( p->ai_family, p->ai_socktype | SOCK_CLOEXEC,
+		 p->ai_protocol );
+
+		// could we establish a socket?
+		if( sockfd == -1 ){
+			perror( "socket" );
+			continue;
+		}
+
+		// could we connect on the new socket?
+		if( connect( sockfd, p->ai_addr, p->ai_addrlen ) == -1 ){
+			close( sockfd );
+			sockfd = -1;
+			perror( "connect" );
+			continue;
+		}
+
+		// the connection is working; we don't need to try any other addrinfos
+		inet_ntop(
+		 p->ai_family, &( ( (struct sockaddr_in*)p->ai_addr)->sin_addr),
+		 addr, addrSize
+		);
+		break;
+
+	}
+
+	freeaddrinfo( servinfo );
+	return sockfd;
+
+}
+
+/*******************************************************************************
+* Name:    connectLocal
+* Purpose: Connects to the server's Unix socket (its -U), on our own host
+* Input:   path - the socket's path
+* Output:  the connected socket, or -1 if we couldn't connect
+*******************************************************************************/
+static inline int connectLocal( char* path ){
+
+	// VARIABLE DEFINITIONS
+	struct sockaddr_un addr;
+	int sockfd;
+
+	if( strlen( path ) >= sizeof(addr.sun_path) ){
+		fprintf( stderr, "%s is too long for a Unix socket\n", path );
+		return -1;
+	}
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+
+	sockfd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+	if( sockfd == -1 ){
+		perror( "socket" );
+		return -1;
+	}
+
+	if( connect( sockfd, (struct sockaddr*)&addr, sizeof(addr) ) == -1 ){
+		perror( "connect" );
+		close( sockfd );
+		return -1;
+	}
+
+	return sockfd;
+
+}
+
+/*******************************************************************************
+* Name:    ringUsed
+* Purpose: Tells how many recieved bytes are waiting in a ring
+* Input:   r - the ring
+* Output:  the number of bytes that have been recieved but not consumed
+*******************************************************************************/
+static inline size_t ringUsed( struct ring* r ){
+	return r->tail - r->head;
+}
+
+/*******************************************************************************
+* Name:    ringResize
+* Purpose: Moves a ring's contents into a new buffer of (at least) the given
+*          size, starting at the front of the buffer so that they don't wrap
+* Input:   r   - the ring
+*          cap - the minimum size of the new buffer
+* Output:  0 on success, -1 if we ran out of memory (the ring is untouched)
+*******************************************************************************/
+static inline int ringResize( struct ring* r, size_t cap ){
+
+	// VARIABLE DEFINITIONS
+	size_t newCap = RINGSIZE;
+	size_t used = ringUsed( r );
+	size_t first;
+	char* newBuf;
+
+	while( newCap < cap || newCap < used )
+		newCap *= 2;
+
+	newBuf = malloc( newCap );
+	if( newBuf == NULL )
+		return -1;
+
+	// copy the (possibly wrapped) contents in at most two pieces
+	if( used > 0 ){
+
+		first = r->cap - (r->head & (r->cap-1));
+		if( first > used )
+			first = used;
+
+		memcpy( newBuf, r->buf + (r->head & (r->cap-1)), first );
+		memcpy( newBuf + first, r->buf, used - first );
+
+	}
+
+	free( r->buf );
+	r->buf = newBuf;
+	r->cap = newCap;
+	r->head = 0;
+	r->tail = used;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    ringRecv
+* Purpose: Recieves as much as will fit into a ring's free space with a single
+*          readv() (the free space may wrap around the end of the buffer)
+* Input:   r  - the ring to recieve into
+*          fd - the socket to recieve from
+* Output:  the number of bytes recieved, 0 if the peer hung up, or -1 on error
+*          (with errno set, so EAGAIN can be told apart from real errors)
+*******************************************************************************/
+static inline ssize_t ringRecv( struct ring* r, int fd ){
+
+	// VARIABLE DEFINITIONS
+	struct iovec iov[2];
+	size_t tailIdx, headIdx;
+	int iovcnt;
+	ssize_t numbytes;
+
+	// is the ring full (or not yet allocated)?
+	if( r->buf == NULL || ringUsed( r ) == r->cap ){
+		if( ringResize( r, r->cap * 2 ) == -1 ){
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+	tailIdx = r->tail & (r->cap-1);
+	headIdx = r->head & (r->cap-1);
+
+	// does the free space wrap around the end of the buffer? (the ring isn't
+	// full, so tailIdx == headIdx can only mean that it is empty)
+	if( tailIdx >= headIdx ){
+
+		iov[0].iov_base = r->buf + tailIdx;
+		iov[0].iov_len = r->cap - tailIdx;
+		iov[1].iov_base = r->buf;
+		iov[1].iov_len = headIdx;
+		iovcnt = headIdx ? 2 : 1;
+
+	} else {
+
+		iov[0].iov_base = r->buf + tailIdx;
+		iov[0].iov_len = headIdx - tailIdx;
+		iovcnt = 1;
+
+	}
+
+	numbytes = readv( fd, iov, iovcnt );
+
+	if( numbytes > 0 )
+		r->tail += numbytes;
+
+	return numbytes;
+
+}
+
+/*******************************************************************************
+* Name:    ringAppend
+* Purpose: Copies bytes that were recieved somewhere else (e.g. into one of
+*          io_uring's buffers) onto the end of a ring, growing it if needed
+* Input:   r    - the ring
+*          data - the bytes to append
+*          len  - the number of bytes to append
+* Output:  0 on success, -1 if we ran out of memory (the ring is untouched)
+*******************************************************************************/
+static inline int ringAppend( struct ring* r, char* data, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	size_t tailIdx, first;
+
+	// is there room (or a buffer at all)?
+	if( r->buf == NULL || r->cap - ringUsed( r ) < len ){
+		if( ringResize( r, ringUsed( r ) + len ) == -1 )
+			return -1;
+	}
+
+	// copy in at most two pieces, in case the free space wraps
+	tailIdx = r->tail & (r->cap-1);
+	first = r->cap - tailIdx;
+	if( first > len )
+		first = len;
+
+	memcpy( r->buf + tailIdx, data, first );
+	memcpy( r->buf, data + first, len - first );
+	r->tail += len;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    ringHdr
+* Purpose: Reads the length prefix of the frame at the front of a ring, without
+*          waiting for (or checking on) the rest of the frame
+* Input:   r   - the ring
+*          len - set to the length of the frame's payload
+* Output:  1 if the whole length prefix has arrived, 0 if not
+*******************************************************************************/
+static inline int ringHdr( struct ring* r, uint32_t* len ){
+
+	// VARIABLE DEFINITIONS
+	unsigned char hdr[FRAMEHDRSIZE];
+
+	// have we even got the whole length prefix yet?
+	if( ringUsed( r ) < FRAMEHDRSIZE )
+		return 0;
+
+	// read the length prefix, one byte at a time since it may wrap
+	for( int i = 0; i < FRAMEHDRSIZE; i++ )
+		hdr[i] = r->buf[ (r->head + i) & (r->cap-1) ];
+
+	*len = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) |
+	       ((uint32_t)hdr[2] << 8)  |  (uint32_t)hdr[3];
+
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    ringFrame
+* Purpose: Looks for a complete frame at the front of a ring. If the frame is
+*          bigger than the ring, the ring is grown so that the rest can arrive.
+*          If the frame wraps around the end of the ring, the ring is rearranged
+*          so that the caller gets the payload in one piece.
+* Input:   r    - the ring
+*          data - set to point at the frame's payload (inside the ring)
+*          len  - set to the length of the frame's payload
+* Output:  1 if a frame was found (call ringConsume() when done with it), 0 if
+*          we need to recieve more first, or -1 if the frame is invalid/too big
+*          or we ran out of memory
+*******************************************************************************/
+static inline int ringFrame( struct ring* r, char** data, uint32_t* len ){
+
+	// VARIABLE DEFINITIONS
+	size_t headIdx;
+
+	// have we even got the whole length prefix yet?
+	if( ringHdr( r, len ) == 0 )
+		return 0;
+
+	if( *len > MAXFRAMESIZE )
+		return -1;
+
+	// will the whole frame fit in the ring at all?
+	if( FRAMEHDRSIZE + *len > r->cap ){
+		if( ringResize( r, FRAMEHDRSIZE + *len ) == -1 )
+			return -1;
+	}
+
+	// have we recieved the whole frame yet?
+	if( ringUsed( r ) < FRAMEHDRSIZE + *len )
+		return 0;
+
+	// does the frame wrap around the end of the ring?
+	headIdx = r->head & (r->cap-1);
+	if( headIdx + FRAMEHDRSIZE + *len > r->cap ){
+		// it does; straighten the ring out
+		if( ringResize( r, r->cap ) == -1 )
+			return -1;
+		headIdx = 0;
+	}
+
+	*data = r->buf + headIdx + FRAMEHDRSIZE;
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    ringPeek
+* Purpose: Finds the raw bytes at the front of a ring, for callers that handle
+*          a frame's payload piece by piece as it arrives
+* Input:   r    - the ring
+*          data - set to point at the bytes (inside the ring)
+*          max  - the most bytes the caller wants
+* Output:  the number of bytes at data (at most max; fewer if the bytes wrap
+*          around the end of the ring, in which case call again after
+*          ringSkip() for the rest). call ringSkip() when done with them.
+*******************************************************************************/
+static inline size_t ringPeek( struct ring* r, char** data, size_t max ){
+
+	// VARIABLE DEFINITIONS
+	size_t headIdx = r->head & (r->cap-1);
+	size_t len = ringUsed( r );
+
+	if( len > r->cap - headIdx )
+		len = r->cap - headIdx;
+	if( len > max )
+		len = max;
+
+	*data = r->buf + headIdx;
+	return len;
+
+}
+
+/*******************************************************************************
+* Name:    ringSkip
+* Purpose: Discards raw bytes from the front of a ring
+* Input:   r - the ring
+*          n - the number of bytes to discard
+* Output:  none
+*******************************************************************************/
+static inline void ringSkip( struct ring* r, size_t n ){
+
+	r->head += n;
+
+	// once the ring is empty, start back at the front of the buffer
+	if( r->head == r->tail )
+		r->head = r->tail = 0;
+
+}
+
+/*******************************************************************************
+* Name:    ringConsume
+* Purpose: Discards the frame at the front of a ring (found with ringFrame())
+* Input:   r   - the ring
+*          len - the length of the frame's payload
+* Output:  none
+*******************************************************************************/
+static inline void ringConsume( struct ring* r, uint32_t len ){
+	ringSkip( r, FRAMEHDRSIZE + len );
+}
+
+/*******************************************************************************
+* Name:    ringFree
+* Purpose: Frees a ring's buffer
+* Input:   r - the ring
+* Output:  none
+*******************************************************************************/
+static inline void ringFree( struct ring* r ){
+	free( r->buf );
+	memset( r, 0, sizeof(*r) );
+}
+
+/*******************************************************************************
+* Name:    frameHdr
+* Purpose: Encodes the length prefix for a frame
+* Input:   hdr - FRAMEHDRSIZE bytes to write the prefix into
+*          len - the length of the frame's payload
+* Output:  none (hdr is a pointer, so it is edited directly)
+*******************************************************************************/
+static inline void frameHdr( char* hdr, uint32_t len ){
+
+	hdr[0] = (len >> 24) & 0xff;
+	hdr[1] = (len >> 16) & 0xff;
+	hdr[2] = (len >> 8) & 0xff;
+	hdr[3] = len & 0xff;
+
+}
+
+/*******************************************************************************
+* Name:    frameLen
+* Purpose: Decodes a length encoded by frameHdr() (e.g. one of the lengths
+*          inside an MGET response or MSTORE's data)
+* Input:   hdr - the FRAMEHDRSIZE bytes holding the length
+* Output:  the length
+*******************************************************************************/
+static inline uint32_t frameLen( char* hdr ){
+
+	// VARIABLE DEFINITIONS
+	unsigned char* h = (unsigned char*)hdr;
+
+	return ((uint32_t)h[0] << 24) | ((uint32_t)h[1] << 16) |
+	       ((uint32_t)h[2] << 8)  |  (uint32_t)h[3];
+
+}
+
+/*******************************************************************************
+* Name:    appendBytes
+* Purpose: Adds bytes to the end of a growing buffer
+* Input:   buf  - the buffer (realloc()'d as needed)
+*          len  - the number of bytes in the buffer (updated)
+*          cap  - the allocated size of the buffer (updated)
+*          data - the bytes to add
+*          n    - the number of bytes to add
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+static inline void appendBytes( char** buf, size_t* len, size_t* cap,
+ char* data, size_t n ){
+
+	// do we need to grow the buffer?
+	if( *len + n > *cap ){
+
+		// VARIABLE DEFINITIONS
+		size_t newCap = *cap ? *cap : RINGSIZE;
+		char* newBuf;
+
+		while( newCap < *len + n )
+			newCap *= 2;
+
+		newBuf = realloc( *buf, newCap );
+		if( newBuf == NULL ){
+			perror( "realloc" );
+			exit(1);
+		}
+
+		*buf = newBuf;
+		*cap = newCap;
+
+	}
+
+	memcpy( *buf + *len, data, n );
+	*len += n;
+
+}
+
+/*******************************************************************************
+* Name:    appendFrame
+* Purpose: Adds a frame to the end of a growing buffer of frames
+* Input:   buf  - the buffer of frames (realloc()'d as needed)
+*          len  - the number of bytes in the buffer (updated)
+*          cap  - the allocated size of the buffer (updated)
+*          data - the frame's payload
+*          n    - the length of the frame's payload
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+static inline void appendFrame( char** buf, size_t* len, size_t* cap,
+ char* data, size_t n ){
+
+	// VARIABLE DEFINITIONS
+	char hdr[FRAMEHDRSIZE];
+
+	frameHdr( hdr, n );
+	appendBytes( buf, len, cap, hdr, FRAMEHDRSIZE );
+	appendBytes( buf, len, cap, data, n );
+
+}
+
+/*******************************************************************************
+* Name:    sendFrame
+* Purpose: Sends a frame to a blocking socket (length prefix & payload are
+*          sent together with one sendmsg())
+* Input:   sockfd - socket file descriptor
+*          data   - the frame's payload
+*          len    - the length of the frame's payload
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+static inline void sendFrame( int sockfd, char* data, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	char hdr[FRAMEHDRSIZE];
+	struct iovec iov[2];
+	struct msghdr msg;
+	ssize_t numbytes;
+	size_t sent;
+
+	frameHdr( hdr, len );
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = FRAMEHDRSIZE;
+	iov[1].iov_base = data;
+	iov[1].iov_len = len;
+
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	// keep going until the whole frame has been sent
+	while( msg.msg_iovlen > 0 ){
+
+		numbytes = sendmsg( sockfd, &msg, MSG_NOSIGNAL );
+
+		// did the send() succeed?
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			// there was an error sending; error & exit.
+			perror("send");
+			exit(1);
+		}
+
+		// skip past whatever was sent
+		sent = (size_t)numbytes;
+		while( msg.msg_iovlen > 0 && sent >= msg.msg_iov->iov_len ){
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if( msg.msg_iovlen > 0 ){
+			msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    sendAll
+* Purpose: Sends a whole buffer to a blocking socket, however many send()s it
+*          takes (e.g. many frames built up to be sent at once)
+* Input:   sockfd - socket file descriptor
+*          buf    - the bytes to send
+*          len    - the number of bytes to send
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+static inline void sendAll( int sockfd, char* buf, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	while( len > 0 ){
+
+		numbytes = send( sockfd, buf, len, MSG_NOSIGNAL );
+
+		// did the send() succeed?
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			// there was an error sending; error & exit.
+			perror("send");
+			exit(1);
+		}
+
+		buf += numbytes;
+		len -= numbytes;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    sendH
+* Purpose: Helper function to send string data as one frame
+* Input:   sockfd - socket file descriptor
+*          s      - string to send
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+static inline void sendH( int sockfd, char* s ){
+	sendFrame( sockfd, s, strlen(s) );
+}
+
+/*******************************************************************************
+* Name:    recvFrame
+* Purpose: Recieves until there is a whole frame at the front of a ring. Any
+*          frames that arrive along with it stay in the ring for the next call.
+* Input:   sockfd - socket file descriptor
+*          r      - this socket's ring buffer
+*          data   - set to point at the frame's payload (inside the ring)
+*          len    - set to the length of the frame's payload
+* Output:  none; call ringConsume() when done with the frame (perror() &
+*          exit() program on fail)
+*******************************************************************************/
+static inline void recvFrame( int sockfd, struct ring* r, char** data,
+ uint32_t* len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+	int status;
+
+	// recieve until there is a whole frame in the ring
+	while( (status = ringFrame( r, data, len )) == 0 ){
+
+		numbytes = ringRecv( r, sockfd );
+
+		// did the recv() succeed?
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			perror( "recv" );
+			exit(1);
+		}
+
+		if( numbytes == 0 ){
+			fprintf( stderr, "recv: connection closed by peer\n" );
+			exit(1);
+		}
+
+	}
+
+	if( status == -1 ){
+		fprintf( stderr, "recv: invalid frame\n" );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    recvH
+* Purpose: Helper function to recieve one frame of string data
+* Input:   sockfd - socket file descriptor
+*          r      - this socket's ring buffer
+*          buf    - buffer to store the string data recieved
+*          size   - size of buf (longer frames are truncated to fit)
+* Output:  the frame's full length (perror() & exit() program on fail)
+*******************************************************************************/
+static inline uint32_t recvH( int sockfd, struct ring* r, char* buf,
+ size_t size ){
+
+	// VARIABLE DEFINITIONS
+	char* data;
+	uint32_t len;
+
+	recvFrame( sockfd, r, &data, &len );
+
+	// copy out as much as fits, leaving room for the null terminator
+	if( len < size ){
+		memcpy( buf, data, len );
+		buf[len] = '\0';
+	} else {
+		memcpy( buf, data, size-1 );
+		buf[size-1] = '\0';
+	}
+
+	ringConsume( r, len );
+	return len;
+
+}
+
+#endif
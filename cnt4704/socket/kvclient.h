@@ -0,0 +1,1166 @@
+/*******************************************************************************
+* File:       kvclient.h
+* Version:    0.5
+* Purpose:    A client library for server.c, for programs that talk to the
+*             server themselves rather than through client.c: plain calls
+*             (kvGet(), kvStore(), kvTranslate(), kvGetV() & kvCas()), a
+*             thread-safe pool of connections, & asynchronous pipelined
+*             batches
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Nothing in here exit()s (short of running out of memory); every
+              call returns one of the KV_* statuses instead. A connection that
+              fails is marked broken & should be closed (a pool does this
+              itself).
+
+              Plain calls make one round trip each:
+
+                  struct kvconn kc;
+                  kvConnect( &kc, "localhost", "3331" );
+                  kvStore( &kc, "k", 1, "v", 1 );
+                  kvGet( &kc, "k", 1, &val, &valLen );  // free(val) after
+                  kvClose( &kc );
+
+              kvGetV() also gets the value's version & kvCas() stores only if
+              the key still has the version given, so a read-modify-write
+              needs no lock, just a retry when it says KV_CONFLICT:
+
+                  do {
+                      kvGetV( &kc, "n", 1, &val, &valLen, &version );
+                      ...work out the new value from val...
+                  } while( kvCas( &kc, "n", 1, new, newLen, &version ) ==
+                   KV_CONFLICT );
+
+              A pool hands out up to a fixed number of connections (opened as
+              they're first needed) to any number of threads; kvPoolGet()
+              waits when every connection is in use.
+
+              kvSubmit() queues a batch of struct kvreqs & returns at once.
+              The pool's lane threads (one per connection) each take up to
+              KVPIPE queued requests, send all of them in one go, & collect
+              the responses as they arrive, so a batch costs about one round
+              trip per KVPIPE requests per connection rather than one per
+              request. Each request's callback (if any) is called from a lane
+              thread when it completes; kvWait() blocks until it has.
+
+              A connection that is also reading while it sends never blocks
+              with both sides' socket buffers full, however big the batch.
+
+              On the server's own host, kvConnectLocal() connects to its Unix
+              socket (its -U) instead of over TCP, & with shm set, moves the
+              connection onto shared memory (see shm.h) before it's used:
+
+                  kvConnectLocal( &kc, "/tmp/kvserver.sock", 1 );
+
+              Every call works the same either way. On shared memory, a call
+              waiting on the server checks its ring SHMSPIN times before it
+              sleeps (if there's more than one CPU for the server to be on).
+
+              Every function here (& in common.h & shm.h) is static inline,
+              so any number of a program's files can include this.
+
+              Please compile with `gcc --std=gnu99 -pthread`
+*******************************************************************************/
+
+#ifndef KVCLIENT_H
+#define KVCLIENT_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define KVPIPE 128 // most requests a lane sends on a connection in one go
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "shm.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// what became of a request
+#define KV_OK        0  // it worked
+#define KV_NOTFOUND  1  // GET of a key that isn't stored
+#define KV_CONFLICT  2  // CAS of a key that doesn't have the version given
+#define KV_ERROR    -1  // the server refused it, or the connection failed
+#define KV_PENDING  -2  // (submitted but not yet complete)
+
+// the requests we can make
+#define KV_GET       0
+#define KV_STORE     1
+#define KV_TRANSLATE 2
+#define KV_GETV      3
+#define KV_CAS       4
+
+// one connection to the server; only one thread may use it at a time
+struct kvconn {
+	int fd;
+	struct ring in;      // frames recieved from the server
+	int broken;          // did the connection fail? (then just close it)
+	struct kvconn* next; // the next idle connection (in a pool)
+	struct shm shm;      // our rings, once we're on shared memory
+	int spin;            // ...& times to check them before sleeping
+};
+
+// one request. the caller owns it (& key & data), & must keep all of them
+// around until it completes.
+struct kvreq {
+	int op;              // KV_GET, KV_STORE, KV_TRANSLATE, KV_GETV or KV_CAS
+	char* key;           // GET, STORE, GETV & CAS
+	size_t keyLen;
+	char* data;          // STORE, TRANSLATE & CAS
+	size_t dataLen;
+	unsigned ttl;        // STORE: seconds until the key expires (0 = never)
+	uint64_t version;    // CAS: the version the key must have (0 = none); set
+	                     // to the value's version by GETV & (a successful) CAS
+
+	// called (from a lane thread) when the request completes; optional
+	void (*callback)( struct kvreq* req );
+	void* arg;           // for the callback's use
+
+	// results
+	int status;          // one of the KV_* statuses
+	char* result;        // GET's value or TRANSLATE's data (malloc()'d; the
+	size_t resultLen;    // caller free()s it), else NULL
+
+	// bookkeeping
+	int frames;          // response frames recieved so far
+	int failed;          // ...& whether any of them was an error
+	int done;            // has it completed (& had its callback called)?
+	struct kvpool* pool; // the pool it was submitted to
+	struct kvreq* next;  // the next request in the pool's queue
+};
+
+// a pool of connections to one server
+struct kvpool {
+	char* host;
+	char* port;
+	int size;                // most connections we'll open
+	int open;                // connections open (or being opened)
+	struct kvconn* idle;     // connections not in use
+
+	struct kvreq* queue;     // submitted requests no lane has taken yet
+	struct kvreq* queueTail;
+	int stopping;            // set by kvPoolDestroy()
+	pthread_t* lanes;
+
+	pthread_mutex_t lock;    // guards everything above
+	pthread_cond_t  freed;   // signalled when a connection is put back
+	pthread_cond_t  work;    // signalled when requests are submitted
+	pthread_cond_t  done;    // broadcast when requests complete
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    kvAttach
+* Purpose: Sets up a connection on a socket that's already connected to the
+*          server, & reads its greeting
+* Input:   kc - the struct kvconn to set up
+*          fd - the socket (closed if this fails)
+* Output:  KV_OK, or KV_ERROR if the connection failed (or the server was too
+*          busy to take us)
+*******************************************************************************/
+static inline int kvAttach( struct kvconn* kc, int fd ){
+
+	// VARIABLE DEFINITIONS
+	char* data;
+	uint32_t len;
+	ssize_t numbytes;
+	int status;
+
+	memset( kc, 0, sizeof(*kc) );
+	kc->fd = fd;
+
+	// wait for the greeting
+	while( (status = ringFrame( &kc->in, &data, &len )) == 0 ){
+		numbytes = ringRecv( &kc->in, kc->fd );
+		if( numbytes == -1 && errno == EINTR )
+			continue;
+		if( numbytes <= 0 )
+			break;
+	}
+
+	// is it a refusal (BUSY) instead?
+	if( status == 1 && len >= 3 && memcmp( data, "503", 3 ) == 0 )
+		status = -1;
+
+	if( status != 1 ){
+		close( kc->fd );
+		ringFree( &kc->in );
+		return KV_ERROR;
+	}
+
+	ringConsume( &kc->in, len );
+	return KV_OK;
+
+}
+
+/*******************************************************************************
+* Name:    kvConnect
+* Purpose: Connects to the server & reads its greeting
+* Input:   kc   - the struct kvconn to set up
+*          host - the server's hostname
+*          port - the server's port
+* Output:  KV_OK, or KV_ERROR if we couldn't connect (or the server was too
+*          busy to take us)
+*******************************************************************************/
+static inline int kvConnect( struct kvconn* kc, char* host, char* port ){
+
+	// VARIABLE DEFINITIONS
+	char addr[INET6_ADDRSTRLEN];
+	int fd;
+
+	memset( kc, 0, sizeof(*kc) );
+
+	fd = connectServer( host, port, addr, sizeof(addr) );
+	if( fd == -1 )
+		return KV_ERROR;
+
+	return kvAttach( kc, fd );
+
+}
+
+/*******************************************************************************
+* Name:    kvShm
+* Purpose: Moves a connection to the server's Unix socket onto shared memory
+*          (it must not have been used yet)
+* Input:   kc - the connection
+* Output:  KV_OK, or KV_ERROR if the server refused (the connection carries on
+*          over the socket) or the connection failed (it's marked broken)
+*******************************************************************************/
+static inline int kvShm( struct kvconn* kc ){
+
+	// VARIABLE DEFINITIONS
+	char frame[FRAMEHDRSIZE + 3];
+	int fds[3] = { -1, -1, -1 }, got[3];
+	char* data;
+	uint32_t len;
+	ssize_t numbytes;
+	int status, ok;
+
+	frameHdr( frame, 3 );
+	memcpy( frame + FRAMEHDRSIZE, "SHM", 3 );
+	if( send( kc->fd, frame, sizeof(frame), MSG_NOSIGNAL ) != sizeof(frame) ){
+		kc->broken = 1;
+		return KV_ERROR;
+	}
+
+	// the OK comes with the area's descriptors (a refusal, without)
+	while( (status = ringFrame( &kc->in, &data, &len )) == 0 ){
+		numbytes = shmRecv( kc->fd, &kc->in, got );
+		if( numbytes == -1 && errno == EINTR )
+			continue;
+		if( numbytes <= 0 )
+			break;
+		if( got[0] != -1 )
+			memcpy( fds, got, sizeof(fds) );
+	}
+
+	ok = status == 1 && len == strlen("200 OK") &&
+	 memcmp( data, "200 OK", len ) == 0;
+	if( status == 1 )
+		ringConsume( &kc->in, len );
+
+	if( ok && fds[0] != -1 ){
+		if( shmAttach( &kc->shm, fds ) == -1 ){
+			kc->broken = 1;
+			return KV_ERROR;
+		}
+		kc->spin = sysconf( _SC_NPROCESSORS_ONLN ) > 1 ? SHMSPIN : 0;
+		return KV_OK;
+	}
+
+	if( fds[0] != -1 )
+		for( int i = 0; i < 3; i++ )
+			close( fds[i] );
+
+	// (a refusal leaves the connection as it was; anything else breaks it)
+	if( ok || status != 1 )
+		kc->broken = 1;
+	return KV_ERROR;
+
+}
+
+/*******************************************************************************
+* Name:    kvConnectLocal
+* Purpose: Connects to the server's Unix socket (on our own host) & reads its
+*          greeting, & optionally moves the connection onto shared memory
+* Input:   kc   - the struct kvconn to set up
+*          path - the socket's path (the server's -U)
+*          shm  - 1 for shared memory, 0 to stay on the socket
+* Output:  KV_OK, or KV_ERROR if we couldn't connect (or the server was too
+*          busy to take us, or refused us shared memory)
+*******************************************************************************/
+static inline int kvConnectLocal( struct kvconn* kc, char* path, int shm ){
+
+	// VARIABLE DEFINITIONS
+	int fd;
+
+	memset( kc, 0, sizeof(*kc) );
+
+	fd = connectLocal( path );
+	if( fd == -1 || kvAttach( kc, fd ) != KV_OK )
+		return KV_ERROR;
+
+	if( shm && kvShm( kc ) != KV_OK ){
+		fprintf( stderr, "kvclient: %s refused us shared memory\n", path );
+		close( kc->fd );
+		ringFree( &kc->in );
+		return KV_ERROR;
+	}
+
+	return KV_OK;
+
+}
+
+/*******************************************************************************
+* Name:    kvClose
+* Purpose: Says EXIT (if the connection still works) & closes a connection
+* Input:   kc - the connection
+* Output:  none
+*******************************************************************************/
+static inline void kvClose( struct kvconn* kc ){
+
+	// VARIABLE DEFINITIONS
+	char frame[FRAMEHDRSIZE + 4];
+
+	if( !kc->broken ){
+		frameHdr( frame, 4 );
+		memcpy( frame + FRAMEHDRSIZE, "EXIT", 4 );
+		// (the server closes its end once it has said OK; we don't wait)
+		if( kc->shm.area != NULL ){
+			if( shmWrite( &kc->shm, frame, sizeof(frame) ) == sizeof(frame) )
+				shmWake( &kc->shm );
+		} else
+			send( kc->fd, frame, sizeof(frame), MSG_NOSIGNAL | MSG_DONTWAIT );
+	}
+
+	close( kc->fd );
+	shmFree( &kc->shm );
+	ringFree( &kc->in );
+
+}
+
+/*******************************************************************************
+* Name:    kvAppendReq
+* Purpose: Builds a request's frames on the end of a buffer
+* Input:   buf, len, cap - the buffer (see appendBytes())
+*          req           - the request
+* Output:  none (exit()s the program if we run out of memory, like
+*          appendBytes())
+*******************************************************************************/
+static inline void kvAppendReq( char** buf, size_t* len, size_t* cap,
+ struct kvreq* req ){
+
+	// VARIABLE DEFINITIONS
+	char hdr[FRAMEHDRSIZE];
+	char cmd[32];
+
+	switch( req->op ){
+
+		case KV_GET:
+		case KV_GETV:
+			strcpy( cmd, req->op == KV_GET ? "GET " : "GETV " );
+			frameHdr( hdr, strlen(cmd) + req->keyLen );
+			appendBytes( buf, len, cap, hdr, FRAMEHDRSIZE );
+			appendBytes( buf, len, cap, cmd, strlen(cmd) );
+			appendBytes( buf, len, cap, req->key, req->keyLen );
+			break;
+
+		case KV_STORE:
+		case KV_CAS:
+			// (with a ttl, it's "STOREX secs key"; a CAS is "CAS version key")
+			if( req->op == KV_CAS )
+				snprintf( cmd, sizeof(cmd), "CAS %llu ",
+				 (unsigned long long)req->version );
+			else if( req->ttl > 0 )
+				snprintf( cmd, sizeof(cmd), "STOREX %u ", req->ttl );
+			else
+				strcpy( cmd, "STORE " );
+			frameHdr( hdr, strlen(cmd) + req->keyLen );
+			appendBytes( buf, len, cap, hdr, FRAMEHDRSIZE );
+			appendBytes( buf, len, cap, cmd, strlen(cmd) );
+			appendBytes( buf, len, cap, req->key, req->keyLen );
+			appendFrame( buf, len, cap, req->data, req->dataLen );
+			break;
+
+		case KV_TRANSLATE:
+			appendFrame( buf, len, cap, "TRANSLATE", strlen("TRANSLATE") );
+			appendFrame( buf, len, cap, req->data, req->dataLen );
+			break;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    kvComplete
+* Purpose: Finishes a request: calls its callback & wakes up its kvWait()ers
+* Input:   req    - the request
+*          status - its final status
+* Output:  none
+*******************************************************************************/
+static inline void kvComplete( struct kvreq* req, int status ){
+
+	// a failed request has no result
+	if( status == KV_ERROR || status == KV_NOTFOUND ){
+		free( req->result );
+		req->result = NULL;
+		req->resultLen = 0;
+	}
+
+	req->status = status;
+
+	if( req->callback != NULL )
+		req->callback( req );
+
+	if( req->pool == NULL ){
+		req->done = 1;
+		return;
+	}
+
+	// (only once the callback is done with it may kvWait() return)
+	pthread_mutex_lock( &req->pool->lock );
+	req->done = 1;
+	pthread_cond_broadcast( &req->pool->done );
+	pthread_mutex_unlock( &req->pool->lock );
+
+}
+
+/*******************************************************************************
+* Name:    kvVersion
+* Purpose: Reads the version at the end of an OK line (" 1234")
+* Input:   s       - what follows the "200 OK"
+*          len     - the length of s
+*          version - set to the version
+* Output:  the number of bytes of s it took up
+*******************************************************************************/
+static inline size_t kvVersion( char* s, size_t len, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	size_t i = 0;
+
+	*version = 0;
+
+	if( i < len && s[i] == ' ' )
+		i++;
+	for( ; i < len && s[i] >= '0' && s[i] <= '9'; i++ )
+		*version = *version * 10 + s[i] - '0';
+
+	return i;
+
+}
+
+/*******************************************************************************
+* Name:    kvResponse
+* Purpose: Applies one response frame to the request it answers
+* Input:   req  - the request
+*          data - the frame's payload
+*          len  - the length of the frame's payload
+* Output:  the request's final status if this was its last response, or
+*          KV_PENDING if it has more coming
+*******************************************************************************/
+static inline int kvResponse( struct kvreq* req, char* data, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	size_t okLen = strlen("200 OK");
+	int ok = len >= okLen && memcmp( data, "200 OK", okLen ) == 0;
+
+	req->frames++;
+
+	switch( req->op ){
+
+		case KV_GET:
+		case KV_GETV:
+			if( len >= 3 && memcmp( data, "404", 3 ) == 0 )
+				return KV_NOTFOUND;
+			if( !ok )
+				return KV_ERROR;
+
+			// GETV's version follows "200 OK "
+			if( req->op == KV_GETV )
+				okLen += kvVersion( data + okLen, len - okLen, &req->version );
+
+			// the value follows "200 OK\n"
+			okLen += ( len > okLen && data[okLen] == '\n' );
+			req->resultLen = len - okLen;
+			req->result = malloc( req->resultLen + 1 );
+			if( req->result == NULL )
+				return KV_ERROR;
+			memcpy( req->result, data + okLen, req->resultLen );
+			req->result[ req->resultLen ] = '\0';
+			return KV_OK;
+
+		case KV_STORE:
+			// an OK for the command, then an OK once it's stored
+			if( !ok )
+				req->failed = 1;
+			if( req->frames < 2 )
+				return KV_PENDING;
+			return req->failed ? KV_ERROR : KV_OK;
+
+		case KV_CAS:
+			// an OK for the command, then "200 OK <version>" once it's stored
+			// (or CONFLICT)
+			if( req->frames < 2 ){
+				if( !ok )
+					req->failed = 1;
+				return KV_PENDING;
+			}
+			if( !req->failed && len >= 3 && memcmp( data, "409", 3 ) == 0 )
+				return KV_CONFLICT;
+			if( req->failed || !ok )
+				return KV_ERROR;
+
+			// ("200 OK <version>")
+			kvVersion( data + okLen, len - okLen, &req->version );
+			return KV_OK;
+
+		case KV_TRANSLATE:
+			// an OK for the command, then the data
+			if( req->frames < 2 ){
+				if( !ok )
+					req->failed = 1;
+				return KV_PENDING;
+			}
+			if( req->failed )
+				return KV_ERROR;
+
+			req->resultLen = len;
+			req->result = malloc( len + 1 );
+			if( req->result == NULL )
+				return KV_ERROR;
+			memcpy( req->result, data, len );
+			req->result[len] = '\0';
+			return KV_OK;
+
+	}
+
+	return KV_ERROR;
+
+}
+
+/*******************************************************************************
+* Name:    kvReady
+* Purpose: Waits until a connection can send or has something to read
+* Input:   kc       - the connection
+*          wantSend - 1 if we have something to send
+* Output:  POLLIN and/or POLLOUT for what it can do (0 if interrupted), or -1
+*          if the connection failed
+*******************************************************************************/
+static inline int kvReady( struct kvconn* kc, int wantSend ){
+
+	// VARIABLE DEFINITIONS
+	struct pollfd pfd;
+	int ready = 0;
+
+	// (on shared memory, try both once there's either)
+	if( kc->shm.area != NULL ){
+		if( shmWait( &kc->shm, kc->fd, wantSend, kc->spin ) == -1 )
+			return -1;
+		return POLLIN | ( wantSend ? POLLOUT : 0 );
+	}
+
+	pfd.fd = kc->fd;
+	pfd.events = POLLIN | ( wantSend ? POLLOUT : 0 );
+
+	if( poll( &pfd, 1, -1 ) == -1 )
+		return errno == EINTR ? 0 : -1;
+
+	if( pfd.revents & POLLOUT )
+		ready |= POLLOUT;
+	if( pfd.revents & (POLLIN | POLLERR | POLLHUP) )
+		ready |= POLLIN;
+	return ready;
+
+}
+
+/*******************************************************************************
+* Name:    kvSendSome
+* Purpose: Sends as much as the server has room for, without waiting
+* Input:   kc  - the connection
+*          buf - the bytes to send
+*          len - the number of bytes
+* Output:  the number of bytes sent (maybe 0), or -1 if the connection failed
+*******************************************************************************/
+static inline ssize_t kvSendSome( struct kvconn* kc, char* buf, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	if( kc->shm.area != NULL ){
+		numbytes = shmWrite( &kc->shm, buf, len );
+		if( numbytes > 0 )
+			shmWake( &kc->shm );
+		return numbytes;
+	}
+
+	numbytes = send( kc->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT );
+	if( numbytes == -1 && ( errno == EAGAIN || errno == EINTR ) )
+		return 0;
+	return numbytes;
+
+}
+
+/*******************************************************************************
+* Name:    kvRecvSome
+* Purpose: Reads whatever the server has sent onto the end of kc->in
+* Input:   kc - the connection
+* Output:  the number of bytes read (maybe 0), or -1 if the connection failed
+*          (or the server closed it)
+*******************************************************************************/
+static inline ssize_t kvRecvSome( struct kvconn* kc ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	if( kc->shm.area != NULL ){
+		numbytes = shmRead( &kc->shm, &kc->in );
+		if( numbytes > 0 )
+			shmWake( &kc->shm ); // (in case it's waiting on room)
+		else if( errno == EAGAIN )
+			return 0;
+		return numbytes;
+	}
+
+	numbytes = ringRecv( &kc->in, kc->fd );
+	if( numbytes == 0 )
+		return -1;
+	if( numbytes == -1 && ( errno == EAGAIN || errno == EINTR ) )
+		return 0;
+	return numbytes;
+
+}
+
+/*******************************************************************************
+* Name:    kvRun
+* Purpose: Pipelines a run of requests over one connection: sends all of them
+*          (as fast as the server takes them) while reading responses, &
+*          completes each as its last response arrives
+* Input:   kc   - the connection
+*          reqs - the requests
+*          n    - the number of requests
+* Output:  KV_OK, or KV_ERROR if the connection failed (every request that
+*          hadn't completed by then fails, & the connection is marked broken)
+*******************************************************************************/
+static inline int kvRun( struct kvconn* kc, struct kvreq** reqs, int n ){
+
+	// VARIABLE DEFINITIONS
+	char* out = NULL;
+	size_t outLen = 0, outCap = 0, sent = 0;
+	ssize_t numbytes;
+	char* data;
+	uint32_t len;
+	int found = 0, status, ready;
+	int next = 0; // the oldest request still waiting on a response
+
+	for( int i = 0; i < n; i++ ){
+		reqs[i]->status = KV_PENDING;
+		reqs[i]->result = NULL;
+		reqs[i]->resultLen = 0;
+		reqs[i]->frames = 0;
+		reqs[i]->failed = 0;
+		kvAppendReq( &out, &outLen, &outCap, reqs[i] );
+	}
+
+	while( next < n && !kc->broken ){
+
+		ready = kvReady( kc, sent < outLen );
+		if( ready == -1 ){
+			kc->broken = 1;
+			break;
+		}
+
+		// send whatever the server has room for...
+		if( ready & POLLOUT ){
+			numbytes = kvSendSome( kc, out + sent, outLen - sent );
+			if( numbytes == -1 )
+				kc->broken = 1;
+			else
+				sent += numbytes;
+		}
+
+		// ...& handle whatever it has answered
+		if( ready & POLLIN ){
+
+			if( kvRecvSome( kc ) == -1 ){
+				kc->broken = 1;
+				break;
+			}
+
+			while( next < n && (found = ringFrame( &kc->in, &data, &len )) == 1 ){
+
+				status = kvResponse( reqs[next], data, len );
+				ringConsume( &kc->in, len );
+
+				if( status != KV_PENDING )
+					kvComplete( reqs[next++], status );
+
+			}
+
+			if( found == -1 )
+				kc->broken = 1;
+
+		}
+
+	}
+
+	// did the connection fail part way?
+	while( next < n )
+		kvComplete( reqs[next++], KV_ERROR );
+
+	free( out );
+	return kc->broken ? KV_ERROR : KV_OK;
+
+}
+
+/*******************************************************************************
+* Name:    kvCall
+* Purpose: Makes one request over a connection & waits for its response
+* Input:   kc  - the connection
+*          req - the request
+* Output:  the request's status
+*******************************************************************************/
+static inline int kvCall( struct kvconn* kc, struct kvreq* req ){
+
+	req->callback = NULL;
+	req->pool = NULL;
+	kvRun( kc, &req, 1 );
+	return req->status;
+
+}
+
+/*******************************************************************************
+* Name:    kvGet
+* Purpose: GETs a key
+* Input:   kc     - the connection
+*          key    - the key
+*          keyLen - the length of the key
+*          val    - set to the value (malloc()'d & null terminated; the caller
+*                   free()s it), or NULL if it isn't found
+*          valLen - set to the length of the value
+* Output:  KV_OK, KV_NOTFOUND, or KV_ERROR
+*******************************************************************************/
+static inline int kvGet( struct kvconn* kc, char* key, size_t keyLen,
+ char** val, size_t* valLen ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_GET, .key = key, .keyLen = keyLen };
+	int status = kvCall( kc, &req );
+
+	*val = req.result;
+	*valLen = req.resultLen;
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    kvStore
+* Purpose: STOREs a value under a key
+* Input:   kc      - the connection
+*          key     - the key
+*          keyLen  - the length of the key
+*          data    - the value
+*          dataLen - the length of the value
+* Output:  KV_OK or KV_ERROR
+*******************************************************************************/
+static inline int kvStore( struct kvconn* kc, char* key, size_t keyLen,
+ char* data, size_t dataLen ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_STORE, .key = key, .keyLen = keyLen,
+	 .data = data, .dataLen = dataLen };
+
+	return kvCall( kc, &req );
+
+}
+
+/*******************************************************************************
+* Name:    kvStoreTTL
+* Purpose: STOREs a value under a key that expires after a number of seconds
+* Input:   kc      - the connection
+*          key     - the key
+*          keyLen  - the length of the key
+*          data    - the value
+*          dataLen - the length of the value
+*          ttl     - seconds until the key expires (0 = never)
+* Output:  KV_OK or KV_ERROR
+*******************************************************************************/
+static inline int kvStoreTTL( struct kvconn* kc, char* key, size_t keyLen,
+ char* data, size_t dataLen, unsigned ttl ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_STORE, .key = key, .keyLen = keyLen,
+	 .data = data, .dataLen = dataLen, .ttl = ttl };
+
+	return kvCall( kc, &req );
+
+}
+
+/*******************************************************************************
+* Name:    kvGetV
+* Purpose: GETs a key & the version of its value
+* Input:   kc      - the connection
+*          key     - the key
+*          keyLen  - the length of the key
+*          val     - set to the value (malloc()'d & null terminated; the caller
+*                    free()s it), or NULL if it isn't found
+*          valLen  - set to the length of the value
+*          version - set to its version (0 if it isn't found, as kvCas() takes
+*                    for "only if it's still not there")
+* Output:  KV_OK, KV_NOTFOUND, or KV_ERROR
+*******************************************************************************/
+static inline int kvGetV( struct kvconn* kc, char* key, size_t keyLen,
+ char** val, size_t* valLen, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_GETV, .key = key, .keyLen = keyLen };
+	int status = kvCall( kc, &req );
+
+	*val = req.result;
+	*valLen = req.resultLen;
+	*version = status == KV_OK ? req.version : 0;
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    kvCas
+* Purpose: STOREs a value under a key, but only if the key still has the
+*          version given (compare-and-swap)
+* Input:   kc      - the connection
+*          key     - the key
+*          keyLen  - the length of the key
+*          data    - the value
+*          dataLen - the length of the value
+*          version - the version the key must have (0 for it not to exist); set
+*                    to the new value's version if it's stored
+* Output:  KV_OK, KV_CONFLICT if the key had some other version, or KV_ERROR
+*******************************************************************************/
+static inline int kvCas( struct kvconn* kc, char* key, size_t keyLen,
+ char* data, size_t dataLen, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_CAS, .key = key, .keyLen = keyLen,
+	 .data = data, .dataLen = dataLen, .version = *version };
+	int status = kvCall( kc, &req );
+
+	if( status == KV_OK )
+		*version = req.version;
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    kvTranslate
+* Purpose: TRANSLATEs some data
+* Input:   kc      - the connection
+*          data    - the data
+*          dataLen - the length of the data
+*          out     - set to the TRANSLATE'd data (malloc()'d & null
+*                    terminated; the caller free()s it)
+* Output:  KV_OK or KV_ERROR
+*******************************************************************************/
+static inline int kvTranslate( struct kvconn* kc, char* data, size_t dataLen,
+ char** out ){
+
+	// VARIABLE DEFINITIONS
+	struct kvreq req = { .op = KV_TRANSLATE, .data = data, .dataLen = dataLen };
+	int status = kvCall( kc, &req );
+
+	*out = req.result;
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    kvPoolGet
+* Purpose: Takes a connection from a pool, opening a new one if the pool isn't
+*          full yet, or waiting for one to be put back if it is
+* Input:   p - the pool
+* Output:  the connection, or NULL if we couldn't connect
+*******************************************************************************/
+static inline struct kvconn* kvPoolGet( struct kvpool* p ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn* kc;
+
+	pthread_mutex_lock( &p->lock );
+
+	while( p->idle == NULL && p->open >= p->size )
+		pthread_cond_wait( &p->freed, &p->lock );
+
+	// is there an idle connection we can reuse?
+	if( p->idle != NULL ){
+		kc = p->idle;
+		p->idle = kc->next;
+		pthread_mutex_unlock( &p->lock );
+		return kc;
+	}
+
+	// no; open a new one (without holding the lock while we connect)
+	p->open++;
+	pthread_mutex_unlock( &p->lock );
+
+	kc = malloc( sizeof(struct kvconn) );
+	if( kc != NULL && kvConnect( kc, p->host, p->port ) == KV_OK )
+		return kc;
+
+	free( kc );
+	pthread_mutex_lock( &p->lock );
+	p->open--;
+	pthread_cond_signal( &p->freed );
+	pthread_mutex_unlock( &p->lock );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    kvPoolPut
+* Purpose: Gives a connection back to its pool (a broken one is closed, so
+*          the pool will open a new one in its place)
+* Input:   p  - the pool
+*          kc - the connection (from kvPoolGet())
+* Output:  none
+*******************************************************************************/
+static inline void kvPoolPut( struct kvpool* p, struct kvconn* kc ){
+
+	if( kc->broken ){
+		kvClose( kc );
+		free( kc );
+		pthread_mutex_lock( &p->lock );
+		p->open--;
+	} else {
+		pthread_mutex_lock( &p->lock );
+		kc->next = p->idle;
+		p->idle = kc;
+	}
+
+	pthread_cond_signal( &p->freed );
+	pthread_mutex_unlock( &p->lock );
+
+}
+
+/*******************************************************************************
+* Name:    kvLane
+* Purpose: A lane thread: takes submitted requests off its pool's queue, up
+*          to KVPIPE at a time, & kvRun()s them over a pooled connection
+* Input:   arg - the pool
+* Output:  NULL (once the pool is being destroyed & its queue is empty)
+*******************************************************************************/
+static inline void* kvLane( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct kvpool* p = arg;
+	struct kvreq* reqs[KVPIPE];
+	struct kvconn* kc;
+	int n;
+
+	while(1){
+
+		pthread_mutex_lock( &p->lock );
+
+		while( p->queue == NULL && !p->stopping )
+			pthread_cond_wait( &p->work, &p->lock );
+
+		if( p->queue == NULL ){
+			pthread_mutex_unlock( &p->lock );
+			return NULL;
+		}
+
+		for( n = 0; n < KVPIPE && p->queue != NULL; n++ ){
+			reqs[n] = p->queue;
+			p->queue = p->queue->next;
+		}
+
+		// leave the rest for the other lanes
+		if( p->queue != NULL )
+			pthread_cond_signal( &p->work );
+
+		pthread_mutex_unlock( &p->lock );
+
+		kc = kvPoolGet( p );
+		if( kc == NULL ){
+			for( int i = 0; i < n; i++ )
+				kvComplete( reqs[i], KV_ERROR );
+			continue;
+		}
+
+		kvRun( kc, reqs, n );
+		kvPoolPut( p, kc );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    kvPoolInit
+* Purpose: Sets up a pool of connections & starts its lane threads (no
+*          connections are opened until they're needed)
+* Input:   p    - the struct kvpool to set up
+*          host - the server's hostname (must outlive the pool)
+*          port - the server's port (must outlive the pool)
+*          size - the most connections to open at once
+* Output:  KV_OK, or KV_ERROR if we couldn't start the lane threads
+*******************************************************************************/
+static inline int kvPoolInit( struct kvpool* p, char* host, char* port,
+ int size ){
+
+	memset( p, 0, sizeof(*p) );
+	p->host = host;
+	p->port = port;
+	p->size = size;
+
+	pthread_mutex_init( &p->lock, NULL );
+	pthread_cond_init( &p->freed, NULL );
+	pthread_cond_init( &p->work, NULL );
+	pthread_cond_init( &p->done, NULL );
+
+	// one lane per connection, so that a batch can use all of them at once
+	p->lanes = calloc( size, sizeof(pthread_t) );
+	if( p->lanes == NULL )
+		return KV_ERROR;
+
+	for( int i = 0; i < size; i++ ){
+		if( pthread_create( &p->lanes[i], NULL, kvLane, p ) != 0 ){
+			p->size = i;
+			return KV_ERROR;
+		}
+	}
+
+	return KV_OK;
+
+}
+
+/*******************************************************************************
+* Name:    kvSubmit
+* Purpose: Queues a batch of requests to be pipelined over the pool's
+*          connections, & returns without waiting for any of them
+* Input:   p    - the pool
+*          reqs - the requests (op, key, data, callback & arg filled in)
+*          n    - the number of requests
+* Output:  none; each request's callback is called, & kvWait() returns, once
+*          it completes
+*******************************************************************************/
+static inline void kvSubmit( struct kvpool* p, struct kvreq* reqs, int n ){
+
+	if( n == 0 )
+		return;
+
+	for( int i = 0; i < n; i++ ){
+		reqs[i].status = KV_PENDING;
+		reqs[i].result = NULL;
+		reqs[i].done = 0;
+		reqs[i].pool = p;
+		reqs[i].next = i + 1 < n ? &reqs[i+1] : NULL;
+	}
+
+	pthread_mutex_lock( &p->lock );
+
+	if( p->queue == NULL )
+		p->queue = reqs;
+	else
+		p->queueTail->next = reqs;
+	p->queueTail = &reqs[n-1];
+
+	pthread_cond_signal( &p->work );
+	pthread_mutex_unlock( &p->lock );
+
+}
+
+/*******************************************************************************
+* Name:    kvWait
+* Purpose: Waits for a submitted request to complete
+* Input:   req - the request
+* Output:  its status
+*******************************************************************************/
+static inline int kvWait( struct kvreq* req ){
+
+	// VARIABLE DEFINITIONS
+	struct kvpool* p = req->pool;
+
+	pthread_mutex_lock( &p->lock );
+	while( !req->done )
+		pthread_cond_wait( &p->done, &p->lock );
+	pthread_mutex_unlock( &p->lock );
+
+	return req->status;
+
+}
+
+/*******************************************************************************
+* Name:    kvBatch
+* Purpose: Pipelines a batch of requests over the pool's connections & waits
+*          for all of them
+* Input:   p    - the pool
+*          reqs - the requests
+*          n    - the number of requests
+* Output:  the number of requests that ended in KV_ERROR
+*******************************************************************************/
+static inline int kvBatch( struct kvpool* p, struct kvreq* reqs, int n ){
+
+	// VARIABLE DEFINITIONS
+	int failed = 0;
+
+	kvSubmit( p, reqs, n );
+
+	for( int i = 0; i < n; i++ )
+		failed += kvWait( &reqs[i] ) == KV_ERROR;
+
+	return failed;
+
+}
+
+/*******************************************************************************
+* Name:    kvPoolDestroy
+* Purpose: Finishes every request already submitted, stops the lane threads &
+*          closes every connection. Every connection taken with kvPoolGet()
+*          must have been put back first.
+* Input:   p - the pool
+* Output:  none
+*******************************************************************************/
+static inline void kvPoolDestroy( struct kvpool* p ){
+
+	// VARIABLE DEFINITIONS
+	struct kvconn* kc;
+
+	pthread_mutex_lock( &p->lock );
+	p->stopping = 1;
+	pthread_cond_broadcast( &p->work );
+	pthread_mutex_unlock( &p->lock );
+
+	for( int i = 0; i < p->size; i++ )
+		pthread_join( p->lanes[i], NULL );
+	free( p->lanes );
+
+	while( (kc = p->idle) != NULL ){
+		p->idle = kc->next;
+		kvClose( kc );
+		free( kc );
+	}
+
+	pthread_mutex_destroy( &p->lock );
+	pthread_cond_destroy( &p->freed );
+	pthread_cond_destroy( &p->work );
+	pthread_cond_destroy( &p->done );
+
+}
+
+#endif
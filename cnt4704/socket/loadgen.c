@@ -0,0 +1,1192 @@
+/*******************************************************************************
+* File:       loadgen.c
+* Version:    0.3
+* Purpose:    Load generator for server.c: drives many connections at once with
+*             a mix of GET, STORE, & TRANSLATE, & reports throughput, errors,
+*             & latency percentiles
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Connects with the same code as client.c (connectServer() &
+              the framing in common.h), then runs every connection from one
+              epoll loop.
+
+              Closed loop (the default) keeps -p requests in flight on each
+              connection, sending the next as soon as one completes; this
+              measures the most the server can do. Open loop (-r) sends
+              requests at a fixed rate no matter how fast the server answers.
+              Each request's latency is measured from when it was *due*, not
+              from when we got around to sending it, so a server (or a
+              loadgen) that stalls is charged for all of the requests that
+              queued up behind the stall ("coordinated omission").
+
+              Before measuring, every key in the keyspace is STOREd, so GETs
+              only miss if something is wrong (or the server has evicted them).
+
+              Keys are picked uniformly, or with -Z from a Zipfian distribution
+              (key N is picked in proportion to 1/(N+1)^skew), as a cache sees.
+              With -a, a GET that misses is followed by a STORE of its key, as
+              a cache-aside client would fill it. -L also runs an exact LRU
+              cache of that many keys over the same requests, in the order we
+              issue them, so that the server's GET hit rate under -M can be
+              held up against what perfect LRU would have got.
+
+              -b sends each GET & STORE as an MGET or MSTORE of that many keys
+              (the first picked as usual, the rest likewise), so that batches
+              can be held up against the same number of single requests,
+              pipelined (-p) or not; compare the keys per second.
+
+              Connections that the server turns away as busy are counted &
+              left out; the rest carry the whole load.
+
+              -j prints the results as one line of JSON instead of a table,
+              for regression tracking.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -O2 -o loadgen loadgen.c -lm`
+*******************************************************************************/
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SERVER "localhost"
+#define PORT "3331"
+#define OK "200 OK"
+#define NOT_FOUND "404"
+#define BUSY "503"
+#define MAXEVENTS 64      // max number of epoll events handled per epoll_wait()
+#define WARMUPBATCH 1000  // keys STOREd per round trip while warming up
+#define DRAINSECS 2       // how long to wait for stragglers after the run
+#define KEYSIZE 32        // longest command we build ("STORE key123")
+#define MAXBATCH 1024     // most keys the server takes in one MGET or MSTORE
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#define _GNU_SOURCE // for epoll_pwait2()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <netinet/tcp.h>
+
+#include "common.h"
+#include "stats.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// a request that has been sent & is waiting on its response(s)
+struct req {
+	int      op;       // STAT_GET, STAT_STORE, STAT_TRANSLATE, STAT_MGET or
+	                   // STAT_MSTORE
+	int      key;      // the key it's for (GET & STORE)
+	int      fill;     // 1 for a STORE filling in a GET's miss (-a)
+	int      frames;   // number of response frames it gets (1 or 2)
+	uint64_t start;    // when it was sent (closed loop) or due (open loop)
+	size_t   bytesOut; // bytes we sent for it
+};
+
+// one connection to the server
+struct lconn {
+	int fd;
+	struct ring in;      // frames recieved from the server
+	char* out;           // frames built but not yet sent
+	size_t outLen, outCap, outSent;
+
+	struct req* reqs;    // requests in flight, oldest first (a circular queue)
+	size_t reqCap;       // size of reqs (a power of 2)
+	size_t reqHead, reqTail;
+	int frames;          // frames of the oldest request recieved so far
+	size_t bytesIn;      // ...& their bytes
+	int failed;          // ...& whether any of them was an error
+
+	uint64_t next;       // open loop: when our next request is due
+	int dead;            // did the connection fail?
+};
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+// options
+int numConns = 16;       // -c
+int seconds = 10;        // -d
+int pipeDepth = 1;       // -p
+double rate = 0;         // -r (requests per second; 0 = closed loop)
+size_t valueSize = 100;  // -s
+int keyspace = 1000;     // -k
+int json = 0;            // -j
+double skew = 0;         // -Z (0 = uniform)
+int fillMisses = 0;      // -a
+int lruKeys = 0;         // -L (0 = don't simulate)
+int batchKeys = 1;       // -b (1 = single GETs & STOREs)
+int mix[NUMSTATS];       // -m (weight of each op, indexed by STAT_*)
+int mixTotal;
+
+char* value;             // the data we STORE & TRANSLATE
+char* batchCmd;          // -b: where MGET & MSTORE commands are built
+char* batchData;         // -b: the data of every MSTORE (a length & value each)
+size_t batchDataLen;
+uint64_t randState = 88172645463325252ULL;
+double* zipfCdf;         // -Z: chance of picking each key or any before it
+
+// -L: the simulated exact LRU cache, a list of keys most recently used first
+int* lruPrev;
+int* lruNext;
+char* lruIn;             // whether each key is in the cache
+int lruHead = -1, lruTail = -1, lruSize;
+size_t lruGets, lruHits;
+
+// results
+struct stats stats;      // latency of every successful request, by op
+size_t errors;           // requests that got something other than OK
+size_t misses;           // GETs that got 404 (& MGET keys that were missing)
+size_t getKeys;          // keys GET or MGET asked for & got an answer about
+size_t keysDone;         // keys of every request that succeeded
+size_t lost;             // requests that never got a response
+size_t connErrors;       // connections that failed
+size_t rejected;         // connections the server turned away as busy
+size_t inFlight;         // requests sent but not yet answered
+uint64_t lastDone;       // when the last request completed
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    randNext
+* Purpose: A fast pseudo random number generator (xorshift64*); the same
+*          sequence every run, so runs are comparable
+* Input:   none
+* Output:  the next pseudo random number
+*******************************************************************************/
+uint64_t randNext(){
+
+	randState ^= randState >> 12;
+	randState ^= randState << 25;
+	randState ^= randState >> 27;
+	return randState * 2685821657736338717ULL;
+
+}
+
+/*******************************************************************************
+* Name:    zipfInit
+* Purpose: Works out the cumulative distribution that -Z picks keys from
+* Input:   none
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void zipfInit(){
+
+	// VARIABLE DEFINITIONS
+	double sum = 0;
+
+	zipfCdf = malloc( keyspace * sizeof(double) );
+	if( zipfCdf == NULL ){
+		perror( "malloc" );
+		exit(1);
+	}
+
+	for( int i = 0; i < keyspace; i++ ){
+		sum += 1 / pow( i + 1, skew );
+		zipfCdf[i] = sum;
+	}
+	for( int i = 0; i < keyspace; i++ )
+		zipfCdf[i] /= sum;
+
+}
+
+/*******************************************************************************
+* Name:    pickKey
+* Purpose: Picks a key, uniformly or (with -Z) from the Zipfian distribution
+* Input:   none
+* Output:  the key's number
+*******************************************************************************/
+int pickKey(){
+
+	// VARIABLE DEFINITIONS
+	double u;
+	int lo = 0, hi = keyspace - 1, mid;
+
+	if( zipfCdf == NULL )
+		return randNext() % keyspace;
+
+	// the first key whose cumulative chance reaches u
+	u = ( randNext() >> 11 ) * 0x1.0p-53;
+	while( lo < hi ){
+		mid = ( lo + hi ) / 2;
+		if( zipfCdf[mid] < u )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+
+}
+
+/*******************************************************************************
+* Name:    lruTouch
+* Purpose: Uses a key in the simulated exact LRU cache (-L): moves it to the
+*          front, putting it in first (& evicting the least recently used key
+*          if that makes one too many) if need be
+* Input:   key - the key
+* Output:  none
+*******************************************************************************/
+void lruTouch( int key ){
+
+	// VARIABLE DEFINITIONS
+	int old;
+
+	// take it out of the list, if it's in
+	if( lruIn[key] ){
+		if( lruPrev[key] != -1 )
+			lruNext[ lruPrev[key] ] = lruNext[key];
+		else
+			lruHead = lruNext[key];
+		if( lruNext[key] != -1 )
+			lruPrev[ lruNext[key] ] = lruPrev[key];
+		else
+			lruTail = lruPrev[key];
+		lruSize--;
+	}
+
+	// & put it at the front
+	lruPrev[key] = -1;
+	lruNext[key] = lruHead;
+	if( lruHead != -1 )
+		lruPrev[lruHead] = key;
+	lruHead = key;
+	if( lruTail == -1 )
+		lruTail = key;
+	lruIn[key] = 1;
+	lruSize++;
+
+	// evict from the back
+	if( lruSize > lruKeys ){
+		old = lruTail;
+		lruTail = lruPrev[old];
+		lruNext[lruTail] = -1;
+		lruIn[old] = 0;
+		lruSize--;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    lruSim
+* Purpose: Runs a request through the simulated exact LRU cache (-L)
+* Input:   op  - STAT_GET or STAT_STORE (anything else is ignored)
+*          key - the key
+* Output:  none
+*******************************************************************************/
+void lruSim( int op, int key ){
+
+	if( lruKeys == 0 )
+		return;
+
+	if( op == STAT_GET ){
+		lruGets++;
+		if( lruIn[key] )
+			lruHits++;
+		else if( !fillMisses )
+			return;
+	} else if( op != STAT_STORE ){
+		return;
+	}
+
+	lruTouch( key );
+
+}
+
+/*******************************************************************************
+* Name:    setNonBlocking
+* Purpose: Puts the given file descriptor into non-blocking mode
+* Input:   fd - the file descriptor to change
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void setNonBlocking( int fd ){
+
+	// VARIABLE DEFINITIONS
+	int flags;
+
+	flags = fcntl( fd, F_GETFL, 0 );
+	if( flags == -1 || fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == -1 ){
+		perror( "fcntl" );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    pushReq
+* Purpose: Adds a request to the end of a connection's in flight queue
+* Input:   c   - the connection
+*          req - the request
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void pushReq( struct lconn* c, struct req* req ){
+
+	// is the queue full?
+	if( c->reqTail - c->reqHead == c->reqCap ){
+
+		// VARIABLE DEFINITIONS
+		size_t newCap = c->reqCap ? c->reqCap * 2 : 16;
+		struct req* newReqs = malloc( newCap * sizeof(struct req) );
+
+		if( newReqs == NULL ){
+			perror( "malloc" );
+			exit(1);
+		}
+
+		// copy the requests over, oldest first
+		for( size_t i = c->reqHead; i != c->reqTail; i++ )
+			newReqs[ i - c->reqHead ] = c->reqs[ i & (c->reqCap-1) ];
+
+		free( c->reqs );
+		c->reqs = newReqs;
+		c->reqTail -= c->reqHead;
+		c->reqHead = 0;
+		c->reqCap = newCap;
+
+	}
+
+	c->reqs[ c->reqTail++ & (c->reqCap-1) ] = *req;
+	inFlight++;
+
+}
+
+/*******************************************************************************
+* Name:    queueReq
+* Purpose: Builds a request in a connection's output buffer. flushConn() sends
+*          it.
+* Input:   c     - the connection
+*          op    - STAT_GET, STAT_STORE, STAT_TRANSLATE, STAT_MGET or
+*                  STAT_MSTORE
+*          key   - the key (GET & STORE), or the first key (MGET & MSTORE)
+*          fill  - 1 if it's a STORE filling in a GET's miss
+*          start - the time to measure the request's latency from
+* Output:  none
+*******************************************************************************/
+void queueReq( struct lconn* c, int op, int key, int fill, uint64_t start ){
+
+	// VARIABLE DEFINITIONS
+	struct req req;
+	char cmd[KEYSIZE];
+	size_t before = c->outLen;
+	size_t len;
+
+	req.op = op;
+	req.key = key;
+	req.fill = fill;
+
+	switch( req.op ){
+
+		case STAT_GET:
+			snprintf( cmd, sizeof(cmd), "GET key%d", key );
+			appendFrame( &c->out, &c->outLen, &c->outCap, cmd, strlen(cmd) );
+			req.frames = 1;
+			break;
+
+		case STAT_STORE:
+			snprintf( cmd, sizeof(cmd), "STORE key%d", key );
+			appendFrame( &c->out, &c->outLen, &c->outCap, cmd, strlen(cmd) );
+			appendFrame( &c->out, &c->outLen, &c->outCap, value, valueSize );
+			req.frames = 2;
+			break;
+
+		case STAT_TRANSLATE:
+			appendFrame( &c->out, &c->outLen, &c->outCap, "TRANSLATE",
+			 strlen("TRANSLATE") );
+			appendFrame( &c->out, &c->outLen, &c->outCap, value, valueSize );
+			req.frames = 2;
+			break;
+
+		case STAT_MGET:
+		case STAT_MSTORE:
+			len = sprintf( batchCmd, "%s key%d", op == STAT_MGET ? "MGET" :
+			 "MSTORE", key );
+			for( int i = 1; i < batchKeys; i++ )
+				len += sprintf( batchCmd + len, " key%d", pickKey() );
+			appendFrame( &c->out, &c->outLen, &c->outCap, batchCmd, len );
+			req.frames = 1;
+			if( op == STAT_MSTORE ){
+				appendFrame( &c->out, &c->outLen, &c->outCap, batchData,
+				 batchDataLen );
+				req.frames = 2;
+			}
+			break;
+
+	}
+
+	req.start = start;
+	req.bytesOut = c->outLen - before;
+	pushReq( c, &req );
+
+}
+
+/*******************************************************************************
+* Name:    issue
+* Purpose: Builds a random request (per the -m mix, for a key picked per -Z)
+*          in a connection's output buffer. flushConn() sends it.
+* Input:   c     - the connection
+*          start - the time to measure the request's latency from
+* Output:  none
+*******************************************************************************/
+void issue( struct lconn* c, uint64_t start ){
+
+	// VARIABLE DEFINITIONS
+	int pick = randNext() % mixTotal;
+	int key = pickKey();
+	int op;
+
+	// pick an op, each with a chance proportional to its weight
+	for( op = 0; pick >= mix[op]; op++ )
+		pick -= mix[op];
+
+	// (-b)
+	if( batchKeys > 1 && op == STAT_GET )
+		op = STAT_MGET;
+	else if( batchKeys > 1 && op == STAT_STORE )
+		op = STAT_MSTORE;
+
+	lruSim( op, key );
+	queueReq( c, op, key, 0, start );
+
+}
+
+/*******************************************************************************
+* Name:    killConn
+* Purpose: Gives up on a connection that failed; its requests in flight are
+*          counted as lost
+* Input:   c   - the connection
+*          why - what went wrong (for the error message)
+* Output:  none
+*******************************************************************************/
+void killConn( struct lconn* c, char* why ){
+
+	if( c->dead )
+		return;
+
+	fprintf( stderr, "loadgen: connection failed: %s\n", why );
+
+	connErrors++;
+	lost += c->reqTail - c->reqHead;
+	inFlight -= c->reqTail - c->reqHead;
+	c->reqHead = c->reqTail;
+
+	close( c->fd );
+	c->dead = 1;
+
+}
+
+/*******************************************************************************
+* Name:    flushConn
+* Purpose: Sends as much of a connection's output buffer as the socket will
+*          take without blocking (epoll tells us when it'll take more)
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void flushConn( struct lconn* c ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	while( !c->dead && c->outSent < c->outLen ){
+
+		numbytes = send( c->fd, c->out + c->outSent, c->outLen - c->outSent,
+		 MSG_NOSIGNAL );
+
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+				killConn( c, strerror(errno) );
+			return;
+		}
+
+		c->outSent += numbytes;
+
+	}
+
+	// start back at the front of the buffer once it's all gone
+	if( c->outSent == c->outLen )
+		c->outSent = c->outLen = 0;
+
+}
+
+/*******************************************************************************
+* Name:    handleResp
+* Purpose: Checks one response frame against the oldest request in flight, &
+*          records the request once all of its responses are in
+* Input:   c    - the connection
+*          data - the frame's payload
+*          len  - the length of the frame's payload
+*          now  - the time it arrived
+* Output:  1 if it completed a request (other than a -a fill), 0 if not
+*******************************************************************************/
+int handleResp( struct lconn* c, char* data, uint32_t len, uint64_t now ){
+
+	// VARIABLE DEFINITIONS
+	struct req* req;
+	int fill, missed = 0;
+	uint32_t n;
+
+	// did the server send us something we never asked for?
+	if( c->reqHead == c->reqTail ){
+		killConn( c, "unexpected response" );
+		return 0;
+	}
+
+	req = &c->reqs[ c->reqHead & (c->reqCap-1) ];
+	c->bytesIn += FRAMEHDRSIZE + len;
+
+	// every response is an OK except the data that TRANSLATE sends back (&
+	// GETs of missing keys)
+	if( req->op == STAT_TRANSLATE && c->frames == 1 ){
+		if( len != valueSize )
+			c->failed = 1;
+	} else if( req->op == STAT_GET && len >= strlen(NOT_FOUND) &&
+	 memcmp( data, NOT_FOUND, strlen(NOT_FOUND) ) == 0 ){
+		misses++;
+		missed = 1;
+	} else if( req->op == STAT_MGET ){
+
+		// OK, then a length & value (or a length of MISSING) for each key
+		if( len < strlen( OK "\n" ) ||
+		 memcmp( data, OK "\n", strlen( OK "\n" ) ) != 0 )
+			c->failed = 1;
+		else {
+			data += strlen( OK "\n" );
+			len -= strlen( OK "\n" );
+		}
+
+		for( int i = 0; i < batchKeys && !c->failed; i++ ){
+			if( len < FRAMEHDRSIZE ){
+				c->failed = 1;
+				break;
+			}
+			n = frameLen( data );
+			data += FRAMEHDRSIZE;
+			len -= FRAMEHDRSIZE;
+			if( n == MISSING ){
+				misses++;
+				continue;
+			}
+			if( n != valueSize || len < n )
+				c->failed = 1;
+			data += n;
+			len -= n;
+		}
+
+		if( !c->failed && len != 0 )
+			c->failed = 1;
+
+	} else if( len < strlen(OK) || memcmp( data, OK, strlen(OK) ) != 0 ){
+		c->failed = 1;
+	}
+
+	// is this request still waiting on more responses?
+	if( ++c->frames < req->frames )
+		return 0;
+
+	if( c->failed )
+		errors++;
+	else {
+		statsRecord( &stats, req->op, now - req->start, c->bytesIn,
+		 req->bytesOut );
+		n = req->op == STAT_MGET || req->op == STAT_MSTORE ? batchKeys :
+		 req->op != STAT_TRANSLATE;
+		keysDone += n;
+		if( req->op == STAT_GET || req->op == STAT_MGET )
+			getKeys += n;
+	}
+
+	c->frames = 0;
+	c->bytesIn = 0;
+	c->failed = 0;
+	c->reqHead++;
+	inFlight--;
+	lastDone = now;
+
+	// fill in the miss, as a cache-aside client would (the caller sends it)
+	fill = req->fill;
+	if( missed && fillMisses )
+		queueReq( c, STAT_STORE, req->key, 1, now );
+
+	return !fill;
+
+}
+
+/*******************************************************************************
+* Name:    readConn
+* Purpose: Recieves everything waiting on a connection & handles every whole
+*          response frame in it
+* Input:   c - the connection
+* Output:  the number of requests completed
+*******************************************************************************/
+int readConn( struct lconn* c ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+	char* data;
+	uint32_t len;
+	int status;
+	int done = 0;
+	uint64_t now;
+
+	while( !c->dead ){
+
+		numbytes = ringRecv( &c->in, c->fd );
+
+		if( numbytes == 0 ){
+			killConn( c, "connection closed by server" );
+			break;
+		}
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+				killConn( c, strerror(errno) );
+			break;
+		}
+
+		now = statsNow();
+
+		while( !c->dead && (status = ringFrame( &c->in, &data, &len )) == 1 ){
+			done += handleResp( c, data, len, now );
+			ringConsume( &c->in, len );
+		}
+
+		if( status == -1 )
+			killConn( c, "invalid frame" );
+
+	}
+
+	return done;
+
+}
+
+/*******************************************************************************
+* Name:    warmUp
+* Purpose: STOREs every key in the keyspace, so that GETs have something to
+*          find. Done over a blocking socket, a batch of keys per round trip.
+* Input:   fd - socket file descriptor
+*          in - the socket's ring buffer
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void warmUp( int fd, struct ring* in ){
+
+	// VARIABLE DEFINITIONS
+	char* out = NULL;
+	size_t outLen, outCap = 0;
+	char cmd[KEYSIZE];
+	char resp[64];
+	int batch;
+
+	for( int key = 0; key < keyspace; key += batch ){
+
+		batch = keyspace - key < WARMUPBATCH ? keyspace - key : WARMUPBATCH;
+
+		outLen = 0;
+		for( int i = key; i < key + batch; i++ ){
+			lruSim( STAT_STORE, i );
+			snprintf( cmd, sizeof(cmd), "STORE key%d", i );
+			appendFrame( &out, &outLen, &outCap, cmd, strlen(cmd) );
+			appendFrame( &out, &outLen, &outCap, value, valueSize );
+		}
+		sendAll( fd, out, outLen );
+
+		// each STORE gets two OKs
+		for( int i = 0; i < batch * 2; i++ ){
+			recvH( fd, in, resp, sizeof(resp) );
+			if( strncmp( resp, OK, strlen(OK) ) != 0 ){
+				fprintf( stderr, "loadgen: warmup STORE failed: %s\n", resp );
+				exit(1);
+			}
+		}
+
+	}
+
+	free( out );
+
+}
+
+/*******************************************************************************
+* Name:    totalStats
+* Purpose: Adds up the stats of every op we ran
+* Input:   total - where to put the total (zeroed first)
+* Output:  none
+*******************************************************************************/
+void totalStats( struct cmdStats* total ){
+
+	memset( total, 0, sizeof(*total) );
+
+	for( int i = 0; i < NUMSTATS; i++ ){
+
+		total->count += stats.cmd[i].count;
+		total->bytesIn += stats.cmd[i].bytesIn;
+		total->bytesOut += stats.cmd[i].bytesOut;
+		if( stats.cmd[i].maxNs > total->maxNs )
+			total->maxNs = stats.cmd[i].maxNs;
+
+		for( int b = 0; b < HISTBUCKETS; b++ )
+			total->hist[b] += stats.cmd[i].hist[b];
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    printRow
+* Purpose: Prints one row of the latency table, or one object of the JSON
+* Input:   name - the op's name
+*          cs   - the op's stats
+* Output:  none. the row is printed directly to Standard Out
+*******************************************************************************/
+void printRow( char* name, struct cmdStats* cs ){
+
+	if( json ){
+		printf( "\"%s\":{\"count\":%zu,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,"
+		 "\"p999\":%.1f,\"max\":%.1f}", name, cs->count,
+		 statsPercentile( cs, 0.50 ) / 1e3, statsPercentile( cs, 0.90 ) / 1e3,
+		 statsPercentile( cs, 0.99 ) / 1e3, statsPercentile( cs, 0.999 ) / 1e3,
+		 cs->maxNs / 1e3 );
+		return;
+	}
+
+	printf( "%-9s %10zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, cs->count,
+	 statsPercentile( cs, 0.50 ) / 1e3, statsPercentile( cs, 0.90 ) / 1e3,
+	 statsPercentile( cs, 0.99 ) / 1e3, statsPercentile( cs, 0.999 ) / 1e3,
+	 cs->maxNs / 1e3 );
+
+}
+
+/*******************************************************************************
+* Name:    report
+* Purpose: Prints the results of the run, as a table or (with -j) as JSON
+* Input:   elapsed - how long the run took, in seconds
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void report( double elapsed ){
+
+	// VARIABLE DEFINITIONS
+	struct cmdStats total;
+	int ops[5] = { STAT_GET, STAT_STORE, STAT_TRANSLATE, STAT_MGET,
+	 STAT_MSTORE };
+	int numOps = batchKeys > 1 ? 5 : 3;
+	size_t requests;
+	double hitRate, lruHitRate;
+
+	totalStats( &total );
+	requests = total.count + errors;
+	hitRate = getKeys > 0 ? 1 - (double)misses / getKeys : 0;
+	lruHitRate = lruGets > 0 ? (double)lruHits / lruGets : 0;
+
+	if( json ){
+
+		printf( "{\"mode\":\"%s\",\"conns\":%d,\"pipeline\":%d,\"seconds\":%d,"
+		 "\"rate\":%.0f,\"valueSize\":%zu,\"keyspace\":%d,"
+		 "\"mix\":{\"GET\":%d,\"STORE\":%d,\"TRANSLATE\":%d},"
+		 "\"skew\":%.2f,\"fill\":%d,\"batch\":%d,",
+		 rate > 0 ? "open" : "closed", numConns, pipeDepth, seconds, rate,
+		 valueSize, keyspace, mix[STAT_GET], mix[STAT_STORE],
+		 mix[STAT_TRANSLATE], skew, fillMisses, batchKeys );
+		printf( "\"hitRate\":%.4f,", hitRate );
+		if( lruKeys > 0 )
+			printf( "\"lruKeys\":%d,\"lruHitRate\":%.4f,", lruKeys, lruHitRate );
+		printf( "\"keys\":%zu,\"keysPerSec\":%.1f,", keysDone,
+		 keysDone / elapsed );
+		printf( "\"elapsed\":%.3f,\"requests\":%zu,\"throughput\":%.1f,"
+		 "\"errors\":%zu,\"misses\":%zu,\"lost\":%zu,\"connErrors\":%d,"
+		 "\"rejected\":%zu,"
+		 "\"bytesOut\":%zu,\"bytesIn\":%zu,\"latencyUs\":{", elapsed, requests,
+		 requests / elapsed, errors, misses, lost, (int)connErrors, rejected,
+		 total.bytesOut, total.bytesIn );
+
+		printRow( "all", &total );
+		for( int i = 0; i < numOps; i++ ){
+			printf( "," );
+			printRow( statNames[ ops[i] ], &stats.cmd[ ops[i] ] );
+		}
+		printf( "}}\n" );
+		return;
+
+	}
+
+	printf( "loadgen: %zu requests in %.2f s = %.1f req/s", requests, elapsed,
+	 requests / elapsed );
+	if( rate > 0 )
+		printf( " (target %.1f req/s)", rate );
+	printf( "\n" );
+	if( batchKeys > 1 )
+		printf( "loadgen: %zu keys in batches of %d = %.1f keys/s\n", keysDone,
+		 batchKeys, keysDone / elapsed );
+
+	printf( "loadgen: %zu errors, %zu misses, %zu lost, %zu connection errors, "
+	 "%zu connections turned away\n", errors, misses, lost, connErrors,
+	 rejected );
+	printf( "loadgen: %.1f MB sent, %.1f MB recieved\n", total.bytesOut / 1e6,
+	 total.bytesIn / 1e6 );
+	if( getKeys > 0 ){
+		printf( "loadgen: GET hit rate %.2f%%", hitRate * 100 );
+		if( lruKeys > 0 )
+			printf( " (exact LRU of %d keys: %.2f%%)", lruKeys, lruHitRate * 100 );
+		printf( "\n" );
+	}
+
+	printf( "%-9s %10s %9s %9s %9s %9s %9s\n", "op", "count", "p50 us",
+	 "p90 us", "p99 us", "p999 us", "max us" );
+	for( int i = 0; i < numOps; i++ )
+		if( stats.cmd[ ops[i] ].count > 0 )
+			printRow( statNames[ ops[i] ], &stats.cmd[ ops[i] ] );
+	printRow( "all", &total );
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-c conns] [-d seconds] [-m get:store:translate]"
+	 " [-s bytes] [-k keys] [-r rate] [-p depth] [-j]\n       [-Z skew] [-a] "
+	 "[-L keys] [-b keys]\n", name );
+	fprintf( stderr, "  -c  number of connections (default: 16)\n" );
+	fprintf( stderr, "  -d  how long to run, in seconds (default: 10)\n" );
+	fprintf( stderr, "  -m  relative weights of GET, STORE & TRANSLATE "
+	 "(default: 80:10:10)\n" );
+	fprintf( stderr, "  -s  size of STORE & TRANSLATE data (default: 100)\n" );
+	fprintf( stderr, "  -k  number of distinct keys (default: 1000)\n" );
+	fprintf( stderr, "  -r  open loop: send this many requests per second, "
+	 "spread over every\n      connection (default: closed loop)\n" );
+	fprintf( stderr, "  -p  closed loop: requests in flight per connection "
+	 "(default: 1)\n" );
+	fprintf( stderr, "  -j  print the results as one line of JSON\n" );
+	fprintf( stderr, "  -Z  pick keys from a Zipfian distribution of this skew "
+	 "(default: uniform)\n" );
+	fprintf( stderr, "  -a  STORE every key that a GET misses\n" );
+	fprintf( stderr, "  -L  also report the GET hit rate of an exact LRU cache of "
+	 "this many keys\n" );
+	fprintf( stderr, "  -b  send each GET & STORE as an MGET or MSTORE of this "
+	 "many keys (not\n      with -a or -L)\n" );
+	exit(1);
+
+}
+
+/*******************************************************************************
+* Name:    main
+* Purpose: Connects, warms up, runs the load, & reports
+* Input:   argc - number of command line arguments
+*          argv - the command line arguments
+* Output:  0 if every request succeeded, 1 if not
+*******************************************************************************/
+int main( int argc, char* argv[] ){
+
+	// VARIABLE DEFINITIONS
+	int opt;
+	struct lconn* conns;
+	struct lconn* c;
+	char addr[INET6_ADDRSTRLEN];
+	char greeting[256];
+	int epfd, n, done, one = 1;
+	int warm = 0, live;
+	struct epoll_event ev, events[MAXEVENTS];
+	struct timespec timeout;
+	uint64_t start, end, now, wake, interval = 0;
+
+	mix[STAT_GET] = 80;
+	mix[STAT_STORE] = 10;
+	mix[STAT_TRANSLATE] = 10;
+
+	while( (opt = getopt( argc, argv, "c:d:m:s:k:r:p:jZ:aL:b:" )) != -1 ){
+		switch( opt ){
+			case 'c':
+				numConns = atoi( optarg );
+				break;
+			case 'd':
+				seconds = atoi( optarg );
+				break;
+			case 'm':
+				if( sscanf( optarg, "%d:%d:%d", &mix[STAT_GET], &mix[STAT_STORE],
+				 &mix[STAT_TRANSLATE] ) != 3 )
+					usage( argv[0] );
+				break;
+			case 's':
+				valueSize = strtoul( optarg, NULL, 10 );
+				break;
+			case 'k':
+				keyspace = atoi( optarg );
+				break;
+			case 'r':
+				rate = atof( optarg );
+				break;
+			case 'p':
+				pipeDepth = atoi( optarg );
+				break;
+			case 'j':
+				json = 1;
+				break;
+			case 'Z':
+				skew = atof( optarg );
+				break;
+			case 'a':
+				fillMisses = 1;
+				break;
+			case 'L':
+				lruKeys = atoi( optarg );
+				break;
+			case 'b':
+				batchKeys = atoi( optarg );
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	mixTotal = mix[STAT_GET] + mix[STAT_STORE] + mix[STAT_TRANSLATE];
+	if( numConns < 1 || seconds < 1 || keyspace < 1 || pipeDepth < 1 ||
+	 rate < 0 || mixTotal < 1 || mix[STAT_GET] < 0 || mix[STAT_STORE] < 0 ||
+	 mix[STAT_TRANSLATE] < 0 || valueSize > MAXFRAMESIZE || skew < 0 ||
+	 lruKeys < 0 || batchKeys < 1 || batchKeys > MAXBATCH ||
+	 ( batchKeys > 1 && ( fillMisses || lruKeys > 0 ) ) ||
+	 (uint64_t)batchKeys * ( FRAMEHDRSIZE + valueSize ) > MAXFRAMESIZE )
+		usage( argv[0] );
+
+	if( skew > 0 )
+		zipfInit();
+
+	if( lruKeys > 0 ){
+		lruPrev = malloc( keyspace * sizeof(int) );
+		lruNext = malloc( keyspace * sizeof(int) );
+		lruIn = calloc( keyspace, 1 );
+		if( lruPrev == NULL || lruNext == NULL || lruIn == NULL ){
+			perror( "malloc" );
+			exit(1);
+		}
+	}
+
+	// lowercase letters, so that TRANSLATE has something to do
+	value = malloc( valueSize + 1 );
+	conns = calloc( numConns, sizeof(struct lconn) );
+	if( value == NULL || conns == NULL ){
+		perror( "malloc" );
+		exit(1);
+	}
+	for( size_t i = 0; i < valueSize; i++ )
+		value[i] = 'a' + i % 26;
+
+	// -b: every MSTORE stores the same value under each of its keys
+	if( batchKeys > 1 ){
+		batchCmd = malloc( batchKeys * KEYSIZE );
+		batchDataLen = batchKeys * ( FRAMEHDRSIZE + valueSize );
+		batchData = malloc( batchDataLen );
+		if( batchCmd == NULL || batchData == NULL ){
+			perror( "malloc" );
+			exit(1);
+		}
+		for( int i = 0; i < batchKeys; i++ ){
+			frameHdr( batchData + i * ( FRAMEHDRSIZE + valueSize ), valueSize );
+			memcpy( batchData + i * ( FRAMEHDRSIZE + valueSize ) + FRAMEHDRSIZE,
+			 value, valueSize );
+		}
+	}
+
+	/***********
+	* CONNECT! *
+	***********/
+
+	epfd = epoll_create1( 0 );
+	if( epfd == -1 ){
+		perror( "epoll_create1" );
+		exit(1);
+	}
+
+	for( int i = 0; i < numConns; i++ ){
+
+		c = &conns[i];
+		c->fd = connectServer( SERVER, PORT, addr, sizeof(addr) );
+		if( c->fd == -1 ){
+			fprintf( stderr, "loadgen: failed to connect\n" );
+			exit(1);
+		}
+
+		// get the server's greeting (or its refusal)
+		recvH( c->fd, &c->in, greeting, sizeof(greeting) );
+
+		if( strncmp( greeting, BUSY, strlen(BUSY) ) == 0 ){
+			rejected++;
+			close( c->fd );
+			c->dead = 1;
+			continue;
+		}
+
+		// our requests are small & pipelined; don't let Nagle hold them back
+		// (not even the last of each warmup batch)
+		setsockopt( c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+
+		if( !warm ){
+			warm = 1;
+			if( !json )
+				printf( "loadgen: connected to %s; storing %d keys\n", addr,
+				 keyspace );
+			warmUp( c->fd, &c->in );
+		}
+
+		setNonBlocking( c->fd );
+
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.ptr = c;
+		if( epoll_ctl( epfd, EPOLL_CTL_ADD, c->fd, &ev ) == -1 ){
+			perror( "epoll_ctl" );
+			exit(1);
+		}
+
+	}
+
+	if( !warm ){
+		fprintf( stderr, "loadgen: the server turned away every connection\n" );
+		exit(1);
+	}
+
+	if( !json )
+		printf( "loadgen: %s loop, %d connections, %d:%d:%d GET:STORE:TRANSLATE, "
+		 "%zu byte values, %d s\n", rate > 0 ? "open" : "closed", numConns,
+		 mix[STAT_GET], mix[STAT_STORE], mix[STAT_TRANSLATE], valueSize,
+		 seconds );
+
+	/********
+	* LOAD! *
+	********/
+
+	start = statsNow();
+	end = start + (uint64_t)seconds * 1000000000;
+	lastDone = start;
+
+	if( rate > 0 ){
+		// each live connection takes every live'th slot of the schedule
+		live = numConns - rejected;
+		interval = 1e9 * live / rate;
+		for( int i = 0, slot = 0; i < numConns; i++ )
+			if( !conns[i].dead )
+				conns[i].next = start + (uint64_t)( 1e9 * slot++ / rate );
+	} else {
+		for( int i = 0; i < numConns; i++ ){
+			if( conns[i].dead )
+				continue;
+			for( int d = 0; d < pipeDepth; d++ )
+				issue( &conns[i], start );
+			flushConn( &conns[i] );
+		}
+	}
+
+	while(1){
+
+		now = statsNow();
+
+		// open loop: send everything that's come due (late or not)
+		if( rate > 0 ){
+			for( int i = 0; i < numConns; i++ ){
+
+				c = &conns[i];
+				if( c->dead || c->next > now || c->next >= end )
+					continue;
+
+				while( c->next <= now && c->next < end ){
+					issue( c, c->next );
+					c->next += interval;
+				}
+				flushConn( c );
+
+			}
+		}
+
+		// are we done (or done waiting for stragglers)?
+		if( now >= end && ( inFlight == 0 || now >= end +
+		 (uint64_t)DRAINSECS * 1000000000 ) )
+			break;
+
+		// sleep until the next request is due, or the run (or drain) is over
+		wake = now < end ? end : end + (uint64_t)DRAINSECS * 1000000000;
+		if( rate > 0 && now < end ){
+			for( int i = 0; i < numConns; i++ )
+				if( !conns[i].dead && conns[i].next < wake )
+					wake = conns[i].next;
+		}
+		wake = wake > now ? wake - now : 0;
+		timeout.tv_sec = wake / 1000000000;
+		timeout.tv_nsec = wake % 1000000000;
+
+		n = epoll_pwait2( epfd, events, MAXEVENTS, &timeout, NULL );
+		if( n == -1 ){
+			if( errno == EINTR )
+				continue;
+			perror( "epoll_pwait2" );
+			exit(1);
+		}
+
+		for( int i = 0; i < n; i++ ){
+
+			c = events[i].data.ptr;
+
+			if( events[i].events & EPOLLOUT )
+				flushConn( c );
+
+			if( events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP) ){
+
+				done = readConn( c );
+
+				// closed loop: replace every request that completed
+				if( rate == 0 && !c->dead && statsNow() < end ){
+					while( done-- > 0 )
+						issue( c, statsNow() );
+				}
+
+				// (& send those, & any -a fills)
+				flushConn( c );
+
+			}
+
+		}
+
+	}
+
+	lost += inFlight;
+
+	/**********
+	* REPORT! *
+	**********/
+
+	report( ( ( lastDone > end ? lastDone : end ) - start ) / 1e9 );
+
+	for( int i = 0; i < numConns; i++ ){
+		if( !conns[i].dead )
+			close( conns[i].fd );
+		ringFree( &conns[i].in );
+		free( conns[i].out );
+		free( conns[i].reqs );
+	}
+	free( conns );
+	free( value );
+	free( zipfCdf );
+	free( lruPrev );
+	free( lruNext );
+	free( lruIn );
+	close( epfd );
+
+	return ( errors || lost || connErrors ) ? 1 : 0;
+
+}
@@ -0,0 +1,1217 @@
+/*******************************************************************************
+* File:       persist.h
+* Version:    0.7
+* Purpose:    Keeps the server's store on disk: an append-only log of every
+*             STORE, & snapshots of the whole store so that a restart only has
+*             to replay the end of that log
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Every value stored goes into the log as a record (its key, its
+              value, when it expires & a checksum of them all), appended to a
+              buffer in memory by whichever worker did the STORE. One logging
+              thread writes that buffer out a batch at a time (group commit):
+              however many STOREs come in while it's busy writing, the next
+              write() & fsync() take them all at once. Workers don't wake it for
+              each record, but with logKick() once they've handled everything in
+              hand (or logWait() when they need to know their records are
+              written). How often the log is fsync()'d is the policy:
+                LOG_ALWAYS   - after every batch. With this, nobody is told a
+                               STORE worked until its record is on disk.
+                LOG_EVERYSEC - at most once a second (a crash may lose the
+                               last second of STOREs)
+                LOG_NEVER    - whenever the kernel gets round to it
+
+              The logs are numbered by generation (log.0, log.1, ...). Now &
+              then a snapshot thread starts the next generation of log & writes
+              every key in the store to snapshot.tmp, which is fsync()'d &
+              renamed over snapshot. The snapshot records the generation that it
+              was started at, so the logs before that one can go.
+
+              A snapshot is written one of two ways. By default (snapFork), a
+              fork()ed child writes it: every stripe is write locked just for
+              the fork(), so the child gets the store exactly as it stood at
+              that moment, & then writes it out while we carry on serving. The
+              kernel shares every page between us, copying one only when we
+              write to it, so the memory that costs is just what changes while
+              the child runs; the child measures that (its Private_Dirty) as it
+              goes. The other way ("walk") reads the store a stripe at a time
+              from the snapshot thread itself, so STOREs to a stripe wait while
+              it's being written, & the snapshot is a blur over the time taken.
+
+              Either way, the snapshot may already hold some of the STOREs
+              logged in its own generation. That's harmless: every record holds
+              a whole value, so replaying the log over the snapshot in order
+              still leaves each key with its latest value.
+
+              Expiry times are kept as wall clock times, so a key's time keeps
+              running while we're down. Snapshots leave out the keys that have
+              already expired, & a record that's expired by the time it's
+              replayed deletes its key instead of setting it. Expiring a key
+              isn't logged: it's gone by the time anyone could read it anyway.
+
+              At startup the snapshot is mmap()'d & loaded straight into a store
+              sized for it up front, then only the logs from its generation on
+              are replayed. A log that ends in a torn record (we died part way
+              through writing it) is cut back to its last whole record.
+
+              When a running server hands over to a new one (see upgrade.h),
+              the old one freezes its log at its generation (persistFreeze()
+              waits out any snapshot under way & holds off the rest), & the new
+              one loads nothing from disk (the store comes from the old one)
+              but logs to the next generation, with every value it's sent, so
+              replaying the logs in order still ends with the latest values.
+              The new one takes no snapshots of its own until the old one has
+              gone, so that neither deletes logs the other still needs.
+
+              Records are in host byte order; the files aren't meant to be
+              carried between machines.
+*******************************************************************************/
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SNAPMAGIC "KVSNAP02"        // the first 8 bytes of every snapshot
+#define SNAPLOGMIN (64*1024*1024)   // a log this big (& twice the size of the
+                                    // last snapshot) gets a snapshot early
+#define SNAPBUFSIZE (1024*1024)     // how much of a snapshot to write at once
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "store.h"
+#include "stats.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// how often the log is fsync()'d
+#define LOG_NEVER    0
+#define LOG_EVERYSEC 1
+#define LOG_ALWAYS   2
+
+// the start of every record (the key & then the value follow it)
+struct logrec {
+	uint32_t keyLen;  // length of the key
+	uint32_t valLen;  // length of the value
+	uint32_t check;   // checksum of the lengths, expiry, key & value
+	uint64_t expires; // when the key expires (see storeNow()), or 0 for never
+} __attribute__(( packed ));
+
+// the start of every snapshot (its records follow it)
+struct snaphdr {
+	char     magic[8]; // SNAPMAGIC
+	uint64_t gen;      // the first generation of log to replay over it
+	uint64_t numKeys;  // number of records that follow
+};
+
+// what writing a snapshot came to
+struct snapres {
+	uint64_t numKeys; // keys written
+	uint64_t bytes;   // bytes written
+	uint64_t cowPeak; // most memory copy-on-write cost (fork()ed snapshots)
+};
+
+// the log, its logging & snapshot threads, & the store they're keeping
+struct plog {
+	pthread_mutex_t lock;
+	pthread_cond_t  more;    // signalled when there's something to write
+	pthread_cond_t  written; // broadcast after each batch (& each rotation)
+	char*    buf;       // records waiting to be written
+	size_t   len;       // length of buf
+	size_t   cap;       // allocated size of buf
+	char*    spare;     // the batch being written (then buf's replacement)
+	size_t   spareCap;  // allocated size of spare
+	uint64_t appended;  // bytes of records ever appended (a record's LSN is
+	                    // where it ends)
+	uint64_t done;      // bytes of records written (& fsync()'d, with
+	                    // LOG_ALWAYS) (updated atomically)
+	int      rotate;    // 1 while a snapshot waits for the next generation
+	int      stop;      // 1 once we're shutting down, 2 once we have
+	struct store* st;   // the store we're keeping
+	char     dir[PATH_MAX-64]; // where the logs & snapshot live
+	int      policy;    // one of the LOG_* values
+	int      snapSecs;  // seconds between snapshots (0 = only when the log's
+	                    // grown too big)
+	int      snapFork;  // 1 to write snapshots from a fork()ed child
+	int      snapNow;   // 1 to take a snapshot right away (atomic)
+	pthread_mutex_t snapLock; // held while deciding on & taking a snapshot
+	int      frozen;    // 1 while no snapshot may be taken (see
+	                    // persistFreeze())
+	size_t   blobSize;  // values this big are loaded into blobs (0 = never)
+	int      fd;        // the current generation's log
+	uint64_t gen;       // the current generation
+	uint64_t logSize;   // size of the current generation's log (atomic)
+	uint64_t snapSize;  // size of the last snapshot
+	size_t   records;   // number of records appended, ever
+	size_t   batches;   // number of write()s they took (atomic)
+	size_t   syncs;     // number of fsync()s (atomic)
+	size_t   snapshots; // number of snapshots taken (atomic)
+	uint64_t snapNs;    // how long the last one took
+	uint64_t snapKeys;  // ...how many keys it wrote
+	uint64_t forkNs;    // ...how long its fork() held up STOREs & GETs
+	uint64_t cowPeak;   // ...& the most memory copy-on-write cost
+	pthread_t logger;   // the logging thread
+	pthread_t snapper;  // the snapshot thread
+};
+
+// the LSN of the last record the calling thread appended (see logAppend())
+__thread uint64_t logLast;
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    logCheck
+* Purpose: Works out a record's checksum (32 bit FNV-1a)
+* Input:   key     - the key
+*          keyLen  - the length of the key
+*          val     - the value
+*          valLen  - the length of the value
+*          expires - when the key expires
+* Output:  the checksum
+*******************************************************************************/
+uint32_t logCheck( char* key, size_t keyLen, char* val, size_t valLen,
+ uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	uint32_t h = 2166136261U ^ keyLen ^ ( valLen << 16 );
+
+	for( int i = 0; i < 64; i += 8 ){
+		h ^= ( expires >> i ) & 0xff;
+		h *= 16777619;
+	}
+
+	for( size_t i = 0; i < keyLen; i++ ){
+		h ^= (unsigned char)key[i];
+		h *= 16777619;
+	}
+
+	for( size_t i = 0; i < valLen; i++ ){
+		h ^= (unsigned char)val[i];
+		h *= 16777619;
+	}
+
+	return h;
+
+}
+
+/*******************************************************************************
+* Name:    logPolicy
+* Purpose: Looks up an fsync policy by name
+* Input:   name - "always", "everysec" or "no"
+* Output:  the LOG_* value, or -1 if there's no such policy
+*******************************************************************************/
+int logPolicy( char* name ){
+
+	if( strcmp( name, "always" ) == 0 )
+		return LOG_ALWAYS;
+	if( strcmp( name, "everysec" ) == 0 )
+		return LOG_EVERYSEC;
+	if( strcmp( name, "no" ) == 0 )
+		return LOG_NEVER;
+
+	return -1;
+
+}
+
+/*******************************************************************************
+* Name:    logPath
+* Purpose: Builds the path of one of our files
+* Input:   l    - the log
+*          path - where to build it (PATH_MAX bytes)
+*          name - the file's name (a printf() format)
+*          gen  - filled into the format (for logs)
+* Output:  none
+*******************************************************************************/
+void logPath( struct plog* l, char* path, char* name, uint64_t gen ){
+
+	// VARIABLE DEFINITIONS
+	char file[64];
+
+	snprintf( file, sizeof(file), name, (unsigned long long)gen );
+	snprintf( path, PATH_MAX, "%s/%s", l->dir, file );
+
+}
+
+/*******************************************************************************
+* Name:    logSyncDir
+* Purpose: fsync()s our directory, so that files created, renamed or deleted
+*          in it stay that way after a crash
+* Input:   l - the log
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void logSyncDir( struct plog* l ){
+
+	// VARIABLE DEFINITIONS
+	int fd = open( l->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+	if( fd == -1 || fsync( fd ) == -1 ){
+		perror( l->dir );
+		exit(1);
+	}
+
+	close( fd );
+
+}
+
+/*******************************************************************************
+* Name:    logOpen
+* Purpose: Opens (or creates) the current generation's log, to append to
+* Input:   l - the log
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void logOpen( struct plog* l ){
+
+	// VARIABLE DEFINITIONS
+	char path[PATH_MAX];
+	struct stat sb;
+
+	logPath( l, path, "log.%llu", l->gen );
+
+	l->fd = open( path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+	if( l->fd == -1 || fstat( l->fd, &sb ) == -1 ){
+		perror( path );
+		exit(1);
+	}
+
+	__atomic_store_n( &l->logSize, sb.st_size, __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    logAppend
+* Purpose: Appends a record to the log (the store's onSet hook, so it's called
+*          with the key's stripe write locked). It's written once logKick() or
+*          logWait() wakes the logging thread (or within a second, anyway).
+* Input:   arg    - the log
+*          key    - the key
+*          keyLen - the length of the key
+*          val     - the new value
+*          valLen  - the length of the value
+*          expires - when the key expires, or 0 for never
+* Output:  none (the record's LSN is left in logLast)
+*******************************************************************************/
+void logAppend( void* arg, char* key, size_t keyLen, char* val, size_t valLen,
+ uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	struct plog* l = arg;
+	struct logrec r;
+
+	r.keyLen = keyLen;
+	r.valLen = valLen;
+	r.expires = expires;
+	r.check = logCheck( key, keyLen, val, valLen, expires );
+
+	pthread_mutex_lock( &l->lock );
+
+	appendBytes( &l->buf, &l->len, &l->cap, (char*)&r, sizeof(r) );
+	appendBytes( &l->buf, &l->len, &l->cap, key, keyLen );
+	appendBytes( &l->buf, &l->len, &l->cap, val, valLen );
+
+	l->appended += sizeof(r) + keyLen + valLen;
+	l->records++;
+	logLast = l->appended;
+
+	pthread_mutex_unlock( &l->lock );
+
+}
+
+/*******************************************************************************
+* Name:    logKick
+* Purpose: Wakes the logging thread to write out the records appended so far
+* Input:   l - the log
+* Output:  none
+*******************************************************************************/
+void logKick( struct plog* l ){
+
+	pthread_mutex_lock( &l->lock );
+	pthread_cond_signal( &l->more );
+	pthread_mutex_unlock( &l->lock );
+
+}
+
+/*******************************************************************************
+* Name:    logWait
+* Purpose: Waits until a record has been written (& fsync()'d, with LOG_ALWAYS)
+* Input:   l   - the log
+*          lsn - the record's LSN
+* Output:  none
+*******************************************************************************/
+void logWait( struct plog* l, uint64_t lsn ){
+
+	if( __atomic_load_n( &l->done, __ATOMIC_ACQUIRE ) >= lsn )
+		return;
+
+	pthread_mutex_lock( &l->lock );
+	pthread_cond_signal( &l->more );
+	while( l->done < lsn )
+		pthread_cond_wait( &l->written, &l->lock );
+	pthread_mutex_unlock( &l->lock );
+
+}
+
+/*******************************************************************************
+* Name:    logWrite
+* Purpose: Writes a batch of records to the end of the log
+* Input:   l   - the log
+*          buf - the records
+*          len - the length of buf
+* Output:  none (perror() & exit() program on fail; we can't go on promising
+*          to keep STOREs that we can't write down)
+*******************************************************************************/
+void logWrite( struct plog* l, char* buf, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	while( len > 0 ){
+
+		numbytes = write( l->fd, buf, len );
+
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			perror( "write log" );
+			exit(1);
+		}
+
+		buf += numbytes;
+		len -= numbytes;
+		__atomic_fetch_add( &l->logSize, numbytes, __ATOMIC_RELAXED );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    logThread
+* Purpose: The body of the logging thread: writes out everything appended
+*          since its last write as one batch, fsync()s it as the policy says,
+*          & starts the next generation of log when a snapshot asks for one
+* Input:   arg - the log
+* Output:  none (returns once the log has been stopped & flushed)
+*******************************************************************************/
+void* logThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct plog* l = arg;
+	struct timespec ts;
+	char* batch;
+	size_t len, cap;
+	uint64_t end;
+	uint64_t lastSync = statsNow();
+	int rotate, stop;
+	int dirty = 0; // 1 if we've written anything since our last fsync()
+
+	pthread_mutex_lock( &l->lock );
+
+	while(1){
+
+		// wait for something to write (but wake up at least once a second,
+		// for LOG_EVERYSEC)
+		if( l->len == 0 && !l->rotate && !l->stop ){
+			clock_gettime( CLOCK_REALTIME, &ts );
+			ts.tv_sec++;
+			pthread_cond_timedwait( &l->more, &l->lock, &ts );
+		}
+
+		// take everything appended so far as one batch, & leave the workers
+		// the spare buffer to go on appending to while we write it
+		batch = l->buf;
+		len = l->len;
+		cap = l->cap;
+		l->buf = l->spare;
+		l->cap = l->spareCap;
+		l->len = 0;
+		l->spare = batch;
+		l->spareCap = cap;
+
+		end = l->appended;
+		rotate = l->rotate;
+		stop = l->stop;
+
+		pthread_mutex_unlock( &l->lock );
+
+		if( len > 0 ){
+			logWrite( l, batch, len );
+			__atomic_fetch_add( &l->batches, 1, __ATOMIC_RELAXED );
+			dirty = 1;
+		}
+
+		if( dirty && ( l->policy == LOG_ALWAYS || rotate || stop ||
+		 ( l->policy == LOG_EVERYSEC && statsNow() - lastSync >= 1000000000 ) ) ){
+
+			if( fdatasync( l->fd ) == -1 ){
+				perror( "fdatasync log" );
+				exit(1);
+			}
+
+			__atomic_fetch_add( &l->syncs, 1, __ATOMIC_RELAXED );
+			lastSync = statsNow();
+			dirty = 0;
+
+		}
+
+		// does a snapshot want everything from here on in a new log?
+		if( rotate ){
+			close( l->fd );
+			__atomic_store_n( &l->gen, l->gen + 1, __ATOMIC_RELAXED );
+			logOpen( l );
+			logSyncDir( l );
+		}
+
+		pthread_mutex_lock( &l->lock );
+
+		__atomic_store_n( &l->done, end, __ATOMIC_RELEASE );
+		if( rotate )
+			l->rotate = 0;
+
+		if( stop && l->len == 0 ){
+			l->stop = 2;
+			pthread_cond_broadcast( &l->written );
+			pthread_mutex_unlock( &l->lock );
+			return NULL;
+		}
+
+		pthread_cond_broadcast( &l->written );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    snapWrite
+* Purpose: Writes one record (of a snapshot) to a file
+* Input:   f      - the file
+*          key    - the key
+*          keyLen - the length of the key
+*          val     - the value
+*          valLen  - the length of the value
+*          expires - when the key expires, or 0 for never
+* Output:  none (check ferror() afterwards)
+*******************************************************************************/
+void snapWrite( FILE* f, char* key, size_t keyLen, char* val, size_t valLen,
+ uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	struct logrec r;
+
+	r.keyLen = keyLen;
+	r.valLen = valLen;
+	r.expires = expires;
+	r.check = logCheck( key, keyLen, val, valLen, expires );
+
+	fwrite( &r, sizeof(r), 1, f );
+	fwrite( key, 1, keyLen, f );
+	fwrite( val, 1, valLen, f );
+
+}
+
+/*******************************************************************************
+* Name:    snapDirty
+* Purpose: Finds how much of our memory is private & dirty. In a snapshot
+*          child, that's every page the parent has written to since the fork
+*          (the kernel gave the parent the copy & left us the original), plus
+*          whatever we've written ourselves.
+* Input:   none
+* Output:  the number of bytes (0 if the kernel won't say)
+*******************************************************************************/
+uint64_t snapDirty(){
+
+	// VARIABLE DEFINITIONS
+	char buf[4096];
+	char* line;
+	unsigned long long kb = 0;
+	ssize_t n;
+	int fd = open( "/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC );
+
+	if( fd == -1 )
+		return 0;
+
+	n = read( fd, buf, sizeof(buf)-1 );
+	close( fd );
+	if( n <= 0 )
+		return 0;
+	buf[n] = '\0';
+
+	line = strstr( buf, "Private_Dirty:" );
+	if( line != NULL )
+		sscanf( line, "Private_Dirty: %llu", &kb );
+
+	return kb * 1024;
+
+}
+
+/*******************************************************************************
+* Name:    snapFile
+* Purpose: Writes a snapshot of the whole store to a file & fsync()s it
+* Input:   l     - the log
+*          path  - the file
+*          gen   - the generation of log that goes after it
+*          child - 0 to read lock each stripe while it's written; 1 if we're a
+*                  snapshot child (which has the store to itself), to track
+*                  copy-on-write as we go instead
+*          res   - filled in with what was written
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+int snapFile( struct plog* l, char* path, uint64_t gen, int child,
+ struct snapres* res ){
+
+	// VARIABLE DEFINITIONS
+	struct snaphdr hdr;
+	struct stripe* s;
+	struct entry* e;
+	uint64_t base = 0, dirty;
+	uint64_t now = storeNow();
+	char* buf;
+	FILE* f;
+
+	memset( res, 0, sizeof(*res) );
+
+	f = fopen( path, "w" );
+	buf = malloc( SNAPBUFSIZE );
+	if( f == NULL || buf == NULL ){
+		perror( path );
+		return -1;
+	}
+
+	// (touch the buffer now, so it's not counted as copy-on-write later)
+	memset( buf, 0, SNAPBUFSIZE );
+	setvbuf( f, buf, _IOFBF, SNAPBUFSIZE );
+	if( child )
+		base = snapDirty();
+
+	memcpy( hdr.magic, SNAPMAGIC, sizeof(hdr.magic) );
+	hdr.gen = gen;
+	hdr.numKeys = 0;
+	fwrite( &hdr, sizeof(hdr), 1, f );
+
+	for( int i = 0; i < STORESTRIPES; i++ ){
+
+		s = &l->st->stripes[i];
+		if( !child )
+			pthread_rwlock_rdlock( &s->lock );
+
+		for( size_t b = 0; b < s->numBuckets; b++ ){
+			for( e = s->buckets[b]; e != NULL; e = e->next ){
+				if( storeExpired( e, now ) )
+					continue;
+				snapWrite( f, e->data, e->keyLen, entryVal( e ), e->valLen,
+				 e->expires );
+				hdr.numKeys++;
+			}
+		}
+
+		if( !child )
+			pthread_rwlock_unlock( &s->lock );
+
+		// how much has the parent changed under us so far?
+		if( child && i % 8 == 7 ){
+			dirty = snapDirty();
+			if( dirty > base && dirty - base > res->cowPeak )
+				res->cowPeak = dirty - base;
+		}
+
+	}
+
+	// now we know how many keys went in
+	if( fflush( f ) == 0 ){
+		res->bytes = ftell( f );
+		pwrite( fileno( f ), &hdr, sizeof(hdr), 0 );
+	}
+	res->numKeys = hdr.numKeys;
+
+	if( ferror( f ) || fsync( fileno( f ) ) == -1 || fclose( f ) == EOF ){
+		perror( path );
+		free( buf );
+		return -1;
+	}
+
+	free( buf );
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    snapFork
+* Purpose: Writes a snapshot of the whole store from a fork()ed child. Every
+*          stripe is write locked for just as long as fork() takes, so the
+*          child gets the store as it stood at that moment (with no STORE
+*          half done); it then writes it out at its leisure while we carry
+*          on, the kernel copying each page we write to in the meantime.
+* Input:   l    - the log
+*          path - the file
+*          gen  - the generation of log that goes after it
+*          res  - filled in with what the child wrote
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+int snapFork( struct plog* l, char* path, uint64_t gen, struct snapres* res ){
+
+	// VARIABLE DEFINITIONS
+	int fds[2]; // a pipe for the child to send res back up
+	int status;
+	uint64_t start;
+	ssize_t numbytes;
+	pid_t pid;
+
+	if( pipe( fds ) == -1 ){
+		perror( "pipe" );
+		return -1;
+	}
+
+	start = statsNow();
+	for( int i = 0; i < STORESTRIPES; i++ )
+		pthread_rwlock_wrlock( &l->st->stripes[i].lock );
+
+	pid = fork();
+
+	// are we the child? (the only thread in it is a copy of this one, which
+	// holds every stripe's lock; nobody else will ever touch them)
+	if( pid == 0 ){
+
+		// close everything but the pipe (& stdio), so that no client socket
+		// (or listener) is kept open, or in its epoll set, by us
+		if( fds[1] > 3 )
+			close_range( 3, fds[1] - 1, 0 );
+		close_range( fds[1] + 1, ~0U, 0 );
+
+		status = snapFile( l, path, gen, 1, res );
+		if( write( fds[1], res, sizeof(*res) ) != sizeof(*res) )
+			_exit(1);
+		_exit( status == -1 ? 1 : 0 );
+
+	}
+
+	for( int i = 0; i < STORESTRIPES; i++ )
+		pthread_rwlock_unlock( &l->st->stripes[i].lock );
+	__atomic_store_n( &l->forkNs, statsNow() - start, __ATOMIC_RELAXED );
+
+	close( fds[1] );
+	if( pid == -1 ){
+		perror( "fork" );
+		close( fds[0] );
+		return -1;
+	}
+
+	// wait for the child to finish (or die)
+	do {
+		numbytes = read( fds[0], res, sizeof(*res) );
+	} while( numbytes == -1 && errno == EINTR );
+	close( fds[0] );
+
+	while( waitpid( pid, &status, 0 ) == -1 && errno == EINTR );
+
+	if( numbytes != sizeof(*res) || !WIFEXITED( status ) ||
+	 WEXITSTATUS( status ) != 0 ){
+		fprintf( stderr, "server: snapshot child failed\n" );
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    persistSnapshot
+* Purpose: Starts the next generation of log & writes a snapshot of the whole
+*          store, then deletes the logs that it replaces
+* Input:   l - the log
+* Output:  0 on success, -1 on failure (the old snapshot & logs are kept)
+*******************************************************************************/
+int persistSnapshot( struct plog* l ){
+
+	// VARIABLE DEFINITIONS
+	char tmp[PATH_MAX], path[PATH_MAX];
+	struct snapres res;
+	uint64_t start = statsNow();
+	uint64_t gen;
+	int status;
+
+	// everything appended from here on goes in the next log, & the snapshot
+	// (taken after this) will hold everything that went in the last one
+	pthread_mutex_lock( &l->lock );
+	l->rotate = 1;
+	pthread_cond_signal( &l->more );
+	while( l->rotate )
+		pthread_cond_wait( &l->written, &l->lock );
+	gen = l->gen;
+	pthread_mutex_unlock( &l->lock );
+
+	logPath( l, tmp, "snapshot.tmp", 0 );
+
+	// fork() a child to write it, or write it a stripe at a time ourselves
+	// (so that STOREs only ever wait on one stripe's worth)
+	if( l->snapFork )
+		status = snapFork( l, tmp, gen, &res );
+	else
+		status = snapFile( l, tmp, gen, 0, &res );
+
+	if( status == -1 ){
+		unlink( tmp );
+		return -1;
+	}
+
+	logPath( l, path, "snapshot", 0 );
+	if( rename( tmp, path ) == -1 ){
+		perror( path );
+		unlink( tmp );
+		return -1;
+	}
+	logSyncDir( l );
+
+	// the snapshot has everything the older logs had
+	while( gen-- > 0 ){
+		logPath( l, path, "log.%llu", gen );
+		if( unlink( path ) == -1 )
+			break;
+	}
+
+	l->snapSize = res.bytes;
+	__atomic_store_n( &l->snapKeys, res.numKeys, __ATOMIC_RELAXED );
+	__atomic_store_n( &l->cowPeak, res.cowPeak, __ATOMIC_RELAXED );
+	__atomic_store_n( &l->snapNs, statsNow() - start, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &l->snapshots, 1, __ATOMIC_RELAXED );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    snapThread
+* Purpose: The body of the snapshot thread: takes a snapshot every snapSecs
+*          seconds if anything has been logged since the last one, or sooner
+*          if the log has grown past SNAPLOGMIN & twice the last snapshot (or
+*          if snapNow asks for one), except while it's frozen
+* Input:   arg - the log
+* Output:  none (never returns)
+*******************************************************************************/
+void* snapThread( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct plog* l = arg;
+	uint64_t last = statsNow();
+	uint64_t size;
+	int due;
+
+	while(1){
+
+		sleep( 1 );
+
+		pthread_mutex_lock( &l->snapLock );
+
+		size = __atomic_load_n( &l->logSize, __ATOMIC_RELAXED );
+
+		// (not while we're handing over, or being handed over, to another
+		// server; see persistFreeze())
+		if( l->frozen )
+			due = 0;
+
+		// has someone asked for one?
+		else if( __atomic_exchange_n( &l->snapNow, 0, __ATOMIC_RELAXED ) )
+			due = 1;
+
+		else
+			due = size > 0 && ( ( l->snapSecs > 0 &&
+			 statsNow() - last >= (uint64_t)l->snapSecs * 1000000000 ) ||
+			 ( size >= SNAPLOGMIN && size >= 2 * l->snapSize ) );
+
+		if( due ){
+			persistSnapshot( l );
+			last = statsNow();
+		}
+
+		pthread_mutex_unlock( &l->snapLock );
+
+	}
+
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    persistSet
+* Purpose: Puts a loaded value into the store (a blob if it's big enough)
+* Input:   st       - the store
+*          blobSize - values this big go in blobs (0 = never)
+*          key      - the key
+*          keyLen   - the length of the key
+*          val      - the value
+*          valLen   - the length of the value
+*          expires  - when the key expires, or 0 for never
+* Output:  none (exit() program on fail)
+*******************************************************************************/
+void persistSet( struct store* st, size_t blobSize, char* key, size_t keyLen,
+ char* val, size_t valLen, uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	struct blob* b;
+	int status;
+
+	// has it expired since? then it's gone (along with any older value)
+	if( expires != 0 && expires <= storeNow() ){
+		storeDelete( st, key, keyLen, 0 );
+		return;
+	}
+
+	if( blobSize > 0 && valLen >= blobSize ){
+		b = blobNew();
+		status = b == NULL || blobWrite( b, val, valLen ) == -1 ? -1 :
+		 storeSetBlob( st, key, keyLen, b, expires );
+	} else {
+		status = storeSet( st, key, keyLen, val, valLen, expires );
+	}
+
+	if( status == -1 ){
+		fprintf( stderr, "server: out of memory loading the store\n" );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    persistRecords
+* Purpose: Loads every whole, intact record from a run of them into the store
+*          (from a snapshot, a log, or a primary; see repl.h)
+* Input:   st       - the store
+*          blobSize - values this big go in blobs (0 = never)
+*          data     - the records
+*          size     - the length of data
+*          used     - set to the length of the records that were loaded
+* Output:  the number of records loaded
+*******************************************************************************/
+size_t persistRecords( struct store* st, size_t blobSize, char* data,
+ size_t size, size_t* used ){
+
+	// VARIABLE DEFINITIONS
+	struct logrec r;
+	size_t off = 0, n = 0;
+	char* key;
+
+	while( size - off >= sizeof(r) ){
+
+		memcpy( &r, data + off, sizeof(r) );
+
+		// is the record cut short, or garbage?
+		if( (uint64_t)r.keyLen + r.valLen > size - off - sizeof(r) )
+			break;
+
+		key = data + off + sizeof(r);
+		if( logCheck( key, r.keyLen, key + r.keyLen, r.valLen, r.expires ) !=
+		 r.check )
+			break;
+
+		persistSet( st, blobSize, key, r.keyLen, key + r.keyLen, r.valLen,
+		 r.expires );
+
+		off += sizeof(r) + r.keyLen + r.valLen;
+		n++;
+
+	}
+
+	*used = off;
+	return n;
+
+}
+
+/*******************************************************************************
+* Name:    persistMap
+* Purpose: Maps a whole file into memory, to be read through once
+* Input:   path - the file
+*          size - set to its size
+* Output:  the file's contents, "" if it's empty, or NULL if there's no such
+*          file (perror() & exit() program on any other failure)
+*******************************************************************************/
+char* persistMap( char* path, size_t* size ){
+
+	// VARIABLE DEFINITIONS
+	int fd = open( path, O_RDONLY | O_CLOEXEC );
+	struct stat sb;
+	char* map;
+
+	if( fd == -1 && errno == ENOENT )
+		return NULL;
+
+	if( fd == -1 || fstat( fd, &sb ) == -1 ){
+		perror( path );
+		exit(1);
+	}
+
+	*size = sb.st_size;
+	if( *size == 0 ){
+		close( fd );
+		return "";
+	}
+
+	map = mmap( NULL, *size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED ){
+		perror( path );
+		exit(1);
+	}
+
+	madvise( map, *size, MADV_SEQUENTIAL );
+	return map;
+
+}
+
+/*******************************************************************************
+* Name:    persistInit
+* Purpose: Sets up the log of a store, & loads the store from its last snapshot
+*          & the logs since (before anything else is using the store), or
+*          leaves it to be loaded from the server we're taking over from
+* Input:   l        - the log
+*          st       - the store
+*          dir      - where the logs & snapshot live
+*          policy   - one of the LOG_* values
+*          snapSecs - seconds between snapshots (0 = only when the log's big)
+*          snapFork - 1 to write snapshots from a fork()ed child
+*          blobSize - values this big are loaded into blobs (0 = never)
+*          handoff  - the generation to log to if we're taking over from
+*                     another server (frozen until persistFreeze() says
+*                     otherwise), or 0 to load the store
+* Output:  none (exit() program on fail)
+*******************************************************************************/
+void persistInit( struct plog* l, struct store* st, char* dir, int policy,
+ int snapSecs, int snapFork, size_t blobSize, uint64_t handoff ){
+
+	// VARIABLE DEFINITIONS
+	char path[PATH_MAX];
+	struct snaphdr hdr;
+	uint64_t start = statsNow();
+	size_t size, used, numKeys = 0, numRecords = 0;
+	char* map;
+
+	memset( l, 0, sizeof(*l) );
+	pthread_mutex_init( &l->lock, NULL );
+	pthread_cond_init( &l->more, NULL );
+	pthread_cond_init( &l->written, NULL );
+	pthread_mutex_init( &l->snapLock, NULL );
+	snprintf( l->dir, sizeof(l->dir), "%s", dir );
+	l->st = st;
+	l->policy = policy;
+	l->snapSecs = snapSecs;
+	l->snapFork = snapFork;
+	l->blobSize = blobSize;
+
+	if( mkdir( dir, 0755 ) == -1 && errno != EEXIST ){
+		perror( dir );
+		exit(1);
+	}
+
+	// the server we're taking over from is still logging to the generation
+	// before this one, & sends us the store itself
+	if( handoff != 0 ){
+		l->gen = handoff;
+		l->frozen = 1;
+		logOpen( l );
+		logSyncDir( l );
+		printf( "server: logging to generation %llu while the old server hands "
+		 "over\n", (unsigned long long)handoff );
+		return;
+	}
+
+	/***********
+	* SNAPSHOT *
+	***********/
+
+	logPath( l, path, "snapshot", 0 );
+	map = persistMap( path, &size );
+
+	if( map != NULL ){
+
+		// (a snapshot is only ever renamed into place whole, so anything
+		// wrong with it means something other than a crash got to it)
+		if( size >= sizeof(hdr) )
+			memcpy( &hdr, map, sizeof(hdr) );
+		if( size < sizeof(hdr) || memcmp( hdr.magic, SNAPMAGIC, 8 ) != 0 ){
+			fprintf( stderr, "server: %s is not a snapshot\n", path );
+			exit(1);
+		}
+
+		storeReserve( st, hdr.numKeys );
+		numKeys = persistRecords( st, blobSize, map + sizeof(hdr),
+		 size - sizeof(hdr), &used );
+
+		if( numKeys != hdr.numKeys || used != size - sizeof(hdr) ){
+			fprintf( stderr, "server: %s is corrupt after %zu of %llu keys\n",
+			 path, numKeys, (unsigned long long)hdr.numKeys );
+			exit(1);
+		}
+
+		munmap( map, size );
+		l->gen = hdr.gen;
+		l->snapSize = size;
+
+	}
+
+	/*******
+	* LOGS *
+	*******/
+
+	// replay every log from the snapshot's generation on, in order
+	for( uint64_t gen = l->gen; ; gen++ ){
+
+		logPath( l, path, "log.%llu", gen );
+		map = persistMap( path, &size );
+		if( map == NULL )
+			break;
+
+		l->gen = gen;
+		if( size == 0 )
+			continue;
+
+		numRecords += persistRecords( st, blobSize, map, size, &used );
+		munmap( map, size );
+
+		// did we die part way through a write? then that record never
+		// happened (& was never acknowledged, with LOG_ALWAYS)
+		if( used < size ){
+			fprintf( stderr, "server: %s: dropping a torn record at byte %zu\n",
+			 path, used );
+			if( truncate( path, used ) == -1 ){
+				perror( path );
+				exit(1);
+			}
+		}
+
+	}
+
+	logOpen( l );
+	logSyncDir( l );
+
+	printf( "server: loaded %zu keys from the snapshot & %zu records from the "
+	 "log in %.2f seconds\n", numKeys, numRecords, ( statsNow() - start ) / 1e9 );
+
+}
+
+/*******************************************************************************
+* Name:    persistFreeze
+* Purpose: Stops (or restarts) the taking of snapshots, & so the rotation of
+*          the log. Freezing waits for any snapshot under way to finish, so
+*          that the generation doesn't move on after we return.
+* Input:   l      - the log
+*          frozen - 1 to freeze, 0 to thaw
+* Output:  the generation being logged to
+*******************************************************************************/
+uint64_t persistFreeze( struct plog* l, int frozen ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t gen;
+
+	pthread_mutex_lock( &l->snapLock );
+	l->frozen = frozen;
+	gen = __atomic_load_n( &l->gen, __ATOMIC_RELAXED );
+	pthread_mutex_unlock( &l->snapLock );
+
+	return gen;
+
+}
+
+/*******************************************************************************
+* Name:    persistStart
+* Purpose: Starts logging every STORE, & starts the logging & snapshot threads
+* Input:   l - the log (set up by persistInit())
+* Output:  none (exit() program on fail)
+*******************************************************************************/
+void persistStart( struct plog* l ){
+
+	// VARIABLE DEFINITIONS
+	int status;
+
+	l->st->onSetArg = l;
+	l->st->onSet = logAppend;
+
+	status = pthread_create( &l->logger, NULL, logThread, l );
+	if( status == 0 )
+		status = pthread_create( &l->snapper, NULL, snapThread, l );
+
+	if( status != 0 ){
+		fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    persistStop
+* Purpose: Writes out (& fsync()s) everything still waiting to be logged
+* Input:   l - the log
+* Output:  none
+*******************************************************************************/
+void persistStop( struct plog* l ){
+
+	pthread_mutex_lock( &l->lock );
+
+	l->stop = 1;
+	pthread_cond_signal( &l->more );
+	while( l->stop != 2 )
+		pthread_cond_wait( &l->written, &l->lock );
+
+	pthread_mutex_unlock( &l->lock );
+
+}
+
+/*******************************************************************************
+* Name:    persistPrint
+* Purpose: Reports on the log & snapshots
+* Input:   l - the log
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void persistPrint( struct plog* l ){
+
+	// VARIABLE DEFINITIONS
+	size_t records, batches;
+
+	pthread_mutex_lock( &l->lock );
+	records = l->records;
+	pthread_mutex_unlock( &l->lock );
+	batches = __atomic_load_n( &l->batches, __ATOMIC_RELAXED );
+
+	printf( "server: log: generation %llu, %llu bytes, %zu records in %zu "
+	 "writes (%.1f per write), %zu fsyncs\n",
+	 (unsigned long long)__atomic_load_n( &l->gen, __ATOMIC_RELAXED ),
+	 (unsigned long long)__atomic_load_n( &l->logSize, __ATOMIC_RELAXED ),
+	 records, batches, batches ? (double)records / batches : 0.0,
+	 __atomic_load_n( &l->syncs, __ATOMIC_RELAXED ) );
+	printf( "server: snapshots: %zu taken (%s); the last: %llu keys, %llu bytes "
+	 "in %.2f seconds\n", __atomic_load_n( &l->snapshots, __ATOMIC_RELAXED ),
+	 l->snapFork ? "fork" : "walk",
+	 (unsigned long long)__atomic_load_n( &l->snapKeys, __ATOMIC_RELAXED ),
+	 (unsigned long long)l->snapSize,
+	 __atomic_load_n( &l->snapNs, __ATOMIC_RELAXED ) / 1e9 );
+
+	if( l->snapFork )
+		printf( "server: snapshots: the last fork() held everyone up for %.3f "
+		 "ms; copy-on-write cost up to %llu KB\n",
+		 __atomic_load_n( &l->forkNs, __ATOMIC_RELAXED ) / 1e6,
+		 (unsigned long long)__atomic_load_n( &l->cowPeak, __ATOMIC_RELAXED ) / 1024 );
+
+}
+
+#endif
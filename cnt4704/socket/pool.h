@@ -0,0 +1,327 @@
+/*******************************************************************************
+* File:       pool.h
+* Version:    0.1
+* Purpose:    The server's buffer allocators: a size class pool per worker, &
+*             an arena per connection for building responses
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      A pool hands out blocks in power of 2 size classes (POOLMIN up
+              to POOLMAX bytes), carved out of big slabs & kept on one free
+              list per class. Each worker has its own pool, & a block is only
+              ever freed by the worker that allocated it, so there are no
+              locks at all. Anything bigger than POOLMAX goes to malloc().
+              Slabs are never given back to the system; a pool's footprint is
+              the most it has ever needed at once.
+
+              An arena hands out pieces of ARENACHUNK byte chunks (taken from
+              the pool) by just bumping a pointer, & frees all of them at once.
+              A connection builds its small responses in its arena & resets it
+              whenever its output queue empties.
+
+              Both keep statistics (see poolPrint()).
+*******************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define POOLMIN 64           // smallest size class (power of 2)
+#define POOLCLASSES 11       // number of size classes (64 bytes to 64KB)
+#define POOLMAX (POOLMIN << (POOLCLASSES-1)) // largest size class
+#define SLABSIZE (256*1024)  // size of the slabs that blocks are carved from
+#define ARENACHUNK 4096      // size of each arena chunk (one pool block)
+#define ARENAMAX 1024        // biggest piece an arena hands out
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// the header in front of every block (16 bytes, to keep blocks 16 aligned)
+struct block {
+	union {
+		struct block* next; // the next free block in our class (when free)
+		long          cls;  // our size class, or -1 for malloc() (in use)
+	};
+	long pad;
+};
+
+// one worker's pool
+struct pool {
+	struct block* free[POOLCLASSES]; // free list of each size class
+
+	// statistics (only written by the owning worker, so the main thread can
+	// read them at any time with relaxed atomic loads)
+	size_t allocs;         // number of poolAlloc()s
+	size_t hits;           // ...how many came straight off a free list
+	size_t large;          // ...how many were too big & went to malloc()
+	size_t slabBytes;      // bytes of slabs we've malloc()'d (our footprint)
+	size_t inUse;          // bytes of blocks handed out & not yet freed
+	size_t resets;         // number of arenaReset()s of our connections' arenas
+	size_t arenaAllocs;    // number of arenaAlloc()s of them
+};
+
+// the header at the front of every arena chunk
+struct chunk {
+	struct chunk* next; // the chunk allocated before this one
+	long pad;
+};
+
+// one connection's arena
+struct arena {
+	struct chunk* chunks; // the chunks we're using, newest first
+	char* cur;            // the next free byte of the newest chunk
+	char* end;            // the end of the newest chunk
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    poolCount
+* Purpose: Adds to one of a pool's statistics (only called by its owner, so
+*          this needs no atomic read-modify-write; it only has to be safe to
+*          read from another thread)
+* Input:   stat - the statistic
+*          n    - how much to add (may be negative)
+* Output:  none
+*******************************************************************************/
+void poolCount( size_t* stat, long n ){
+	__atomic_store_n( stat, *stat + n, __ATOMIC_RELAXED );
+}
+
+/*******************************************************************************
+* Name:    poolClass
+* Purpose: Finds the smallest size class that fits a number of bytes
+* Input:   size - the number of bytes
+* Output:  the size class, or -1 if it's bigger than POOLMAX
+*******************************************************************************/
+int poolClass( size_t size ){
+
+	// VARIABLE DEFINITIONS
+	int cls = 0;
+
+	if( size > POOLMAX )
+		return -1;
+
+	while( (size_t)(POOLMIN << cls) < size )
+		cls++;
+
+	return cls;
+
+}
+
+/*******************************************************************************
+* Name:    poolRefill
+* Purpose: Carves a new slab into free blocks of one size class
+* Input:   p   - the pool
+*          cls - the size class
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int poolRefill( struct pool* p, int cls ){
+
+	// VARIABLE DEFINITIONS
+	size_t blockSize = sizeof(struct block) + (POOLMIN << cls);
+	size_t count = SLABSIZE / blockSize;
+	char* slab;
+	struct block* b;
+
+	// the biggest classes still get a few blocks per slab
+	if( count < 4 )
+		count = 4;
+
+	slab = malloc( count * blockSize );
+	if( slab == NULL )
+		return -1;
+
+	poolCount( &p->slabBytes, count * blockSize );
+
+	for( size_t i = 0; i < count; i++ ){
+		b = (struct block*)( slab + i * blockSize );
+		b->next = p->free[cls];
+		p->free[cls] = b;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    poolAlloc
+* Purpose: Allocates a buffer from a pool
+* Input:   p    - the pool (of the calling worker)
+*          size - the number of bytes needed
+* Output:  the buffer, or NULL if we ran out of memory
+*******************************************************************************/
+void* poolAlloc( struct pool* p, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	int cls = poolClass( size );
+	struct block* b;
+
+	poolCount( &p->allocs, 1 );
+
+	// too big for any class?
+	if( cls == -1 ){
+
+		b = malloc( sizeof(struct block) + size );
+		if( b == NULL )
+			return NULL;
+
+		poolCount( &p->large, 1 );
+		b->cls = -1;
+		return b + 1;
+
+	}
+
+	if( p->free[cls] != NULL )
+		poolCount( &p->hits, 1 );
+	else if( poolRefill( p, cls ) == -1 )
+		return NULL;
+
+	b = p->free[cls];
+	p->free[cls] = b->next;
+
+	poolCount( &p->inUse, POOLMIN << cls );
+	b->cls = cls;
+	return b + 1;
+
+}
+
+/*******************************************************************************
+* Name:    poolFree
+* Purpose: Gives a buffer back to the pool it came from
+* Input:   p   - the pool (of the worker that allocated ptr)
+*          ptr - the buffer (NULL is ignored)
+* Output:  none
+*******************************************************************************/
+void poolFree( struct pool* p, void* ptr ){
+
+	// VARIABLE DEFINITIONS
+	struct block* b;
+	long cls;
+
+	if( ptr == NULL )
+		return;
+
+	b = (struct block*)ptr - 1;
+	cls = b->cls;
+
+	if( cls == -1 ){
+		free( b );
+		return;
+	}
+
+	poolCount( &p->inUse, -(long)(POOLMIN << cls) );
+	b->next = p->free[cls];
+	p->free[cls] = b;
+
+}
+
+/*******************************************************************************
+* Name:    arenaAlloc
+* Purpose: Allocates a piece of an arena
+* Input:   a    - the arena
+*          p    - the pool to take new chunks from
+*          size - the number of bytes needed (no more than ARENAMAX)
+* Output:  the piece (8 byte aligned), or NULL if we ran out of memory
+*******************************************************************************/
+char* arenaAlloc( struct arena* a, struct pool* p, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct chunk* c;
+	char* piece;
+
+	size = ( size + 7 ) & ~(size_t)7;
+
+	poolCount( &p->arenaAllocs, 1 );
+
+	// is there no room left in our newest chunk?
+	if( (size_t)( a->end - a->cur ) < size ){
+
+		c = poolAlloc( p, ARENACHUNK );
+		if( c == NULL )
+			return NULL;
+
+		c->next = a->chunks;
+		a->chunks = c;
+		a->cur = (char*)( c + 1 );
+		a->end = (char*)c + ARENACHUNK;
+
+	}
+
+	piece = a->cur;
+	a->cur += size;
+	return piece;
+
+}
+
+/*******************************************************************************
+* Name:    arenaReset
+* Purpose: Frees everything allocated from an arena at once. Its chunks go back
+*          on the pool's free list (usually there's just the one), so an idle
+*          connection holds no arena memory at all.
+* Input:   a - the arena
+*          p - the pool its chunks came from
+* Output:  none
+*******************************************************************************/
+void arenaReset( struct arena* a, struct pool* p ){
+
+	// VARIABLE DEFINITIONS
+	struct chunk* c;
+
+	if( a->chunks == NULL )
+		return;
+
+	poolCount( &p->resets, 1 );
+
+	while( (c = a->chunks) != NULL ){
+		a->chunks = c->next;
+		poolFree( p, c );
+	}
+
+	a->cur = a->end = NULL;
+
+}
+
+/*******************************************************************************
+* Name:    poolPrint
+* Purpose: Reports a pool's statistics
+* Input:   p    - the pool (may belong to another thread)
+*          name - what to call it in the report
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void poolPrint( struct pool* p, char* name ){
+
+	// VARIABLE DEFINITIONS
+	size_t allocs = __atomic_load_n( &p->allocs, __ATOMIC_RELAXED );
+	size_t hits = __atomic_load_n( &p->hits, __ATOMIC_RELAXED );
+	size_t large = __atomic_load_n( &p->large, __ATOMIC_RELAXED );
+
+	printf( "server: %s pool: %zu allocs, %.1f%% hit, %zu large, "
+	 "%zu KB in slabs, %zu KB in use\n", name, allocs,
+	 allocs ? 100.0 * hits / allocs : 0.0, large,
+	 __atomic_load_n( &p->slabBytes, __ATOMIC_RELAXED ) / 1024,
+	 __atomic_load_n( &p->inUse, __ATOMIC_RELAXED ) / 1024 );
+
+	printf( "server: %s arenas: %zu allocs, %zu resets\n", name,
+	 __atomic_load_n( &p->arenaAllocs, __ATOMIC_RELAXED ),
+	 __atomic_load_n( &p->resets, __ATOMIC_RELAXED ) );
+
+}
+
+#endif
@@ -0,0 +1,666 @@
+/*******************************************************************************
+* File:       pubsub.h
+* Version:    0.2
+* Purpose:    Change notifications for the server: who has subscribed to which
+*             keys (& prefixes), & getting each change to them
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      A topic is a key, or a prefix standing for every key that starts
+              with it. Each worker keeps its own table of the topics its
+              connections have subscribed to, with a list of the subscriptions
+              to each, that only it ever touches. The shared table (behind a
+              read-write lock) only records which workers have subscribers to
+              each topic, & changes only when a worker gains its first (or
+              loses its last) subscriber to one.
+
+              A change to a key becomes one message: its notification, framed
+              once, in one buffer. The writer looks up which workers want it in
+              the shared table & posts the message to each of their inboxes, so
+              the writer's cost is the same for 1 subscriber as for 10,000. Each
+              worker then queues the same buffer to every one of its own
+              subscribers; the message is reference counted (one reference per
+              inbox it's in & per queue it's on) & freed by whoever drops the
+              last one. Nothing is copied per subscriber.
+
+              An inbox is a lock free stack that any thread may push onto &
+              only its worker takes from (all of it at once, put back in the
+              order it was posted). The first message posted to an empty inbox
+              writes to the inbox's eventfd, to wake its worker. (Anyone else
+              with news for a worker, e.g. that the server is handing over to
+              a new one, may wake it the same way with inboxWake().)
+
+              With no subscriptions at all, a change costs one atomic load.
+              Prefixes are looked through in turn, so they're meant to be few.
+*******************************************************************************/
+
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define TOPICBUCKETS 1024 // hash buckets per table of topics (a power of 2)
+#define CHANGED "CHANGED " // what a notification says before the key
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "common.h"
+#include "store.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one notification, framed once & shared by every queue it's on
+struct message {
+	int      refs;   // references still held (atomic)
+	uint32_t len;    // the length of bytes
+	char*    bytes;  // the frame: its length, CHANGED & then the key
+	char*    key;    // the key that changed (inside bytes)
+	uint32_t keyLen; // the length of key
+	struct message* next[]; // the next message in each worker's inbox
+};
+
+// a worker's inbox: any thread may post to it, only its worker takes from it
+struct inbox {
+	struct message* head; // the newest message posted (atomic)
+	int id;               // the worker's index (which of next[] is ours)
+	int fd;               // an eventfd, written when the inbox was empty
+} __attribute__(( aligned(64) ));
+
+// one connection's subscription to one topic
+struct sub {
+	struct sub*   prev;      // the topic's other subscriptions
+	struct sub*   next;
+	struct sub*   ownerNext; // the connection's other subscriptions
+	struct topic* topic;     // what it's subscribed to
+	void*         owner;     // the connection
+};
+
+// a key, or a prefix of keys, that someone has subscribed to
+struct topic {
+	struct topic* next;    // the next topic in its bucket (or prefix list)
+	struct sub*   subs;    // (a worker's topics) the subscriptions to it
+	uint8_t*      workers; // (the shared topics) 1 for each worker with any
+	size_t        count;   // how many subs (or workers) there are
+	uint32_t      hash;
+	uint32_t      len;     // the length of name
+	int           prefix;  // 1 if it stands for every key that starts with name
+	char          name[];
+};
+
+// a table of topics
+struct topics {
+	struct topic* buckets[TOPICBUCKETS]; // the keys
+	struct topic* prefixes;              // the prefixes
+	size_t        count;                 // the number of topics (atomic)
+};
+
+// what every worker shares: which of them want which topics, & their inboxes
+struct pubsub {
+	pthread_rwlock_t lock;   // over topics
+	struct topics topics;    // every topic that any worker has subscribers to
+	int           numWorkers;
+	struct inbox* inboxes;   // one for each worker
+	unsigned long published; // number of changes that anyone wanted (atomic)
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    topicFind
+* Purpose: Looks a topic up in a table
+* Input:   t      - the table
+*          name   - the key or prefix
+*          len    - the length of name
+*          prefix - 1 for a prefix, 0 for a key
+* Output:  the topic, or NULL if it isn't there
+*******************************************************************************/
+struct topic* topicFind( struct topics* t, char* name, uint32_t len,
+ int prefix ){
+
+	// VARIABLE DEFINITIONS
+	uint32_t hash = storeHash( name, len );
+	struct topic* p = prefix ? t->prefixes : t->buckets[ hash % TOPICBUCKETS ];
+
+	for( ; p != NULL; p = p->next )
+		if( p->hash == hash && p->len == len && memcmp( p->name, name, len ) == 0 )
+			return p;
+
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    topicAdd
+* Purpose: Adds a new topic to a table
+* Input:   t       - the table
+*          name    - the key or prefix
+*          len     - the length of name
+*          prefix  - 1 for a prefix, 0 for a key
+*          workers - the number of workers to keep track of (0 for none; only
+*                    the shared table does)
+* Output:  the topic, or NULL if we ran out of memory
+*******************************************************************************/
+struct topic* topicAdd( struct topics* t, char* name, uint32_t len, int prefix,
+ int workers ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p = calloc( 1, sizeof(struct topic) + len + workers );
+	struct topic** head;
+
+	if( p == NULL )
+		return NULL;
+
+	p->hash = storeHash( name, len );
+	p->len = len;
+	p->prefix = prefix;
+	memcpy( p->name, name, len );
+	if( workers > 0 )
+		p->workers = (uint8_t*)p->name + len;
+
+	head = prefix ? &t->prefixes : &t->buckets[ p->hash % TOPICBUCKETS ];
+	p->next = *head;
+	*head = p;
+	__atomic_fetch_add( &t->count, 1, __ATOMIC_RELAXED );
+
+	return p;
+
+}
+
+/*******************************************************************************
+* Name:    topicDrop
+* Purpose: Takes a topic out of a table & frees it
+* Input:   t - the table
+*          p - the topic
+* Output:  none
+*******************************************************************************/
+void topicDrop( struct topics* t, struct topic* p ){
+
+	// VARIABLE DEFINITIONS
+	struct topic** link = p->prefix ? &t->prefixes :
+	 &t->buckets[ p->hash % TOPICBUCKETS ];
+
+	while( *link != p )
+		link = &(*link)->next;
+	*link = p->next;
+
+	__atomic_fetch_sub( &t->count, 1, __ATOMIC_RELAXED );
+	free( p );
+
+}
+
+/*******************************************************************************
+* Name:    topicMatches
+* Purpose: Tells whether a key is what a prefix topic stands for
+* Input:   p      - the (prefix) topic
+*          key    - the key
+*          keyLen - the length of key
+* Output:  1 if it is, 0 if not
+*******************************************************************************/
+int topicMatches( struct topic* p, char* key, uint32_t keyLen ){
+	return p->len <= keyLen && memcmp( p->name, key, p->len ) == 0;
+}
+
+/*******************************************************************************
+* Name:    msgRef
+* Purpose: Takes another reference to a message
+* Input:   m - the message
+* Output:  none
+*******************************************************************************/
+void msgRef( struct message* m ){
+	__atomic_fetch_add( &m->refs, 1, __ATOMIC_RELAXED );
+}
+
+/*******************************************************************************
+* Name:    msgUnref
+* Purpose: Drops a reference to a message, freeing it if it was the last
+* Input:   m - the message
+* Output:  none
+*******************************************************************************/
+void msgUnref( struct message* m ){
+	if( __atomic_sub_fetch( &m->refs, 1, __ATOMIC_ACQ_REL ) == 0 )
+		free( m );
+}
+
+/*******************************************************************************
+* Name:    inboxWake
+* Purpose: Wakes a worker by its inbox's eventfd (from any thread)
+* Input:   in - the inbox
+* Output:  none
+*******************************************************************************/
+void inboxWake( struct inbox* in ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t one = 1;
+
+	if( write( in->fd, &one, sizeof(one) ) == -1 )
+		perror( "write eventfd" );
+
+}
+
+/*******************************************************************************
+* Name:    inboxPost
+* Purpose: Posts a message to a worker's inbox (from any thread), waking the
+*          worker if the inbox was empty
+* Input:   in - the inbox
+*          m  - the message (the inbox takes over one of its references)
+* Output:  none
+*******************************************************************************/
+void inboxPost( struct inbox* in, struct message* m ){
+
+	// VARIABLE DEFINITIONS
+	struct message* head = __atomic_load_n( &in->head, __ATOMIC_RELAXED );
+
+	do {
+		m->next[ in->id ] = head;
+	} while( !__atomic_compare_exchange_n( &in->head, &head, m, 1,
+	 __ATOMIC_RELEASE, __ATOMIC_RELAXED ) );
+
+	// (a worker always takes its whole inbox, so only the first post after
+	// that needs to wake it)
+	if( head == NULL )
+		inboxWake( in );
+
+}
+
+/*******************************************************************************
+* Name:    inboxTake
+* Purpose: Takes every message out of a worker's inbox (by its worker only)
+* Input:   in - the inbox
+* Output:  the messages, oldest first & linked by their next[ in->id ] (NULL
+*          if there were none)
+*******************************************************************************/
+struct message* inboxTake( struct inbox* in ){
+
+	// VARIABLE DEFINITIONS
+	struct message* m;
+	struct message* next;
+	struct message* oldest = NULL;
+
+	if( __atomic_load_n( &in->head, __ATOMIC_RELAXED ) == NULL )
+		return NULL;
+
+	m = __atomic_exchange_n( &in->head, NULL, __ATOMIC_ACQUIRE );
+
+	// it's a stack, newest first; turn it around
+	for( ; m != NULL; m = next ){
+		next = m->next[ in->id ];
+		m->next[ in->id ] = oldest;
+		oldest = m;
+	}
+
+	return oldest;
+
+}
+
+/*******************************************************************************
+* Name:    inboxClear
+* Purpose: Resets an inbox's eventfd once its wake up has been seen
+* Input:   in - the inbox
+* Output:  none
+*******************************************************************************/
+void inboxClear( struct inbox* in ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t count;
+
+	// (it's non-blocking, so this just fails if there's nothing to clear)
+	if( read( in->fd, &count, sizeof(count) ) == -1 && errno != EAGAIN )
+		perror( "read eventfd" );
+
+}
+
+/*******************************************************************************
+* Name:    pubsubInit
+* Purpose: Sets up the shared table & every worker's inbox
+* Input:   ps         - the struct pubsub
+*          numWorkers - the number of workers
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void pubsubInit( struct pubsub* ps, int numWorkers ){
+
+	memset( ps, 0, sizeof(*ps) );
+	pthread_rwlock_init( &ps->lock, NULL );
+	ps->numWorkers = numWorkers;
+
+	ps->inboxes = aligned_alloc( 64, numWorkers * sizeof(struct inbox) );
+	if( ps->inboxes == NULL ){
+		perror( "aligned_alloc" );
+		exit(1);
+	}
+
+	for( int i = 0; i < numWorkers; i++ ){
+		ps->inboxes[i].head = NULL;
+		ps->inboxes[i].id = i;
+		ps->inboxes[i].fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if( ps->inboxes[i].fd == -1 ){
+			perror( "eventfd" );
+			exit(1);
+		}
+	}
+
+}
+
+/*******************************************************************************
+* Name:    pubsubJoin
+* Purpose: Records that a worker has (its first) subscribers to a topic
+* Input:   ps     - the struct pubsub
+*          id     - the worker
+*          name   - the key or prefix
+*          len    - the length of name
+*          prefix - 1 for a prefix, 0 for a key
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int pubsubJoin( struct pubsub* ps, int id, char* name, uint32_t len,
+ int prefix ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p;
+
+	pthread_rwlock_wrlock( &ps->lock );
+
+	p = topicFind( &ps->topics, name, len, prefix );
+	if( p == NULL )
+		p = topicAdd( &ps->topics, name, len, prefix, ps->numWorkers );
+
+	if( p != NULL && !p->workers[id] ){
+		p->workers[id] = 1;
+		p->count++;
+	}
+
+	pthread_rwlock_unlock( &ps->lock );
+
+	return p != NULL ? 0 : -1;
+
+}
+
+/*******************************************************************************
+* Name:    pubsubLeave
+* Purpose: Records that a worker has no subscribers to a topic any more
+* Input:   ps     - the struct pubsub
+*          id     - the worker
+*          name   - the key or prefix
+*          len    - the length of name
+*          prefix - 1 for a prefix, 0 for a key
+* Output:  none
+*******************************************************************************/
+void pubsubLeave( struct pubsub* ps, int id, char* name, uint32_t len,
+ int prefix ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p;
+
+	pthread_rwlock_wrlock( &ps->lock );
+
+	p = topicFind( &ps->topics, name, len, prefix );
+	if( p != NULL && p->workers[id] ){
+		p->workers[id] = 0;
+		if( --p->count == 0 )
+			topicDrop( &ps->topics, p );
+	}
+
+	pthread_rwlock_unlock( &ps->lock );
+
+}
+
+/*******************************************************************************
+* Name:    pubsubPublish
+* Purpose: Tells every worker with subscribers to a key (or to a prefix of it)
+*          that it has changed: one message, posted to each of their inboxes
+* Input:   ps     - the struct pubsub
+*          key    - the key
+*          keyLen - the length of key
+* Output:  none (if we're out of memory, the change goes unannounced)
+*******************************************************************************/
+void pubsubPublish( struct pubsub* ps, char* key, uint32_t keyLen ){
+
+	// VARIABLE DEFINITIONS
+	uint8_t to[ ps->numWorkers ]; // which workers to post to
+	int numTo = 0;
+	struct topic* p;
+	struct message* m;
+	size_t head = sizeof(struct message) +
+	 ps->numWorkers * sizeof(struct message*);
+	uint32_t payload = strlen(CHANGED) + keyLen;
+
+	// no one's subscribed to anything?
+	if( __atomic_load_n( &ps->topics.count, __ATOMIC_RELAXED ) == 0 )
+		return;
+
+	memset( to, 0, sizeof(to) );
+
+	pthread_rwlock_rdlock( &ps->lock );
+
+	if( (p = topicFind( &ps->topics, key, keyLen, 0 )) != NULL )
+		for( int i = 0; i < ps->numWorkers; i++ )
+			to[i] |= p->workers[i];
+
+	for( p = ps->topics.prefixes; p != NULL; p = p->next )
+		if( topicMatches( p, key, keyLen ) )
+			for( int i = 0; i < ps->numWorkers; i++ )
+				to[i] |= p->workers[i];
+
+	pthread_rwlock_unlock( &ps->lock );
+
+	for( int i = 0; i < ps->numWorkers; i++ )
+		numTo += to[i];
+
+	if( numTo == 0 )
+		return;
+
+	// frame it once, for all of them
+	m = malloc( head + FRAMEHDRSIZE + payload );
+	if( m == NULL ){
+		perror( "malloc" );
+		return;
+	}
+
+	m->refs = numTo;
+	m->bytes = (char*)m + head;
+	m->len = FRAMEHDRSIZE + payload;
+	frameHdr( m->bytes, payload );
+	memcpy( m->bytes + FRAMEHDRSIZE, CHANGED, strlen(CHANGED) );
+	m->key = m->bytes + FRAMEHDRSIZE + strlen(CHANGED);
+	m->keyLen = keyLen;
+	memcpy( m->key, key, keyLen );
+
+	__atomic_fetch_add( &ps->published, 1, __ATOMIC_RELAXED );
+
+	for( int i = 0; i < ps->numWorkers; i++ )
+		if( to[i] )
+			inboxPost( &ps->inboxes[i], m );
+
+}
+
+/*******************************************************************************
+* Name:    subAdd
+* Purpose: Subscribes a worker's connection to a topic
+* Input:   ps     - the struct pubsub
+*          id     - the worker
+*          t      - the worker's own topics
+*          owner  - the connection
+*          owned  - the connection's list of subscriptions
+*          name   - the key or prefix
+*          len    - the length of name
+*          prefix - 1 for a prefix, 0 for a key
+* Output:  1 if it's subscribed now, 0 if it already was, or -1 if we ran out
+*          of memory
+*******************************************************************************/
+int subAdd( struct pubsub* ps, int id, struct topics* t, void* owner,
+ struct sub** owned, char* name, uint32_t len, int prefix ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p = topicFind( t, name, len, prefix );
+	struct sub* s;
+
+	if( p != NULL )
+		for( s = *owned; s != NULL; s = s->ownerNext )
+			if( s->topic == p )
+				return 0;
+
+	s = calloc( 1, sizeof(struct sub) );
+	if( s == NULL )
+		return -1;
+
+	// is it our first subscriber to this topic? then the writers must know
+	if( p == NULL ){
+		p = topicAdd( t, name, len, prefix, 0 );
+		if( p == NULL || pubsubJoin( ps, id, name, len, prefix ) == -1 ){
+			if( p != NULL )
+				topicDrop( t, p );
+			free( s );
+			return -1;
+		}
+	}
+
+	s->topic = p;
+	s->owner = owner;
+	s->next = p->subs;
+	if( p->subs != NULL )
+		p->subs->prev = s;
+	p->subs = s;
+	p->count++;
+
+	s->ownerNext = *owned;
+	*owned = s;
+
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    subUnlink
+* Purpose: Takes a subscription off its topic & frees it (but not off its
+*          connection's list), dropping the topic if it was the last
+* Input:   ps - the struct pubsub
+*          id - the worker
+*          t  - the worker's own topics
+*          s  - the subscription
+* Output:  none
+*******************************************************************************/
+void subUnlink( struct pubsub* ps, int id, struct topics* t, struct sub* s ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p = s->topic;
+
+	if( s->prev != NULL )
+		s->prev->next = s->next;
+	else
+		p->subs = s->next;
+	if( s->next != NULL )
+		s->next->prev = s->prev;
+	free( s );
+
+	if( --p->count == 0 ){
+		pubsubLeave( ps, id, p->name, p->len, p->prefix );
+		topicDrop( t, p );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    subRemove
+* Purpose: Unsubscribes a worker's connection from a topic
+* Input:   ps     - the struct pubsub
+*          id     - the worker
+*          t      - the worker's own topics
+*          owned  - the connection's list of subscriptions
+*          name   - the key or prefix
+*          len    - the length of name
+*          prefix - 1 for a prefix, 0 for a key
+* Output:  1 if it was subscribed, 0 if not
+*******************************************************************************/
+int subRemove( struct pubsub* ps, int id, struct topics* t, struct sub** owned,
+ char* name, uint32_t len, int prefix ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p = topicFind( t, name, len, prefix );
+	struct sub* s;
+
+	if( p == NULL )
+		return 0;
+
+	for( ; *owned != NULL; owned = &(*owned)->ownerNext ){
+		if( (*owned)->topic == p ){
+			s = *owned;
+			*owned = s->ownerNext;
+			subUnlink( ps, id, t, s );
+			return 1;
+		}
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    subRemoveAll
+* Purpose: Unsubscribes a worker's connection from everything
+* Input:   ps    - the struct pubsub
+*          id    - the worker
+*          t     - the worker's own topics
+*          owned - the connection's list of subscriptions (emptied)
+* Output:  none
+*******************************************************************************/
+void subRemoveAll( struct pubsub* ps, int id, struct topics* t,
+ struct sub** owned ){
+
+	// VARIABLE DEFINITIONS
+	struct sub* s;
+
+	while( (s = *owned) != NULL ){
+		*owned = s->ownerNext;
+		subUnlink( ps, id, t, s );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    subEach
+* Purpose: Calls a function for each of a worker's subscriptions that a
+*          message is for (once per subscription, so a connection subscribed
+*          to both a key & a prefix of it gets both)
+* Input:   t    - the worker's own topics
+*          m    - the message
+*          fn   - what to call, with the subscription's connection & m
+* Output:  the number of subscriptions it was for
+*******************************************************************************/
+size_t subEach( struct topics* t, struct message* m,
+ void (*fn)( void* owner, struct message* m ) ){
+
+	// VARIABLE DEFINITIONS
+	struct topic* p = topicFind( t, m->key, m->keyLen, 0 );
+	size_t n = 0;
+
+	if( p != NULL )
+		for( struct sub* s = p->subs; s != NULL; s = s->next, n++ )
+			fn( s->owner, m );
+
+	for( p = t->prefixes; p != NULL; p = p->next )
+		if( topicMatches( p, m->key, m->keyLen ) )
+			for( struct sub* s = p->subs; s != NULL; s = s->next, n++ )
+				fn( s->owner, m );
+
+	return n;
+
+}
+
+#endif
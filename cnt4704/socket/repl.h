@@ -0,0 +1,1125 @@
+/*******************************************************************************
+* File:       repl.h
+* Version:    0.2
+* Purpose:    Replication for the server: a primary streams every STORE to its
+*             replicas, which serve GETs from their own copy of the store
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      A primary listens for replicas on a port of its own. A replica
+              connects to it, & from then on only ever reads batches: each is
+              a struct replhdr followed by records in the same format as the
+              log's (see persist.h), loaded into the replica's store with
+              persistRecords(). After each batch the replica sends back the
+              offset it has now applied up to (8 bytes), so the primary knows
+              how far behind it is.
+
+              The primary gives each replica a thread of its own. It first
+              adds the replica to the list that the store's onSet hook appends
+              every new value to, then sends the whole store a stripe at a time
+              (as snapFile() does with "walk": STOREs to a stripe wait only
+              while it's copied out, not while it's sent). Anything STOREd
+              during that is in the replica's buffer by then, & goes after it.
+              As with a snapshot & its log, replaying it over a snapshot that
+              already has some of it leaves every key with its latest value.
+
+              From then on it's the logging thread's pattern: STOREs append
+              records to the replica's buffer (waking its thread only when the
+              buffer was empty), & the thread sends whatever has built up as
+              one batch while the next one builds up behind it. A replica that
+              falls REPLMAXBUF bytes behind is dropped (& has to start over
+              with a new snapshot) rather than let its buffer eat our memory.
+              With nothing to send, a batch with no records goes every REPLBEAT
+              ms, so each end knows that the other is still there.
+
+              Each batch carries the wall clock time that its oldest record was
+              appended; a replica's lag is how long ago that was when the batch
+              has been loaded. With the primary & replica on different machines,
+              that's only as good as their clocks' agreement.
+
+              Replication is asynchronous: a STORE is answered before any
+              replica has it, so a replica can be behind, & STOREs a primary
+              answered just before it died may never reach one. A replica that
+              loses its primary keeps serving what it has, & reconnects (&
+              takes a new snapshot) every REPLRETRY seconds until it's back.
+              Keys deleted on the primary (by expiry or eviction) aren't sent:
+              a replica expires keys by their (wall clock) expiry times itself,
+              & should be given at least the primary's -M. Versions are each
+              store's own, so GETV on a replica gives its own versions.
+
+              The same stream hands a running server's store over to the new
+              server that's replacing it (see upgrade.h): the old server feeds
+              it over a Unix socket with replHandoff(), whether or not it's a
+              primary, & the new one loads it with replLoad(), up to the end of
+              the snapshot before it takes any clients & the rest as the old
+              one finishes with its own.
+
+              Records & headers are in host byte order, so the primary &
+              replicas have to share one.
+*******************************************************************************/
+
+#ifndef REPL_H
+#define REPL_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define REPLMAXBUF (256*1024*1024) // most bytes of records queued per replica
+#define REPLSNAPBATCH (1024*1024)  // snapshot bytes sent per batch (at least)
+#define REPLBEAT 1000              // ms between batches when there's no news
+#define REPLTIMEOUT 5              // secs a replica waits for a batch
+#define REPLRETRY 1                // secs between a replica's reconnects
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+#include "store.h"
+#include "stats.h"
+#include "persist.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// what a batch is
+#define REPL_SNAPSHOT 1 // part of the snapshot a replica starts with
+#define REPL_SYNCED   2 // the end of it (no records; streaming from here on)
+
+// where a replica has got to with its primary
+#define REPL_CONNECTING 0
+#define REPL_LOADING    1 // loading the snapshot
+#define REPL_STREAMING  2
+
+char* replStates[] = { "connecting", "loading the snapshot", "streaming" };
+
+// the start of every batch a primary sends (its records follow it)
+struct replhdr {
+	uint64_t len;     // length of the records that follow
+	uint64_t end;     // the offset they end at (bytes of records sent so far)
+	uint64_t since;   // when the oldest of them was appended (replNow()), or
+	                  // when the batch was sent if it has none
+	uint32_t records; // number of records
+	uint32_t flags;   // REPL_SNAPSHOT or REPL_SYNCED (or neither)
+} __attribute__(( packed ));
+
+// one replica, as its primary sees it
+struct replica {
+	struct repl* r;        // the primary it's a replica of
+	struct replica* next;  // the next in the primary's list
+	int      fd;
+	char     addr[INET6_ADDRSTRLEN];
+	pthread_cond_t more;   // signalled when its buffer stops being empty
+	char*    buf;          // records waiting to be sent
+	size_t   len;          // length of buf
+	size_t   cap;          // allocated size of buf
+	char*    spare;        // the batch being sent (then buf's replacement)
+	size_t   spareCap;     // allocated size of spare
+	uint32_t records;      // number of records in buf
+	uint64_t since;        // when the first of them was appended
+	uint64_t sent;         // the offset we've sent up to (atomic)
+	uint64_t acked;        // ...& the replica has loaded up to (atomic)
+	uint64_t snapEnd;      // the offset its snapshot ends at
+	size_t   batches;      // batches sent (atomic)
+	int      synced;       // 1 once its snapshot has been sent (atomic)
+	int      dead;         // 1 once it's gone (or fallen too far behind)
+	int      handoff;      // 1 if it's a new server taking over from us (it's
+	                       // freed by whoever joins its thread, not by it)
+	char     ack[8];       // part of an ack (if that's all recv() had)
+	size_t   ackLen;       // length of it
+};
+
+// replication, as a primary, a replica or both (a replica may have replicas)
+struct repl {
+	pthread_mutex_t lock;  // guards the list of replicas & their buffers
+	struct store* st;      // the store being replicated
+	size_t blobSize;       // values this big are loaded into blobs (0 = never)
+
+	// as a primary
+	void (*next)( void* arg, char* key, size_t keyLen, char* val,
+	 size_t valLen, uint64_t expires ); // the onSet hook we went in front of
+	void*  nextArg;         // ...& its arg
+	int    hooked;         // 1 once replAppend() is the store's onSet hook
+	struct replica* replicas; // every replica we're sending to (atomic)
+	int    sockfd;         // where replicas connect to us (-1 = nowhere)
+	int    closed;         // 1 once we've stopped taking them (atomic)
+	pthread_t handoff;     // the thread sending a new server the store
+	size_t served;         // replicas ever connected
+	size_t dropped;        // ...& dropped for falling too far behind
+	size_t records;        // records appended for them (while there were any)
+	size_t bytes;          // ...& their bytes
+
+	// as a replica
+	char*  host;           // our primary (NULL if we're not a replica)
+	char*  port;
+	int    state;          // one of the REPL_* states (atomic)
+	size_t syncs;          // snapshots taken (one per connection) (atomic)
+	uint64_t syncKeys;     // ...how many keys the last one had (atomic)
+	uint64_t syncNs;       // ...& how long it took to load (atomic)
+	size_t applied;        // records loaded, ever (atomic)
+	size_t appliedBytes;   // ...& their bytes (atomic)
+	uint64_t lagNow;       // the lag of the last batch loaded (atomic)
+	struct cmdStats lag;   // the lag of each batch of records loaded
+
+	// what we'd sent & loaded at our last report (only the main thread
+	// touches these)
+	uint64_t lastReport;
+	size_t lastRecords, lastBytes, lastApplied, lastAppliedBytes;
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    replNow
+* Purpose: Reads the wall clock (which, unlike statsNow(), means the same thing
+*          to a primary & its replicas)
+* Input:   none
+* Output:  the time in nanoseconds
+*******************************************************************************/
+uint64_t replNow(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+}
+
+/*******************************************************************************
+* Name:    replRecord
+* Purpose: Adds a record to the end of a buffer of them
+* Input:   buf     - the buffer (realloc()'d as needed)
+*          len     - the number of bytes in the buffer (updated)
+*          cap     - the allocated size of the buffer (updated)
+*          key     - the key
+*          keyLen  - the length of the key
+*          val     - the value
+*          valLen  - the length of the value
+*          expires - when the key expires, or 0 for never
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void replRecord( char** buf, size_t* len, size_t* cap, char* key,
+ size_t keyLen, char* val, size_t valLen, uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	struct logrec r;
+
+	r.keyLen = keyLen;
+	r.valLen = valLen;
+	r.expires = expires;
+	r.check = logCheck( key, keyLen, val, valLen, expires );
+
+	appendBytes( buf, len, cap, (char*)&r, sizeof(r) );
+	appendBytes( buf, len, cap, key, keyLen );
+	appendBytes( buf, len, cap, val, valLen );
+
+}
+
+/*******************************************************************************
+* Name:    replDrop
+* Purpose: Gives up on a replica: its thread finds out as soon as it next
+*          sends (or is woken), & cleans up after it (call with the lock held)
+* Input:   rp - the replica
+* Output:  none
+*******************************************************************************/
+void replDrop( struct replica* rp ){
+
+	rp->dead = 1;
+	shutdown( rp->fd, SHUT_RDWR );
+	pthread_cond_signal( &rp->more );
+
+}
+
+/*******************************************************************************
+* Name:    replAppend
+* Purpose: Appends a record to every replica's buffer (the store's onSet hook,
+*          so it's called with the key's stripe write locked), after calling
+*          the hook it went in front of
+* Input:   arg     - the struct repl
+*          key     - the key
+*          keyLen  - the length of the key
+*          val     - the new value
+*          valLen  - the length of the value
+*          expires - when the key expires, or 0 for never
+* Output:  none
+*******************************************************************************/
+void replAppend( void* arg, char* key, size_t keyLen, char* val, size_t valLen,
+ uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	struct repl* r = arg;
+	struct replica* rp;
+	size_t size = sizeof(struct logrec) + keyLen + valLen;
+
+	if( r->next != NULL )
+		r->next( r->nextArg, key, keyLen, val, valLen, expires );
+
+	// (with no replicas, that's all a STORE costs us)
+	if( __atomic_load_n( &r->replicas, __ATOMIC_ACQUIRE ) == NULL )
+		return;
+
+	pthread_mutex_lock( &r->lock );
+
+	for( rp = r->replicas; rp != NULL; rp = rp->next ){
+
+		if( rp->dead )
+			continue;
+
+		// has it fallen too far behind to catch up?
+		if( rp->len + size > REPLMAXBUF ){
+			fprintf( stderr, "server: replica %s fell %zu bytes behind; dropping "
+			 "it\n", rp->addr, rp->len );
+			r->dropped++;
+			replDrop( rp );
+			continue;
+		}
+
+		// (its thread only needs waking if it's run out of things to send)
+		if( rp->len == 0 ){
+			rp->since = replNow();
+			pthread_cond_signal( &rp->more );
+		}
+
+		replRecord( &rp->buf, &rp->len, &rp->cap, key, keyLen, val, valLen,
+		 expires );
+		rp->records++;
+
+	}
+
+	r->records++;
+	r->bytes += size;
+
+	pthread_mutex_unlock( &r->lock );
+
+}
+
+/*******************************************************************************
+* Name:    replSend
+* Purpose: Sends a batch to a replica (its header & records together), however
+*          many sendmsg()s it takes
+* Input:   fd   - the replica's socket
+*          hdr  - the batch's header
+*          data - its records
+* Output:  0 on success, -1 if the replica has gone
+*******************************************************************************/
+int replSend( int fd, struct replhdr* hdr, char* data ){
+
+	// VARIABLE DEFINITIONS
+	struct iovec iov[2];
+	struct msghdr msg;
+	ssize_t numbytes;
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(*hdr);
+	iov[1].iov_base = data;
+	iov[1].iov_len = hdr->len;
+
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = iov;
+	msg.msg_iovlen = hdr->len > 0 ? 2 : 1;
+
+	while( msg.msg_iovlen > 0 ){
+
+		numbytes = sendmsg( fd, &msg, MSG_NOSIGNAL );
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+
+		// skip past whatever went
+		while( msg.msg_iovlen > 0 && (size_t)numbytes >= msg.msg_iov->iov_len ){
+			numbytes -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if( msg.msg_iovlen > 0 ){
+			msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + numbytes;
+			msg.msg_iov->iov_len -= numbytes;
+		}
+
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    replAcks
+* Purpose: Takes whatever acks a replica has sent back (without waiting), &
+*          notes the last of them
+* Input:   rp - the replica
+* Output:  0 on success, -1 if the replica has gone
+*******************************************************************************/
+int replAcks( struct replica* rp ){
+
+	// VARIABLE DEFINITIONS
+	char buf[sizeof(rp->ack) + 512];
+	size_t have, whole;
+	uint64_t acked;
+	ssize_t numbytes;
+
+	do {
+
+		memcpy( buf, rp->ack, rp->ackLen );
+		numbytes = recv( rp->fd, buf + rp->ackLen, 512, MSG_DONTWAIT );
+
+		if( numbytes == 0 )
+			return -1;
+		if( numbytes == -1 )
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ?
+			 0 : -1;
+
+		// (only the last whole ack matters)
+		have = rp->ackLen + numbytes;
+		whole = have - have % sizeof(acked);
+		if( whole > 0 ){
+			memcpy( &acked, buf + whole - sizeof(acked), sizeof(acked) );
+			__atomic_store_n( &rp->acked, acked, __ATOMIC_RELAXED );
+		}
+		rp->ackLen = have - whole;
+		memcpy( rp->ack, buf + whole, rp->ackLen );
+
+	} while( numbytes == 512 );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    replBatch
+* Purpose: Sends a replica one batch of records & takes its acks
+* Input:   rp      - the replica
+*          data    - the records
+*          len     - the length of data
+*          records - the number of records
+*          since   - when the oldest of them was appended (0 = now)
+*          flags   - REPL_SNAPSHOT, REPL_SYNCED or 0
+* Output:  0 on success, -1 if the replica has gone
+*******************************************************************************/
+int replBatch( struct replica* rp, char* data, size_t len, uint32_t records,
+ uint64_t since, uint32_t flags ){
+
+	// VARIABLE DEFINITIONS
+	struct replhdr hdr;
+
+	hdr.len = len;
+	hdr.end = rp->sent + len;
+	hdr.since = since != 0 ? since : replNow();
+	hdr.records = records;
+	hdr.flags = flags;
+
+	if( replSend( rp->fd, &hdr, data ) == -1 )
+		return -1;
+
+	__atomic_store_n( &rp->sent, hdr.end, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &rp->batches, 1, __ATOMIC_RELAXED );
+
+	return replAcks( rp );
+
+}
+
+/*******************************************************************************
+* Name:    replSnapshot
+* Purpose: Sends a replica the whole store, a stripe at a time. Each stripe is
+*          read locked only while its records are copied out, not while
+*          they're sent.
+* Input:   rp - the replica
+* Output:  0 on success, -1 if the replica has gone
+*******************************************************************************/
+int replSnapshot( struct replica* rp ){
+
+	// VARIABLE DEFINITIONS
+	struct stripe* s;
+	struct entry* e;
+	uint64_t now = storeNow();
+	char* buf = NULL;
+	size_t len = 0, cap = 0;
+	uint32_t records = 0;
+	int status = 0;
+
+	for( int i = 0; i < STORESTRIPES && status == 0; i++ ){
+
+		s = &rp->r->st->stripes[i];
+		pthread_rwlock_rdlock( &s->lock );
+
+		for( size_t b = 0; b < s->numBuckets; b++ ){
+			for( e = s->buckets[b]; e != NULL; e = e->next ){
+				if( storeExpired( e, now ) )
+					continue;
+				replRecord( &buf, &len, &cap, e->data, e->keyLen, entryVal( e ),
+				 e->valLen, e->expires );
+				records++;
+			}
+		}
+
+		pthread_rwlock_unlock( &s->lock );
+
+		if( len >= REPLSNAPBATCH || ( i == STORESTRIPES-1 && len > 0 ) ){
+			status = replBatch( rp, buf, len, records, 0, REPL_SNAPSHOT );
+			len = 0;
+			records = 0;
+		}
+
+	}
+
+	free( buf );
+
+	if( status == 0 )
+		status = replBatch( rp, NULL, 0, 0, 0, REPL_SYNCED );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    replFeed
+* Purpose: The body of a replica's thread on its primary: sends it the store,
+*          then everything STOREd since, a batch at a time, until it's gone
+* Input:   arg - the replica
+* Output:  NULL
+*******************************************************************************/
+void* replFeed( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct replica* rp = arg;
+	struct repl* r = rp->r;
+	struct replica** p;
+	struct timespec ts;
+	char* batch;
+	size_t len, cap;
+	uint32_t records;
+	uint64_t since;
+	uint64_t start = statsNow();
+	int status;
+
+	// from here on, every STORE is appended to our buffer...
+	pthread_mutex_lock( &r->lock );
+	rp->next = r->replicas;
+	__atomic_store_n( &r->replicas, rp, __ATOMIC_RELEASE );
+	r->served++;
+	pthread_mutex_unlock( &r->lock );
+
+	// ...& the snapshot has everything from before that
+	status = replSnapshot( rp );
+	if( status == 0 ){
+		rp->snapEnd = rp->sent;
+		__atomic_store_n( &rp->synced, 1, __ATOMIC_RELEASE );
+		printf( "server: sent replica %s a snapshot of %llu bytes in %.2f "
+		 "seconds\n", rp->addr, (unsigned long long)rp->sent,
+		 ( statsNow() - start ) / 1e9 );
+	}
+
+	pthread_mutex_lock( &r->lock );
+
+	while( status == 0 && !rp->dead ){
+
+		// wait for something to send (but send something at least every
+		// REPLBEAT ms)
+		if( rp->len == 0 ){
+			clock_gettime( CLOCK_REALTIME, &ts );
+			ts.tv_nsec += (long)REPLBEAT * 1000000;
+			ts.tv_sec += ts.tv_nsec / 1000000000;
+			ts.tv_nsec %= 1000000000;
+			pthread_cond_timedwait( &rp->more, &r->lock, &ts );
+			if( rp->dead )
+				break;
+		}
+
+		// take everything appended so far as one batch, & leave the spare
+		// buffer to go on appending to while we send it
+		batch = rp->buf;
+		len = rp->len;
+		cap = rp->cap;
+		records = rp->records;
+		since = len > 0 ? rp->since : 0;
+		rp->buf = rp->spare;
+		rp->cap = rp->spareCap;
+		rp->len = 0;
+		rp->records = 0;
+		rp->spare = batch;
+		rp->spareCap = cap;
+
+		pthread_mutex_unlock( &r->lock );
+		status = replBatch( rp, batch, len, records, since, 0 );
+		pthread_mutex_lock( &r->lock );
+
+	}
+
+	// it's gone; take it off the list (so nothing more is appended for it)
+	rp->dead = 1;
+	for( p = &r->replicas; *p != rp; p = &(*p)->next );
+	__atomic_store_n( p, rp->next, __ATOMIC_RELEASE );
+	pthread_mutex_unlock( &r->lock );
+
+	printf( "server: replica %s has gone\n", rp->addr );
+
+	close( rp->fd );
+	free( rp->buf );
+	free( rp->spare );
+	rp->buf = rp->spare = NULL;
+
+	if( !rp->handoff ){
+		pthread_cond_destroy( &rp->more );
+		free( rp );
+	}
+
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    replNew
+* Purpose: Sets up the struct replica for a newly connected replica
+* Input:   r    - the struct repl
+*          fd   - its socket
+*          addr - its address (for logging)
+* Output:  the replica, or NULL if we ran out of memory
+*******************************************************************************/
+struct replica* replNew( struct repl* r, int fd, char* addr ){
+
+	// VARIABLE DEFINITIONS
+	struct replica* rp = calloc( 1, sizeof(struct replica) );
+
+	if( rp == NULL ){
+		perror( "calloc" );
+		return NULL;
+	}
+
+	rp->r = r;
+	rp->fd = fd;
+	pthread_cond_init( &rp->more, NULL );
+	snprintf( rp->addr, sizeof(rp->addr), "%s", addr );
+
+	return rp;
+
+}
+
+/*******************************************************************************
+* Name:    replAccept
+* Purpose: The body of a primary's thread that accepts replicas, & starts a
+*          thread for each
+* Input:   arg - the struct repl
+* Output:  none (returns once replStop() has been called)
+*******************************************************************************/
+void* replAccept( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct repl* r = arg;
+	struct replica* rp;
+	struct sockaddr_storage their_addr;
+	socklen_t sin_size;
+	struct pollfd pfd;
+	pthread_t thread;
+	char addr[INET6_ADDRSTRLEN];
+	int fd, yes = 1;
+
+	pfd.fd = r->sockfd;
+	pfd.events = POLLIN;
+
+	while( !__atomic_load_n( &r->closed, __ATOMIC_RELAXED ) ){
+
+		// (the listener is non-blocking, like the workers'; & we look up now
+		// & then to see if we've been stopped)
+		if( poll( &pfd, 1, REPLBEAT ) <= 0 )
+			continue;
+
+		sin_size = sizeof(their_addr);
+		fd = accept4( r->sockfd, (struct sockaddr*)&their_addr, &sin_size,
+		 SOCK_CLOEXEC );
+		if( fd == -1 )
+			continue;
+
+		// our batches are written whole, & its acks are tiny & wanted now
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes) );
+
+		inet_ntop( their_addr.ss_family,
+		 get_in_addr( (struct sockaddr*)&their_addr ), addr, sizeof(addr) );
+
+		rp = replNew( r, fd, addr );
+		if( rp == NULL ){
+			close( fd );
+			continue;
+		}
+
+		printf( "server: replica %s connected\n", rp->addr );
+
+		if( pthread_create( &thread, NULL, replFeed, rp ) != 0 ){
+			fprintf( stderr, "server: no thread for replica %s\n", rp->addr );
+			close( fd );
+			pthread_cond_destroy( &rp->more );
+			free( rp );
+			continue;
+		}
+		pthread_detach( thread );
+
+	}
+
+	// (whoever we're stopping for has its own copy of the listener)
+	close( r->sockfd );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    replRead
+* Purpose: Recieves exactly so many bytes from a (blocking) socket
+* Input:   fd  - the socket
+*          buf - where to put them
+*          len - how many
+* Output:  0 on success, -1 if the connection failed or timed out
+*******************************************************************************/
+int replRead( int fd, char* buf, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	while( len > 0 ){
+
+		numbytes = recv( fd, buf, len, 0 );
+		if( numbytes == -1 && errno == EINTR )
+			continue;
+		if( numbytes <= 0 )
+			return -1;
+
+		buf += numbytes;
+		len -= numbytes;
+
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    replLoad
+* Purpose: Loads every batch a primary sends into our store, acking each, until
+*          the connection fails (or the snapshot has all been loaded)
+* Input:   r        - the struct repl
+*          fd       - the connection to the primary
+*          from     - who the primary is (for logging)
+*          snapOnly - 1 to return once the snapshot has been loaded
+* Output:  0 if the snapshot has been loaded (with snapOnly), else -1 once
+*          the connection has failed
+*******************************************************************************/
+int replLoad( struct repl* r, int fd, char* from, int snapOnly ){
+
+	// VARIABLE DEFINITIONS
+	struct replhdr hdr;
+	char* buf = NULL;
+	size_t cap = 0, used, n;
+	uint64_t start = statsNow(), keys = 0, lag;
+	char* newBuf;
+
+	while( replRead( fd, (char*)&hdr, sizeof(hdr) ) == 0 ){
+
+		if( hdr.len > cap ){
+			newBuf = realloc( buf, hdr.len );
+			if( newBuf == NULL ){
+				perror( "realloc" );
+				break;
+			}
+			buf = newBuf;
+			cap = hdr.len;
+		}
+
+		if( replRead( fd, buf, hdr.len ) == -1 )
+			break;
+
+		n = persistRecords( r->st, r->blobSize, buf, hdr.len, &used );
+		if( n != hdr.records || used != hdr.len ){
+			fprintf( stderr, "server: corrupt batch from our primary after %zu "
+			 "of %u records\n", n, hdr.records );
+			break;
+		}
+
+		statsAdd( &r->applied, n );
+		statsAdd( &r->appliedBytes, hdr.len );
+
+		if( hdr.flags & REPL_SNAPSHOT )
+			keys += n;
+
+		// that's the whole snapshot; we're up to date from here on
+		if( hdr.flags & REPL_SYNCED ){
+			__atomic_store_n( &r->syncKeys, keys, __ATOMIC_RELAXED );
+			__atomic_store_n( &r->syncNs, statsNow() - start, __ATOMIC_RELAXED );
+			statsAdd( &r->syncs, 1 );
+			__atomic_store_n( &r->state, REPL_STREAMING, __ATOMIC_RELAXED );
+			printf( "server: loaded a snapshot of %llu keys from %s in %.2f "
+			 "seconds\n", (unsigned long long)keys, from,
+			 ( statsNow() - start ) / 1e9 );
+		}
+
+		// how long ago was the oldest of these STOREd?
+		if( !( hdr.flags & REPL_SNAPSHOT ) ){
+			lag = replNow();
+			lag = lag > hdr.since ? lag - hdr.since : 0;
+			__atomic_store_n( &r->lagNow, lag, __ATOMIC_RELAXED );
+			if( n > 0 ){
+				statsAdd( &r->lag.count, 1 );
+				statsAdd( &r->lag.bytesIn, hdr.len );
+				statsAdd( &r->lag.hist[ statsBucket( lag ) ], 1 );
+				if( lag > r->lag.maxNs )
+					__atomic_store_n( &r->lag.maxNs, lag, __ATOMIC_RELAXED );
+			}
+		}
+
+		if( send( fd, &hdr.end, sizeof(hdr.end), MSG_NOSIGNAL ) !=
+		 sizeof(hdr.end) )
+			break;
+
+		if( snapOnly && ( hdr.flags & REPL_SYNCED ) ){
+			free( buf );
+			return 0;
+		}
+
+	}
+
+	free( buf );
+	return -1;
+
+}
+
+/*******************************************************************************
+* Name:    replFollow
+* Purpose: The body of a replica's thread: connects to the primary & loads all
+*          it sends, & reconnects whenever that fails
+* Input:   arg - the struct repl
+* Output:  none (never returns)
+*******************************************************************************/
+void* replFollow( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct repl* r = arg;
+	struct timeval tv = { REPLTIMEOUT, 0 };
+	char addr[INET6_ADDRSTRLEN];
+	char from[256];
+	int fd, yes = 1;
+
+	snprintf( from, sizeof(from), "%s:%s", r->host, r->port );
+
+	while(1){
+
+		fd = connectServer( r->host, r->port, addr, sizeof(addr) );
+
+		if( fd != -1 ){
+
+			setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes) );
+			setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+
+			printf( "server: replicating from %s\n", from );
+			__atomic_store_n( &r->state, REPL_LOADING, __ATOMIC_RELAXED );
+
+			replLoad( r, fd, from, 0 );
+
+			close( fd );
+			__atomic_store_n( &r->state, REPL_CONNECTING, __ATOMIC_RELAXED );
+			fprintf( stderr, "server: lost our primary %s; reconnecting\n",
+			 from );
+
+		}
+
+		sleep( REPLRETRY );
+
+	}
+
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    replInit
+* Purpose: Sets up a struct repl (as neither a primary nor a replica, yet)
+* Input:   r        - the struct repl
+*          st       - the store to replicate
+*          blobSize - values this big are loaded into blobs (0 = never)
+* Output:  none
+*******************************************************************************/
+void replInit( struct repl* r, struct store* st, size_t blobSize ){
+
+	memset( r, 0, sizeof(*r) );
+	pthread_mutex_init( &r->lock, NULL );
+	r->st = st;
+	r->blobSize = blobSize;
+	r->sockfd = -1;
+	r->lastReport = statsNow();
+
+}
+
+/*******************************************************************************
+* Name:    replHook
+* Purpose: Starts appending every STORE for replicas, in front of whatever
+*          onSet hook the store already has (e.g. the log's). Every stripe is
+*          write locked for the swap, so no STORE sees half of it.
+* Input:   r - the struct repl
+* Output:  none
+*******************************************************************************/
+void replHook( struct repl* r ){
+
+	if( r->hooked )
+		return;
+
+	for( int i = 0; i < STORESTRIPES; i++ )
+		pthread_rwlock_wrlock( &r->st->stripes[i].lock );
+
+	r->next = r->st->onSet;
+	r->nextArg = r->st->onSetArg;
+	r->st->onSetArg = r;
+	r->st->onSet = replAppend;
+	r->hooked = 1;
+
+	for( int i = 0; i < STORESTRIPES; i++ )
+		pthread_rwlock_unlock( &r->st->stripes[i].lock );
+
+}
+
+/*******************************************************************************
+* Name:    replServe
+* Purpose: Makes us a primary: starts appending every STORE for replicas, &
+*          accepting them
+* Input:   r      - the struct repl
+*          sockfd - the (non-blocking) socket listening for replicas
+* Output:  none (exit() program on fail)
+*******************************************************************************/
+void replServe( struct repl* r, int sockfd ){
+
+	// VARIABLE DEFINITIONS
+	pthread_t thread;
+	int status;
+
+	r->sockfd = sockfd;
+	replHook( r );
+
+	status = pthread_create( &thread, NULL, replAccept, r );
+	if( status != 0 ){
+		fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    replStop
+* Purpose: Stops taking replicas (those we have carry on), & closes our
+*          listener for them
+* Input:   r - the struct repl
+* Output:  none
+*******************************************************************************/
+void replStop( struct repl* r ){
+
+	if( r->sockfd != -1 )
+		__atomic_store_n( &r->closed, 1, __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    replHandoff
+* Purpose: Starts sending the store, & every STORE from then on, to the new
+*          server taking over from us, as if it were a replica
+* Input:   r  - the struct repl
+*          fd - our end of a (blocking) connection to the new server
+* Output:  the new server's struct replica (see replCaughtUp(); once its
+*          thread has been joined, it's freed with replFree()), or NULL on
+*          failure
+*******************************************************************************/
+struct replica* replHandoff( struct repl* r, int fd ){
+
+	// VARIABLE DEFINITIONS
+	struct replica* rp = replNew( r, fd, "(new server)" );
+	int status;
+
+	if( rp == NULL )
+		return NULL;
+
+	rp->handoff = 1;
+	replHook( r );
+
+	status = pthread_create( &r->handoff, NULL, replFeed, rp );
+	if( status != 0 ){
+		fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+		pthread_cond_destroy( &rp->more );
+		free( rp );
+		return NULL;
+	}
+
+	return rp;
+
+}
+
+/*******************************************************************************
+* Name:    replCaughtUp
+* Purpose: Tells whether a replica has loaded its snapshot (& everything
+*          since), nudging its thread to send an empty batch, & so take its
+*          acks, if not
+* Input:   rp  - the replica
+*          all - 1 for everything since too, 0 for just the snapshot
+* Output:  1 if it has, 0 if not (yet), -1 if it's gone
+*******************************************************************************/
+int replCaughtUp( struct replica* rp, int all ){
+
+	// VARIABLE DEFINITIONS
+	int status;
+	uint64_t acked;
+
+	pthread_mutex_lock( &rp->r->lock );
+
+	acked = __atomic_load_n( &rp->acked, __ATOMIC_RELAXED );
+	if( rp->dead )
+		status = -1;
+	else if( !__atomic_load_n( &rp->synced, __ATOMIC_ACQUIRE ) )
+		status = 0;
+	else if( all )
+		status = rp->len == 0 &&
+		 acked == __atomic_load_n( &rp->sent, __ATOMIC_RELAXED );
+	else
+		status = acked >= rp->snapEnd;
+	if( status == 0 )
+		pthread_cond_signal( &rp->more );
+
+	pthread_mutex_unlock( &rp->r->lock );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    replFree
+* Purpose: Drops the new server taking over from us (if it's still there),
+*          waits for its thread to finish & frees it
+* Input:   rp - its struct replica (from replHandoff())
+* Output:  none
+*******************************************************************************/
+void replFree( struct replica* rp ){
+
+	pthread_mutex_lock( &rp->r->lock );
+	if( !rp->dead )
+		replDrop( rp );
+	pthread_mutex_unlock( &rp->r->lock );
+
+	pthread_join( rp->r->handoff, NULL );
+	pthread_cond_destroy( &rp->more );
+	free( rp );
+
+}
+
+/*******************************************************************************
+* Name:    replStart
+* Purpose: Makes us a replica of a primary
+* Input:   r    - the struct repl
+*          host - the primary's hostname
+*          port - the port it takes replicas on
+* Output:  none (exit() program on fail)
+*******************************************************************************/
+void replStart( struct repl* r, char* host, char* port ){
+
+	// VARIABLE DEFINITIONS
+	pthread_t thread;
+	int status;
+
+	r->host = host;
+	r->port = port;
+
+	status = pthread_create( &thread, NULL, replFollow, r );
+	if( status != 0 ){
+		fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+		exit(1);
+	}
+
+}
+
+/*******************************************************************************
+* Name:    replPrint
+* Purpose: Reports on our replicas (as a primary) & our lag & throughput (as a
+*          replica). Rates are since the last report.
+* Input:   r - the struct repl
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void replPrint( struct repl* r ){
+
+	// VARIABLE DEFINITIONS
+	struct replica* rp;
+	uint64_t now = statsNow(), sent;
+	double secs = ( now - r->lastReport ) / 1e9;
+	size_t records, bytes;
+
+	if( r->sockfd != -1 ){
+
+		pthread_mutex_lock( &r->lock );
+
+		printf( "server: replication: %zu replicas served, %zu dropped for "
+		 "falling behind; %zu records (%.1f MB) sent, %.0f records/s (%.1f "
+		 "MB/s) since the last report\n", r->served, r->dropped, r->records,
+		 r->bytes / 1e6, ( r->records - r->lastRecords ) / secs,
+		 ( r->bytes - r->lastBytes ) / 1e6 / secs );
+		r->lastRecords = r->records;
+		r->lastBytes = r->bytes;
+
+		for( rp = r->replicas; rp != NULL; rp = rp->next ){
+			sent = __atomic_load_n( &rp->sent, __ATOMIC_RELAXED );
+			printf( "server: replica %s: %s, %.1f MB sent in %zu batches, %zu "
+			 "bytes waiting & %llu unacked\n", rp->addr,
+			 rp->dead ? "dropped" : __atomic_load_n( &rp->synced,
+			 __ATOMIC_RELAXED ) ? "streaming" : "sending the snapshot",
+			 sent / 1e6, __atomic_load_n( &rp->batches, __ATOMIC_RELAXED ),
+			 rp->len, (unsigned long long)( sent -
+			 __atomic_load_n( &rp->acked, __ATOMIC_RELAXED ) ) );
+		}
+
+		pthread_mutex_unlock( &r->lock );
+
+	}
+
+	if( r->host != NULL ){
+
+		records = __atomic_load_n( &r->applied, __ATOMIC_RELAXED );
+		bytes = __atomic_load_n( &r->appliedBytes, __ATOMIC_RELAXED );
+
+		printf( "server: replica of %s:%s: %s; %zu snapshots taken (the last: "
+		 "%llu keys in %.2f seconds)\n", r->host, r->port,
+		 replStates[ __atomic_load_n( &r->state, __ATOMIC_RELAXED ) ],
+		 __atomic_load_n( &r->syncs, __ATOMIC_RELAXED ),
+		 (unsigned long long)__atomic_load_n( &r->syncKeys, __ATOMIC_RELAXED ),
+		 __atomic_load_n( &r->syncNs, __ATOMIC_RELAXED ) / 1e9 );
+		printf( "server: replica: %zu records (%.1f MB) loaded, %.0f records/s "
+		 "(%.1f MB/s) since the last report\n", records, bytes / 1e6,
+		 ( records - r->lastApplied ) / secs,
+		 ( bytes - r->lastAppliedBytes ) / 1e6 / secs );
+		printf( "server: replica: lag now %.3f ms; over %zu batches, p50 %.3f ms, "
+		 "p99 %.3f ms, max %.3f ms\n",
+		 __atomic_load_n( &r->lagNow, __ATOMIC_RELAXED ) / 1e6,
+		 __atomic_load_n( &r->lag.count, __ATOMIC_RELAXED ),
+		 statsPercentile( &r->lag, 0.50 ) / 1e6,
+		 statsPercentile( &r->lag, 0.99 ) / 1e6,
+		 __atomic_load_n( &r->lag.maxNs, __ATOMIC_RELAXED ) / 1e6 );
+		r->lastApplied = records;
+		r->lastAppliedBytes = bytes;
+
+	}
+
+	r->lastReport = now;
+
+}
+
+#endif
@@ -1,14 +1,23 @@
 /*******************************************************************************
 * File:       server.c
-* Version:    0.7
-* Purpose:    Accepts connections & implements TRANSLATE, GET, STORE, & EXIT
+* Version:    0.26
+* Purpose:    Accepts connections & implements TRANSLATE, GET, GETV, STORE,
+*             CAS, MGET, MSTORE, SUBSCRIBE, SHM & EXIT
 * Author:     Michael Altfield <maltfield@knights.ucf.edu>
 * Course:     CNT4707
 * Assignment: 1
 * Created:    2011-10-01
-* Updated:    2011-10-05
+* Updated:    2026-10-18
 * Notes:      Much of this code's base was obtained/modified using:
               http://beej.us/guide/bgnet/
+
+              One event loop (epoll, or io_uring with -u) per worker thread,
+              each with its own listener, over one store that all of them
+              share; optionally kept on disk, replicated & upgraded in place.
+              See DESIGN for the protocol & how it all fits together.
+
+              This program was written to be compiled against the GNU99 standard
+              Please compile with `gcc --std=gnu99 -pthread`
 *******************************************************************************/
 
 /*******************************************************************************
@@ -17,19 +26,45 @@
 
 #define SERVER "localhost"
 #define PORT "3331"
-#define BACKLOG 10 // number of connections queue size
-#define MAXDATASIZE 100 // max number of bytes that can be recieved at once
+#define BACKLOG 4096 // listen() queue size (the kernel caps it at somaxconn)
+#define MAXEVENTS 64 // max number of epoll events handled per epoll_wait()
+#define MAXIOV 1024 // max number of responses handed to one writev() (IOV_MAX)
+#define STREAMSIZE (64*1024) // TRANSLATE data this big is streamed, not buffered
+#define BLOBSIZE (64*1024) // default for -z: STORE data this big goes in a blob
+#define IDLETIMEOUT 300 // default for -i: close connections idle this many secs
+#define READTIMEOUT 30  // default for -t: ...or stalled mid-command this long
+#define MAXCONNS 10000  // default for -c: turn away clients past this many
+#define MAXOUTPUT (4*1024*1024) // default for -o: unsent bytes before pausing
+#define SNAPSECS 300    // default for -s: seconds between snapshots (with -d)
+#define SWEEPTIME 1000  // default for -e: usecs per tick spent expiring keys
+#define MAXBATCH 1024   // most keys one MGET or MSTORE may name
+#define BATCHKEEP (1024*1024) // scratch space an MGET leaves its worker
+#define NOTIFYBATCH 256 // subscribers each worker sends to per trip round its loop
+#define DRAINSECS 10    // default for -g: secs our clients get after a SIGHUP
 #define OK "200 OK"
 #define NOT_OK "400 Command not valid."
+#define READONLY "403 Replica is read only."
+#define NOT_FOUND "404 Key not found."
+#define CONFLICT "409 Version mismatch."
+#define ERROR "500 Server error."
+#define BUSY "503 Server busy."
 #define BUFFER "We ain't in Joe-Ja no mo!"
 
-#define DEBUG 1 // 0 = turn debug messages off
+#define DEBUG 0 // 0 = turn debug messages off
                 // 1 = turn debug messages on
 
+#define URING 1 // 0 = build without the io_uring backend (for old kernels)
+                // 1 = build with it (run with -u to use it)
+#define URINGDEPTH 4096  // io_uring submission queue size, per worker (-u)
+#define RECVBUFS 1024    // number of provided recv() buffers, per worker (-u)
+#define RECVBUFSIZE 4096 // size of each provided recv() buffer (-u)
+
 /*******************************************************************************
                                    INCLUDES                                     
 *******************************************************************************/
 
+#define _GNU_SOURCE // for accept4() & pthread_setaffinity_np()
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -38,360 +73,3927 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
-#include <sys/wait.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "common.h"
+#include "store.h"
+#include "translate.h"
+#include "pool.h"
+#include "stats.h"
+#include "wheel.h"
+#include "persist.h"
+#include "pubsub.h"
+#include "repl.h"
+#include "upgrade.h"
+#include "shm.h"
+#if URING
+#include "uring.h"
+#endif
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
 
-#include <ctype.h>
+// states of each connection's command state machine
+#define STATE_CMD       0 // waiting for the client's next command
+#define STATE_TRANSLATE 1 // got TRANSLATE; waiting for the data to translate
+#define STATE_STORE     2 // got STORE (or CAS); waiting for the data to store
+#define STATE_CLOSING   3 // got EXIT; close once our output has been sent
+#define STATE_STREAM_TRANSLATE 4 // streaming the (big) data of a TRANSLATE
+#define STATE_STREAM_STORE     5 // streaming the (big) data of a STORE
+#define STATE_MSTORE    6 // got MSTORE; waiting for the data to store
+
+// a worker's scratch space for the keys of an MGET or MSTORE
+struct batch {
+	struct storekey keys[MAXBATCH];
+	size_t off[MAXBATCH]; // MGET: where each key's value is in buf (or -1)
+	char*  buf;           // MGET: the values found, in stripe order
+	size_t used, cap;     // ...the bytes of buf in use, & its size
+	int    tooBig;        // MGET: 1 if they won't fit in one response
+};
+
+// a constant response, framed once at startup
+struct frame {
+	char*  bytes; // the length prefix followed by the payload
+	size_t len;   // the length of bytes
+};
+
+// one response (or what's left of one) waiting to be sent
+struct outv {
+	char*  base;  // the bytes still to send
+	size_t len;   // the number of bytes still to send
+	char*  owned; // what to poolFree() once it's all sent (NULL for nothing)
+	struct blob* blob; // the blob that base points into (sent with sendfile())
+	struct message* msg; // the notification base points into (see pubsub.h)
+};
+
+// everything we need to know about one worker thread
+struct worker {
+	int           id;       // our index in main()'s array of workers
+	int           cpu;      // the CPU we're pinned to (-1 = not pinned)
+	pthread_t     thread;   // our thread
+	int           sockfd;   // our own SO_REUSEPORT listening socket
+	int           localfd;  // the Unix socket every worker listens on (-U;
+	                        // -1 = none)
+	int           epfd;     // our own epoll file descriptor
+	unsigned long accepted; // number of connections we've accepted, ever
+	unsigned long open;     // number of connections we're holding right now
+	unsigned long long bytesOut; // number of bytes we've sent, ever
+	struct pool   pool;     // our own buffers (for our connections only)
+	struct stats  stats;    // our own per-command stats
+	struct wheel  wheel;    // our connections' timeouts
+	unsigned long reapedIdle; // number of connections closed for being idle
+	unsigned long reapedRead; // ...or for stalling part way through a command
+	unsigned long rejected; // number of clients turned away (over -c)
+	unsigned long paused;   // number of times we've paused a client's reads
+	struct conn*  held;     // connections waiting on the log (-f always)
+	uint64_t      kicked;   // our last record the logger's been woken for
+	uint64_t      swept;    // the tick of our last sweep for expired keys
+	unsigned long expired;  // number of expired keys we've swept away
+	uint64_t      sweepNs;  // time spent sweeping, ever
+	uint64_t      sweepMax; // ...& the longest a sweep has taken
+	struct batch* batch;    // the keys of the MGET or MSTORE we're handling
+	struct topics subs;     // what our connections are subscribed to
+	struct conn*  notified; // connections with new notifications to send...
+	struct conn*  notifiedTail; // ...oldest first
+	unsigned long notifications; // number of notifications queued, ever
+	unsigned long slowSubs; // subscribers closed for falling -o bytes behind
+	struct conn*  conns;    // every connection we hold
+	uint64_t      drained;  // the tick of our last pass closing finished
+	                        // clients (while draining)
+#if URING
+	struct uring  ring;     // our own io_uring (with -u)
+#endif
+};
+
+// everything we need to know about one client connection
+struct conn {
+	int    fd;                      // the client's socket file descriptor
+	struct worker* w;               // the worker that owns this connection
+	int    state;                   // one of the STATE_* values above
+	char   addr[INET6_ADDRSTRLEN];  // the client's address (for logging)
+	char*  key;                     // the key of a STORE awaiting its data
+	uint32_t keyLen;                // length of key (it may hold any bytes)
+	                                // (or the keys of an MSTORE)
+	uint64_t expires;               // when that key expires (0 = never)
+	int    cas;                     // 1 if that STORE is a CAS...
+	uint64_t version;               // ...that needs the key to have this version
+	uint32_t streamLeft;            // bytes of a streamed frame still to come
+	struct blob* blob;              // the blob a streamed STORE is filling
+	struct ring in;                 // frames recieved but not yet handled
+	struct outv* outq;              // responses not yet accepted by writev()
+	struct arena arena;             // where the small responses in outq live
+	int    outHead;                 // index of the oldest response in outq
+	int    outCount;                // number of responses waiting in outq
+	int    outCap;                  // allocated size of outq
+	int    pending;                 // io_uring requests in flight (with -u)
+	int    sending;                 // ...how many of those are sendmsg()s
+	int    closing;                 // 1 once we've started closing (with -u)
+	struct msghdr* sendMsgs;        // what those sendmsg()s are sending
+	size_t queued;                  // bytes of responses queued, ever
+	uint64_t recvTime;              // when the latest recv() completed (or
+	                                // we accepted it)
+	int    cmd;                     // the STAT_* of the command being handled
+	uint64_t cmdStart;              // when its first frame was recieved
+	size_t cmdIn;                   // bytes recieved for it so far
+	size_t cmdOut;                  // queued when it started
+	struct timer timer;             // when to give up on the client
+	size_t outBytes;                // bytes in outq (not yet sent)
+	int    paused;                  // 1 while we've stopped reading (over -o)
+	int    recving;                 // 1 while a recv() is in flight (with -u)
+	uint64_t logWait;               // LSN our output waits on (-f always)
+	int    held;                    // 1 while on our worker's held list
+	struct conn* heldNext;          // the next connection on that list
+	struct sub* subs;               // what it's subscribed to (see pubsub.h)
+	int    notified;                // 1 while on our worker's notified list
+	struct conn* notifiedNext;      // the next connection on that list
+	int    missed;                  // 1 if a notification couldn't be queued
+	struct conn* prev;              // our worker's other connections
+	struct conn* next;
+	int    local;                   // 1 if it came in on our Unix socket
+	struct shm shm;                 // its rings, once it has sent SHM
+};
 
 /*******************************************************************************
                            GLOBAL VARIABLE DEFINITIONS                      
 *******************************************************************************/
 
-// na
+// our most common responses, framed once by main() & then only ever read
+struct frame okFrame, notOkFrame, notFoundFrame, errorFrame, readyFrame;
+struct frame busyFrame, conflictFrame, readOnlyFrame;
+
+// every key & value STOREd by any client, shared by all of our workers
+struct store kvstore;
+
+// STORE data of this many bytes or more is kept in a blob (0 = never)
+size_t blobSize = BLOBSIZE;
+
+// all of our workers (for STATS, which reports on every one of them)
+struct worker* workers;
+int numWorkers;
+
+// seconds a connection may sit idle, or stall mid-command (0 = forever)
+int idleTimeout = IDLETIMEOUT;
+int readTimeout = READTIMEOUT;
+
+// most connections open at once, & most unsent bytes per connection (0 = no
+// limit), & the number of connections open right now (over every worker)
+unsigned long maxConns = MAXCONNS;
+size_t maxOutput = MAXOUTPUT;
+unsigned long openConns;
+
+// nanoseconds each worker may spend sweeping for expired keys per tick
+uint64_t sweepTime = (uint64_t)SWEEPTIME * 1000;
+
+// where the store is kept on disk (NULL = it isn't), & its log
+char* dataDir = NULL;
+struct plog plog;
+
+// who's subscribed to what, & each worker's inbox of changes to tell them of
+struct pubsub pubsub;
+
+// the port we take clients on, & our replicas or primary (see repl.h)
+char* listenPort = PORT;
+struct repl repl;
+
+// the Unix socket every worker takes local clients on (-U; -1 = none)
+int localfd = -1;
+
+// once we've handed our listeners over to a new server, how we're closing
+// our clients (see drainConns()), or 0 if we haven't (atomic); & how long they
+// get to finish with us
+int draining;
+int drainSecs = DRAINSECS;
+
+// 1 while the server we're replacing is still handing over to us (atomic)
+int takingOver;
+
+// 1 if our workers run on io_uring (-u)
+int useUring = 0;
 
 /*******************************************************************************
                                    FUNCTIONS                                    
 *******************************************************************************/
 
-void sigchld_handler( int s ){
-    while(waitpid(-1, NULL, WNOHANG) > 0);
+/*******************************************************************************
+* Name:    setNonBlocking
+* Purpose: Puts the given file descriptor into non-blocking mode
+* Input:   fd - the file descriptor to change
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void setNonBlocking( int fd ){
+
+	// VARIABLE DEFINITIONS
+	int flags;
+
+	flags = fcntl( fd, F_GETFL, 0 );
+	if( flags == -1 || fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == -1 ){
+		perror( "fcntl" );
+		exit(1);
+	}
+
 }
 
 /*******************************************************************************
-* Name:    sendH
-* Purpose: Helper function to send string data to server
-* Input:   sockfd - socket file descriptor
-*          s      - string to send
-* Output:  none (perror() & exit() program on fail)
+* Name:    raiseFileLimit
+* Purpose: Raises our open file descriptor limit as high as we're allowed, so
+*          that we can hold many thousands of (mostly idle) connections open
+* Input:   none
+* Output:  none (failure is non-fatal; we just keep the default limit)
 *******************************************************************************/
-void sendH( int sockfd, char* s ){
+void raiseFileLimit(){
 
 	// VARIABLE DEFINITIONS
-	int status;
+	struct rlimit rl;
 
-	status = send( sockfd, s, strlen(s), 0 );
+	if( getrlimit( RLIMIT_NOFILE, &rl ) == -1 )
+		return;
 
-	// did the send() succeed?
-	if( status == -1){
-		// there was an error sending; error & exit.
-		perror("send");
-		exit(1);
+	rl.rlim_cur = rl.rlim_max;
+	if( setrlimit( RLIMIT_NOFILE, &rl ) == -1 )
+		perror( "setrlimit" );
+
+	if( DEBUG ){
+		printf( "DEBUG: file descriptor limit is %lu\n", (unsigned long)rl.rlim_cur );
 	}
 
 }
 
 /*******************************************************************************
-* Name:    recvH
-* Purpose: Helper function to recieve string data from server
-* Input:   sockfd - socket file descriptor
-*          buf    - buffer to store the string data recieved from the server
+* Name:    makeFrame
+* Purpose: Frames a constant string once, so that it can be queued over & over
+*          without being copied or framed again
+* Input:   f - the frame to fill in
+*          s - the string to frame
 * Output:  none (perror() & exit() program on fail)
 *******************************************************************************/
-void recvH( int sockfd, char* buf ){
+void makeFrame( struct frame* f, char* s ){
+
+	f->len = FRAMEHDRSIZE + strlen(s);
+	f->bytes = malloc( f->len );
+	if( f->bytes == NULL ){
+		perror( "malloc" );
+		exit(1);
+	}
+
+	frameHdr( f->bytes, strlen(s) );
+	memcpy( f->bytes + FRAMEHDRSIZE, s, strlen(s) );
+
+}
+
+/*******************************************************************************
+* Name:    outvDone
+* Purpose: Releases whatever a queued response was holding on to
+* Input:   c - the connection it was queued on
+*          o - the queued response
+* Output:  none
+*******************************************************************************/
+void outvDone( struct conn* c, struct outv* o ){
+
+	poolFree( &c->w->pool, o->owned );
+	if( o->blob != NULL )
+		blobUnref( o->blob );
+	if( o->msg != NULL )
+		msgUnref( o->msg );
+
+}
+
+/*******************************************************************************
+* Name:    midCommand
+* Purpose: Tells whether a connection is part way through sending a command
+*          (so that it's waiting on the rest of a frame, or on the data of a
+*          TRANSLATE or STORE)
+* Input:   c - the connection
+* Output:  1 if it is, 0 if not
+*******************************************************************************/
+int midCommand( struct conn* c ){
+	return ringUsed( &c->in ) > 0 ||
+	 ( c->state != STATE_CMD && c->state != STATE_CLOSING );
+}
+
+/*******************************************************************************
+* Name:    touchConn
+* Purpose: Restarts a connection's timeout after it has done something (sent
+*          us data or taken some of our output). A subscriber is only waiting
+*          on us, so it's never idle.
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void touchConn( struct conn* c ){
 
 	// VARIABLE DEFINITIONS
-	int numbytes;
+	int secs = midCommand( c ) ? readTimeout : c->subs != NULL ? 0 :
+	 idleTimeout;
 
-	numbytes = recv( sockfd, buf, MAXDATASIZE-1, 0);
+	if( secs == 0 )
+		timerCancel( &c->w->wheel, &c->timer );
+	else
+		timerArm( &c->w->wheel, &c->timer, secs * 1000 / WHEELTICK );
 
-	// did the recv() succeed?
-	if( numbytes == -1 ){
-		perror( "recv" );
-		exit(1);
+}
+
+/*******************************************************************************
+* Name:    outputFull
+* Purpose: Tells whether so many of a connection's responses are unsent that
+*          we should stop reading from it (& pauses it if so)
+* Input:   c - the connection
+* Output:  1 if it's paused, 0 if not
+*******************************************************************************/
+int outputFull( struct conn* c ){
+
+	if( !c->paused && maxOutput > 0 && c->outBytes >= maxOutput ){
+		c->paused = 1;
+		__atomic_fetch_add( &c->w->paused, 1, __ATOMIC_RELAXED );
 	}
 
-	buf[numbytes] = '\0';
+	return c->paused;
 
 }
 
 /*******************************************************************************
-* Name:    strToUpper
-* Purpose: Converts a given string to all uppercase
-* Input:   s - our string to convert
-* Output:  none (s is a pointer, so it is edited directly)
+* Name:    outputDrained
+* Purpose: Tells whether a paused connection has sent enough of its responses
+*          that we can read from it again (& unpauses it if so)
+* Input:   c - the connection
+* Output:  1 if it was paused & now isn't, 0 if not
 *******************************************************************************/
-void strToUpper( char* s ){
-	for( int i = 0; i<strlen(s); i++ )
-		s[i] = toupper( s[i] );
+int outputDrained( struct conn* c ){
+
+	if( !c->paused || c->outBytes > maxOutput / 2 )
+		return 0;
+
+	c->paused = 0;
+	return 1;
+
 }
 
 /*******************************************************************************
-                                   MAIN BODY                                    
+* Name:    outqAdvance
+* Purpose: Drops the queued responses (or the parts of them) that were sent
+* Input:   c        - the connection
+*          numbytes - the number of bytes that were sent from the queue's head
+* Output:  none
 *******************************************************************************/
+void outqAdvance( struct conn* c, size_t numbytes ){
 
-int main(){
+	// VARIABLE DEFINITIONS
+	struct outv* o;
 
-	/***********************
-	* VARIABLE DEFINITIONS *
-	***********************/
+	c->outBytes -= numbytes;
 
-	int yes = 1;
-	int status; // generic varaible for all function results
-	struct addrinfo hints, *servinfo, *p;
-	struct sockaddr_storage their_addr; // connector's address info
-	socklen_t sin_size;
-	struct sigaction sa;
-	int sockfd, new_fd;
-	char clientAddr[INET6_ADDRSTRLEN];
-	char store_buffer[] = BUFFER;
+	// drop every response that was sent completely...
+	while( c->outCount > 0 && numbytes >= c->outq[ c->outHead ].len ){
 
-	memset( &hints, 0, sizeof(hints) ); // make struct empty
-	hints.ai_family = AF_INET;          // IPv4 only
-	hints.ai_socktype = SOCK_STREAM;    // TCP
-	hints.ai_flags = AI_PASSIVE;        // use my ip
+		o = &c->outq[ c->outHead ];
+		numbytes -= o->len;
+		outvDone( c, o );
 
-	int numbytes; // number of bytes returned by send() or recv()
-	int sentinel; // used to exit loops
-	char buf[MAXDATASIZE];
+		c->outHead++;
+		c->outCount--;
 
-	/****************
-	* getaddrinfo() *
-	****************/
+	}
 
-	status = getaddrinfo(NULL, PORT, &hints, &servinfo);
+	// ...& skip past the part of the next one that was sent
+	if( numbytes > 0 ){
+		c->outq[ c->outHead ].base += numbytes;
+		c->outq[ c->outHead ].len -= numbytes;
+	}
 
-	// were there errors?
-	if( status != 0 ){
-		// there were errors; alert & exit.
-		fprintf( stderr, "getaddrinfo error: %s\n", gai_strerror(status) );
-		exit(1);
+	// once the queue is empty, start back at the front of it, & free every
+	// response that was built in the arena in one go
+	if( c->outCount == 0 ){
+		c->outHead = 0;
+		arenaReset( &c->arena, &c->w->pool );
 	}
 
-	// loop through getaddrinfo()'s results = servinfo
-	for( p = servinfo; p != NULL; p = p->ai_next ){
-		// try to establish a connection with this iteration's addrinfo
+	touchConn( c );
 
-		/***********
-		* socket() *
-		***********/
+}
 
-		sockfd = socket(
-		 servinfo-> ai_family, servinfo->ai_socktype, servinfo->ai_protocol
-		);
+/*******************************************************************************
+* Name:    logged
+* Purpose: Holds back a connection's responses, from the one to the STORE it
+*          just did on, until that STORE is on disk (with -f always)
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void logged( struct conn* c ){
 
-		// could we establish a socket?
-		if( sockfd == -1 ){
-			// socket creation failed
+	if( dataDir != NULL && plog.policy == LOG_ALWAYS )
+		c->logWait = logLast;
 
-			perror( "server: socket" );
+}
 
-			// try the next iteration's addrinfo
-			continue;
+/*******************************************************************************
+* Name:    holdConn
+* Purpose: Tells whether a connection's responses must wait for the log (&
+*          puts it on its worker's held list if so)
+* Input:   c - the connection
+* Output:  1 if they must wait, 0 if they may be sent
+*******************************************************************************/
+int holdConn( struct conn* c ){
 
-		}
+	if( c->logWait <= __atomic_load_n( &plog.done, __ATOMIC_ACQUIRE ) )
+		return 0;
 
-		// fix "Address Already in Use" Error
-		if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1){
-			perror("setsockopt");
-			exit(1);
+	if( !c->held ){
+		c->held = 1;
+		c->heldNext = c->w->held;
+		c->w->held = c;
+	}
+
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    shmFlush
+* Purpose: flushConn() for a client on shared memory: copies as much of its
+*          queued responses as there's room for into its ring (blobs straight
+*          from their mapping), & wakes it if it's waiting on us
+* Input:   c - the connection to flush
+* Output:  0 on success (even if some output is still pending), -1 if the
+*          client has broken its ring & should be closed
+*******************************************************************************/
+int shmFlush( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct outv* o;
+	ssize_t numbytes;
+	size_t total = 0;
+
+	while( c->outCount > 0 ){
+
+		o = &c->outq[ c->outHead ];
+		numbytes = shmWrite( &c->shm, o->base, o->len );
+		if( numbytes == -1 ){
+			fprintf( stderr, "server: %s broke its ring\n", c->addr );
+			return -1;
 		}
 
-		// If we made it this far, the socket has been successfully established.
-		// Now try to bind on the established socket.
+		// is the ring full? (only a write of nothing says we're waiting, so
+		// keep on until one is) the client wakes us once it has read some
+		if( numbytes == 0 )
+			break;
 
-		/*********
-		* bind() *
-		*********/
+		total += numbytes;
+		outqAdvance( c, numbytes );
 
-		status = bind( sockfd, p->ai_addr, p->ai_addrlen );
+	}
 
-		// could we bind() on the new socket?
-		if( status == -1 ){
-			// we could not bind() on the new socket, so close it & error.
+	if( total > 0 )
+		__atomic_fetch_add( &c->w->bytesOut, total, __ATOMIC_RELAXED );
 
-			close(sockfd);
-			perror( "server: bind" );
+	// (for the responses we've written, or the room we've made by reading)
+	shmWake( &c->shm );
 
-			// now try the next iteration's addrinfo
-			continue;
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    flushConn
+* Purpose: Sends as much of a connection's queued responses as the socket will
+*          take without blocking. Runs of in-memory responses are handed to
+*          one sendmsg() (a writev() with flags) at a time; blobs are sent
+*          straight from their memfd with sendfile().
+* Input:   c - the connection to flush
+* Output:  0 on success (even if some output is still pending), -1 if the
+*          connection failed and should be closed
+*******************************************************************************/
+int flushConn( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct iovec iov[MAXIOV];
+	struct msghdr msg;
+	ssize_t numbytes;
+	int iovcnt;
+	struct outv* o;
+	off_t off;
+
+	if( c->outCount > 0 && holdConn( c ) )
+		return 0;
+
+	if( c->shm.area != NULL )
+		return shmFlush( c );
+
+	while( c->outCount > 0 ){
+
+		o = &c->outq[ c->outHead ];
+
+		if( o->blob != NULL ){
+
+			// the kernel copies the value from the memfd's pages to the socket
+			off = o->base - o->blob->map;
+			numbytes = sendfile( c->fd, o->blob->fd, &off, o->len );
+
+		} else {
+
+			// gather (up to MAXIOV of) the in-memory responses into one call
+			iovcnt = 0;
+			while( iovcnt < c->outCount && iovcnt < MAXIOV &&
+			 c->outq[ c->outHead + iovcnt ].blob == NULL ){
+				iov[iovcnt].iov_base = c->outq[ c->outHead + iovcnt ].base;
+				iov[iovcnt].iov_len = c->outq[ c->outHead + iovcnt ].len;
+				iovcnt++;
+			}
+
+			memset( &msg, 0, sizeof(msg) );
+			msg.msg_iov = iov;
+			msg.msg_iovlen = iovcnt;
+
+			// if a blob comes next (e.g. a big GET's "200 OK"), ask TCP to hold
+			// these bytes for the blob rather than push out a little packet
+			numbytes = sendmsg( c->fd, &msg,
+			 iovcnt < c->outCount ? MSG_NOSIGNAL | MSG_MORE : MSG_NOSIGNAL );
 
 		}
 
-		// If we made it this far, the bind on the socket is working.
+		if( numbytes == -1 ){
 
-		// break free from this for loop; we don't need to try any other addrinfos
-		break;
+			if( errno == EINTR )
+				continue;
 
-	} // end for each getaddrinfo() result
+			// is the socket's send buffer full?
+			if( errno == EAGAIN || errno == EWOULDBLOCK )
+				// it is; EPOLLOUT will tell us when to try again
+				break;
 
-	// is p pointing to NULL?
-	if( p == NULL ){
-		// p is pointing to null, which means we iterated through all of the
-		// getaddrinfo() results (trying to bind() at each iteration), and made
-		// it to the end of the results, still without a working bind().
+			perror( o->blob != NULL ? "sendfile" : "sendmsg" );
+			return -1;
+		}
+
+		__atomic_fetch_add( &c->w->bytesOut, numbytes, __ATOMIC_RELAXED );
+		outqAdvance( c, numbytes );
 
-		fprintf( stderr, "server: failed to bind\n" );
-		return 2;
 	}
 
-	/***********
-	* listen() *
-	***********/
+	return 0;
 
-	status = listen( sockfd, BACKLOG );
+}
 
-	// could we listen() on the connect()ion?
-	if( status == -1 ){
-		// we could not listen(); error & exit.
+/*******************************************************************************
+* Name:    queueOutv
+* Purpose: Adds a buffer to the end of a connection's queued responses
+* Input:   c     - the connection to respond on
+*          base  - the bytes to send
+*          len   - the number of bytes to send
+*          owned - what to poolFree() once the bytes are sent (NULL for nothing)
+* Output:  0 on success, -1 if we ran out of memory (owned is freed)
+*******************************************************************************/
+int queueOutv( struct conn* c, char* base, size_t len, char* owned ){
 
-		perror( "listen" );
-		exit(1);
+	// have we run off the end of our queue?
+	if( c->outHead + c->outCount == c->outCap ){
 
-	}
+		// is there room at the front of the queue that we can reuse?
+		if( c->outHead > 0 ){
 
-	// REAP ALL DEAD PROCESSES
-	sa.sa_handler = sigchld_handler;
-	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = SA_RESTART;
-	if (sigaction(SIGCHLD, &sa, NULL) == -1) {
-		perror("sigaction");
-		exit(1);
-	}
+			memmove( c->outq, c->outq + c->outHead,
+			 c->outCount * sizeof(struct outv) );
+			c->outHead = 0;
 
-	printf( "server: waiting for connections...\n" );
+		} else {
 
-	while(1) {  // main accept() loop
+			// VARIABLE DEFINITIONS
+			int newCap = c->outCap ? c->outCap * 2 : 8;
+			struct outv* newQ;
 
-		sin_size = sizeof( their_addr );
-		new_fd = accept( sockfd, (struct sockaddr *)&their_addr, &sin_size );
+			newQ = realloc( c->outq, newCap * sizeof(struct outv) );
+			if( newQ == NULL ){
+				perror( "realloc" );
+				poolFree( &c->w->pool, owned );
+				return -1;
+			}
+
+			c->outq = newQ;
+			c->outCap = newCap;
 
-		if( new_fd == -1 ){
-			perror("accept");
-			continue;
 		}
 
-		inet_ntop(
-		 their_addr.ss_family, &( ( (struct sockaddr_in*)&their_addr)->sin_addr ),
-		 clientAddr, sizeof(clientAddr)
-		);
+	}
 
-		printf( "server: got connection from %s\n", clientAddr );
+	c->outq[ c->outHead + c->outCount ].base = base;
+	c->outq[ c->outHead + c->outCount ].len = len;
+	c->outq[ c->outHead + c->outCount ].owned = owned;
+	c->outq[ c->outHead + c->outCount ].blob = NULL;
+	c->outq[ c->outHead + c->outCount ].msg = NULL;
+	c->outCount++;
+	c->queued += len;
+	c->outBytes += len;
 
-		if( !fork() ){ // this is the child process
+	return 0;
 
-			// child doesn't need the listener
-			close(sockfd);
+}
 
-			// tell the client that we're ready and waiting for their command
-			sendH( new_fd, "Server is ready..." );
+/*******************************************************************************
+* Name:    queueBlob
+* Purpose: Queues a whole blob, to be sent with sendfile() (no copying)
+* Input:   c - the connection to respond on
+*          b - the blob to send (the queue takes over the caller's reference)
+* Output:  0 on success, -1 if we ran out of memory (the reference is dropped)
+*******************************************************************************/
+int queueBlob( struct conn* c, struct blob* b ){
 
-			// loop until client commands us to EXIT
-			sentinel = 0;
-			do{ 
+	// (base tracks how far we've got, for sendfile()'s offset)
+	if( queueOutv( c, b->map, b->len, NULL ) == -1 ){
+		blobUnref( b );
+		return -1;
+	}
 
-				// DEFINE VARIABLES
-				char *resp[100]; // string to build our response to the client
+	c->outq[ c->outHead + c->outCount - 1 ].blob = b;
+	return 0;
 
-				// if we don't print a newline here, the server will hang on the
-				// following line. TODO: find out why!
-				printf( "\n" );
+}
 
-				// recieve client's command on new_fd into buf
-				// note: this line is blocking
-				recvH( new_fd, buf );
+/*******************************************************************************
+* Name:    queueMsg
+* Purpose: Queues a notification, sharing its frame with every other queue it
+*          is on (no copying)
+* Input:   c - the connection to send it on
+*          m - the notification (the queue takes a reference of its own)
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int queueMsg( struct conn* c, struct message* m ){
 
-				// if DEBUG enabled, print client's incoming command
-				if( DEBUG ){
-					printf( "DEBUG: incoming cmd '%s' from %s.\n", buf, clientAddr );
-				}
+	if( queueOutv( c, m->bytes, m->len, NULL ) == -1 )
+		return -1;
 
-				/************
-				* TRANSLATE *
-				************/
+	msgRef( m );
+	c->outq[ c->outHead + c->outCount - 1 ].msg = m;
+	return 0;
 
-				status = strcmp( buf, "TRANSLATE" );
-				if( status == 0 ){
+}
 
-					// first, tell our client that the command is valid
-					sendH( new_fd, OK );
+/*******************************************************************************
+* Name:    queueStatic
+* Purpose: Queues one of our pre-framed constant responses (no copying)
+* Input:   c - the connection to respond on
+*          f - the frame to send
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int queueStatic( struct conn* c, struct frame* f ){
+	return queueOutv( c, f->bytes, f->len, NULL );
+}
 
-					recvH( new_fd, buf ); // get the data from the client
-					strToUpper( buf );    // TRANSLATE the data
+/*******************************************************************************
+* Name:    queueRaw
+* Purpose: Queues new, unframed output that the caller will fill in (e.g. a
+*          piece of a frame that's being streamed). Small output is built in
+*          the connection's arena, which is freed all at once when the queue
+*          empties; anything bigger gets a buffer of its own from the pool,
+*          so that it's freed as soon as it's sent.
+* Input:   c   - the connection to respond on
+*          len - the number of bytes to queue
+* Output:  a pointer to the new bytes, or NULL if we ran out of memory
+*******************************************************************************/
+char* queueRaw( struct conn* c, size_t len ){
 
-					// send the client back the TRANSLATE'd data
-					sendH( new_fd, buf );
+	// VARIABLE DEFINITIONS
+	char* b;
+	char* owned = NULL;
 
-					continue;
-				}
+	if( len <= ARENAMAX )
+		b = arenaAlloc( &c->arena, &c->w->pool, len );
+	else
+		b = owned = poolAlloc( &c->w->pool, len );
 
-				/******
-				* GET *
-				******/
+	if( b == NULL ){
+		perror( "poolAlloc" );
+		return NULL;
+	}
 
-				status = strcmp( buf, "GET" );
-				if( status == 0 ){
+	if( queueOutv( c, b, len, owned ) == -1 )
+		return NULL;
 
-					// BUILD OUR RESPONSE STRING
-					// first, tell our client that the command is valid
-					strcpy( (char *)resp, OK );
-					strcat( (char *)resp, "\n" );
-					// for GET, the next line of our response should be the store
-					strcat( (char *)resp, store_buffer );
-					sendH( new_fd, (char *)resp );
+	return b;
 
-					continue;
-				}
+}
 
-				/********
-				* STORE *
-				********/
+/*******************************************************************************
+* Name:    queueAlloc
+* Purpose: Queues a new frame whose payload the caller will fill in
+* Input:   c   - the connection to respond on
+*          len - the length of the frame's payload
+* Output:  a pointer to the frame's payload, or NULL if we ran out of memory
+*******************************************************************************/
+char* queueAlloc( struct conn* c, uint32_t len ){
 
-				status = strcmp( buf, "STORE" );
-				if( status == 0 ){
+	// VARIABLE DEFINITIONS
+	char* f = queueRaw( c, FRAMEHDRSIZE + len );
 
-					// first, tell our client that the command is valid
-					sendH( new_fd, OK );
+	if( f == NULL )
+		return NULL;
 
-					recvH( new_fd, buf ); // get the data from the client
+	frameHdr( f, len );
+	return f + FRAMEHDRSIZE;
 
-					strcpy( (char *)store_buffer, buf );
+}
 
-					// first, tell our client that the command is valid
-					sendH( new_fd, OK );
+/*******************************************************************************
+* Name:    isCmd
+* Purpose: Compares a frame's payload to a command name
+* Input:   buf - the frame's payload
+*          len - the length of the frame's payload
+*          cmd - the command name to compare against
+* Output:  1 if the payload is exactly the command name, 0 otherwise
+*******************************************************************************/
+int isCmd( char* buf, uint32_t len, char* cmd ){
+	return len == strlen(cmd) && memcmp( buf, cmd, len ) == 0;
+}
 
-					continue;
-				}
+/*******************************************************************************
+* Name:    isKeyCmd
+* Purpose: Compares a frame's payload to a command name that takes a key, as
+*          in "GET" or "GET somekey". With no key, the key is "" (which holds
+*          the original single STORE buffer).
+* Input:   buf    - the frame's payload
+*          len    - the length of the frame's payload
+*          cmd    - the command name to compare against
+*          key    - set to point at the key (inside buf)
+*          keyLen - set to the length of the key
+* Output:  1 if the payload is the command name (& maybe a key), 0 otherwise
+*******************************************************************************/
+int isKeyCmd( char* buf, uint32_t len, char* cmd, char** key, uint32_t* keyLen ){
+
+	// VARIABLE DEFINITIONS
+	uint32_t cmdLen = strlen(cmd);
 
-				/*******
-				* EXIT *
-				*******/
+	if( len < cmdLen || memcmp( buf, cmd, cmdLen ) != 0 )
+		return 0;
 
-				status = strcmp( buf, "EXIT" );
-				if( status == 0 ){
+	// is it just the command?
+	if( len == cmdLen ){
+		*key = buf;
+		*keyLen = 0;
+		return 1;
+	}
 
-					// tell our client that the command is valid
-					sendH( new_fd, OK );
+	// is the command followed by a key? (if not, it's some other command)
+	if( buf[cmdLen] != ' ' )
+		return 0;
 
-					// print this action for logging
-					printf( "%s sends EXIT", clientAddr );
+	*key = buf + cmdLen + 1;
+	*keyLen = len - cmdLen - 1;
+	return 1;
 
-					// exit the loop
-					sentinel = 1;
-					continue;
+}
 
-				}
+/*******************************************************************************
+* Name:    parseExpiry
+* Purpose: Takes the seconds off the front of a STOREX's key, as in "60" or
+*          "60 somekey"
+* Input:   key    - the key (moved past the seconds)
+*          keyLen - the length of the key (shortened to match)
+* Output:  when the key expires (see storeNow()), or 0 if there's no sensible
+*          number of seconds
+*******************************************************************************/
+uint64_t parseExpiry( char** key, uint32_t* keyLen ){
 
-				// if we made it this far, the command is not recognized.
-				sendH( new_fd, NOT_OK );
+	// VARIABLE DEFINITIONS
+	uint64_t secs = 0;
+	uint32_t i;
 
-			} while( sentinel == 0 );
+	// (at most 9 digits, about 31 years)
+	for( i = 0; i < *keyLen && i < 10 && (*key)[i] >= '0' && (*key)[i] <= '9';
+	 i++ )
+		secs = secs * 10 + (*key)[i] - '0';
 
-			close(new_fd);
-			exit(0);
+	if( i == 0 || i == 10 || secs == 0 )
+		return 0;
 
-		}
+	// the seconds are either the whole thing or followed by the key
+	if( i < *keyLen && (*key)[i] != ' ' )
+		return 0;
+	if( i < *keyLen )
+		i++;
+
+	*key += i;
+	*keyLen -= i;
+
+	return storeNow() + secs * 1000;
+
+}
 
-		close(new_fd);  // parent doesn't need this
+/*******************************************************************************
+* Name:    parseVersion
+* Purpose: Takes the version off the front of a CAS's key, as in "1234" or
+*          "1234 somekey"
+* Input:   key     - the key (moved past the version)
+*          keyLen  - the length of the key (shortened to match)
+*          version - set to the version
+* Output:  0 on success, -1 if there's no sensible version
+*******************************************************************************/
+int parseVersion( char** key, uint32_t* keyLen, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t v = 0;
+	uint32_t i;
 
+	for( i = 0; i < *keyLen && (*key)[i] >= '0' && (*key)[i] <= '9'; i++ ){
+		if( v > ( UINT64_MAX - ( (*key)[i] - '0' ) ) / 10 )
+			return -1;
+		v = v * 10 + (*key)[i] - '0';
 	}
 
-	/***********
-	* CLEANUP! *
-	***********/
+	// the version is either the whole thing or followed by the key
+	if( i == 0 || ( i < *keyLen && (*key)[i] != ' ' ) )
+		return -1;
+	if( i < *keyLen )
+		i++;
 
-	freeaddrinfo(servinfo);
+	*key += i;
+	*keyLen -= i;
+	*version = v;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    copyGet
+* Purpose: Builds the response to a GET (or GETV) while storeGet() has the
+*          value locked
+* Input:   arg     - the connection to respond on
+*          val     - the value that was found (NULL if it's in a blob)
+*          valLen  - the length of the value
+*          blob    - the blob holding the value (if it's big)
+*          version - the value's version
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int copyGet( void* arg, char* val, size_t valLen, struct blob* blob,
+ uint64_t version ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c = arg;
+	char* resp; // the response frame we're building for the client
+	char okLine[64] = OK "\n"; // ...& its first line
+	size_t okLen = strlen( OK "\n" );
+
+	// GETV's OK carries the version
+	if( c->cmd == STAT_GETV )
+		okLen = snprintf( okLine, sizeof(okLine), OK " %llu\n",
+		 (unsigned long long)version );
+
+	// is the value in a blob?
+	if( blob != NULL ){
+
+		// then only the frame's length & "200 OK\n" are built here...
+		resp = queueRaw( c, FRAMEHDRSIZE + okLen );
+		if( resp == NULL )
+			return -1;
+		frameHdr( resp, okLen + valLen );
+		memcpy( resp + FRAMEHDRSIZE, okLine, okLen );
+
+		// ...& the value itself goes out with sendfile(), never copied by us
+		blobRef( blob );
+		return queueBlob( c, blob );
+
+	}
+
+	// BUILD OUR RESPONSE FRAME
+	resp = queueAlloc( c, okLen + valLen );
+	if( resp == NULL )
+		return -1;
+
+	// first, tell our client that the command is valid
+	memcpy( resp, okLine, okLen );
+	// for GET, the next line of our response should be the stored value
+	memcpy( resp + okLen, val, valLen );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    stored
+* Purpose: Answers a STORE (or CAS) once its data has been handed to the store
+*          (before the connection lets go of its key)
+* Input:   c      - the connection
+*          status - what the store said: 0 for stored, -1 for failed, -2
+*                   for a CAS whose key had some other version, or -3 if we're
+*                   a replica (& didn't ask it)
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int stored( struct conn* c, int status ){
+
+	// VARIABLE DEFINITIONS
+	char line[64];
+	size_t lineLen;
+	char* resp;
+
+	if( status == -1 )
+		return queueStatic( c, &errorFrame );
+	if( status == -2 )
+		return queueStatic( c, &conflictFrame );
+	if( status == -3 )
+		return queueStatic( c, &readOnlyFrame );
+
+	// tell our client that the data has been stored (once it has), & anyone
+	// subscribed to the key that it has changed
+	logged( c );
+	pubsubPublish( &pubsub, c->key, c->keyLen );
+	if( !c->cas )
+		return queueStatic( c, &okFrame );
+
+	// ...& a CAS what its version is now
+	lineLen = snprintf( line, sizeof(line), OK " %llu",
+	 (unsigned long long)c->version );
+	resp = queueAlloc( c, lineLen );
+	if( resp == NULL )
+		return -1;
+	memcpy( resp, line, lineLen );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    splitKeys
+* Purpose: Splits the keys of an MGET or MSTORE into its worker's batch
+* Input:   b      - the batch
+*          list   - the keys, separated by single spaces
+*          len    - the length of list
+* Output:  the number of keys, or -1 if there are none, too many, or an empty
+*          one
+*******************************************************************************/
+int splitKeys( struct batch* b, char* list, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	char* end = list + len;
+	char* space;
+	int n = 0;
+
+	if( len == 0 )
+		return -1;
+
+	while( 1 ){
+
+		if( n == MAXBATCH )
+			return -1;
+
+		space = memchr( list, ' ', end - list );
+		b->keys[n].key = list;
+		b->keys[n].keyLen = ( space != NULL ? space : end ) - list;
+		if( b->keys[n].keyLen == 0 )
+			return -1;
+		n++;
+
+		if( space == NULL )
+			return n;
+		list = space + 1;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    copyMget
+* Purpose: Copies one value that an MGET found, while storeGetMany() has it
+*          locked, into its worker's batch
+* Input:   arg    - the batch
+*          i      - the index of the key
+*          val    - the value
+*          valLen - the length of the value
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int copyMget( void* arg, int i, char* val, size_t valLen ){
+
+	// VARIABLE DEFINITIONS
+	struct batch* b = arg;
+	size_t newCap;
+	char* newBuf;
+
+	// would the response be too big to send? (it'll be an error anyway)
+	if( b->used + valLen > MAXFRAMESIZE ){
+		b->tooBig = 1;
+		return 0;
+	}
+
+	if( b->used + valLen > b->cap ){
+		for( newCap = b->cap ? b->cap : 4096; newCap < b->used + valLen; )
+			newCap *= 2;
+		newBuf = realloc( b->buf, newCap );
+		if( newBuf == NULL ){
+			perror( "realloc" );
+			return -1;
+		}
+		b->buf = newBuf;
+		b->cap = newCap;
+	}
+
+	memcpy( b->buf + b->used, val, valLen );
+	b->off[i] = b->used;
+	b->keys[i].valLen = valLen;
+	b->used += valLen;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    mget
+* Purpose: Looks up an MGET's keys & queues its response
+* Input:   c    - the connection to respond on
+*          list - the keys
+*          len  - the length of list
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int mget( struct conn* c, char* list, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	struct batch* b = c->w->batch;
+	int n = splitKeys( b, list, len );
+	size_t respLen;
+	char* resp;
+	int status;
+
+	if( n == -1 )
+		return queueStatic( c, &notOkFrame );
+
+	for( int i = 0; i < n; i++ )
+		b->off[i] = (size_t)-1;
+	b->used = 0;
+	b->tooBig = 0;
+
+	status = storeGetMany( &kvstore, b->keys, n, copyMget, b );
+
+	respLen = strlen( OK "\n" ) + (size_t)n * FRAMEHDRSIZE + b->used;
+	if( status == -1 || b->tooBig || respLen > MAXFRAMESIZE )
+		status = queueStatic( c, &errorFrame );
+	else if( (resp = queueAlloc( c, respLen )) == NULL )
+		status = -1;
+	else {
+
+		// OK, then each value (or MISSING) in the order the keys were asked for
+		memcpy( resp, OK "\n", strlen( OK "\n" ) );
+		resp += strlen( OK "\n" );
+
+		for( int i = 0; i < n; i++ ){
+			if( b->off[i] == (size_t)-1 ){
+				frameHdr( resp, MISSING );
+				resp += FRAMEHDRSIZE;
+			} else {
+				frameHdr( resp, b->keys[i].valLen );
+				memcpy( resp + FRAMEHDRSIZE, b->buf + b->off[i], b->keys[i].valLen );
+				resp += FRAMEHDRSIZE + b->keys[i].valLen;
+			}
+		}
+
+		status = 0;
+
+	}
+
+	// don't hang on to the space a huge MGET needed
+	if( b->cap > BATCHKEEP ){
+		free( b->buf );
+		b->buf = NULL;
+		b->cap = 0;
+	}
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    mstore
+* Purpose: Stores the values of an MSTORE, once its data arrives
+* Input:   c    - the connection (c->key holds the keys)
+*          data - the data: a length & a value for each key
+*          len  - the length of the data
+* Output:  0 on success, -1 if we ran out of memory, or -2 if the data didn't
+*          hold exactly one value for each key
+*******************************************************************************/
+int mstore( struct conn* c, char* data, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	struct batch* b = c->w->batch;
+	int n = splitKeys( b, c->key, c->keyLen );
+	char* end = data + len;
+	int status;
+
+	for( int i = 0; i < n; i++ ){
+
+		if( end - data < FRAMEHDRSIZE )
+			return -2;
+		b->keys[i].valLen = frameLen( data );
+		data += FRAMEHDRSIZE;
+
+		if( (size_t)( end - data ) < b->keys[i].valLen )
+			return -2;
+		b->keys[i].val = data;
+		data += b->keys[i].valLen;
+
+	}
+
+	if( data != end )
+		return -2;
+
+	status = storeSetMany( &kvstore, b->keys, n, c->expires );
+
+	// (keys that couldn't be stored are announced too: a needless notification
+	// costs a subscriber a GET, a missing one leaves it stale)
+	for( int i = 0; i < n; i++ )
+		pubsubPublish( &pubsub, b->keys[i].key, b->keys[i].keyLen );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    formatStats
+* Purpose: Merges every worker's per-command stats into one table
+* Input:   buf  - where to write the table
+*          size - the size of buf
+* Output:  the length of the table
+*******************************************************************************/
+size_t formatStats( char* buf, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct stats* total;
+	size_t len;
+
+	// (too big for a worker's stack to hold comfortably)
+	total = calloc( 1, sizeof(struct stats) );
+	if( total == NULL )
+		return snprintf( buf, size, "out of memory\n" );
+
+	for( int i = 0; i < numWorkers; i++ )
+		statsMerge( total, &workers[i].stats );
+
+	len = statsFormat( total, buf, size );
+	free( total );
+
+	return len;
+
+}
+
+/*******************************************************************************
+* Name:    shmServe
+* Purpose: Moves a client on our Unix socket onto shared memory (for SHM):
+*          makes its rings & sends them to it with our OK, & swaps its socket
+*          in our epoll set for its eventfd (see shm.h)
+* Input:   c - the connection
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int shmServe( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct epoll_event ev;
+	int fds[3];
+	int status;
+
+	// (if we can't make them, it can carry on over the socket)
+	if( shmCreate( &c->shm, fds ) == -1 )
+		return queueStatic( c, &errorFrame );
+
+	// nothing of ours is waiting to be sent, so the OK goes straight out
+	// (we're done with the memfd once it has, since it's mapped)
+	status = shmSend( c->fd, okFrame.bytes, okFrame.len, fds );
+	close( fds[0] );
+	if( status == -1 )
+		return -1;
+
+	// (it never went through the queue, so count it here)
+	c->queued += okFrame.len;
+	__atomic_fetch_add( &c->w->bytesOut, okFrame.len, __ATOMIC_RELAXED );
+
+	// (being edge-triggered, we're told of every write to the eventfd, so we
+	// never need to read it)
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = c;
+	if( epoll_ctl( c->w->epfd, EPOLL_CTL_ADD, c->shm.waitFd, &ev ) == -1 ){
+		perror( "epoll_ctl" );
+		return -1;
+	}
+
+	ev.events = EPOLLRDHUP | EPOLLET;
+	if( epoll_ctl( c->w->epfd, EPOLL_CTL_MOD, c->fd, &ev ) == -1 ){
+		perror( "epoll_ctl" );
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    handleMsg
+* Purpose: Steps a connection's state machine with one frame from the client.
+*          Responses are only queued here; readConn() sends them all at once.
+* Input:   c   - the connection that the frame arrived on
+*          buf - the frame's payload (not null terminated)
+*          len - the length of the frame's payload
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int handleMsg( struct conn* c, char* buf, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	char* resp; // the response frame we're building for the client
+	char* key;
+	uint32_t keyLen;
+	uint64_t expires = 0;
+	int cas = 0;
+	int prefix = 0;
+	int status;
+
+	// is this message the data that follows a TRANSLATE or STORE?
+	switch( c->state ){
+
+		case STATE_TRANSLATE:
+			resp = queueAlloc( c, len );
+			if( resp == NULL )
+				return -1;
+
+			// send the client back the TRANSLATE'd data
+			translate( resp, buf, len );
+			c->state = STATE_CMD;
+
+			return 0;
+
+		case STATE_STORE:
+			if( repl.host != NULL )
+				status = -3;
+			else if( c->cas )
+				status = storeCas( &kvstore, c->key, c->keyLen, buf, len, NULL,
+				 c->expires, &c->version );
+			else
+				status = storeSet( &kvstore, c->key, c->keyLen, buf, len,
+				 c->expires );
+			c->state = STATE_CMD;
+			status = stored( c, status );
+
+			poolFree( &c->w->pool, c->key );
+			c->key = NULL;
+
+			return status;
+
+		case STATE_MSTORE:
+			status = repl.host != NULL ? -3 : mstore( c, buf, len );
+			c->state = STATE_CMD;
+
+			poolFree( &c->w->pool, c->key );
+			c->key = NULL;
+
+			// are we a replica? was the data garbled, or did we run out of
+			// memory?
+			if( status == -3 )
+				return queueStatic( c, &readOnlyFrame );
+			if( status == -2 )
+				return queueStatic( c, &notOkFrame );
+			if( status == -1 )
+				return queueStatic( c, &errorFrame );
+
+			// tell our client that the data has been stored (once it has)
+			logged( c );
+			return queueStatic( c, &okFrame );
+
+		case STATE_CLOSING:
+			// the client already sent EXIT; ignore anything else it says
+			return 0;
+
+	}
+
+	// if we made it this far, this message should be a command
+
+	// if DEBUG enabled, print client's incoming command
+	if( DEBUG ){
+		printf( "DEBUG: incoming cmd '%.*s' from %s.\n", (int)len, buf, c->addr );
+	}
+
+	/*************************
+	* SUBSCRIBE & PSUBSCRIBE *
+	*************************/
+
+	if( isKeyCmd( buf, len, "SUBSCRIBE", &key, &keyLen ) ||
+	 ( isKeyCmd( buf, len, "PSUBSCRIBE", &key, &keyLen ) && (prefix = 1) ) ){
+
+		c->cmd = STAT_SUBSCRIBE;
+
+		// (subscribing to something twice is the same as subscribing once)
+		status = subAdd( &pubsub, c->w->id, &c->w->subs, c, &c->subs, key,
+		 keyLen, prefix );
+		if( status == -1 )
+			return queueStatic( c, &errorFrame );
+
+		return queueStatic( c, &okFrame );
+
+	}
+
+	/*****************************
+	* UNSUBSCRIBE & PUNSUBSCRIBE *
+	*****************************/
+
+	if( isKeyCmd( buf, len, "UNSUBSCRIBE", &key, &keyLen ) ||
+	 ( isKeyCmd( buf, len, "PUNSUBSCRIBE", &key, &keyLen ) && (prefix = 1) ) ){
+
+		c->cmd = STAT_UNSUBSCRIBE;
+
+		if( !subRemove( &pubsub, c->w->id, &c->w->subs, &c->subs, key, keyLen,
+		 prefix ) )
+			return queueStatic( c, &notFoundFrame );
+
+		return queueStatic( c, &okFrame );
+
+	}
+
+	// a subscriber's notifications could be mistaken for the values of its
+	// GETs (& so on), so until it has unsubscribed from everything, it may
+	// only (un)subscribe or EXIT
+	if( c->subs != NULL && !isCmd( buf, len, "EXIT" ) )
+		return queueStatic( c, &notOkFrame );
+
+	/******
+	* SHM *
+	******/
+
+	if( isCmd( buf, len, "SHM" ) ){
+
+		c->cmd = STAT_SHM;
+
+		// (its rings can only be sent over our Unix socket, & only once
+		// there's nothing of ours left to go before them)
+		if( !c->local || useUring || c->shm.area != NULL || c->outCount > 0 )
+			return queueStatic( c, &notOkFrame );
+
+		return shmServe( c );
+
+	}
+
+	/************
+	* TRANSLATE *
+	************/
+
+	if( isCmd( buf, len, "TRANSLATE" ) ){
+
+		c->cmd = STAT_TRANSLATE;
+
+		// tell our client that the command is valid & wait for its data
+		c->state = STATE_TRANSLATE;
+		return queueStatic( c, &okFrame );
+
+	}
+
+	/*************
+	* GET & GETV *
+	*************/
+
+	if( ( isKeyCmd( buf, len, "GET", &key, &keyLen ) && (c->cmd = STAT_GET) ) ||
+	 ( isKeyCmd( buf, len, "GETV", &key, &keyLen ) && (c->cmd = STAT_GETV) ) ){
+
+		status = storeGet( &kvstore, key, keyLen, copyGet, c );
+
+		// is there no such key?
+		if( status == 0 )
+			return queueStatic( c, &notFoundFrame );
+
+		return status == -1 ? -1 : 0;
+
+	}
+
+	/*******
+	* MGET *
+	*******/
+
+	if( isKeyCmd( buf, len, "MGET", &key, &keyLen ) ){
+
+		c->cmd = STAT_MGET;
+		return mget( c, key, keyLen );
+
+	}
+
+	/*******************
+	* MSTORE & MSTOREX *
+	*******************/
+
+	if( isKeyCmd( buf, len, "MSTORE", &key, &keyLen ) ||
+	 ( isKeyCmd( buf, len, "MSTOREX", &key, &keyLen ) &&
+	 (expires = parseExpiry( &key, &keyLen )) != 0 ) ){
+
+		c->cmd = STAT_MSTORE;
+
+		if( splitKeys( c->w->batch, key, keyLen ) == -1 )
+			return queueStatic( c, &notOkFrame );
+
+		// hang on to the keys until the data arrives
+		c->key = poolAlloc( &c->w->pool, keyLen );
+		if( c->key == NULL ){
+			perror( "poolAlloc" );
+			return -1;
+		}
+		memcpy( c->key, key, keyLen );
+		c->keyLen = keyLen;
+		c->expires = expires;
+
+		// tell our client that the command is valid & wait for its data
+		c->state = STATE_MSTORE;
+		return queueStatic( c, &okFrame );
+
+	}
+
+	/**********************
+	* STORE, STOREX & CAS *
+	**********************/
+
+	if( isKeyCmd( buf, len, "STORE", &key, &keyLen ) ||
+	 ( isKeyCmd( buf, len, "STOREX", &key, &keyLen ) &&
+	 (expires = parseExpiry( &key, &keyLen )) != 0 ) ||
+	 ( isKeyCmd( buf, len, "CAS", &key, &keyLen ) &&
+	 parseVersion( &key, &keyLen, &c->version ) == 0 && (cas = 1) ) ){
+
+		c->cmd = cas ? STAT_CAS : STAT_STORE;
+		c->expires = expires;
+		c->cas = cas;
+
+		// hang on to the key until the data arrives
+		c->key = poolAlloc( &c->w->pool, keyLen );
+		if( c->key == NULL ){
+			perror( "poolAlloc" );
+			return -1;
+		}
+		memcpy( c->key, key, keyLen );
+		c->keyLen = keyLen;
+
+		// tell our client that the command is valid & wait for its data
+		c->state = STATE_STORE;
+		return queueStatic( c, &okFrame );
+
+	}
+
+	/*******
+	* EXIT *
+	*******/
+
+	if( isCmd( buf, len, "EXIT" ) ){
+
+		c->cmd = STAT_EXIT;
+
+		if( DEBUG ){
+			printf( "DEBUG: %s sends EXIT\n", c->addr );
+		}
+
+		// close the connection as soon as our OK has been sent (with no more
+		// notifications coming along to hold it open)
+		subRemoveAll( &pubsub, c->w->id, &c->w->subs, &c->subs );
+		c->state = STATE_CLOSING;
+		return queueStatic( c, &okFrame );
+
+	}
+
+	/********
+	* STATS *
+	********/
+
+	if( isCmd( buf, len, "STATS" ) ){
+
+		// VARIABLE DEFINITIONS
+		char table[4096];
+		size_t tableLen;
+
+		c->cmd = STAT_STATS;
+
+		tableLen = formatStats( table, sizeof(table) );
+		resp = queueAlloc( c, strlen( OK "\n" ) + tableLen );
+		if( resp == NULL )
+			return -1;
+
+		memcpy( resp, OK "\n", strlen( OK "\n" ) );
+		memcpy( resp + strlen( OK "\n" ), table, tableLen );
+		return 0;
+
+	}
+
+	// if we made it this far, the command is not recognized.
+	return queueStatic( c, &notOkFrame );
+
+}
+
+/*******************************************************************************
+* Name:    cmdDone
+* Purpose: Records the stats of the command a connection just finished
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void cmdDone( struct conn* c ){
+
+	// (frames after an EXIT aren't commands)
+	if( c->cmd == STAT_NONE )
+		return;
+
+	statsRecord( &c->w->stats, c->cmd, statsNow() - c->cmdStart, c->cmdIn,
+	 c->queued - c->cmdOut );
+	c->cmd = STAT_NONE;
+
+}
+
+/*******************************************************************************
+* Name:    startStream
+* Purpose: Starts streaming the data of a big TRANSLATE or STORE. We know the
+*          length of a TRANSLATE's response already, so it can start right
+*          away; a STORE's data is written into a new blob as it arrives.
+* Input:   c   - the connection
+*          len - the length of the data to come
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int startStream( struct conn* c, uint32_t len ){
+
+	// VARIABLE DEFINITIONS
+	char* resp;
+
+	c->streamLeft = len;
+
+	if( c->state == STATE_TRANSLATE ){
+
+		resp = queueRaw( c, FRAMEHDRSIZE );
+		if( resp == NULL )
+			return -1;
+		frameHdr( resp, len );
+
+		c->state = STATE_STREAM_TRANSLATE;
+
+	} else {
+
+		// if this fails, we still swallow the data & then report the error
+		c->blob = blobNew();
+		c->state = STATE_STREAM_STORE;
+
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    streamChunk
+* Purpose: Handles the next piece of a streamed TRANSLATE or STORE
+* Input:   c    - the connection
+*          data - the piece of data
+*          n    - the length of the piece (no more than c->streamLeft)
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int streamChunk( struct conn* c, char* data, size_t n ){
+
+	// VARIABLE DEFINITIONS
+	char* resp;
+	int status = -1;
+
+	c->streamLeft -= n;
+
+	if( c->state == STATE_STREAM_TRANSLATE ){
+
+		// TRANSLATE this piece & send it right along
+		resp = queueRaw( c, n );
+		if( resp == NULL )
+			return -1;
+		translate( resp, data, n );
+
+		if( c->streamLeft == 0 )
+			c->state = STATE_CMD;
+
+		return 0;
+
+	}
+
+	// STORE this piece in our blob
+	if( c->blob != NULL && blobWrite( c->blob, data, n ) == -1 ){
+		blobUnref( c->blob );
+		c->blob = NULL;
+	}
+
+	if( c->streamLeft > 0 )
+		return 0;
+
+	// that was the last piece; hand the blob over to the store (unless we're a
+	// replica, which only stores what its primary sends)
+	if( c->blob != NULL && repl.host != NULL ){
+		blobUnref( c->blob );
+		status = -3;
+	} else if( c->blob != NULL && c->cas ){
+		status = storeCas( &kvstore, c->key, c->keyLen, NULL, 0, c->blob,
+		 c->expires, &c->version );
+	} else if( c->blob != NULL ){
+		status = storeSetBlob( &kvstore, c->key, c->keyLen, c->blob,
+		 c->expires );
+	}
+
+	c->blob = NULL;
+	c->state = STATE_CMD;
+	status = stored( c, status );
+
+	poolFree( &c->w->pool, c->key );
+	c->key = NULL;
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    handleFrames
+* Purpose: Handles every complete frame waiting in a connection's ring. The data
+*          for a TRANSLATE of STREAMSIZE bytes or more (or a STORE of blobSize
+*          bytes or more) isn't buffered whole; it's handled piece by piece as
+*          it arrives instead.
+* Input:   c - the connection to handle frames for
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int handleFrames( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	char* data;
+	uint32_t len;
+	size_t n;
+	int status;
+
+	while(1){
+
+		// leave the rest until the client has taken some of our output
+		if( outputFull( c ) )
+			return 0;
+
+		/******************
+		* STREAMED CHUNKS *
+		******************/
+
+		// are we in the middle of streaming a big TRANSLATE or STORE?
+		if( c->state == STATE_STREAM_TRANSLATE || c->state == STATE_STREAM_STORE ){
+
+			n = ringPeek( &c->in, &data, c->streamLeft );
+			if( n == 0 )
+				return 0;
+
+			if( streamChunk( c, data, n ) == -1 )
+				return -1;
+
+			ringSkip( &c->in, n );
+
+			// was that the last piece?
+			if( c->state == STATE_CMD )
+				cmdDone( c );
+
+			continue;
+
+		}
+
+		// is this the data for a TRANSLATE or STORE, & big enough to stream?
+		if( ringHdr( &c->in, &len ) && (
+		 ( c->state == STATE_TRANSLATE && len >= STREAMSIZE ) ||
+		 ( c->state == STATE_STORE && blobSize > 0 && len >= blobSize ) ) ){
+
+			ringSkip( &c->in, FRAMEHDRSIZE );
+			c->cmdIn += FRAMEHDRSIZE + len;
+
+			if( startStream( c, len ) == -1 )
+				return -1;
+
+			// recieve in big pieces from here on
+			if( c->in.cap < STREAMSIZE && ringResize( &c->in, STREAMSIZE ) == -1 )
+				return -1;
+
+			continue;
+
+		}
+
+		/***************
+		* WHOLE FRAMES *
+		***************/
+
+		status = ringFrame( &c->in, &data, &len );
+
+		// do we need to recieve more first?
+		if( status == 0 )
+			return 0;
+
+		// was the frame garbage (or too big for us)?
+		if( status == -1 ){
+			fprintf( stderr, "server: bad frame from %s\n", c->addr );
+			return -1;
+		}
+
+		// is this the first frame of a new command?
+		if( c->state == STATE_CMD ){
+			c->cmd = STAT_UNKNOWN; // (handleMsg() will tell us which)
+			c->cmdStart = c->recvTime;
+			c->cmdIn = 0;
+			c->cmdOut = c->queued;
+		}
+		c->cmdIn += FRAMEHDRSIZE + len;
+
+		if( handleMsg( c, data, len ) == -1 )
+			return -1;
+
+		ringConsume( &c->in, len );
+
+		// has the command been answered in full?
+		if( c->state == STATE_CMD || c->state == STATE_CLOSING )
+			cmdDone( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    readConn
+* Purpose: Recieves everything waiting on a connection's socket (or in its
+*          ring, on shared memory), feeding each complete frame into the
+*          connection's state machine
+* Input:   c - the connection that became readable
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int readConn( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	// we're edge-triggered, so we must read until the socket runs dry
+	while(1){
+
+		// has a paused client's output drained (maybe just now, in one go)?
+		// then carry on with the frames we left in its ring
+		if( outputDrained( c ) ){
+			if( handleFrames( c ) == -1 || flushConn( c ) == -1 )
+				return -1;
+			continue;
+		}
+
+		// if it's still paused, leave the rest in its socket; we'll be back
+		// here once EPOLLOUT says it has taken more of our output
+		if( c->paused )
+			return 0;
+
+		numbytes = c->shm.area != NULL ? shmRead( &c->shm, &c->in ) :
+		 ringRecv( &c->in, c->fd );
+
+		if( numbytes == -1 ){
+
+			if( errno == EINTR )
+				continue;
+
+			// have we read everything there is to read?
+			if( errno == EAGAIN || errno == EWOULDBLOCK )
+				return 0;
+
+			perror( c->shm.area != NULL ? "shmRead" : "recv" );
+			return -1;
+		}
+
+		// did the client hang up?
+		if( numbytes == 0 )
+			return -1;
+
+		c->recvTime = statsNow();
+
+		// handle every complete frame this recv() gave us; a pipelining client
+		// may have sent us many commands without waiting for our responses
+		if( handleFrames( c ) == -1 )
+			return -1;
+
+		// send all of the responses to those frames with one writev()
+		if( flushConn( c ) == -1 )
+			return -1;
+
+		touchConn( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    closeConn
+* Purpose: Closes a connection's socket & frees everything it was using
+* Input:   c - the connection to close
+* Output:  none
+*******************************************************************************/
+void closeConn( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* prev = NULL;
+
+	if( DEBUG ){
+		printf( "DEBUG: closing connection from %s.\n", c->addr );
+	}
+
+	// take it out of our epoll set first: closing our fd only does that once
+	// no other process (e.g. a snapshot child) holds the socket too
+	epoll_ctl( c->w->epfd, EPOLL_CTL_DEL, c->fd, NULL );
+	if( c->shm.area != NULL )
+		epoll_ctl( c->w->epfd, EPOLL_CTL_DEL, c->shm.waitFd, NULL );
+	close( c->fd );
+	shmFree( &c->shm );
+	timerCancel( &c->w->wheel, &c->timer );
+	__atomic_fetch_sub( &c->w->open, 1, __ATOMIC_RELAXED );
+	__atomic_fetch_sub( &openConns, 1, __ATOMIC_RELAXED );
+
+	// free any responses that never got sent
+	for( int i = 0; i < c->outCount; i++ )
+		outvDone( c, &c->outq[ c->outHead + i ] );
+
+	// & any STORE that was being streamed into a blob
+	if( c->blob != NULL )
+		blobUnref( c->blob );
+
+	// & whatever it was subscribed to, & its notifications still to be sent
+	subRemoveAll( &pubsub, c->w->id, &c->w->subs, &c->subs );
+	for( struct conn** link = &c->w->notified; c->notified && *link != NULL;
+	 prev = *link, link = &(*link)->notifiedNext ){
+		if( *link == c ){
+			*link = c->notifiedNext;
+			if( c->w->notifiedTail == c )
+				c->w->notifiedTail = prev;
+			break;
+		}
+	}
+
+	// & take it off its worker's list of connections waiting on the log
+	for( struct conn** link = &c->w->held; c->held && *link != NULL;
+	 link = &(*link)->heldNext ){
+		if( *link == c ){
+			*link = c->heldNext;
+			break;
+		}
+	}
+
+	// & off its worker's list of every connection
+	if( c->prev != NULL )
+		c->prev->next = c->next;
+	else
+		c->w->conns = c->next;
+	if( c->next != NULL )
+		c->next->prev = c->prev;
+
+	ringFree( &c->in );
+	arenaReset( &c->arena, &c->w->pool );
+	free( c->outq );
+	poolFree( &c->w->pool, c->sendMsgs );
+	poolFree( &c->w->pool, c->key );
+	free( c );
+
+}
+
+/*******************************************************************************
+* Name:    admitConn
+* Purpose: Decides whether we have room for a newly accepted client. If not,
+*          it is sent BUSY & closed straight away, without costing us any
+*          more than that.
+* Input:   w  - the worker that accepted the client
+*          fd - the client's socket
+* Output:  1 if the client may stay, 0 if it was turned away
+*******************************************************************************/
+int admitConn( struct worker* w, int fd ){
+
+	// VARIABLE DEFINITIONS
+	unsigned long open = __atomic_add_fetch( &openConns, 1, __ATOMIC_RELAXED );
+
+	if( maxConns == 0 || open <= maxConns )
+		return 1;
+
+	__atomic_fetch_sub( &openConns, 1, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &w->rejected, 1, __ATOMIC_RELAXED );
+
+	// (the socket's send buffer is empty, so this can't block or come up short)
+	send( fd, busyFrame.bytes, busyFrame.len, MSG_NOSIGNAL | MSG_DONTWAIT );
+	close( fd );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    newConn
+* Purpose: Sets up the struct conn for a newly accepted client
+* Input:   w          - the worker that accepted the client
+*          fd         - the client's socket
+*          their_addr - the client's address
+* Output:  the new connection, or NULL if we ran out of memory (fd is closed)
+*******************************************************************************/
+struct conn* newConn( struct worker* w, int fd, struct sockaddr_storage* their_addr ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c = calloc( 1, sizeof(struct conn) );
+	int one = 1;
+
+	if( c == NULL ){
+		perror( "calloc" );
+		close( fd );
+		return NULL;
+	}
+
+	c->fd = fd;
+	c->w = w;
+	c->state = STATE_CMD;
+	c->cmd = STAT_NONE;
+
+	// (a client on our Unix socket has no address, or Nagle)
+	if( their_addr->ss_family == AF_UNIX ){
+		c->local = 1;
+		strcpy( c->addr, "local" );
+	} else {
+		// we send each batch of responses in one go; don't let Nagle hold the
+		// next batch back until the client ACKs the last
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+		inet_ntop(
+		 their_addr->ss_family,
+		 &( ( (struct sockaddr_in*)their_addr)->sin_addr ),
+		 c->addr, sizeof(c->addr)
+		);
+	}
+
+	__atomic_fetch_add( &w->accepted, 1, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &w->open, 1, __ATOMIC_RELAXED );
+
+	c->next = w->conns;
+	if( c->next != NULL )
+		c->next->prev = c;
+	w->conns = c;
+	c->recvTime = statsNow();
+
+	touchConn( c );
+
+	if( DEBUG ){
+		printf( "DEBUG: worker %d got connection from %s\n", w->id, c->addr );
+	}
+
+	return c;
+
+}
+
+/*******************************************************************************
+* Name:    acceptConns
+* Purpose: Accepts every connection waiting on one of a worker's listening
+*          sockets & adds each one to that worker's epoll set
+* Input:   w      - the worker
+*          sockfd - its listener that became readable (its own, or the Unix
+*                   socket)
+* Output:  none
+*******************************************************************************/
+void acceptConns( struct worker* w, int sockfd ){
+
+	// VARIABLE DEFINITIONS
+	struct sockaddr_storage their_addr; // connector's address info
+	socklen_t sin_size;
+	struct epoll_event ev;
+	struct conn* c;
+	int new_fd;
+
+	// we're edge-triggered, so we must accept until the queue runs dry
+	while(1){
+
+		sin_size = sizeof( their_addr );
+		new_fd = accept4(
+		 sockfd, (struct sockaddr *)&their_addr, &sin_size,
+		 SOCK_NONBLOCK | SOCK_CLOEXEC
+		);
+
+		if( new_fd == -1 ){
+
+			if( errno == EINTR || errno == ECONNABORTED )
+				continue;
+
+			// EAGAIN means we've accepted everyone; anything else is an error
+			if( errno != EAGAIN && errno != EWOULDBLOCK )
+				perror("accept");
+
+			return;
+		}
+
+		if( !admitConn( w, new_fd ) )
+			continue;
+
+		c = newConn( w, new_fd, &their_addr );
+		if( c == NULL ){
+			__atomic_fetch_sub( &openConns, 1, __ATOMIC_RELAXED );
+			continue;
+		}
+
+		// watch for both directions at once; being edge-triggered, EPOLLOUT only
+		// fires when a full send buffer drains, so it costs nothing when idle
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = c;
+		if( epoll_ctl( w->epfd, EPOLL_CTL_ADD, new_fd, &ev ) == -1 ){
+			perror( "epoll_ctl" );
+			closeConn( c );
+			continue;
+		}
+
+		// tell the client that we're ready and waiting for their command
+		if( queueStatic( c, &readyFrame ) == -1 || flushConn( c ) == -1 )
+			closeConn( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    openListener
+* Purpose: Creates a socket listening on a port. SO_REUSEPORT lets every worker
+*          bind its own listener to the same port, and the kernel then spreads
+*          incoming connections across them (no shared accept() lock)
+* Input:   port - the port
+* Output:  the new non-blocking listening socket (perror() & exit() on fail)
+*******************************************************************************/
+int openListener( char* port ){
+
+	/***********************
+	* VARIABLE DEFINITIONS *
+	***********************/
+
+	int yes = 1;
+	int status; // generic varaible for all function results
+	struct addrinfo hints, *servinfo, *p;
+	int sockfd;
+
+	memset( &hints, 0, sizeof(hints) ); // make struct empty
+	hints.ai_family = AF_INET;          // IPv4 only
+	hints.ai_socktype = SOCK_STREAM;    // TCP
+	hints.ai_flags = AI_PASSIVE;        // use my ip
+
+	/****************
+	* getaddrinfo() *
+	****************/
+
+	status = getaddrinfo(NULL, port, &hints, &servinfo);
+
+	// were there errors?
+	if( status != 0 ){
+		// there were errors; alert & exit.
+		fprintf( stderr, "getaddrinfo error: %s\n", gai_strerror(status) );
+		exit(1);
+	}
+
+	// loop through getaddrinfo()'s results = servinfo
+	for( p = servinfo; p != NULL; p = p->ai_next ){
+		// try to establish a connection with this iteration's addrinfo
+
+		/***********
+		* socket() *
+		***********/
+
+		sockfd = socket(
+		 p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol
+		);
+
+		// could we establish a socket?
+		if( sockfd == -1 ){
+			// socket creation failed
+
+			perror( "server: socket" );
+
+			// try the next iteration's addrinfo
+			continue;
+
+		}
+
+		// fix "Address Already in Use" Error
+		if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1){
+			perror("setsockopt");
+			exit(1);
+		}
+
+		// let each of our workers bind() its own listener on this same port
+		if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) == -1){
+			perror("setsockopt");
+			exit(1);
+		}
+
+		// If we made it this far, the socket has been successfully established.
+		// Now try to bind on the established socket.
+
+		/*********
+		* bind() *
+		*********/
+
+		status = bind( sockfd, p->ai_addr, p->ai_addrlen );
+
+		// could we bind() on the new socket?
+		if( status == -1 ){
+			// we could not bind() on the new socket, so close it & error.
+
+			close(sockfd);
+			perror( "server: bind" );
+
+			// now try the next iteration's addrinfo
+			continue;
+
+		}
+
+		// If we made it this far, the bind on the socket is working.
+
+		// break free from this for loop; we don't need to try any other addrinfos
+		break;
+
+	} // end for each getaddrinfo() result
+
+	// is p pointing to NULL?
+	if( p == NULL ){
+		// p is pointing to null, which means we iterated through all of the
+		// getaddrinfo() results (trying to bind() at each iteration), and made
+		// it to the end of the results, still without a working bind().
+
+		fprintf( stderr, "server: failed to bind\n" );
+		exit(2);
+	}
+
+	freeaddrinfo(servinfo);
+
+	/***********
+	* listen() *
+	***********/
+
+	status = listen( sockfd, BACKLOG );
+
+	// could we listen() on the connect()ion?
+	if( status == -1 ){
+		// we could not listen(); error & exit.
+
+		perror( "listen" );
+		exit(1);
+
+	}
+
+	setNonBlocking( sockfd );
+	return sockfd;
+
+}
+
+/*******************************************************************************
+* Name:    openLocalListener
+* Purpose: Creates a Unix socket listening at a path (replacing whatever was
+*          left there by the last server), for clients on our own host
+* Input:   path - the path
+* Output:  the new non-blocking listening socket (perror() & exit() on fail)
+*******************************************************************************/
+int openLocalListener( char* path ){
+
+	// VARIABLE DEFINITIONS
+	struct sockaddr_un addr;
+	int sockfd;
+
+	if( strlen( path ) >= sizeof(addr.sun_path) ){
+		fprintf( stderr, "server: %s is too long for a Unix socket\n", path );
+		exit(1);
+	}
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+
+	sockfd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+	if( sockfd == -1 ){
+		perror( "socket" );
+		exit(1);
+	}
+
+	// (a socket file outlives the server that bound it)
+	if( unlink( path ) == -1 && errno != ENOENT ){
+		perror( "unlink" );
+		exit(1);
+	}
+
+	if( bind( sockfd, (struct sockaddr*)&addr, sizeof(addr) ) == -1 ){
+		perror( "server: bind" );
+		exit(2);
+	}
+
+	if( listen( sockfd, BACKLOG ) == -1 ){
+		perror( "listen" );
+		exit(1);
+	}
+
+	setNonBlocking( sockfd );
+	return sockfd;
+
+}
+
+/*******************************************************************************
+* Name:    pinWorker
+* Purpose: Pins the calling worker thread to its CPU, if it has one
+* Input:   w - the worker
+* Output:  none
+*******************************************************************************/
+void pinWorker( struct worker* w ){
+
+	// VARIABLE DEFINITIONS
+	cpu_set_t cpus;
+	int status;
+
+	// should this worker stay on one CPU?
+	if( w->cpu == -1 )
+		return;
+
+	CPU_ZERO( &cpus );
+	CPU_SET( w->cpu, &cpus );
+
+	status = pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus );
+	if( status != 0 )
+		fprintf( stderr, "worker %d: pthread_setaffinity_np: %s\n",
+		 w->id, strerror(status) );
+
+}
+
+/*******************************************************************************
+* Name:    timedOut
+* Purpose: Counts & logs a connection whose timeout has expired (the caller
+*          closes it)
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void timedOut( struct conn* c ){
+
+	if( midCommand( c ) ){
+		__atomic_fetch_add( &c->w->reapedRead, 1, __ATOMIC_RELAXED );
+		printf( "server: %s stalled mid-command; closing\n", c->addr );
+	} else {
+		__atomic_fetch_add( &c->w->reapedIdle, 1, __ATOMIC_RELAXED );
+		printf( "server: %s was idle; closing\n", c->addr );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    expireConn
+* Purpose: Closes a connection whose timer expired (called by wheelAdvance())
+* Input:   t - the connection's timer
+* Output:  none
+*******************************************************************************/
+void expireConn( struct timer* t ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c = (struct conn*)( (char*)t - offsetof( struct conn, timer ) );
+
+	timedOut( c );
+	closeConn( c );
+
+}
+
+/*******************************************************************************
+* Name:    sweepKeys
+* Purpose: Deletes expired keys, once a tick & for no more than sweepTime, so
+*          that keys nobody GETs don't hold on to memory. (Whichever worker
+*          STOREs a key with an expiry wakes every tick from then on, so the
+*          sweeps carry on while any such keys are left.)
+* Input:   w - the worker
+* Output:  none
+*******************************************************************************/
+void sweepKeys( struct worker* w ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t start, ns;
+	size_t expired;
+
+	if( __atomic_load_n( &kvstore.numExpiring, __ATOMIC_RELAXED ) == 0 )
+		return;
+
+	start = statsNow();
+	if( wheelTicks( start ) == w->swept )
+		return;
+	w->swept = wheelTicks( start );
+
+	expired = storeSweep( &kvstore, sweepTime );
+
+	ns = statsNow() - start;
+	__atomic_fetch_add( &w->expired, expired, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &w->sweepNs, ns, __ATOMIC_RELAXED );
+	if( ns > w->sweepMax )
+		__atomic_store_n( &w->sweepMax, ns, __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    releaseHeld
+* Purpose: Wakes the logger for the STOREs we've handled since we last did,
+*          & waits until the log has caught up with every one whose responses
+*          our connections are holding back, then sends them (-f always). It
+*          is one wait for all of them, however many there are.
+* Input:   w     - the worker
+*          flush - sends a connection's responses (returns -1 on failure)
+*          drop  - closes a connection
+* Output:  none
+*******************************************************************************/
+void releaseHeld( struct worker* w, int (*flush)( struct conn* c ),
+ void (*drop)( struct conn* c ) ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c;
+	struct conn* next;
+	uint64_t lsn = 0;
+
+	if( w->held == NULL ){
+		if( logLast > w->kicked ){
+			logKick( &plog );
+			w->kicked = logLast;
+		}
+		return;
+	}
+
+	for( c = w->held; c != NULL; c = c->heldNext )
+		if( c->logWait > lsn )
+			lsn = c->logWait;
+
+	logWait( &plog, lsn );
+	w->kicked = logLast;
+
+	c = w->held;
+	w->held = NULL;
+
+	for( ; c != NULL; c = next ){
+
+		next = c->heldNext;
+		c->held = 0;
+
+		if( flush( c ) == -1 )
+			drop( c );
+
+		// are we done with a client that sent EXIT?
+		else if( c->state == STATE_CLOSING && c->outCount == 0 )
+			drop( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    flushHeld
+* Purpose: Sends the responses a connection held back for the log, & carries on
+*          reading from it if that was all that kept it paused (no EPOLLOUT
+*          will come to say so, if the socket never filled up)
+* Input:   c - the connection
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int flushHeld( struct conn* c ){
+
+	if( flushConn( c ) == -1 )
+		return -1;
+
+	return c->paused ? readConn( c ) : 0;
+
+}
+
+/*******************************************************************************
+* Name:    notify
+* Purpose: Queues a notification to one of our subscribers (for subEach())
+* Input:   owner - the subscriber's connection
+*          m     - the notification
+* Output:  none
+*******************************************************************************/
+void notify( void* owner, struct message* m ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c = owner;
+
+	if( queueMsg( c, m ) == -1 )
+		c->missed = 1;
+
+	// (it's sent them all at once, later, in its turn)
+	if( !c->notified ){
+		c->notified = 1;
+		c->notifiedNext = NULL;
+		if( c->w->notified == NULL )
+			c->w->notified = c;
+		else
+			c->w->notifiedTail->notifiedNext = c;
+		c->w->notifiedTail = c;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    deliver
+* Purpose: Takes every change posted to a worker's inbox & queues each one to
+*          all of its subscribers, then sends them to the next NOTIFYBATCH of
+*          the subscribers waiting (so that 10,000 of them can't keep the
+*          worker's other connections waiting). A subscriber that has fallen
+*          -o bytes behind (or missed a notification, for want of memory) is
+*          closed: it can't be paused like a client that sends us commands,
+*          & we mustn't hold on to everything it hasn't taken.
+* Input:   w     - the worker
+*          flush - sends a connection's queued output (returns -1 on failure)
+*          drop  - closes a connection
+* Output:  none
+*******************************************************************************/
+void deliver( struct worker* w, int (*flush)( struct conn* c ),
+ void (*drop)( struct conn* c ) ){
+
+	// VARIABLE DEFINITIONS
+	struct message* m = inboxTake( &pubsub.inboxes[ w->id ] );
+	struct message* nextMsg;
+	struct conn* c;
+	size_t n = 0;
+
+	// queue them all first (each subscriber takes a reference to the message,
+	// & then we drop our inbox's)...
+	for( ; m != NULL; m = nextMsg ){
+		nextMsg = m->next[ w->id ];
+		n += subEach( &w->subs, m, notify );
+		msgUnref( m );
+	}
+
+	if( n > 0 )
+		__atomic_fetch_add( &w->notifications, n, __ATOMIC_RELAXED );
+
+	// ...so that each subscriber gets all of its notifications in one send
+	for( int i = 0; i < NOTIFYBATCH && (c = w->notified) != NULL; i++ ){
+
+		w->notified = c->notifiedNext;
+		c->notified = 0;
+
+		// (with -u, a connection that's closing has no one left to tell)
+		if( c->closing )
+			continue;
+
+		if( c->missed || flush( c ) == -1 ){
+			drop( c );
+			continue;
+		}
+
+		if( maxOutput > 0 && c->outBytes > maxOutput ){
+			__atomic_fetch_add( &w->slowSubs, 1, __ATOMIC_RELAXED );
+			drop( c );
+		}
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    finished
+* Purpose: Tells whether a connection could be closed without cutting a
+*          command short: it's between commands, with nothing left to send &
+*          nothing waiting to be read
+* Input:   c - the connection
+* Output:  1 if it could, 0 if not
+*******************************************************************************/
+int finished( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	int waiting = 0;
+
+	if( midCommand( c ) || c->outCount > 0 )
+		return 0;
+
+	if( c->shm.area != NULL )
+		return shmEmpty( &c->shm );
+
+	return ioctl( c->fd, FIONREAD, &waiting ) == 0 && waiting == 0;
+
+}
+
+/*******************************************************************************
+* Name:    drainConns
+* Purpose: Once a tick while we're handing over to a new server, closes every
+*          connection that's finished with us: at first, only those that have
+*          also sent us nothing for a tick (so that a client isn't closed
+*          between two commands of a conversation); after -g seconds, those
+*          that are between any two commands; & a second after that, every
+*          connection at all
+* Input:   w       - the worker
+*          closeFn - how to close a connection (closeConn() or uringClose())
+* Output:  none
+*******************************************************************************/
+void drainConns( struct worker* w, void (*closeFn)( struct conn* c ) ){
+
+	// VARIABLE DEFINITIONS
+	int mode = __atomic_load_n( &draining, __ATOMIC_RELAXED );
+	uint64_t now = statsNow();
+	uint64_t tick = wheelTicks( now );
+	struct conn* c;
+	struct conn* next;
+
+	if( mode == 0 || tick == w->drained )
+		return;
+	w->drained = tick;
+
+	for( c = w->conns; c != NULL; c = next ){
+
+		next = c->next;
+		if( c->closing )
+			continue;
+
+		if( mode == 3 || ( finished( c ) && ( mode == 2 ||
+		 now - c->recvTime >= (uint64_t)WHEELTICK * 1000000 ) ) )
+			closeFn( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    stopAccepting
+* Purpose: Takes a worker's listeners out of its epoll set & closes our copy
+*          of its own, leaving them to the new server we've handed them to
+*          (the Unix socket is every worker's, so it stays open until we exit)
+* Input:   w - the worker
+* Output:  none
+*******************************************************************************/
+void stopAccepting( struct worker* w ){
+
+	epoll_ctl( w->epfd, EPOLL_CTL_DEL, w->sockfd, NULL );
+	close( w->sockfd );
+	w->sockfd = -1;
+
+	if( w->localfd != -1 ){
+		epoll_ctl( w->epfd, EPOLL_CTL_DEL, w->localfd, NULL );
+		w->localfd = -1;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    shmEvent
+* Purpose: Handles a client on shared memory waking us: it has written frames
+*          to us, or read enough of our responses to make room for more (or
+*          both)
+* Input:   c - the connection
+* Output:  0 on success, -1 if the connection should be closed
+*******************************************************************************/
+int shmEvent( struct conn* c ){
+
+	if( flushConn( c ) == -1 )
+		return -1;
+
+	return readConn( c );
+
+}
+
+/*******************************************************************************
+* Name:    workerLoop
+* Purpose: The body of each worker thread: optionally pins itself to a CPU,
+*          then runs its own epoll event loop over its own listener & clients
+* Input:   arg - the worker's struct worker
+* Output:  none (never returns)
+*******************************************************************************/
+void* workerLoop( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct worker* w = arg;
+	struct epoll_event events[MAXEVENTS];
+	int numEvents; // number of events returned by epoll_wait()
+
+	pinWorker( w );
+	wheelInit( &w->wheel, wheelTicks( statsNow() ) );
+
+	while(1) {  // this worker's event loop
+
+		// (while any timers are armed, keys may expire or we're draining,
+		// wake up at least once a tick; while anyone's waiting on the log, or
+		// on notifications, don't wait at all)
+		numEvents = epoll_wait( w->epfd, events, MAXEVENTS,
+		 w->held != NULL || w->notified != NULL ? 0 :
+		 w->wheel.armed || kvstore.numExpiring || draining ?
+		 WHEELTICK : -1 );
+
+		if( numEvents == -1 ){
+
+			if( errno == EINTR )
+				continue;
+
+			perror( "epoll_wait" );
+			exit(1);
+		}
+
+		// handle each socket that is ready for us
+		for( int i = 0; i < numEvents; i++ ){
+
+			// DEFINE VARIABLES
+			struct conn* c = events[i].data.ptr;
+
+			// was it for a client on shared memory we've just closed (below)?
+			if( events[i].events == 0 )
+				continue;
+
+			// is this our listener?
+			if( c == NULL ){
+				acceptConns( w, w->sockfd );
+				continue;
+			}
+
+			// or the Unix socket?
+			if( (void*)c == &w->localfd ){
+				acceptConns( w, w->localfd );
+				continue;
+			}
+
+			// or our inbox? (deliver() takes what's in it, below)
+			if( (void*)c == &pubsub.inboxes[ w->id ] ){
+				inboxClear( &pubsub.inboxes[ w->id ] );
+				continue;
+			}
+
+			// is it a client on shared memory? then it was its eventfd, unless
+			// its socket says it has hung up (or failed)
+			if( c->shm.area != NULL ){
+				if( ( events[i].events & (EPOLLERR | EPOLLRDHUP | EPOLLHUP) ) ||
+				 shmEvent( c ) == -1 ||
+				 ( c->state == STATE_CLOSING && c->outCount == 0 ) ){
+					// (it has two descriptors, so may have another event
+					// later on in this batch)
+					for( int j = i + 1; j < numEvents; j++ )
+						if( events[j].data.ptr == c )
+							events[j].events = 0;
+					closeConn( c );
+				}
+				continue;
+			}
+
+			// did the connection fail?
+			if( events[i].events & EPOLLERR ){
+				closeConn( c );
+				continue;
+			}
+
+			// is there new data from the client (or did it hang up)?
+			if( events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP) ){
+				if( readConn( c ) == -1 ){
+					closeConn( c );
+					continue;
+				}
+			}
+
+			// did the socket drain enough to send more of our output?
+			if( events[i].events & EPOLLOUT ){
+				if( flushConn( c ) == -1 ){
+					closeConn( c );
+					continue;
+				}
+				// & enough to start reading from a paused client again?
+				if( c->paused && readConn( c ) == -1 ){
+					closeConn( c );
+					continue;
+				}
+			}
+
+			// are we done with a client that sent EXIT?
+			if( c->state == STATE_CLOSING && c->outCount == 0 )
+				closeConn( c );
+
+		}
+
+		// send whatever was waiting on the log
+		releaseHeld( w, flushHeld, closeConn );
+
+		// & whatever changed that our subscribers wanted to hear about
+		deliver( w, flushConn, closeConn );
+
+		// close every connection that has timed out
+		wheelAdvance( &w->wheel, wheelTicks( statsNow() ), expireConn );
+
+		// & clear out some expired keys
+		sweepKeys( w );
+
+		// & if we've handed over to a new server, stop accepting & close
+		// every client that's finished with us
+		if( __atomic_load_n( &draining, __ATOMIC_RELAXED ) ){
+			if( w->sockfd != -1 )
+				stopAccepting( w );
+			drainConns( w, closeConn );
+		}
+
+	}
+
+	return NULL;
+
+}
+
+#if URING
+
+/*******************************************************************************
+                               IO_URING BACKEND
+*******************************************************************************/
+
+// what each of our io_uring requests was for, kept in the low bits of its
+// user_data (the rest is the struct conn*, which is at least 8 byte aligned)
+#define OP_ACCEPT 1
+#define OP_RECV   2
+#define OP_SEND   3
+#define OP_CANCEL 4
+#define OP_WAKE   5
+#define OP_STOP   6
+#define OP_MASK   7
+#define OP_LOCAL  8 // (with OP_ACCEPT: it's the Unix socket's)
+
+/*******************************************************************************
+* Name:    uringRecv
+* Purpose: Starts a multishot recv() on a connection: it keeps completing, with
+*          a buffer picked from the worker's provided buffer ring each time,
+*          until it runs out of buffers or the connection ends
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void uringRecv( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe = uringSqe( &c->w->ring );
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = (unsigned long)c | OP_RECV;
+
+	c->pending++;
+	c->recving = 1;
+
+}
+
+/*******************************************************************************
+* Name:    uringPause
+* Purpose: Cancels a paused connection's multishot recv(), so that whatever
+*          the client sends stays in its socket (& TCP pushes back on it)
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void uringPause( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe;
+
+	if( !c->recving || c->closing )
+		return;
+
+	sqe = uringSqe( &c->w->ring );
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = (unsigned long)c | OP_RECV;
+	sqe->user_data = (unsigned long)c | OP_CANCEL;
+
+	c->pending++;
+
+}
+
+/*******************************************************************************
+* Name:    uringFlush
+* Purpose: Submits a connection's queued responses as one chain of sendmsg()s
+*          (up to MAXIOV responses each), linked so that they go out in order.
+*          Only one chain is in flight per connection at a time; whatever is
+*          queued meanwhile goes out in the next one.
+* Input:   c - the connection
+* Output:  0 on success, -1 if we ran out of memory
+*******************************************************************************/
+int uringFlush( struct conn* c ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe;
+	struct iovec* iov;
+	int chunks;
+
+	if( c->sending > 0 || c->outCount == 0 || c->closing || holdConn( c ) )
+		return 0;
+
+	// the kernel reads these later, so they must outlive this function
+	chunks = ( c->outCount + MAXIOV - 1 ) / MAXIOV;
+	c->sendMsgs = poolAlloc( &c->w->pool, chunks * sizeof(struct msghdr) +
+	 c->outCount * sizeof(struct iovec) );
+	if( c->sendMsgs == NULL ){
+		perror( "poolAlloc" );
+		return -1;
+	}
+	iov = (struct iovec*)( c->sendMsgs + chunks );
+
+	for( int i = 0; i < c->outCount; i++ ){
+		iov[i].iov_base = c->outq[ c->outHead + i ].base;
+		iov[i].iov_len = c->outq[ c->outHead + i ].len;
+	}
+
+	for( int i = 0; i < chunks; i++ ){
+
+		memset( &c->sendMsgs[i], 0, sizeof(struct msghdr) );
+		c->sendMsgs[i].msg_iov = iov + i * MAXIOV;
+		c->sendMsgs[i].msg_iovlen = ( i == chunks-1 ) ?
+		 c->outCount - i * MAXIOV : MAXIOV;
+
+		sqe = uringSqe( &c->w->ring );
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = c->fd;
+		sqe->addr = (unsigned long)&c->sendMsgs[i];
+		// MSG_WAITALL makes the kernel finish each one before the next
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		sqe->user_data = (unsigned long)c | OP_SEND;
+		if( i < chunks-1 )
+			sqe->flags = IOSQE_IO_LINK;
+
+	}
+
+	c->sending = chunks;
+	c->pending += chunks;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    uringClose
+* Purpose: Starts closing a connection. Its requests still in flight are
+*          ended by shutdown(); uringDone() frees it once they have all
+*          completed.
+* Input:   c - the connection
+* Output:  none
+*******************************************************************************/
+void uringClose( struct conn* c ){
+
+	if( c->closing )
+		return;
+
+	c->closing = 1;
+	shutdown( c->fd, SHUT_RDWR );
+
+	// (it's no use telling it of any more changes)
+	subRemoveAll( &pubsub, c->w->id, &c->w->subs, &c->subs );
+
+	if( c->pending == 0 )
+		closeConn( c );
+
+}
+
+/*******************************************************************************
+* Name:    uringDone
+* Purpose: Accounts for one of a connection's requests having completed
+*          (for good), freeing the connection if it was the last one of a
+*          connection that's closing
+* Input:   c - the connection
+* Output:  1 if the connection was freed, 0 if not
+*******************************************************************************/
+int uringDone( struct conn* c ){
+
+	c->pending--;
+
+	if( c->closing && c->pending == 0 ){
+		closeConn( c );
+		return 1;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    uringExpire
+* Purpose: Starts closing a connection whose timer expired (called by
+*          wheelAdvance())
+* Input:   t - the connection's timer
+* Output:  none
+*******************************************************************************/
+void uringExpire( struct timer* t ){
+
+	// VARIABLE DEFINITIONS
+	struct conn* c = (struct conn*)( (char*)t - offsetof( struct conn, timer ) );
+
+	if( c->closing )
+		return;
+
+	timedOut( c );
+	uringClose( c );
+
+}
+
+/*******************************************************************************
+* Name:    uringAccept
+* Purpose: Starts a multishot accept() on one of a worker's listeners: it
+*          completes once per new client, until something goes wrong
+* Input:   w     - the worker
+*          local - 1 for the Unix socket, 0 for its own listener
+* Output:  none
+*******************************************************************************/
+void uringAccept( struct worker* w, int local ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe = uringSqe( &w->ring );
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = local ? w->localfd : w->sockfd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = local ? OP_ACCEPT | OP_LOCAL : OP_ACCEPT;
+
+}
+
+/*******************************************************************************
+* Name:    uringStopAccepting
+* Purpose: Cancels a worker's multishot accept()s & closes our copy of its own
+*          listener, leaving them to the new server we've handed them to (see
+*          stopAccepting())
+* Input:   w - the worker
+* Output:  none
+*******************************************************************************/
+void uringStopAccepting( struct worker* w ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe = uringSqe( &w->ring );
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = OP_ACCEPT;
+	sqe->user_data = OP_STOP;
+
+	close( w->sockfd );
+	w->sockfd = -1;
+
+	if( w->localfd != -1 ){
+		sqe = uringSqe( &w->ring );
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = OP_ACCEPT | OP_LOCAL;
+		sqe->user_data = OP_STOP;
+		w->localfd = -1;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    uringWatch
+* Purpose: Starts a multishot poll() on a worker's inbox: it completes each
+*          time a change is posted to the inbox while it was empty
+* Input:   w - the worker
+* Output:  none
+*******************************************************************************/
+void uringWatch( struct worker* w ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_sqe* sqe = uringSqe( &w->ring );
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = pubsub.inboxes[ w->id ].fd;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = OP_WAKE;
+
+}
+
+/*******************************************************************************
+* Name:    uringAccepted
+* Purpose: Handles the completion of an accept()
+* Input:   w   - the worker
+*          cqe - the completion
+* Output:  none
+*******************************************************************************/
+void uringAccepted( struct worker* w, struct io_uring_cqe* cqe ){
+
+	// VARIABLE DEFINITIONS
+	struct sockaddr_storage their_addr; // connector's address info
+	socklen_t sin_size = sizeof( their_addr );
+	struct conn* c;
+	int local = ( cqe->user_data & OP_LOCAL ) != 0;
+
+	// has the multishot accept() stopped? then start another one (unless
+	// it was us that stopped it)
+	if( !( cqe->flags & IORING_CQE_F_MORE ) &&
+	 ( local ? w->localfd : w->sockfd ) != -1 )
+		uringAccept( w, local );
+
+	if( cqe->res < 0 ){
+		if( cqe->res != -ECONNABORTED && cqe->res != -ECANCELED )
+			fprintf( stderr, "accept: %s\n", strerror( -cqe->res ) );
+		return;
+	}
+
+	if( !admitConn( w, cqe->res ) )
+		return;
+
+	// (a multishot accept() can't hand back each client's address)
+	if( getpeername( cqe->res, (struct sockaddr*)&their_addr, &sin_size ) == -1 )
+		memset( &their_addr, 0, sizeof(their_addr) );
+
+	c = newConn( w, cqe->res, &their_addr );
+	if( c == NULL ){
+		__atomic_fetch_sub( &openConns, 1, __ATOMIC_RELAXED );
+		return;
+	}
+
+	// tell the client that we're ready and waiting for their command
+	uringRecv( c );
+	if( queueStatic( c, &readyFrame ) == -1 || uringFlush( c ) == -1 )
+		uringClose( c );
+
+}
+
+/*******************************************************************************
+* Name:    uringRecvd
+* Purpose: Handles the completion of a recv(): feeds the data into the
+*          connection's state machine & submits the responses
+* Input:   c   - the connection
+*          cqe - the completion
+* Output:  none
+*******************************************************************************/
+void uringRecvd( struct conn* c, struct io_uring_cqe* cqe ){
+
+	// VARIABLE DEFINITIONS
+	struct uring* u = &c->w->ring;
+	int more = cqe->flags & IORING_CQE_F_MORE;
+	unsigned short bid;
+
+	if( cqe->flags & IORING_CQE_F_BUFFER ){
+
+		// copy out of the kernel's buffer & give it straight back
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		if( cqe->res > 0 && !c->closing &&
+		 ringAppend( &c->in, uringBufGet( u, bid ), cqe->res ) == -1 )
+			uringClose( c );
+		uringBufPut( u, bid );
+
+	}
+
+	// (while the client is paused, anything that was already on its way
+	// just waits in the ring)
+	if( cqe->res > 0 && !c->closing && !c->paused ){
+
+		c->recvTime = statsNow();
+
+		// handle every complete frame this recv() gave us & send all of the
+		// responses to them at once
+		if( handleFrames( c ) == -1 || uringFlush( c ) == -1 )
+			uringClose( c );
+
+		// are we done with a client that sent EXIT?
+		else if( c->state == STATE_CLOSING && c->outCount == 0 )
+			uringClose( c );
+
+		else
+			touchConn( c );
+
+		// did that pause the client? then stop recieving from it
+		if( c->paused )
+			uringPause( c );
+
+	}
+
+	// did the client hang up (or the recv() fail, other than by uringPause())?
+	if( cqe->res == 0 || ( cqe->res < 0 && cqe->res != -ENOBUFS &&
+	 cqe->res != -ECANCELED ) )
+		uringClose( c );
+
+	// the multishot recv() may stop (e.g. if every buffer was in use); if
+	// the connection is still going (& not paused), start it again
+	if( !more ){
+		c->recving = 0;
+		if( uringDone( c ) )
+			return;
+		if( !c->closing && !c->paused )
+			uringRecv( c );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    uringSent
+* Purpose: Handles the completion of one sendmsg() of a chain
+* Input:   c   - the connection
+*          cqe - the completion
+* Output:  none
+*******************************************************************************/
+void uringSent( struct conn* c, struct io_uring_cqe* cqe ){
+
+	// a short send (or an error) cancels the rest of the chain, which is then
+	// sent again from where it stopped
+	if( cqe->res > 0 ){
+		__atomic_fetch_add( &c->w->bytesOut, cqe->res, __ATOMIC_RELAXED );
+		outqAdvance( c, cqe->res );
+	} else if( cqe->res < 0 && cqe->res != -ECANCELED ){
+		uringClose( c );
+	}
+
+	c->sending--;
+	if( c->sending == 0 ){
+		poolFree( &c->w->pool, c->sendMsgs );
+		c->sendMsgs = NULL;
+	}
+
+	if( uringDone( c ) )
+		return;
+
+	// has a paused client's output drained enough to read from it again?
+	// then carry on with the frames we left in its ring, & then its socket
+	if( !c->closing && outputDrained( c ) ){
+		if( handleFrames( c ) == -1 ){
+			uringClose( c );
+			return;
+		}
+		if( c->paused )
+			uringPause( c );
+		else if( !c->recving )
+			uringRecv( c );
+	}
+
+	if( c->sending == 0 && !c->closing ){
+
+		// send whatever was queued while that chain was in flight
+		if( uringFlush( c ) == -1 )
+			uringClose( c );
+
+		// are we done with a client that sent EXIT?
+		else if( c->state == STATE_CLOSING && c->outCount == 0 )
+			uringClose( c );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    uringLoop
+* Purpose: The body of each worker thread with -u: the same as workerLoop(),
+*          but on io_uring instead of epoll
+* Input:   arg - the worker's struct worker
+* Output:  none (never returns)
+*******************************************************************************/
+void* uringLoop( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct worker* w = arg;
+	struct io_uring_cqe* cqe;
+	struct conn* c;
+
+	pinWorker( w );
+
+	// (set up here, since only the thread that creates the ring may use it)
+	if( uringInit( &w->ring, URINGDEPTH ) == -1 ){
+		perror( "io_uring_setup" );
+		exit(1);
+	}
+	if( uringBufInit( &w->ring, RECVBUFS, RECVBUFSIZE ) == -1 ){
+		perror( "io_uring provided buffers" );
+		exit(1);
+	}
+
+	uringAccept( w, 0 );
+	if( w->localfd != -1 )
+		uringAccept( w, 1 );
+	uringWatch( w );
+	wheelInit( &w->wheel, wheelTicks( statsNow() ) );
+
+	while(1) {  // this worker's event loop
+
+		// submit everything we've queued up & wait for something to happen
+		// (while any timers are armed, keys may expire or we're draining, for
+		// no more than a tick; while anyone's waiting on notifications, not
+		// at all)
+		if( ( w->notified != NULL ? uringEnter( &w->ring, 0 ) :
+		 w->wheel.armed || kvstore.numExpiring || draining ?
+		 uringWait( &w->ring, (uint64_t)WHEELTICK * 1000000 ) :
+		 uringEnter( &w->ring, 1 ) ) == -1 ){
+			perror( "io_uring_enter" );
+			exit(1);
+		}
+
+		// handle everything that has happened
+		while( (cqe = uringCqe( &w->ring )) != NULL ){
+
+			c = (struct conn*)( cqe->user_data & ~(unsigned long)OP_MASK );
+
+			switch( cqe->user_data & OP_MASK ){
+				case OP_ACCEPT:
+					uringAccepted( w, cqe );
+					break;
+				case OP_RECV:
+					uringRecvd( c, cqe );
+					break;
+				case OP_SEND:
+					uringSent( c, cqe );
+					break;
+				case OP_CANCEL:
+					uringDone( c );
+					break;
+				case OP_STOP:
+					// (the accept() it cancelled completes on its own)
+					break;
+				case OP_WAKE:
+					// (deliver() takes what's in the inbox, below)
+					if( !( cqe->flags & IORING_CQE_F_MORE ) )
+						uringWatch( w );
+					inboxClear( &pubsub.inboxes[ w->id ] );
+					break;
+			}
+
+			uringSeen( &w->ring );
+
+		}
+
+		// submit whatever was waiting on the log
+		releaseHeld( w, uringFlush, uringClose );
+
+		// & whatever changed that our subscribers wanted to hear about
+		deliver( w, uringFlush, uringClose );
+
+		// start closing every connection that has timed out
+		wheelAdvance( &w->wheel, wheelTicks( statsNow() ), uringExpire );
+
+		// & clear out some expired keys
+		sweepKeys( w );
+
+		// & if we've handed over to a new server, stop accepting & start
+		// closing every client that's finished with us
+		if( __atomic_load_n( &draining, __ATOMIC_RELAXED ) ){
+			if( w->sockfd != -1 )
+				uringStopAccepting( w );
+			drainConns( w, uringClose );
+		}
+
+	}
+
+	return NULL;
+
+}
+
+#endif
+
+/*******************************************************************************
+* Name:    printWorkers
+* Purpose: Reports how many connections each worker is holding & has accepted,
+*          its buffer pool's statistics, & how much CPU time each GB sent has
+*          cost
+* Input:   workers    - array of our workers
+*          numWorkers - number of elements in workers
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void printWorkers( struct worker* workers, int numWorkers ){
+
+	// VARIABLE DEFINITIONS
+	unsigned long open, accepted, idle, stalled, rejected, paused, expired;
+	unsigned long notifications, slowSubs;
+	unsigned long totalOpen = 0, totalAccepted = 0;
+	unsigned long totalIdle = 0, totalStalled = 0;
+	unsigned long totalRejected = 0, totalPaused = 0, totalExpired = 0;
+	unsigned long totalNotifications = 0, totalSlowSubs = 0;
+	uint64_t sweepNs, sweepMax, totalSweepNs = 0, totalSweepMax = 0;
+	unsigned long long totalOut = 0;
+	struct rusage usage;
+	double cpu, gb;
+	char name[32];
+
+	for( int i = 0; i < numWorkers; i++ ){
+
+		open = __atomic_load_n( &workers[i].open, __ATOMIC_RELAXED );
+		accepted = __atomic_load_n( &workers[i].accepted, __ATOMIC_RELAXED );
+		idle = __atomic_load_n( &workers[i].reapedIdle, __ATOMIC_RELAXED );
+		stalled = __atomic_load_n( &workers[i].reapedRead, __ATOMIC_RELAXED );
+		rejected = __atomic_load_n( &workers[i].rejected, __ATOMIC_RELAXED );
+		paused = __atomic_load_n( &workers[i].paused, __ATOMIC_RELAXED );
+		expired = __atomic_load_n( &workers[i].expired, __ATOMIC_RELAXED );
+		sweepNs = __atomic_load_n( &workers[i].sweepNs, __ATOMIC_RELAXED );
+		sweepMax = __atomic_load_n( &workers[i].sweepMax, __ATOMIC_RELAXED );
+		notifications = __atomic_load_n( &workers[i].notifications,
+		 __ATOMIC_RELAXED );
+		slowSubs = __atomic_load_n( &workers[i].slowSubs, __ATOMIC_RELAXED );
+
+		printf( "server: worker %d (cpu %d): %lu open, %lu accepted, "
+		 "%lu reaped idle, %lu reaped mid-command\n", workers[i].id,
+		 workers[i].cpu, open, accepted, idle, stalled );
+		printf( "server: worker %d: %lu turned away busy, %lu reads paused\n",
+		 workers[i].id, rejected, paused );
+		printf( "server: worker %d: %lu keys expired by sweeps taking %.3f ms "
+		 "(longest %.3f ms)\n", workers[i].id, expired, sweepNs / 1e6,
+		 sweepMax / 1e6 );
+		printf( "server: worker %d: %lu notifications queued, %lu slow "
+		 "subscribers closed\n", workers[i].id, notifications, slowSubs );
+
+		snprintf( name, sizeof(name), "worker %d", workers[i].id );
+		poolPrint( &workers[i].pool, name );
+
+		totalOpen += open;
+		totalAccepted += accepted;
+		totalIdle += idle;
+		totalStalled += stalled;
+		totalRejected += rejected;
+		totalPaused += paused;
+		totalExpired += expired;
+		totalSweepNs += sweepNs;
+		totalNotifications += notifications;
+		totalSlowSubs += slowSubs;
+		if( sweepMax > totalSweepMax )
+			totalSweepMax = sweepMax;
+		totalOut += __atomic_load_n( &workers[i].bytesOut, __ATOMIC_RELAXED );
+
+	}
+
+	printf( "server: total: %lu open, %lu accepted, %lu reaped idle, "
+	 "%lu reaped mid-command\n", totalOpen, totalAccepted, totalIdle,
+	 totalStalled );
+	printf( "server: total: %lu turned away busy, %lu reads paused\n",
+	 totalRejected, totalPaused );
+	printf( "server: total: %lu keys expired by sweeps taking %.3f ms "
+	 "(longest %.3f ms)\n", totalExpired, totalSweepNs / 1e6,
+	 totalSweepMax / 1e6 );
+	printf( "server: total: %lu changes published, %lu notifications queued, "
+	 "%lu slow subscribers closed\n",
+	 __atomic_load_n( &pubsub.published, __ATOMIC_RELAXED ),
+	 totalNotifications, totalSlowSubs );
+
+	// what has each GB we've sent cost us in CPU time (user + system)?
+	getrusage( RUSAGE_SELF, &usage );
+	cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+	      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	gb = totalOut / 1e9;
+	printf( "server: sent %.3f GB using %.3f CPU seconds (%.3f per GB)\n",
+	 gb, cpu, gb > 0 ? cpu / gb : 0.0 );
+
+}
+
+/*******************************************************************************
+* Name:    printStats
+* Purpose: Reports every worker's per-command stats, merged (the same table
+*          that STATS returns)
+* Input:   none
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void printStats(){
+
+	// VARIABLE DEFINITIONS
+	char table[4096];
+
+	formatStats( table, sizeof(table) );
+	printf( "server: command stats:\n%s", table );
+
+}
+
+/*******************************************************************************
+* Name:    upgrade
+* Purpose: Hands over to a new server (started from our own command line):
+*          our listeners & store, then every STORE until our clients have all
+*          finished with us (see upgrade.h & repl.h)
+* Input:   args - our command line (as it was before getopt())
+* Output:  1 once the new server has it all (& we have no clients left), or 0
+*          if it failed (& we carry on as we were)
+*******************************************************************************/
+int upgrade( char** args ){
+
+	// VARIABLE DEFINITIONS
+	struct handoff h;
+	int fds[MAXHANDOFF];
+	char path[PATH_MAX];
+	struct replica* rp = NULL;
+	uint64_t start = statsNow(), deadline;
+	int fd, status, caughtUp = 0, alive;
+	pid_t pid;
+
+	if( __atomic_load_n( &takingOver, __ATOMIC_RELAXED ) ){
+		fprintf( stderr, "server: still taking over from the last server; "
+		 "not upgrading yet\n" );
+		return 0;
+	}
+
+	if( numWorkers + 2 > MAXHANDOFF ){
+		fprintf( stderr, "server: too many listeners to hand over (at most "
+		 "%d)\n", MAXHANDOFF );
+		return 0;
+	}
+
+	// (our log stays at this generation from here on; the new server's
+	// starts at the next)
+	h.gen = dataDir != NULL ? persistFreeze( &plog, 1 ) + 1 : 0;
+
+	h.numFds = 0;
+	h.flags = 0;
+	for( int i = 0; i < numWorkers; i++ )
+		fds[ h.numFds++ ] = workers[i].sockfd;
+	if( localfd != -1 ){
+		fds[ h.numFds++ ] = localfd;
+		h.flags |= HANDOFF_LOCAL;
+	}
+	if( repl.sockfd != -1 ){
+		fds[ h.numFds++ ] = repl.sockfd;
+		h.flags |= HANDOFF_REPL;
+	}
+
+	printf( "server: upgrading to a new %s\n", args[0] );
+
+	pid = upgradeSpawn( args, &fd );
+	alive = pid != -1;
+	if( alive && upgradeSend( fd, &h, fds ) == 0 )
+		rp = replHandoff( &repl, fd );
+	if( alive && rp == NULL )
+		close( fd );
+
+	// wait for it to load the store (it takes clients from then on)
+	while( rp != NULL && (caughtUp = replCaughtUp( rp, 0 )) == 0 ){
+		if( waitpid( pid, &status, WNOHANG ) == pid ){
+			alive = 0;
+			break;
+		}
+		usleep( 10000 );
+	}
+
+	if( caughtUp != 1 ){
+
+		fprintf( stderr, "server: the new server failed; carrying on\n" );
+
+		if( rp != NULL )
+			replFree( rp );
+		if( alive ){
+			kill( pid, SIGKILL );
+			waitpid( pid, NULL, 0 );
+		}
+
+		// (we'll log to that generation ourselves one day)
+		if( dataDir != NULL ){
+			logPath( &plog, path, "log.%llu", h.gen );
+			unlink( path );
+			persistFreeze( &plog, 0 );
+		}
+
+		return 0;
+
+	}
+
+	printf( "server: the new server (pid %d) has the store after %.2f seconds; "
+	 "closing our clients as they finish\n", (int)pid,
+	 ( statsNow() - start ) / 1e9 );
+
+	// it has our listeners; stop accepting on them & close every client once
+	// it's finished with us (or after -g seconds, whether it has or not)
+	replStop( &repl );
+	__atomic_store_n( &draining, 1, __ATOMIC_RELAXED );
+	for( int i = 0; i < numWorkers; i++ )
+		inboxWake( &pubsub.inboxes[i] );
+
+	deadline = statsNow() + (uint64_t)drainSecs * 1000000000;
+	while( __atomic_load_n( &openConns, __ATOMIC_RELAXED ) > 0 ){
+
+		// (a second to close those between commands, then the rest)
+		if( draining < 3 && statsNow() >= deadline ){
+			printf( "server: closing the %lu clients still open%s\n",
+			 __atomic_load_n( &openConns, __ATOMIC_RELAXED ),
+			 draining == 1 ? " once they're between commands" : "" );
+			__atomic_store_n( &draining, draining + 1, __ATOMIC_RELAXED );
+			for( int i = 0; i < numWorkers; i++ )
+				inboxWake( &pubsub.inboxes[i] );
+			deadline += 1000000000;
+		}
+
+		usleep( 10000 );
+
+	}
+
+	// & for the new server to have every STORE they made
+	deadline = statsNow() + (uint64_t)REPLTIMEOUT * 1000000000;
+	while( (caughtUp = replCaughtUp( rp, 1 )) == 0 && statsNow() < deadline )
+		usleep( 10000 );
+	if( caughtUp != 1 )
+		fprintf( stderr, "server: the new server may have missed our last "
+		 "STOREs\n" );
+
+	printf( "server: handed over to the new server in %.2f seconds\n",
+	 ( statsNow() - start ) / 1e9 );
+
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    takeOver
+* Purpose: The body of a new server's thread that loads every STORE the old
+*          server passes on as its clients finish, & then takes on what only
+*          one of us may do: snapshots, & following our primary (if we're a
+*          replica)
+* Input:   arg - our end of the socketpair (an int, cast to a pointer)
+* Output:  NULL
+*******************************************************************************/
+void* takeOver( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	int fd = (int)(intptr_t)arg;
+
+	// (the connection ends when the old server exits)
+	replLoad( &repl, fd, "the old server", 0 );
+	close( fd );
+
+	printf( "server: the old server has gone; taking over\n" );
+
+	if( dataDir != NULL )
+		persistFreeze( &plog, 0 );
+
+	if( repl.host != NULL )
+		replStart( &repl, repl.host, repl.port );
+
+	__atomic_store_n( &takingOver, 0, __ATOMIC_RELAXED );
+	return NULL;
+
+}
+
+/*******************************************************************************
+* Name:    usage
+* Purpose: Prints our command line options & exits
+* Input:   name - the name this program was run as (argv[0])
+* Output:  none (exit()s the program)
+*******************************************************************************/
+void usage( char* name ){
+
+	fprintf( stderr, "usage: %s [-w workers] [-p] [-z bytes] [-u] [-i secs] "
+	 "[-t secs] [-c conns]\n       [-o bytes] [-d dir] [-f policy] [-s secs] "
+	 "[-m mode]\n       [-e usecs] [-M bytes] [-l samples] [-P port] [-R port] "
+	 "[-r host:port]\n       [-g secs] [-U path]\n", name );
+	fprintf( stderr, "  -w  number of worker threads (default: online CPUs)\n" );
+	fprintf( stderr, "  -p  pin each worker thread to its own CPU\n" );
+	fprintf( stderr, "  -z  STORE values this big are sent with sendfile() (default:"
+	 " %d; 0 = never)\n", BLOBSIZE );
+	fprintf( stderr, "  -u  use io_uring instead of epoll\n" );
+	fprintf( stderr, "  -i  close connections idle this long (default: %d; "
+	 "0 = never)\n", IDLETIMEOUT );
+	fprintf( stderr, "  -t  close connections stalled part way through a command "
+	 "this long\n      (default: %d; 0 = never)\n", READTIMEOUT );
+	fprintf( stderr, "  -c  turn away clients past this many connections "
+	 "(default: %d; 0 = no\n      limit)\n", MAXCONNS );
+	fprintf( stderr, "  -o  stop reading from a client (or close a subscriber) with "
+	 "this many bytes\n      of responses unsent (default: %d; 0 = no limit)\n",
+	 MAXOUTPUT );
+	fprintf( stderr, "  -d  keep the store on disk in this directory (default: "
+	 "don't)\n" );
+	fprintf( stderr, "  -f  fsync() the log: always, everysec or no (default: "
+	 "everysec)\n" );
+	fprintf( stderr, "  -s  seconds between snapshots (default: %d; 0 = only when "
+	 "the log is big)\n", SNAPSECS );
+	fprintf( stderr, "  -m  write snapshots from a fork()ed child (fork) or a "
+	 "thread (walk)\n      (default: fork)\n" );
+	fprintf( stderr, "  -e  microseconds per tick each worker may spend expiring "
+	 "keys (default: %d)\n", SWEEPTIME );
+	fprintf( stderr, "  -M  evict keys once the store is this many bytes "
+	 "(default: 0 = never)\n" );
+	fprintf( stderr, "  -l  keys sampled to pick each one to evict (default: "
+	 "%d)\n", EVICTSAMPLES );
+	fprintf( stderr, "  -P  port to take clients on (default: %s)\n", PORT );
+	fprintf( stderr, "  -R  be a primary, taking replicas on this port (default: "
+	 "don't)\n" );
+	fprintf( stderr, "  -r  be a read only replica of the primary at host:port "
+	 "(its -R)\n" );
+	fprintf( stderr, "  -g  seconds our clients get to finish after SIGHUP "
+	 "hands over to a new\n      server (default: %d)\n", DRAINSECS );
+	fprintf( stderr, "  -U  also take clients on a Unix socket at this path "
+	 "(default: don't)\n" );
+	exit(1);
+
+}
+
+/*******************************************************************************
+                                   MAIN BODY                                    
+*******************************************************************************/
+
+int main( int argc, char* argv[] ){
+
+	/***********************
+	* VARIABLE DEFINITIONS *
+	***********************/
+
+	int status; // generic varaible for all function results
+	int opt;
+	int numCpus = sysconf( _SC_NPROCESSORS_ONLN );
+	int pin = 0;
+	int policy = LOG_EVERYSEC;
+	int snapSecs = SNAPSECS;
+	int snapFork = 1;
+	size_t maxMemory = 0;
+	int evictSamples = EVICTSAMPLES;
+	char* replPort = NULL;
+	char* primary = NULL;
+	char* primaryPort = NULL;
+	char* localPath = NULL;
+	char** args;
+	struct handoff handoff;
+	int handoffFds[MAXHANDOFF];
+	int upgradeFd;
+	int numListeners = 0;
+	pthread_t thread;
+	struct epoll_event ev;
+	sigset_t sigs;
+	int sig;
+
+	/********************
+	* COMMAND LINE ARGS *
+	********************/
+
+	numWorkers = numCpus;
+
+	// (getopt() may reorder argv, & we cut -r's host:port in two, so keep it
+	// as it was for the server that replaces us; see upgrade())
+	args = calloc( argc + 1, sizeof(char*) );
+	if( args == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+	for( int i = 0; i < argc; i++ )
+		args[i] = strdup( argv[i] );
+
+	while( (opt = getopt( argc, argv,
+	 "w:pz:ui:t:c:o:d:f:s:m:e:M:l:P:R:r:g:U:" )) != -1 ){
+		switch( opt ){
+			case 'w':
+				numWorkers = atoi( optarg );
+				break;
+			case 'p':
+				pin = 1;
+				break;
+			case 'z':
+				blobSize = strtoul( optarg, NULL, 10 );
+				break;
+			case 'u':
+				useUring = 1;
+				break;
+			case 'i':
+				idleTimeout = atoi( optarg );
+				break;
+			case 't':
+				readTimeout = atoi( optarg );
+				break;
+			case 'c':
+				maxConns = strtoul( optarg, NULL, 10 );
+				break;
+			case 'o':
+				maxOutput = strtoul( optarg, NULL, 10 );
+				break;
+			case 'd':
+				dataDir = optarg;
+				break;
+			case 'f':
+				policy = logPolicy( optarg );
+				break;
+			case 's':
+				snapSecs = atoi( optarg );
+				break;
+			case 'm':
+				snapFork = strcmp( optarg, "fork" ) == 0 ? 1 :
+				 strcmp( optarg, "walk" ) == 0 ? 0 : -1;
+				break;
+			case 'e':
+				sweepTime = strtoull( optarg, NULL, 10 ) * 1000;
+				break;
+			case 'M':
+				maxMemory = strtoul( optarg, NULL, 10 );
+				break;
+			case 'l':
+				evictSamples = atoi( optarg );
+				break;
+			case 'P':
+				listenPort = optarg;
+				break;
+			case 'R':
+				replPort = optarg;
+				break;
+			case 'r':
+				primary = optarg;
+				primaryPort = strrchr( optarg, ':' );
+				if( primaryPort != NULL )
+					*primaryPort++ = '\0';
+				break;
+			case 'g':
+				drainSecs = atoi( optarg );
+				break;
+			case 'U':
+				localPath = optarg;
+				break;
+			default:
+				usage( argv[0] );
+		}
+	}
+
+	if( numWorkers < 1 || idleTimeout < 0 || readTimeout < 0 || policy < 0 ||
+	 snapSecs < 0 || snapFork < 0 || evictSamples < 1 || drainSecs < 0 ||
+	 ( primary != NULL && primaryPort == NULL ) )
+		usage( argv[0] );
+
+#if !URING
+	if( useUring ){
+		fprintf( stderr, "server: built without io_uring (see URING)\n" );
+		exit(1);
+	}
+#endif
+
+	// are we replacing a server that's still running? then take its listeners
+	// (we need a worker for each, or clients would be left in its queue)
+	upgradeFd = upgradeRecv( &handoff, handoffFds );
+	if( upgradeFd != -1 ){
+		numListeners = handoff.numFds - !!( handoff.flags & HANDOFF_REPL ) -
+		 !!( handoff.flags & HANDOFF_LOCAL );
+		if( numWorkers < numListeners ){
+			printf( "server: taking %d workers, one per listener handed "
+			 "over\n", numListeners );
+			numWorkers = numListeners;
+		}
+		__atomic_store_n( &takingOver, 1, __ATOMIC_RELAXED );
+	}
+
+	// pick the fastest TRANSLATE our CPU can do
+	translateInit();
+	if( DEBUG ){
+		printf( "DEBUG: using the %s TRANSLATE\n", translateName );
+	}
+
+	makeFrame( &okFrame, OK );
+	makeFrame( &notOkFrame, NOT_OK );
+	makeFrame( &notFoundFrame, NOT_FOUND );
+	makeFrame( &errorFrame, ERROR );
+	makeFrame( &readyFrame, "Server is ready..." );
+	makeFrame( &busyFrame, BUSY );
+	makeFrame( &conflictFrame, CONFLICT );
+	makeFrame( &readOnlyFrame, READONLY );
+
+	// the key "" is our original, single STORE buffer
+	storeInit( &kvstore );
+	kvstore.maxMemory = maxMemory;
+	kvstore.evictSamples = evictSamples;
+	if( storeSet( &kvstore, "", 0, BUFFER, strlen(BUFFER), 0 ) == -1 ){
+		fprintf( stderr, "server: out of memory\n" );
+		exit(1);
+	}
+
+	// bring back whatever was STOREd before we last stopped (or log to the
+	// generation after the server we're replacing)
+	if( dataDir != NULL )
+		persistInit( &plog, &kvstore, dataDir, policy, snapSecs, snapFork,
+		 blobSize, upgradeFd != -1 ? handoff.gen : 0 );
+
+	// a client that hangs up on us must not kill the whole server with SIGPIPE
+	signal( SIGPIPE, SIG_IGN );
+
+	// we'll be holding every client's socket open in this one process
+	raiseFileLimit();
+
+	// we're a single long-lived process now, so don't let our log sit in a buffer
+	setvbuf( stdout, NULL, _IOLBF, 0 );
+
+	// the main thread handles our signals with sigwait(); block them here (before
+	// any threads exist) so that every worker thread inherits the mask
+	sigemptyset( &sigs );
+	sigaddset( &sigs, SIGINT );
+	sigaddset( &sigs, SIGTERM );
+	sigaddset( &sigs, SIGUSR1 );
+	sigaddset( &sigs, SIGUSR2 );
+	sigaddset( &sigs, SIGHUP );
+	pthread_sigmask( SIG_BLOCK, &sigs, NULL );
+
+	// (the logging threads inherit that mask too)
+	if( dataDir != NULL )
+		persistStart( &plog );
+
+	// (& so do replication's; a primary's hook goes in front of the log's, &
+	// a replica's STOREs from its primary are logged & passed on like any)
+	replInit( &repl, &kvstore, blobSize );
+	if( replPort != NULL )
+		replServe( &repl, upgradeFd != -1 && ( handoff.flags & HANDOFF_REPL ) ?
+		 handoffFds[ handoff.numFds - 1 ] : openListener( replPort ) );
+
+	// (replacing a replica, we refuse STOREs from the start, but only follow
+	// our primary once the old server has gone; see takeOver())
+	if( primary != NULL && upgradeFd == -1 )
+		replStart( &repl, primary, primaryPort );
+	else if( primary != NULL ){
+		repl.host = primary;
+		repl.port = primaryPort;
+	}
+
+	/****************
+	* START WORKERS *
+	****************/
+
+	workers = calloc( numWorkers, sizeof(struct worker) );
+	if( workers == NULL ){
+		perror( "calloc" );
+		exit(1);
+	}
+
+	pubsubInit( &pubsub, numWorkers );
+
+	// (the old server's Unix socket comes straight after its workers')
+	if( localPath != NULL )
+		localfd = upgradeFd != -1 && ( handoff.flags & HANDOFF_LOCAL ) ?
+		 handoffFds[ numListeners ] : openLocalListener( localPath );
+
+	for( int i = 0; i < numWorkers; i++ ){
+
+		workers[i].id = i;
+		workers[i].cpu = pin ? i % numCpus : -1;
+		workers[i].sockfd = i < numListeners ? handoffFds[i] :
+		 openListener( listenPort );
+		workers[i].localfd = localfd;
+
+		workers[i].batch = calloc( 1, sizeof(struct batch) );
+		if( workers[i].batch == NULL ){
+			perror( "calloc" );
+			exit(1);
+		}
+
+		// (an io_uring worker sets up its ring in its own thread)
+		if( useUring )
+			continue;
+
+		workers[i].epfd = epoll_create1( EPOLL_CLOEXEC );
+		if( workers[i].epfd == -1 ){
+			perror( "epoll_create1" );
+			exit(1);
+		}
+
+		// the listeners & the inbox are the only entries in an epoll set
+		// without a struct conn
+		ev.events = EPOLLIN | EPOLLET;
+		ev.data.ptr = NULL;
+		if( epoll_ctl( workers[i].epfd, EPOLL_CTL_ADD, workers[i].sockfd, &ev ) == -1 ){
+			perror( "epoll_ctl" );
+			exit(1);
+		}
+
+		ev.data.ptr = &pubsub.inboxes[i];
+		if( epoll_ctl( workers[i].epfd, EPOLL_CTL_ADD, pubsub.inboxes[i].fd,
+		 &ev ) == -1 ){
+			perror( "epoll_ctl" );
+			exit(1);
+		}
+
+		// (only one worker is woken for each client on the Unix socket)
+		if( localfd != -1 ){
+			ev.events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+			ev.data.ptr = &workers[i].localfd;
+			if( epoll_ctl( workers[i].epfd, EPOLL_CTL_ADD, localfd, &ev ) ==
+			 -1 ){
+				perror( "epoll_ctl" );
+				exit(1);
+			}
+		}
+
+	}
+
+	// load the store from the server we're replacing before we take a single
+	// client (meanwhile, they're still taken by it, or wait in the queue)
+	if( upgradeFd != -1 &&
+	 replLoad( &repl, upgradeFd, "the old server", 1 ) == -1 ){
+		fprintf( stderr, "server: lost the old server before it sent us the "
+		 "store\n" );
+		exit(1);
+	}
+
+	// only start the threads once every listener is bound, so that a bind()
+	// failure can't leave a half-started server behind
+	for( int i = 0; i < numWorkers; i++ ){
+
+		status = pthread_create( &workers[i].thread, NULL,
+#if URING
+		 useUring ? uringLoop :
+#endif
+		 workerLoop, &workers[i] );
+		if( status != 0 ){
+			fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+			exit(1);
+		}
+
+	}
+
+	printf( "server: %d %s workers waiting for connections...\n", numWorkers,
+	 useUring ? "io_uring" : "epoll" );
+
+	// & the rest of what it sends, until it has gone
+	if( upgradeFd != -1 ){
+		status = pthread_create( &thread, NULL, takeOver,
+		 (void*)(intptr_t)upgradeFd );
+		if( status != 0 ){
+			fprintf( stderr, "pthread_create: %s\n", strerror(status) );
+			exit(1);
+		}
+	}
+
+	/**************
+	* SIGNAL LOOP *
+	**************/
+
+	// SIGUSR1 reports on our workers; SIGINT & SIGTERM report & then shut down;
+	// SIGUSR2 takes a snapshot (with -d); SIGHUP hands over to a new server,
+	// & then reports & shuts down (or carries on, if the new server failed)
+	while(1){
+
+		if( sigwait( &sigs, &sig ) != 0 )
+			continue;
+
+		if( sig == SIGUSR2 ){
+			if( dataDir != NULL )
+				__atomic_store_n( &plog.snapNow, 1, __ATOMIC_RELAXED );
+			continue;
+		}
+
+		if( sig == SIGHUP && !upgrade( args ) )
+			continue;
+
+		printWorkers( workers, numWorkers );
+		storePrint( &kvstore );
+		if( dataDir != NULL )
+			persistPrint( &plog );
+		replPrint( &repl );
+		printStats();
+
+		if( sig != SIGUSR1 )
+			break;
+
+	}
+
+	/***********
+	* CLEANUP! *
+	***********/
+
+	// everything STOREd so far goes to disk before we go
+	if( dataDir != NULL )
+		persistStop( &plog );
+
+	// the workers never return, so just take the whole process down with us
 	return 0;
 
 }
@@ -0,0 +1,568 @@
+/*******************************************************************************
+* File:       shm.h
+* Version:    0.1
+* Purpose:    A shared memory transport for clients on the server's own host:
+*             a pair of single producer, single consumer byte rings in one
+*             memfd, with eventfds to wake whichever end is asleep
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      A client that has connected over the server's Unix socket may
+              send SHM (& nothing after it). The server makes a struct shmarea
+              in a memfd, & two eventfds, & sends all three back with its OK in
+              one SCM_RIGHTS message (shmSend() & shmRecv()). From then on the
+              client writes its frames into the request ring & reads the
+              server's from the response ring, exactly as they'd have gone
+              over the socket; the socket is only kept open so that each end
+              sees when the other has gone.
+
+              Each ring has one writer, which alone moves its tail, & one
+              reader, which alone moves its head. Both only ever count up, & a
+              release store of one paired with an acquire load by the other is
+              all it takes to pass bytes across: no locks & no system calls.
+              Each end keeps its own copy of the index it moves, & the server
+              checks the other end's against it, so that a client scribbling
+              on the area can only hurt itself.
+
+              An end with nothing to read (or no room to write) says so in the
+              ring's readerWaiting (or writerWaiting), checks once more, & then
+              sleeps on its eventfd; the other end wakes it after writing (or
+              reading) if, & only if, it says it's waiting. A busy server &
+              client therefore pass requests & responses without waking anyone.
+              A client may also spin a little first (shmWait()), which is
+              cheaper still when it has a CPU to itself.
+*******************************************************************************/
+
+#ifndef SHM_H
+#define SHM_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SHMRINGSIZE (256*1024) // bytes in each ring (a power of 2)
+#define SHMSPIN 20000          // times a client checks before sleeping (when
+                               // there's more than one CPU)
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "common.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one direction's indices, each on its own cache line so that the reader &
+// writer don't keep taking the line from each other
+struct shmring {
+	uint64_t head;          // bytes read, ever (the reader's; atomic)
+	uint32_t readerWaiting; // 1 while the reader sleeps for bytes (atomic)
+	char     pad1[52];
+	uint64_t tail;          // bytes written, ever (the writer's; atomic)
+	uint32_t writerWaiting; // 1 while the writer sleeps for room (atomic)
+	char     pad2[52];
+};
+
+// everything in the memfd
+struct shmarea {
+	struct shmring req;        // client to server
+	struct shmring resp;       // server to client
+	char reqData[SHMRINGSIZE];
+	char respData[SHMRINGSIZE];
+};
+
+// one end's view of the area
+struct shm {
+	struct shmarea* area;  // (NULL if this end isn't on shared memory)
+	struct shmring* in;    // the ring we read...
+	char*    inData;
+	uint64_t inPos;        // ...& our own copy of its head
+	struct shmring* out;   // the ring we write...
+	char*    outData;
+	uint64_t outPos;       // ...& our own copy of its tail
+	int      waitFd;       // the eventfd the other end wakes us with
+	int      wakeFd;       // ...& the one we wake it with
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    shmMap
+* Purpose: Maps an area's memfd & points an end at its rings
+* Input:   s      - the end
+*          fd     - the memfd
+*          server - 1 for the server's end, 0 for the client's
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+static inline int shmMap( struct shm* s, int fd, int server ){
+
+	s->area = mmap( NULL, sizeof(struct shmarea), PROT_READ | PROT_WRITE,
+	 MAP_SHARED, fd, 0 );
+	if( s->area == MAP_FAILED ){
+		perror( "mmap" );
+		s->area = NULL;
+		return -1;
+	}
+
+	s->in = server ? &s->area->req : &s->area->resp;
+	s->inData = server ? s->area->reqData : s->area->respData;
+	s->inPos = __atomic_load_n( &s->in->head, __ATOMIC_RELAXED );
+	s->out = server ? &s->area->resp : &s->area->req;
+	s->outData = server ? s->area->respData : s->area->reqData;
+	s->outPos = __atomic_load_n( &s->out->tail, __ATOMIC_RELAXED );
+
+	return 0;
+
+}
+
+// (only the server makes areas, & memfd_create() needs _GNU_SOURCE, which
+// its clients needn't define)
+#ifdef _GNU_SOURCE
+
+/*******************************************************************************
+* Name:    shmCreate
+* Purpose: Makes a new area for a client (the server's end)
+* Input:   s   - set to the server's end
+*          fds - set to the memfd, the eventfd that wakes the server & the one
+*                that wakes the client (to send to the client; the caller
+*                closes the memfd once it has)
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+static inline int shmCreate( struct shm* s, int* fds ){
+
+	memset( s, 0, sizeof(*s) );
+
+	fds[0] = memfd_create( "kvshm", MFD_CLOEXEC );
+	if( fds[0] == -1 ){
+		perror( "memfd_create" );
+		return -1;
+	}
+
+	fds[1] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	fds[2] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+	// (a new memfd reads as zeros, which is every index at the start)
+	if( fds[1] == -1 || fds[2] == -1 ||
+	 ftruncate( fds[0], sizeof(struct shmarea) ) == -1 ||
+	 shmMap( s, fds[0], 1 ) == -1 ){
+		perror( "shmCreate" );
+		for( int i = 0; i < 3; i++ )
+			if( fds[i] != -1 )
+				close( fds[i] );
+		return -1;
+	}
+
+	s->waitFd = fds[1];
+	s->wakeFd = fds[2];
+	return 0;
+
+}
+
+#endif
+
+/*******************************************************************************
+* Name:    shmAttach
+* Purpose: Maps the area the server sent us (the client's end)
+* Input:   s   - set to the client's end
+*          fds - what the server sent (see shmCreate()); the memfd is closed
+* Output:  0 on success, -1 on failure (every fd is closed)
+*******************************************************************************/
+static inline int shmAttach( struct shm* s, int* fds ){
+
+	// VARIABLE DEFINITIONS
+	struct stat st;
+	int status = -1;
+
+	memset( s, 0, sizeof(*s) );
+
+	if( fstat( fds[0], &st ) == 0 && st.st_size == sizeof(struct shmarea) )
+		status = shmMap( s, fds[0], 0 );
+	close( fds[0] );
+
+	if( status == -1 ){
+		close( fds[1] );
+		close( fds[2] );
+		return -1;
+	}
+
+	s->waitFd = fds[2];
+	s->wakeFd = fds[1];
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    shmFree
+* Purpose: Unmaps an end's area & closes its eventfds
+* Input:   s - the end
+* Output:  none
+*******************************************************************************/
+static inline void shmFree( struct shm* s ){
+
+	if( s->area == NULL )
+		return;
+
+	munmap( s->area, sizeof(struct shmarea) );
+	close( s->waitFd );
+	close( s->wakeFd );
+	s->area = NULL;
+
+}
+
+/*******************************************************************************
+* Name:    shmSend
+* Purpose: Sends a message over a Unix socket with an area's descriptors
+* Input:   sock - the socket
+*          buf  - the message (all of it goes, or none)
+*          len  - the length of buf
+*          fds  - the three descriptors (see shmCreate())
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+static inline int shmSend( int sock, char* buf, size_t len, int* fds ){
+
+	// VARIABLE DEFINITIONS
+	char control[ CMSG_SPACE( 3 * sizeof(int) ) ];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	ssize_t numbytes;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+
+	memset( &msg, 0, sizeof(msg) );
+	memset( control, 0, sizeof(control) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR( &msg );
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN( 3 * sizeof(int) );
+	memcpy( CMSG_DATA( cmsg ), fds, 3 * sizeof(int) );
+
+	do {
+		numbytes = sendmsg( sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT );
+	} while( numbytes == -1 && errno == EINTR );
+
+	// (it's sent before anything else, so the socket's buffer has room)
+	if( numbytes != (ssize_t)len ){
+		perror( "sendmsg shm" );
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    shmRecv
+* Purpose: Recieves the server's response to SHM (& the area's descriptors,
+*          if it has sent them)
+* Input:   sock - the socket
+*          r    - the ring to recieve the response into
+*          fds  - set to the three descriptors (or -1s)
+* Output:  the number of bytes recieved, 0 if the server hung up, or -1 on
+*          failure
+*******************************************************************************/
+static inline ssize_t shmRecv( int sock, struct ring* r, int* fds ){
+
+	// VARIABLE DEFINITIONS
+	char control[ CMSG_SPACE( 3 * sizeof(int) ) ];
+	char buf[256];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	ssize_t numbytes;
+
+	fds[0] = fds[1] = fds[2] = -1;
+
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do {
+		numbytes = recvmsg( sock, &msg, MSG_CMSG_CLOEXEC );
+	} while( numbytes == -1 && errno == EINTR );
+
+	if( numbytes <= 0 )
+		return numbytes;
+
+	cmsg = CMSG_FIRSTHDR( &msg );
+	if( cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+	 cmsg->cmsg_type == SCM_RIGHTS &&
+	 cmsg->cmsg_len == CMSG_LEN( 3 * sizeof(int) ) )
+		memcpy( fds, CMSG_DATA( cmsg ), 3 * sizeof(int) );
+
+	if( ringAppend( r, buf, numbytes ) == -1 )
+		return -1;
+
+	return numbytes;
+
+}
+
+/*******************************************************************************
+* Name:    shmWake
+* Purpose: Wakes the other end if it's asleep waiting on us: for the bytes
+*          we've written, or the room we've made by reading. Call it once
+*          after each batch of shmRead()s & shmWrite()s.
+* Input:   s - our end
+* Output:  none
+*******************************************************************************/
+static inline void shmWake( struct shm* s ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t one = 1;
+
+	// (our indices must be visible before we look at its flags; its flags are
+	// set before it looks at our indices one last time, so one of us sees
+	// the other)
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+	if( ( __atomic_load_n( &s->out->readerWaiting, __ATOMIC_RELAXED ) &&
+	 __atomic_exchange_n( &s->out->readerWaiting, 0, __ATOMIC_RELAXED ) ) ||
+	 ( __atomic_load_n( &s->in->writerWaiting, __ATOMIC_RELAXED ) &&
+	 __atomic_exchange_n( &s->in->writerWaiting, 0, __ATOMIC_RELAXED ) ) ){
+		if( write( s->wakeFd, &one, sizeof(one) ) == -1 && errno != EAGAIN )
+			perror( "write eventfd" );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    shmUsed
+* Purpose: Tells how many bytes are waiting to be read from our end's ring
+* Input:   s - our end
+* Output:  the number of bytes, or -1 if the other end has broken the ring
+*******************************************************************************/
+static inline ssize_t shmUsed( struct shm* s ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t used = __atomic_load_n( &s->in->tail, __ATOMIC_ACQUIRE ) -
+	 s->inPos;
+
+	return used > SHMRINGSIZE ? -1 : (ssize_t)used;
+
+}
+
+/*******************************************************************************
+* Name:    shmRoom
+* Purpose: Tells how many bytes may be written to our end's ring
+* Input:   s - our end
+* Output:  the number of bytes, or -1 if the other end has broken the ring
+*******************************************************************************/
+static inline ssize_t shmRoom( struct shm* s ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t used = s->outPos -
+	 __atomic_load_n( &s->out->head, __ATOMIC_ACQUIRE );
+
+	return used > SHMRINGSIZE ? -1 : (ssize_t)( SHMRINGSIZE - used );
+
+}
+
+/*******************************************************************************
+* Name:    shmRead
+* Purpose: Moves everything waiting in our end's ring onto the end of a ring
+*          of our own. If there's nothing, says that we're waiting (so that
+*          the other end wakes us once there is).
+* Input:   s - our end
+*          r - the ring to append to
+* Output:  the number of bytes moved, or -1 (errno EAGAIN if there were none,
+*          EPROTO if the other end has broken the ring, ENOMEM if we ran out
+*          of memory)
+*******************************************************************************/
+static inline ssize_t shmRead( struct shm* s, struct ring* r ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t used = shmUsed( s );
+	size_t off, first;
+
+	// is it empty? then say we're waiting, & look one last time
+	if( used == 0 ){
+		__atomic_store_n( &s->in->readerWaiting, 1, __ATOMIC_RELAXED );
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );
+		used = shmUsed( s );
+		if( used == 0 ){
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+
+	if( used == -1 ){
+		errno = EPROTO;
+		return -1;
+	}
+
+	// (the other end only wakes us once per wait; don't leave it thinking
+	// we're still asleep)
+	if( __atomic_load_n( &s->in->readerWaiting, __ATOMIC_RELAXED ) )
+		__atomic_store_n( &s->in->readerWaiting, 0, __ATOMIC_RELAXED );
+
+	// (it may wrap around the end of the ring)
+	off = s->inPos & ( SHMRINGSIZE - 1 );
+	first = SHMRINGSIZE - off < (size_t)used ? SHMRINGSIZE - off :
+	 (size_t)used;
+	if( ringAppend( r, s->inData + off, first ) == -1 ||
+	 ringAppend( r, s->inData, used - first ) == -1 ){
+		errno = ENOMEM;
+		return -1;
+	}
+
+	s->inPos += used;
+	__atomic_store_n( &s->in->head, s->inPos, __ATOMIC_RELEASE );
+
+	return used;
+
+}
+
+/*******************************************************************************
+* Name:    shmWrite
+* Purpose: Copies as much as there's room for into our end's ring. If there's
+*          no room at all, says that we're waiting (so that the other end
+*          wakes us once there is).
+* Input:   s   - our end
+*          buf - the bytes to write
+*          len - the number of bytes
+* Output:  the number of bytes written (0 if there was no room), or -1 if the
+*          other end has broken the ring
+*******************************************************************************/
+static inline ssize_t shmWrite( struct shm* s, char* buf, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t room = shmRoom( s );
+	size_t off, first;
+
+	if( len == 0 )
+		return 0;
+
+	// is it full? then say we're waiting, & look one last time
+	if( room == 0 ){
+		__atomic_store_n( &s->out->writerWaiting, 1, __ATOMIC_RELAXED );
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );
+		room = shmRoom( s );
+		if( room == 0 )
+			return 0;
+	}
+
+	if( room == -1 )
+		return -1;
+
+	if( __atomic_load_n( &s->out->writerWaiting, __ATOMIC_RELAXED ) )
+		__atomic_store_n( &s->out->writerWaiting, 0, __ATOMIC_RELAXED );
+
+	if( len > (size_t)room )
+		len = room;
+
+	off = s->outPos & ( SHMRINGSIZE - 1 );
+	first = SHMRINGSIZE - off < len ? SHMRINGSIZE - off : len;
+	memcpy( s->outData + off, buf, first );
+	memcpy( s->outData, buf + first, len - first );
+
+	s->outPos += len;
+	__atomic_store_n( &s->out->tail, s->outPos, __ATOMIC_RELEASE );
+
+	return len;
+
+}
+
+/*******************************************************************************
+* Name:    shmWait
+* Purpose: Waits until there's something to read from our end's ring (or,
+*          if we want it, room to write to it), or the other end hangs up
+* Input:   s        - our end
+*          sock     - the socket to the other end
+*          wantRoom - 1 to wait for room as well
+*          spin     - times to check before sleeping
+* Output:  0 once there is, -1 if the other end has gone (or broken the ring)
+*******************************************************************************/
+static inline int shmWait( struct shm* s, int sock, int wantRoom, int spin ){
+
+	// VARIABLE DEFINITIONS
+	struct pollfd pfds[2];
+	uint64_t count;
+	ssize_t used, room;
+
+	for( int i = 0; ; i++ ){
+
+		used = shmUsed( s );
+		room = wantRoom ? shmRoom( s ) : 0;
+		if( used == -1 || room == -1 )
+			return -1;
+		if( used > 0 || room > 0 )
+			return 0;
+
+		if( i < spin ){
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+			continue;
+		}
+
+		// say what we're waiting for, & look one last time
+		__atomic_store_n( &s->in->readerWaiting, 1, __ATOMIC_RELAXED );
+		if( wantRoom )
+			__atomic_store_n( &s->out->writerWaiting, 1, __ATOMIC_RELAXED );
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );
+		if( shmUsed( s ) != 0 || ( wantRoom && shmRoom( s ) != 0 ) )
+			continue;
+
+		pfds[0].fd = s->waitFd;
+		pfds[0].events = POLLIN;
+		pfds[1].fd = sock;
+		pfds[1].events = POLLIN;
+
+		if( poll( pfds, 2, -1 ) == -1 && errno != EINTR )
+			return -1;
+
+		// (the socket only ever becomes readable when the other end has gone)
+		if( pfds[1].revents )
+			return -1;
+
+		if( pfds[0].revents & POLLIN )
+			if( read( s->waitFd, &count, sizeof(count) ) == -1 &&
+			 errno != EAGAIN )
+				return -1;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    shmEmpty
+* Purpose: Tells whether the other end has written nothing we haven't read
+* Input:   s - our end
+* Output:  1 if it has, 0 if not
+*******************************************************************************/
+static inline int shmEmpty( struct shm* s ){
+	return shmUsed( s ) == 0;
+}
+
+#endif
@@ -0,0 +1,453 @@
+/*******************************************************************************
+* File:       slab.h
+* Version:    0.2
+* Purpose:    The store's allocator for its entries: size classed slabs shared
+*             by every thread, with no per-chunk header, & a small cache of
+*             each class's chunks per thread
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      pool.h's pools are per worker & put a 16 byte header on every
+              block, which is fine for buffers but not for millions of tiny
+              entries that any thread may free. So the store has its own.
+
+              Chunks come in size classes from SLABMIN to SLABMAX bytes: 8
+              bytes apart while that's less than SLABGROWTH apart, & then
+              SLABGROWTH apart, so no chunk wastes more than an eighth of
+              itself (or 7 bytes). Each class carves SLABPAGE byte pages into
+              chunks as they're needed (a bump pointer, so pages only cost
+              memory once they're used) & keeps freed chunks on a free list,
+              behind its own lock.
+
+              So that workers don't all queue on that lock, each thread keeps
+              up to SLABCACHE chunks of each class to itself, & only takes the
+              lock to fetch (or give back) SLABCACHE/2 of them at a time; most
+              allocs & frees touch nothing but the thread's own cache. A thread
+              that exits gives its cache back.
+
+              A chunk carries nothing but what it holds: the caller says how
+              big it is when freeing it, as the store can always work that out
+              from the entry. Pages are never given back to the system; the
+              footprint is the most ever needed at once.
+*******************************************************************************/
+
+#ifndef SLAB_H
+#define SLAB_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define SLABPAGE (1024*1024) // size of the pages chunks are carved from
+#define SLABMIN 32           // smallest chunk (a multiple of 8)
+#define SLABMAX 1024         // largest chunk; anything bigger is malloc()'d
+#define SLABGROWTH 1.125     // how much bigger each class is than the last
+#define SLABCLASSES 48       // room for every class from SLABMIN to SLABMAX
+#define SLABCACHE 32         // most chunks of a class each thread keeps
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one size class. aligned to a cache line so that threads allocating from
+// neighbouring classes don't fight over the same line.
+struct slabclass {
+	pthread_mutex_t lock;
+	size_t size;   // size of each chunk
+	void*  free;   // freed chunks (each starts with a pointer to the next)
+	char*  cur;    // the next never used chunk of our newest page
+	char*  end;    // the end of our newest page
+	size_t inUse;  // chunks handed out (to threads' caches, or from them
+	               // to callers) & not yet given back (atomic)
+	size_t pages;  // pages we've carved up (atomic)
+} __attribute__(( aligned(64) ));
+
+// one thread's chunks of each class
+struct slabcache {
+	void*  free[SLABCLASSES];  // the chunks (a list, as in struct slabclass)
+	size_t count[SLABCLASSES]; // ...& how many (atomic, for slabPrint())
+	struct slabs* sl;          // the slabs they're from
+	struct slabcache* next;    // the next thread's
+};
+
+// every size class
+struct slabs {
+	struct slabclass classes[SLABCLASSES];
+	int     numClasses;
+	uint8_t classOf[ SLABMAX/8 + 1 ]; // the class for each size, in 8 bytes
+	size_t  large;      // chunks too big for any class, malloc()'d (atomic)
+	pthread_key_t   key;        // each thread's struct slabcache
+	pthread_mutex_t cachesLock; // guards caches
+	struct slabcache* caches;   // every thread's
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    slabGiveBack
+* Purpose: Moves chunks from a thread's cache back to their class
+* Input:   cache - the thread's cache
+*          cls   - the class
+*          n     - how many (no more than it has)
+* Output:  none
+*******************************************************************************/
+void slabGiveBack( struct slabcache* cache, int cls, size_t n ){
+
+	// VARIABLE DEFINITIONS
+	struct slabclass* c = &cache->sl->classes[cls];
+	void* chunk;
+
+	pthread_mutex_lock( &c->lock );
+
+	for( size_t i = 0; i < n; i++ ){
+		chunk = cache->free[cls];
+		cache->free[cls] = *(void**)chunk;
+		*(void**)chunk = c->free;
+		c->free = chunk;
+	}
+	__atomic_fetch_sub( &c->inUse, n, __ATOMIC_RELAXED );
+
+	pthread_mutex_unlock( &c->lock );
+
+	__atomic_store_n( &cache->count[cls], cache->count[cls] - n,
+	 __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    slabCacheExit
+* Purpose: Gives an exiting thread's cache back (its key's destructor)
+* Input:   arg - the thread's struct slabcache
+* Output:  none
+*******************************************************************************/
+void slabCacheExit( void* arg ){
+
+	// VARIABLE DEFINITIONS
+	struct slabcache* cache = arg;
+	struct slabs* sl = cache->sl;
+
+	for( int cls = 0; cls < sl->numClasses; cls++ )
+		if( cache->count[cls] > 0 )
+			slabGiveBack( cache, cls, cache->count[cls] );
+
+	pthread_mutex_lock( &sl->cachesLock );
+	for( struct slabcache** link = &sl->caches; *link != NULL;
+	 link = &(*link)->next ){
+		if( *link == cache ){
+			*link = cache->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &sl->cachesLock );
+
+	free( cache );
+
+}
+
+/*******************************************************************************
+* Name:    slabInit
+* Purpose: Works out the size classes
+* Input:   sl - the slabs
+* Output:  none
+*******************************************************************************/
+void slabInit( struct slabs* sl ){
+
+	// VARIABLE DEFINITIONS
+	size_t size = SLABMIN, next;
+	int cls = 0;
+
+	memset( sl, 0, sizeof(*sl) );
+
+	while( 1 ){
+
+		pthread_mutex_init( &sl->classes[cls].lock, NULL );
+		sl->classes[cls].size = size;
+		cls++;
+
+		if( size == SLABMAX )
+			break;
+
+		next = ( (size_t)( size * SLABGROWTH ) + 7 ) & ~(size_t)7;
+		if( next < size + 8 )
+			next = size + 8;
+		size = next < SLABMAX ? next : SLABMAX;
+
+	}
+
+	sl->numClasses = cls;
+
+	pthread_mutex_init( &sl->cachesLock, NULL );
+	if( pthread_key_create( &sl->key, slabCacheExit ) != 0 ){
+		perror( "pthread_key_create" );
+		exit(1);
+	}
+
+	// the smallest class that fits each size
+	for( size = 0, cls = 0; size <= SLABMAX; size += 8 ){
+		while( sl->classes[cls].size < size )
+			cls++;
+		sl->classOf[ size / 8 ] = cls;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    slabClass
+* Purpose: Finds the class a chunk of some size comes from
+* Input:   sl   - the slabs
+*          size - the size
+* Output:  the class, or NULL if it's too big for any
+*******************************************************************************/
+struct slabclass* slabClass( struct slabs* sl, size_t size ){
+
+	if( size > SLABMAX )
+		return NULL;
+
+	return &sl->classes[ sl->classOf[ ( size + 7 ) / 8 ] ];
+
+}
+
+/*******************************************************************************
+* Name:    slabSize
+* Purpose: Works out how much memory a chunk of some size really takes
+* Input:   sl   - the slabs
+*          size - the size
+* Output:  its chunk size (or its own size, if it's too big for a class)
+*******************************************************************************/
+size_t slabSize( struct slabs* sl, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct slabclass* c = slabClass( sl, size );
+
+	return c != NULL ? c->size : size;
+
+}
+
+/*******************************************************************************
+* Name:    slabCache
+* Purpose: Finds (or makes) the calling thread's cache
+* Input:   sl - the slabs
+* Output:  the cache, or NULL if we ran out of memory
+*******************************************************************************/
+struct slabcache* slabCache( struct slabs* sl ){
+
+	// VARIABLE DEFINITIONS
+	struct slabcache* cache = pthread_getspecific( sl->key );
+
+	if( cache != NULL )
+		return cache;
+
+	cache = calloc( 1, sizeof(*cache) );
+	if( cache == NULL )
+		return NULL;
+	cache->sl = sl;
+
+	if( pthread_setspecific( sl->key, cache ) != 0 ){
+		free( cache );
+		return NULL;
+	}
+
+	pthread_mutex_lock( &sl->cachesLock );
+	cache->next = sl->caches;
+	sl->caches = cache;
+	pthread_mutex_unlock( &sl->cachesLock );
+
+	return cache;
+
+}
+
+/*******************************************************************************
+* Name:    slabFetch
+* Purpose: Moves SLABCACHE/2 chunks (or as many as we can get) from a class to
+*          a thread's empty cache
+* Input:   cache - the thread's cache
+*          cls   - the class
+* Output:  0 on success, -1 if we ran out of memory before getting any
+*******************************************************************************/
+int slabFetch( struct slabcache* cache, int cls ){
+
+	// VARIABLE DEFINITIONS
+	struct slabclass* c = &cache->sl->classes[cls];
+	size_t n;
+	void* chunk;
+	char* page;
+
+	pthread_mutex_lock( &c->lock );
+
+	for( n = 0; n < SLABCACHE / 2; n++ ){
+
+		// a freed chunk, or the next of our newest page, or a new page
+		if( c->free != NULL ){
+			chunk = c->free;
+			c->free = *(void**)chunk;
+		} else {
+			if( (size_t)( c->end - c->cur ) < c->size ){
+				page = mmap( NULL, SLABPAGE, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+				if( page == MAP_FAILED )
+					break;
+				c->cur = page;
+				c->end = page + SLABPAGE / c->size * c->size;
+				__atomic_fetch_add( &c->pages, 1, __ATOMIC_RELAXED );
+			}
+			chunk = c->cur;
+			c->cur += c->size;
+		}
+
+		*(void**)chunk = cache->free[cls];
+		cache->free[cls] = chunk;
+
+	}
+	__atomic_fetch_add( &c->inUse, n, __ATOMIC_RELAXED );
+
+	pthread_mutex_unlock( &c->lock );
+
+	__atomic_store_n( &cache->count[cls], n, __ATOMIC_RELAXED );
+	return n > 0 ? 0 : -1;
+
+}
+
+/*******************************************************************************
+* Name:    slabAlloc
+* Purpose: Allocates a chunk (8 byte aligned)
+* Input:   sl   - the slabs
+*          size - how big it must be
+* Output:  the chunk, or NULL if we ran out of memory
+*******************************************************************************/
+void* slabAlloc( struct slabs* sl, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct slabcache* cache;
+	void* chunk;
+	int cls;
+
+	if( size > SLABMAX ){
+		chunk = malloc( size );
+		if( chunk != NULL )
+			__atomic_fetch_add( &sl->large, 1, __ATOMIC_RELAXED );
+		return chunk;
+	}
+
+	cls = sl->classOf[ ( size + 7 ) / 8 ];
+	cache = slabCache( sl );
+	if( cache == NULL ||
+	 ( cache->free[cls] == NULL && slabFetch( cache, cls ) == -1 ) )
+		return NULL;
+
+	chunk = cache->free[cls];
+	cache->free[cls] = *(void**)chunk;
+	__atomic_store_n( &cache->count[cls], cache->count[cls] - 1,
+	 __ATOMIC_RELAXED );
+
+	return chunk;
+
+}
+
+/*******************************************************************************
+* Name:    slabFree
+* Purpose: Gives a chunk back (to the calling thread's cache, & from there, if
+*          it's full, half of it to the chunk's class)
+* Input:   sl    - the slabs
+*          chunk - the chunk
+*          size  - the size it was allocated with
+* Output:  none
+*******************************************************************************/
+void slabFree( struct slabs* sl, void* chunk, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct slabcache* cache;
+	struct slabclass* c;
+	int cls;
+
+	if( size > SLABMAX ){
+		free( chunk );
+		__atomic_fetch_sub( &sl->large, 1, __ATOMIC_RELAXED );
+		return;
+	}
+
+	cls = sl->classOf[ ( size + 7 ) / 8 ];
+	cache = slabCache( sl );
+
+	// (with no cache, & no memory to make one, straight back to the class)
+	if( cache == NULL ){
+		c = &sl->classes[cls];
+		pthread_mutex_lock( &c->lock );
+		*(void**)chunk = c->free;
+		c->free = chunk;
+		__atomic_fetch_sub( &c->inUse, 1, __ATOMIC_RELAXED );
+		pthread_mutex_unlock( &c->lock );
+		return;
+	}
+
+	*(void**)chunk = cache->free[cls];
+	cache->free[cls] = chunk;
+	__atomic_store_n( &cache->count[cls], cache->count[cls] + 1,
+	 __ATOMIC_RELAXED );
+
+	if( cache->count[cls] > SLABCACHE )
+		slabGiveBack( cache, cls, SLABCACHE / 2 );
+
+}
+
+/*******************************************************************************
+* Name:    slabPrint
+* Purpose: Reports the slabs' footprint & how much of it is in use
+* Input:   sl   - the slabs
+*          name - what to call them in the report
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void slabPrint( struct slabs* sl, char* name ){
+
+	// VARIABLE DEFINITIONS
+	size_t inUse[SLABCLASSES];
+	size_t pages = 0, used = 0, n;
+
+	// (what's sitting in threads' caches isn't in use)
+	for( int i = 0; i < sl->numClasses; i++ )
+		inUse[i] = __atomic_load_n( &sl->classes[i].inUse, __ATOMIC_RELAXED );
+	pthread_mutex_lock( &sl->cachesLock );
+	for( struct slabcache* cache = sl->caches; cache != NULL;
+	 cache = cache->next )
+		for( int i = 0; i < sl->numClasses; i++ ){
+			n = __atomic_load_n( &cache->count[i], __ATOMIC_RELAXED );
+			inUse[i] -= n < inUse[i] ? n : inUse[i];
+		}
+	pthread_mutex_unlock( &sl->cachesLock );
+
+	for( int i = 0; i < sl->numClasses; i++ ){
+		pages += __atomic_load_n( &sl->classes[i].pages, __ATOMIC_RELAXED );
+		used += inUse[i] * sl->classes[i].size;
+	}
+
+	printf( "server: %s slabs: %zu KB in %zu pages, %zu KB in use (%.1f%%), "
+	 "%zu chunks malloc()'d\n", name, pages * ( SLABPAGE / 1024 ), pages,
+	 used / 1024, pages ? 100.0 * used / ( pages * (double)SLABPAGE ) : 0.0,
+	 __atomic_load_n( &sl->large, __ATOMIC_RELAXED ) );
+
+	// the classes in use
+	for( int i = 0; i < sl->numClasses; i++ ){
+		n = inUse[i];
+		if( n > 0 )
+			printf( "server: %s slabs: %4zu byte chunks: %zu in use, %zu pages\n",
+			 name, sl->classes[i].size, n,
+			 __atomic_load_n( &sl->classes[i].pages, __ATOMIC_RELAXED ) );
+	}
+
+}
+
+#endif
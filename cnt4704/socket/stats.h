@@ -0,0 +1,283 @@
+/*******************************************************************************
+* File:       stats.h
+* Version:    0.4
+* Purpose:    Per-command counters & latency histograms for the server's STATS
+*             command & SIGUSR1 report
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Each worker keeps its own struct stats & is the only one to write
+              to it, so recording a command is a handful of plain stores (no
+              locks, no atomic read-modify-writes). A report merges every
+              worker's stats into a new struct stats first.
+
+              Latencies go into HDR-style histograms: buckets are exact below
+              HISTSUB nanoseconds, & above that each power of 2 is split into
+              HISTSUB/2 equal buckets. We report the middle of a bucket, so any
+              percentile is within 1/HISTSUB (about 3%) of the true value, from
+              nanoseconds up to 2^HISTBITS ns (about 18 minutes), in under 5KB
+              per command.
+*******************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define HISTSUBBITS 5                 // log2 of HISTSUB
+#define HISTSUB (1 << HISTSUBBITS)    // exact buckets below this many ns
+#define HISTBITS 40                   // the histogram tops out at 2^HISTBITS ns
+#define HISTBUCKETS ( (HISTBITS - HISTSUBBITS) * (HISTSUB/2) + HISTSUB )
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// the commands we keep stats for
+#define STAT_TRANSLATE    0
+#define STAT_GET          1
+#define STAT_STORE        2
+#define STAT_EXIT         3
+#define STAT_STATS        4
+#define STAT_MGET         5
+#define STAT_MSTORE       6
+#define STAT_GETV         7
+#define STAT_CAS          8
+#define STAT_SUBSCRIBE    9 // SUBSCRIBE & PSUBSCRIBE
+#define STAT_UNSUBSCRIBE 10 // UNSUBSCRIBE & PUNSUBSCRIBE
+#define STAT_SHM         11 // switching to shared memory (see shm.h)
+#define STAT_UNKNOWN     12 // anything that got NOT_OK
+#define NUMSTATS         13
+#define STAT_NONE        -1 // (not in the middle of a command)
+
+char* statNames[NUMSTATS] = {
+	"TRANSLATE", "GET", "STORE", "EXIT", "STATS", "MGET", "MSTORE", "GETV",
+	"CAS", "SUBSCRIBE", "UNSUBSCRIBE", "SHM", "unknown"
+};
+
+// everything we know about one command
+struct cmdStats {
+	size_t count;    // number of times it was run
+	size_t bytesIn;  // bytes of frames recieved for it (length prefixes too)
+	size_t bytesOut; // bytes of responses sent for it (length prefixes too)
+	size_t maxNs;    // its slowest run
+	size_t hist[HISTBUCKETS]; // how many runs took how long
+};
+
+// everything we know about every command
+struct stats {
+	struct cmdStats cmd[NUMSTATS];
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    statsNow
+* Purpose: Reads the monotonic clock (through the vDSO; no system call)
+* Input:   none
+* Output:  the time in nanoseconds
+*******************************************************************************/
+uint64_t statsNow(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+}
+
+/*******************************************************************************
+* Name:    statsBucket
+* Purpose: Finds the histogram bucket for a latency
+* Input:   ns - the latency
+* Output:  the bucket's index
+*******************************************************************************/
+int statsBucket( uint64_t ns ){
+
+	// VARIABLE DEFINITIONS
+	int shift;
+
+	if( ns < HISTSUB )
+		return ns;
+
+	if( ns >= (uint64_t)1 << HISTBITS )
+		ns = ( (uint64_t)1 << HISTBITS ) - 1;
+
+	// keep the top HISTSUBBITS bits of ns; the bits we drop pick the row
+	shift = 63 - __builtin_clzll( ns ) - ( HISTSUBBITS - 1 );
+	return shift * (HISTSUB/2) + ( ns >> shift );
+
+}
+
+/*******************************************************************************
+* Name:    statsValue
+* Purpose: Finds the latency in the middle of a histogram bucket
+* Input:   bucket - the bucket's index
+* Output:  the latency in nanoseconds
+*******************************************************************************/
+uint64_t statsValue( int bucket ){
+
+	// VARIABLE DEFINITIONS
+	int shift;
+
+	if( bucket < HISTSUB )
+		return bucket;
+
+	shift = bucket / (HISTSUB/2) - 1;
+	return ( (uint64_t)( bucket - shift * (HISTSUB/2) ) << shift ) +
+	 ( ( (uint64_t)1 << shift ) >> 1 );
+
+}
+
+/*******************************************************************************
+* Name:    statsAdd
+* Purpose: Adds to a counter that only the calling thread writes to, but that
+*          other threads may read at any time
+* Input:   counter - the counter
+*          n       - how much to add
+* Output:  none
+*******************************************************************************/
+void statsAdd( size_t* counter, size_t n ){
+	__atomic_store_n( counter, *counter + n, __ATOMIC_RELAXED );
+}
+
+/*******************************************************************************
+* Name:    statsRecord
+* Purpose: Records one run of a command
+* Input:   s        - the (calling worker's) stats
+*          cmd      - the command (one of the STAT_* values)
+*          ns       - how long it took
+*          bytesIn  - bytes recieved for it
+*          bytesOut - bytes sent for it
+* Output:  none
+*******************************************************************************/
+void statsRecord( struct stats* s, int cmd, uint64_t ns, size_t bytesIn,
+ size_t bytesOut ){
+
+	// VARIABLE DEFINITIONS
+	struct cmdStats* cs = &s->cmd[cmd];
+
+	statsAdd( &cs->count, 1 );
+	statsAdd( &cs->bytesIn, bytesIn );
+	statsAdd( &cs->bytesOut, bytesOut );
+	statsAdd( &cs->hist[ statsBucket( ns ) ], 1 );
+
+	if( ns > cs->maxNs )
+		__atomic_store_n( &cs->maxNs, ns, __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    statsMerge
+* Purpose: Adds one worker's stats to a total
+* Input:   total - the total
+*          s     - the worker's stats (which it may be writing to right now)
+* Output:  none
+*******************************************************************************/
+void statsMerge( struct stats* total, struct stats* s ){
+
+	// VARIABLE DEFINITIONS
+	size_t maxNs;
+
+	for( int i = 0; i < NUMSTATS; i++ ){
+
+		total->cmd[i].count += __atomic_load_n( &s->cmd[i].count, __ATOMIC_RELAXED );
+		total->cmd[i].bytesIn += __atomic_load_n( &s->cmd[i].bytesIn, __ATOMIC_RELAXED );
+		total->cmd[i].bytesOut += __atomic_load_n( &s->cmd[i].bytesOut, __ATOMIC_RELAXED );
+
+		maxNs = __atomic_load_n( &s->cmd[i].maxNs, __ATOMIC_RELAXED );
+		if( maxNs > total->cmd[i].maxNs )
+			total->cmd[i].maxNs = maxNs;
+
+		for( int b = 0; b < HISTBUCKETS; b++ )
+			total->cmd[i].hist[b] += __atomic_load_n( &s->cmd[i].hist[b],
+			 __ATOMIC_RELAXED );
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    statsPercentile
+* Purpose: Finds a percentile of a command's latency
+* Input:   cs - the command's stats
+*          q  - the percentile, from 0 to 1 (e.g. 0.99)
+* Output:  the latency in nanoseconds (0 if the command was never run)
+*******************************************************************************/
+uint64_t statsPercentile( struct cmdStats* cs, double q ){
+
+	// VARIABLE DEFINITIONS
+	size_t total = 0, seen = 0, rank;
+
+	for( int b = 0; b < HISTBUCKETS; b++ )
+		total += cs->hist[b];
+
+	if( total == 0 )
+		return 0;
+
+	// the rank of the run we're after (1 is the fastest)
+	rank = q * total;
+	if( rank < q * total || rank == 0 )
+		rank++;
+
+	for( int b = 0; b < HISTBUCKETS; b++ ){
+		seen += cs->hist[b];
+		// (the middle of the slowest run's bucket may be past the run itself)
+		if( seen >= rank )
+			return statsValue( b ) < cs->maxNs ? statsValue( b ) : cs->maxNs;
+	}
+
+	return cs->maxNs;
+
+}
+
+/*******************************************************************************
+* Name:    statsFormat
+* Purpose: Writes a table of every command's stats
+* Input:   s    - the stats
+*          buf  - where to write the table
+*          size - the size of buf
+* Output:  the length of the table (it's cut short if buf is too small)
+*******************************************************************************/
+size_t statsFormat( struct stats* s, char* buf, size_t size ){
+
+	// VARIABLE DEFINITIONS
+	struct cmdStats* cs;
+	size_t len;
+
+	len = snprintf( buf, size, "%-11s %10s %12s %12s %9s %9s %9s %9s\n",
+	 "command", "count", "bytes in", "bytes out",
+	 "p50 us", "p99 us", "p999 us", "max us" );
+
+	for( int i = 0; i < NUMSTATS && len < size; i++ ){
+
+		cs = &s->cmd[i];
+		len += snprintf( buf + len, size - len,
+		 "%-11s %10zu %12zu %12zu %9.1f %9.1f %9.1f %9.1f\n",
+		 statNames[i], cs->count, cs->bytesIn, cs->bytesOut,
+		 statsPercentile( cs, 0.50 ) / 1e3, statsPercentile( cs, 0.99 ) / 1e3,
+		 statsPercentile( cs, 0.999 ) / 1e3, cs->maxNs / 1e3 );
+
+	}
+
+	return len < size ? len : size - 1;
+
+}
+
+#endif
@@ -0,0 +1,1422 @@
+/*******************************************************************************
+* File:       store.h
+* Version:    0.7
+* Purpose:    The server-wide keyed store behind GET & STORE
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      One hash table shared by every connection on every worker thread.
+              It is split into STORESTRIPES stripes, each a little hash table of
+              its own behind its own reader/writer lock, so GETs only ever
+              share a lock with other GETs of keys that hash to the same
+              stripe, & STOREs only block their own stripe.
+
+              Big values are kept in blobs: memfds that GET can hand straight
+              to sendfile(). Small values are kept in the entry itself, right
+              after the key, & the ones in between are malloc()'d buffers.
+
+              Entries come from size classed slabs (slab.h) & have a 40 byte
+              header, so a small key costs its header, its key & value, the
+              rounding up to its chunk size & its share of a bucket array; no
+              malloc() header or separately allocated value. Only the bits of
+              the hash that pick a bucket are kept (32 of them, which is
+              plenty for 2^32 buckets per stripe).
+
+              memUsed accounts for every byte the table has allocated: entry
+              chunks, values outside of them (blobs included) & bucket arrays.
+
+              A key may be given an expiry time. Once it's past, GET treats the
+              key as gone & deletes it (lazy expiry), & storeSweep() deletes the
+              ones nobody asks for, a few buckets at a time within a time
+              budget, so that the memory comes back without anyone stalling.
+              Each stripe keeps a time that none of its keys expires before
+              (the earliest it saw on its last full sweep, lowered by every
+              expiry set since), so a sweep skips the stripes with nothing due.
+
+              With maxMemory set, a STORE that takes memUsed past it evicts keys
+              until it's back under, least recently used first, near enough:
+              each key notes when it was last used (the coarse clock's
+              milliseconds, written by a GET only when it's moved on, so a hot
+              key's cache line isn't dirtied on every GET & there's no shared
+              list to update), & each eviction samples evictSamples keys from
+              a random stripe & drops the one that's gone unused longest.
+              Evictions aren't logged, so a restart loads as much as fits.
+
+              Every value carries a 64 bit version, from a counter per stripe
+              that's bumped under the stripe's write lock, so a key's versions
+              only ever go up, even across a delete. The counters start at the
+              clock's milliseconds << VERSIONSHIFT, so they go on going up
+              across a restart too (as long as no stripe sets more than 2^20
+              values a millisecond), though they aren't saved. storeCas()
+              stores a value only if the key still has the version the caller
+              read, for optimistic concurrency without any lock of the
+              client's own.
+
+              storeGetMany() & storeSetMany() take a batch of keys, group them
+              by stripe & lock each stripe once for all of its keys, rather
+              than once per key.
+
+              If onSet is set, it's called with every new value while its
+              stripe is still write locked, so that whatever it records (e.g.
+              the append-only log in persist.h) sees the STOREs to any one key
+              in the same order as the table does.
+*******************************************************************************/
+
+#ifndef STORE_H
+#define STORE_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define STORESTRIPES 64  // number of independently locked stripes (power of 2)
+#define STOREBUCKETS 16  // initial number of buckets per stripe (power of 2)
+#define SWEEPCHUNK 16    // buckets a sweep looks through per lock
+#define EVICTSAMPLES 5   // default for evictSamples
+#define VERSIONSHIFT 20  // versions start at the clock's ms shifted this far
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "stats.h"
+#include "slab.h"
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// a big value, kept in an anonymous in-memory file (memfd) so that it can be
+// sent to clients with sendfile() instead of being copied through userspace.
+// reference counted, since GETs may still be sending it after it's replaced.
+struct blob {
+	int    fd;   // the memfd holding the value
+	char*  map;  // the value, mapped read only (once it's complete)
+	size_t len;  // length of the value
+	int    refs; // number of references (updated atomically)
+};
+
+// where an entry's value is kept (see entryVal())
+#define VAL_INLINE 0 // right after the key
+#define VAL_HEAP   1 // in a malloc()'d buffer; a pointer to it follows the key
+#define VAL_BLOB   2 // in a blob; a pointer to that follows the key
+
+// one key & its value: a 40 byte header, then the key, then the value or a
+// pointer to it (unaligned; see entryPtr())
+struct entry {
+	struct entry* next;    // the next entry in the same bucket
+	uint64_t      expires; // when the key expires (see storeNow(); 0 = never)
+	uint64_t      version; // the value's version (see storeCas())
+	uint32_t      hash;    // the key's bucket bits (see storeBucket())
+	uint32_t      atime;   // when it was last used (storeNow()'s low 32 bits)
+	uint32_t      valLen;  // length of the value
+	uint32_t      keyLen : 30; // length of the key (frames keep it far smaller)
+	uint32_t      kind : 2;    // where the value is (VAL_*)
+	char          data[];  // the key (any bytes; not null terminated) & value
+};
+
+// one key of a batch (see storeGetMany() & storeSetMany())
+struct storekey {
+	char*    key;    // the key (any bytes; not null terminated)
+	char*    val;    // its value (storeSetMany() only)
+	uint32_t keyLen; // length of the key
+	uint32_t valLen; // length of the value (storeSetMany() only)
+	uint64_t hash;   // the key's hash (filled in)
+	int      next;   // the batch's next key in the same stripe (filled in)
+};
+
+// one independently locked piece of the table. aligned to a cache line so that
+// threads locking neighbouring stripes don't fight over the same line.
+struct stripe {
+	pthread_rwlock_t lock;
+	struct entry**   buckets;
+	size_t           numBuckets; // always a power of two
+	size_t           numEntries;
+	size_t           numExpiring; // entries with an expiry (atomic)
+	uint64_t         nextExpiry;  // none of them expires before this (atomic)
+	uint64_t         sweepMin;    // ...& of those seen this sweep (atomic)
+	size_t           sweepAt;     // the next bucket to sweep
+	int              sweeping;    // 1 while someone's sweeping us (atomic)
+	uint64_t         version;     // the last version given out
+} __attribute__(( aligned(64) ));
+
+// the whole table
+struct store {
+	struct stripe stripes[STORESTRIPES];
+	size_t        memUsed; // bytes allocated by the table (updated atomically)
+	size_t        numKeys; // number of keys in the table (updated atomically)
+	size_t        numExpiring; // ...that have an expiry (updated atomically)
+	size_t        expiredLazy; // keys deleted by GETs that found them expired
+	unsigned      sweepNext;   // the next stripe to sweep (atomic)
+	size_t        maxMemory;   // evict keys past this much memUsed (0 = never)
+	int           evictSamples; // keys looked at to pick each one to evict
+	size_t        evicted;     // keys evicted (updated atomically)
+	size_t        evictedBytes; // ...& the memory that gave back
+	struct slabs  slabs;       // what the entries are allocated from
+	// called with each new value, under its stripe's write lock (or NULL)
+	void (*onSet)( void* arg, char* key, size_t keyLen, char* val, size_t valLen,
+	 uint64_t expires );
+	void*         onSetArg; // passed through to onSet
+};
+
+// the calling thread's random number state (see storeRand())
+__thread uint64_t storeRandState;
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    storeHash
+* Purpose: Hashes a key (64 bit FNV-1a)
+* Input:   key    - the key
+*          keyLen - the length of the key
+* Output:  the key's hash
+*******************************************************************************/
+uint64_t storeHash( char* key, size_t keyLen ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t h = 14695981039346656037ULL;
+
+	for( size_t i = 0; i < keyLen; i++ ){
+		h ^= (unsigned char)key[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+
+}
+
+/*******************************************************************************
+* Name:    storeNow
+* Purpose: Reads the clock that expiry times are kept by: the wall clock (so
+*          that they mean the same thing after a restart), to the millisecond
+*          (the coarse clock is plenty for that & costs next to nothing)
+* Input:   none
+* Output:  the time in milliseconds since the epoch
+*******************************************************************************/
+uint64_t storeNow(){
+
+	// VARIABLE DEFINITIONS
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME_COARSE, &ts );
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+}
+
+/*******************************************************************************
+* Name:    storeExpired
+* Purpose: Tells whether an entry has expired
+* Input:   e   - the entry
+*          now - the time (from storeNow())
+* Output:  1 if it has, 0 if not
+*******************************************************************************/
+int storeExpired( struct entry* e, uint64_t now ){
+	return e->expires != 0 && e->expires <= now;
+}
+
+/*******************************************************************************
+* Name:    storeKind
+* Purpose: Decides where a value that isn't a blob is kept: in the entry, if
+*          that still fits the biggest slab chunk, or else malloc()'d
+* Input:   keyLen - the length of the key
+*          valLen - the length of the value
+* Output:  VAL_INLINE or VAL_HEAP
+*******************************************************************************/
+int storeKind( size_t keyLen, size_t valLen ){
+	return sizeof(struct entry) + keyLen + valLen <= SLABMAX ? VAL_INLINE :
+	 VAL_HEAP;
+}
+
+/*******************************************************************************
+* Name:    entrySize
+* Purpose: Works out how big an entry is
+* Input:   keyLen - the length of its key
+*          valLen - the length of its value
+*          kind   - where the value is kept (VAL_*)
+* Output:  its size in bytes
+*******************************************************************************/
+size_t entrySize( size_t keyLen, size_t valLen, int kind ){
+	return sizeof(struct entry) + keyLen +
+	 ( kind == VAL_INLINE ? valLen : sizeof(void*) );
+}
+
+/*******************************************************************************
+* Name:    entryPtr
+* Purpose: Reads the pointer to an entry's value (which follows the key, so it
+*          may not be aligned)
+* Input:   e - the entry (not VAL_INLINE)
+* Output:  the malloc()'d value or the blob
+*******************************************************************************/
+void* entryPtr( struct entry* e ){
+
+	// VARIABLE DEFINITIONS
+	void* p;
+
+	memcpy( &p, e->data + e->keyLen, sizeof(p) );
+	return p;
+
+}
+
+/*******************************************************************************
+* Name:    entryBlob
+* Purpose: Finds the blob holding an entry's value
+* Input:   e - the entry
+* Output:  the blob, or NULL if the value isn't in one
+*******************************************************************************/
+struct blob* entryBlob( struct entry* e ){
+	return e->kind == VAL_BLOB ? entryPtr( e ) : NULL;
+}
+
+/*******************************************************************************
+* Name:    entryVal
+* Purpose: Finds an entry's value, wherever it's kept
+* Input:   e - the entry
+* Output:  the value (any bytes; not null terminated)
+*******************************************************************************/
+char* entryVal( struct entry* e ){
+
+	switch( e->kind ){
+		case VAL_INLINE: return e->data + e->keyLen;
+		case VAL_HEAP:   return entryPtr( e );
+		default:         return entryBlob( e )->map;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeLower
+* Purpose: Lowers a time that's shared between threads (atomically)
+* Input:   at - the time
+*          t  - what to lower it to (if it isn't lower already)
+* Output:  none
+*******************************************************************************/
+void storeLower( uint64_t* at, uint64_t t ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t old = __atomic_load_n( at, __ATOMIC_RELAXED );
+
+	while( t < old && !__atomic_compare_exchange_n( at, &old, t, 1,
+	 __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+
+}
+
+/*******************************************************************************
+* Name:    storeRand
+* Purpose: A fast pseudo random number generator (xorshift64*), one per thread
+* Input:   none
+* Output:  the next pseudo random number
+*******************************************************************************/
+uint64_t storeRand(){
+
+	// (each thread starts somewhere different)
+	if( storeRandState == 0 )
+		storeRandState = ( statsNow() ^ (uintptr_t)&storeRandState ) | 1;
+
+	storeRandState ^= storeRandState >> 12;
+	storeRandState ^= storeRandState << 25;
+	storeRandState ^= storeRandState >> 27;
+	return storeRandState * 2685821657736338717ULL;
+
+}
+
+/*******************************************************************************
+* Name:    storeStripe
+* Purpose: Finds the stripe a hash belongs to
+* Input:   st   - the store
+*          hash - the key's hash
+* Output:  the stripe
+*******************************************************************************/
+struct stripe* storeStripe( struct store* st, uint64_t hash ){
+	return &st->stripes[ hash & (STORESTRIPES-1) ];
+}
+
+/*******************************************************************************
+* Name:    storeBucket
+* Purpose: Finds the bucket a hash belongs to within its stripe. The low bits
+*          already picked the stripe, so use (32 of) the ones above them;
+*          that's what an entry keeps in its hash field.
+* Input:   s    - the stripe
+*          hash - the key's bucket bits ((uint32_t)( its hash / STORESTRIPES ))
+* Output:  a pointer to the head of the bucket's list
+*******************************************************************************/
+struct entry** storeBucket( struct stripe* s, uint32_t hash ){
+	return &s->buckets[ hash & (s->numBuckets-1) ];
+}
+
+/*******************************************************************************
+* Name:    storeInit
+* Purpose: Sets up an empty store
+* Input:   st - the store
+* Output:  none (perror() & exit() program on fail)
+*******************************************************************************/
+void storeInit( struct store* st ){
+
+	memset( st, 0, sizeof(*st) );
+	st->evictSamples = EVICTSAMPLES;
+	slabInit( &st->slabs );
+
+	for( int i = 0; i < STORESTRIPES; i++ ){
+
+		pthread_rwlock_init( &st->stripes[i].lock, NULL );
+		st->stripes[i].nextExpiry = UINT64_MAX;
+		st->stripes[i].sweepMin = UINT64_MAX;
+		st->stripes[i].version = storeNow() << VERSIONSHIFT;
+
+		st->stripes[i].numBuckets = STOREBUCKETS;
+		st->stripes[i].buckets = calloc( STOREBUCKETS, sizeof(struct entry*) );
+		if( st->stripes[i].buckets == NULL ){
+			perror( "calloc" );
+			exit(1);
+		}
+
+		st->memUsed += STOREBUCKETS * sizeof(struct entry*);
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeReserve
+* Purpose: Gives every stripe of an empty store enough buckets for a number of
+*          keys up front (e.g. before loading a snapshot), so that it doesn't
+*          have to grow over & over as they go in
+* Input:   st      - the store (nothing may be using it yet)
+*          numKeys - the number of keys expected
+* Output:  none. failure is harmless; the stripes will grow as usual
+*******************************************************************************/
+void storeReserve( struct store* st, size_t numKeys ){
+
+	// VARIABLE DEFINITIONS
+	size_t num = STOREBUCKETS;
+	struct entry** buckets;
+
+	while( num * STORESTRIPES < numKeys )
+		num *= 2;
+
+	for( int i = 0; i < STORESTRIPES; i++ ){
+
+		if( st->stripes[i].numBuckets >= num || st->stripes[i].numEntries > 0 )
+			continue;
+
+		buckets = calloc( num, sizeof(struct entry*) );
+		if( buckets == NULL )
+			return;
+
+		free( st->stripes[i].buckets );
+		st->memUsed += ( num - st->stripes[i].numBuckets ) * sizeof(struct entry*);
+		st->stripes[i].buckets = buckets;
+		st->stripes[i].numBuckets = num;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeFind
+* Purpose: Looks up a key within its stripe (the caller holds the lock)
+* Input:   s      - the key's stripe
+*          hash   - the key's hash
+*          key    - the key
+*          keyLen - the length of the key
+* Output:  a pointer to the link that points at the entry (so that it can be
+*          unlinked), or to the NULL at the end of the bucket if there is none
+*******************************************************************************/
+struct entry** storeFind( struct stripe* s, uint64_t hash, char* key, size_t keyLen ){
+
+	// VARIABLE DEFINITIONS
+	uint32_t bits = hash / STORESTRIPES;
+	struct entry** e = storeBucket( s, bits );
+
+	while( *e != NULL ){
+
+		if( (*e)->hash == bits && (*e)->keyLen == keyLen &&
+		 memcmp( (*e)->data, key, keyLen ) == 0 )
+			break;
+
+		e = &(*e)->next;
+
+	}
+
+	return e;
+
+}
+
+/*******************************************************************************
+* Name:    storeGrow
+* Purpose: Doubles a stripe's number of buckets (the caller holds the write
+*          lock). Failure is harmless; the buckets just get a bit longer.
+* Input:   st - the store
+*          s  - the stripe
+* Output:  none
+*******************************************************************************/
+void storeGrow( struct store* st, struct stripe* s ){
+
+	// VARIABLE DEFINITIONS
+	size_t oldNum = s->numBuckets;
+	struct entry** old = s->buckets;
+	struct entry* e;
+	struct entry* next;
+
+	s->buckets = calloc( oldNum * 2, sizeof(struct entry*) );
+	if( s->buckets == NULL ){
+		s->buckets = old;
+		return;
+	}
+	s->numBuckets = oldNum * 2;
+
+	// move every entry into its new bucket
+	for( size_t i = 0; i < oldNum; i++ ){
+		for( e = old[i]; e != NULL; e = next ){
+			next = e->next;
+			e->next = *storeBucket( s, e->hash );
+			*storeBucket( s, e->hash ) = e;
+		}
+	}
+
+	free( old );
+	__atomic_fetch_add( &st->memUsed, oldNum * sizeof(struct entry*),
+	 __ATOMIC_RELAXED );
+
+}
+
+/*******************************************************************************
+* Name:    blobNew
+* Purpose: Creates a new, empty blob (an anonymous in-memory file)
+* Input:   none
+* Output:  the blob, with one reference held by the caller, or NULL on failure
+*******************************************************************************/
+struct blob* blobNew(){
+
+	// VARIABLE DEFINITIONS
+	struct blob* b = malloc( sizeof(struct blob) );
+
+	if( b == NULL )
+		return NULL;
+
+	b->fd = memfd_create( "store", MFD_CLOEXEC );
+	if( b->fd == -1 ){
+		perror( "memfd_create" );
+		free( b );
+		return NULL;
+	}
+
+	b->map = NULL;
+	b->len = 0;
+	b->refs = 1;
+
+	return b;
+
+}
+
+/*******************************************************************************
+* Name:    blobWrite
+* Purpose: Appends bytes to the end of a blob
+* Input:   b    - the blob
+*          data - the bytes to append
+*          len  - the number of bytes to append
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+int blobWrite( struct blob* b, char* data, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	ssize_t numbytes;
+
+	while( len > 0 ){
+
+		numbytes = write( b->fd, data, len );
+
+		if( numbytes == -1 ){
+			if( errno == EINTR )
+				continue;
+			perror( "write" );
+			return -1;
+		}
+
+		data += numbytes;
+		len -= numbytes;
+		b->len += numbytes;
+
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    blobMap
+* Purpose: Maps a complete blob into memory, for senders that want an address
+*          rather than a file descriptor (e.g. io_uring's sendmsg())
+* Input:   b - the blob (nothing more may be written to it afterwards)
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+int blobMap( struct blob* b ){
+
+	// VARIABLE DEFINITIONS
+	void* map;
+
+	// (mmap() refuses to map nothing)
+	map = mmap( NULL, b->len ? b->len : 1, PROT_READ, MAP_SHARED, b->fd, 0 );
+	if( map == MAP_FAILED ){
+		perror( "mmap" );
+		return -1;
+	}
+
+	b->map = map;
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    blobRef
+* Purpose: Takes another reference to a blob (e.g. for a GET that is still
+*          being sent, so that a STORE can't pull the value out from under it)
+* Input:   b - the blob
+* Output:  none
+*******************************************************************************/
+void blobRef( struct blob* b ){
+	__atomic_fetch_add( &b->refs, 1, __ATOMIC_RELAXED );
+}
+
+/*******************************************************************************
+* Name:    blobUnref
+* Purpose: Drops a reference to a blob, freeing it when it was the last one
+* Input:   b - the blob
+* Output:  none
+*******************************************************************************/
+void blobUnref( struct blob* b ){
+
+	if( __atomic_sub_fetch( &b->refs, 1, __ATOMIC_ACQ_REL ) == 0 ){
+		if( b->map != NULL )
+			munmap( b->map, b->len ? b->len : 1 );
+		close( b->fd );
+		free( b );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeUnlink
+* Purpose: Takes an entry out of its stripe (the caller holds the write lock)
+* Input:   st   - the store
+*          s    - the stripe
+*          link - the link that points at the entry
+* Output:  the entry, for storeFree() once the lock is dropped
+*******************************************************************************/
+struct entry* storeUnlink( struct store* st, struct stripe* s, struct entry** link ){
+
+	// VARIABLE DEFINITIONS
+	struct entry* e = *link;
+
+	*link = e->next;
+	e->next = NULL;
+
+	s->numEntries--;
+	__atomic_fetch_sub( &st->numKeys, 1, __ATOMIC_RELAXED );
+	if( e->expires != 0 ){
+		__atomic_fetch_sub( &s->numExpiring, 1, __ATOMIC_RELAXED );
+		__atomic_fetch_sub( &st->numExpiring, 1, __ATOMIC_RELAXED );
+	}
+
+	return e;
+
+}
+
+/*******************************************************************************
+* Name:    storeBytes
+* Purpose: Works out how much of memUsed an entry accounts for
+* Input:   st - the store
+*          e  - the entry
+* Output:  its chunk's size, plus its value's if that isn't in the chunk
+*******************************************************************************/
+size_t storeBytes( struct store* st, struct entry* e ){
+	return slabSize( &st->slabs, entrySize( e->keyLen, e->valLen, e->kind ) ) +
+	 ( e->kind != VAL_INLINE ? e->valLen : 0 );
+}
+
+/*******************************************************************************
+* Name:    storeFreeVal
+* Purpose: Frees a value that was kept outside of its entry
+* Input:   kind - where it was kept (VAL_*)
+*          p    - the malloc()'d value or the blob (see entryPtr())
+* Output:  none
+*******************************************************************************/
+void storeFreeVal( int kind, void* p ){
+
+	if( kind == VAL_HEAP )
+		free( p );
+	else if( kind == VAL_BLOB )
+		blobUnref( p );
+
+}
+
+/*******************************************************************************
+* Name:    storeFree
+* Purpose: Frees an unlinked entry & its value
+* Input:   st - the store
+*          e  - the entry
+* Output:  none
+*******************************************************************************/
+void storeFree( struct store* st, struct entry* e ){
+
+	__atomic_fetch_sub( &st->memUsed, storeBytes( st, e ), __ATOMIC_RELAXED );
+
+	if( e->kind != VAL_INLINE )
+		storeFreeVal( e->kind, entryPtr( e ) );
+	slabFree( &st->slabs, e, entrySize( e->keyLen, e->valLen, e->kind ) );
+
+}
+
+/*******************************************************************************
+* Name:    storeDelete
+* Purpose: Deletes a key (if it's there)
+* Input:   st          - the store
+*          key         - the key
+*          keyLen      - the length of the key
+*          onlyExpired - 1 to leave it alone unless it has expired
+* Output:  1 if it was deleted, 0 if not
+*******************************************************************************/
+int storeDelete( struct store* st, char* key, size_t keyLen, int onlyExpired ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t hash = storeHash( key, keyLen );
+	struct stripe* s = storeStripe( st, hash );
+	struct entry** link;
+	struct entry* e = NULL;
+
+	pthread_rwlock_wrlock( &s->lock );
+
+	link = storeFind( s, hash, key, keyLen );
+	if( *link != NULL && ( !onlyExpired || storeExpired( *link, storeNow() ) ) )
+		e = storeUnlink( st, s, link );
+
+	pthread_rwlock_unlock( &s->lock );
+
+	if( e == NULL )
+		return 0;
+
+	storeFree( st, e );
+	return 1;
+
+}
+
+/*******************************************************************************
+* Name:    storeEvict
+* Purpose: Evicts keys until memUsed is back under maxMemory. Each one is the
+*          least recently used of evictSamples keys, taken from a random
+*          stripe starting at random buckets, with that stripe write locked.
+* Input:   st - the store
+* Output:  the number of keys evicted
+*******************************************************************************/
+size_t storeEvict( struct store* st ){
+
+	// VARIABLE DEFINITIONS
+	uint32_t now = storeNow();
+	struct stripe* s;
+	struct entry** link;
+	struct entry** oldest;
+	struct entry* e;
+	size_t evicted = 0;
+	size_t b, probes;
+	int samples, misses = 0;
+
+	while( __atomic_load_n( &st->memUsed, __ATOMIC_RELAXED ) > st->maxMemory &&
+	 misses < STORESTRIPES ){
+
+		s = &st->stripes[ storeRand() & (STORESTRIPES-1) ];
+		oldest = NULL;
+
+		pthread_rwlock_wrlock( &s->lock );
+
+		// sample keys a bucket's worth at a time (but skip the empty stripes)
+		for( samples = 0, probes = 0; s->numEntries > 0 &&
+		 samples < st->evictSamples && probes < s->numBuckets; probes++ ){
+			b = storeRand() & (s->numBuckets-1);
+			for( link = &s->buckets[b]; *link != NULL &&
+			 samples < st->evictSamples; link = &(*link)->next, samples++ )
+				if( oldest == NULL ||
+				 (uint32_t)( now - (*link)->atime ) >
+				 (uint32_t)( now - (*oldest)->atime ) )
+					oldest = link;
+		}
+
+		e = oldest != NULL ? storeUnlink( st, s, oldest ) : NULL;
+
+		pthread_rwlock_unlock( &s->lock );
+
+		if( e == NULL ){
+			misses++;
+			continue;
+		}
+
+		__atomic_fetch_add( &st->evictedBytes, storeBytes( st, e ),
+		 __ATOMIC_RELAXED );
+		storeFree( st, e );
+		evicted++;
+
+	}
+
+	__atomic_fetch_add( &st->evicted, evicted, __ATOMIC_RELAXED );
+
+	return evicted;
+
+}
+
+/*******************************************************************************
+* Name:    storePut
+* Purpose: Stores a value under a key, replacing any value it already had (the
+*          caller holds the key's stripe write locked). A small value is
+*          copied into the entry; otherwise the store takes over the caller's
+*          value (or reference to the blob).
+* Input:   st      - the store
+*          s       - the key's stripe
+*          hash    - the key's hash
+*          key     - the key
+*          keyLen  - the length of the key
+*          val     - the value: the caller's own if it's small enough to go in
+*                    the entry (see storeKind()), else malloc()'d; NULL for a
+*                    blob
+*          valLen  - the length of the value
+*          blob    - the blob holding the value, or NULL
+*          expires - when the key expires (see storeNow()), or 0 for never
+*          freed   - the entry this replaces (if any) is pushed on to this
+*                    list, for storeFreeList() once the stripe is unlocked
+*          version - NULL, or the version the key must have now for this to
+*                    go ahead (0 for none at all), set to the new value's
+*                    version
+* Output:  0 on success, -1 if we ran out of memory, or -2 if the key didn't
+*          have that version (either way, the old value is kept & the new one
+*          is freed)
+*******************************************************************************/
+int storePut( struct store* st, struct stripe* s, uint64_t hash, char* key,
+ size_t keyLen, char* val, size_t valLen, struct blob* blob, uint64_t expires,
+ struct entry** freed, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	int kind = blob != NULL ? VAL_BLOB : storeKind( keyLen, valLen );
+	size_t size = entrySize( keyLen, valLen, kind );
+	struct entry** link = storeFind( s, hash, key, keyLen );
+	struct entry* e = *link;
+	void* p;
+
+	// is it conditional on the version the key has? (an expired key has none)
+	if( version != NULL && *version != ( e != NULL &&
+	 !storeExpired( e, storeNow() ) ? e->version : 0 ) ){
+		if( kind != VAL_INLINE )
+			storeFreeVal( kind, blob != NULL ? (void*)blob : (void*)val );
+		return -2;
+	}
+
+	// does this need a new entry? (a new key, a different sized chunk, or an
+	// old value outside of the entry, which goes when the entry does)
+	if( e == NULL || e->kind != VAL_INLINE || slabSize( &st->slabs, size ) !=
+	 slabSize( &st->slabs, entrySize( keyLen, e->valLen, e->kind ) ) ){
+
+		e = slabAlloc( &st->slabs, size );
+		if( e == NULL ){
+			if( kind != VAL_INLINE )
+				storeFreeVal( kind, blob != NULL ? (void*)blob : (void*)val );
+			return -1;
+		}
+
+		// take the old entry's place (& expiry, until it's replaced below)
+		e->next = *link != NULL ? (*link)->next : NULL;
+		e->hash = hash / STORESTRIPES;
+		e->expires = *link != NULL ? (*link)->expires : 0;
+		e->keyLen = keyLen;
+		memcpy( e->data, key, keyLen );
+
+		if( *link != NULL ){
+			(*link)->next = *freed;
+			*freed = *link;
+		} else {
+			s->numEntries++;
+			__atomic_fetch_add( &st->numKeys, 1, __ATOMIC_RELAXED );
+		}
+		*link = e;
+
+	} else {
+
+		// the old value was in the entry, so it goes as it's overwritten
+		__atomic_fetch_sub( &st->memUsed, storeBytes( st, e ), __ATOMIC_RELAXED );
+
+	}
+
+	// put in the new value
+	e->valLen = valLen;
+	e->kind = kind;
+	if( kind == VAL_INLINE )
+		memcpy( e->data + keyLen, val, valLen );
+	else {
+		p = blob != NULL ? (void*)blob : (void*)val;
+		memcpy( e->data + keyLen, &p, sizeof(p) );
+	}
+	e->atime = storeNow();
+	e->version = ++s->version;
+	if( version != NULL )
+		*version = e->version;
+	__atomic_fetch_add( &st->memUsed, storeBytes( st, e ), __ATOMIC_RELAXED );
+
+	// a value replaces the old expiry too
+	if( ( e->expires != 0 ) != ( expires != 0 ) ){
+		__atomic_fetch_add( &s->numExpiring, expires != 0 ? 1 : -1,
+		 __ATOMIC_RELAXED );
+		__atomic_fetch_add( &st->numExpiring, expires != 0 ? 1 : -1,
+		 __ATOMIC_RELAXED );
+	}
+	e->expires = expires;
+	if( expires != 0 ){
+		storeLower( &s->nextExpiry, expires );
+		storeLower( &s->sweepMin, expires );
+	}
+
+	if( st->onSet != NULL )
+		st->onSet( st->onSetArg, key, keyLen, entryVal( e ), valLen, expires );
+
+	// keep the buckets short
+	if( s->numEntries > s->numBuckets )
+		storeGrow( st, s );
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    storeFreeList
+* Purpose: Frees the entries storePut() replaced, once their stripe is unlocked
+* Input:   st - the store
+*          e  - the first of them (linked through next), or NULL
+* Output:  none
+*******************************************************************************/
+void storeFreeList( struct store* st, struct entry* e ){
+
+	// VARIABLE DEFINITIONS
+	struct entry* next;
+
+	for( ; e != NULL; e = next ){
+		next = e->next;
+		storeFree( st, e );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeReplace
+* Purpose: Stores a value under a key, replacing any value it already had (see
+*          storePut())
+* Input:   st     - the store
+*          key    - the key
+*          keyLen - the length of the key
+*          val    - the value, as for storePut()
+*          valLen - the length of the value
+*          blob    - the blob holding the value, or NULL
+*          expires - when the key expires (see storeNow()), or 0 for never
+*          version - NULL, or the version the key must have, as for storePut()
+* Output:  0 on success, -1 if we ran out of memory, or -2 if the key didn't
+*          have that version (either way, the old value is kept & the new one
+*          is freed)
+*******************************************************************************/
+int storeReplace( struct store* st, char* key, size_t keyLen, char* val,
+ size_t valLen, struct blob* blob, uint64_t expires, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t hash = storeHash( key, keyLen );
+	struct stripe* s = storeStripe( st, hash );
+	struct entry* freed = NULL;
+	int status;
+
+	pthread_rwlock_wrlock( &s->lock );
+	status = storePut( st, s, hash, key, keyLen, val, valLen, blob, expires,
+	 &freed, version );
+	pthread_rwlock_unlock( &s->lock );
+
+	// free the old value outside of the lock
+	storeFreeList( st, freed );
+
+	// are we over our memory?
+	if( st->maxMemory > 0 &&
+	 __atomic_load_n( &st->memUsed, __ATOMIC_RELAXED ) > st->maxMemory )
+		storeEvict( st );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    storeSet
+* Purpose: Stores a copy of a value under a key, replacing any value it
+*          already had
+* Input:   st     - the store
+*          key    - the key
+*          keyLen - the length of the key
+*          val    - the value
+*          valLen  - the length of the value
+*          expires - when the key expires (see storeNow()), or 0 for never
+* Output:  0 on success, -1 if we ran out of memory (the old value is kept)
+*******************************************************************************/
+int storeSet( struct store* st, char* key, size_t keyLen, char* val,
+ size_t valLen, uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	char* newVal;
+
+	// a value too big for the entry is copied before taking the lock, to keep
+	// the lock held briefly
+	if( storeKind( keyLen, valLen ) == VAL_HEAP ){
+		newVal = malloc( valLen );
+		if( newVal == NULL )
+			return -1;
+		memcpy( newVal, val, valLen );
+		val = newVal;
+	}
+
+	return storeReplace( st, key, keyLen, val, valLen, NULL, expires, NULL );
+
+}
+
+/*******************************************************************************
+* Name:    storeSetBlob
+* Purpose: Stores a blob under a key, replacing any value it already had
+* Input:   st     - the store
+*          key    - the key
+*          keyLen - the length of the key
+*          blob    - the blob (the store takes over the caller's reference)
+*          expires - when the key expires (see storeNow()), or 0 for never
+* Output:  0 on success, -1 on failure (the old value is kept)
+*******************************************************************************/
+int storeSetBlob( struct store* st, char* key, size_t keyLen, struct blob* blob,
+ uint64_t expires ){
+
+	// every blob in the store is mapped, so that any sender can use it
+	if( blobMap( blob ) == -1 ){
+		blobUnref( blob );
+		return -1;
+	}
+
+	return storeReplace( st, key, keyLen, NULL, blob->len, blob, expires, NULL );
+
+}
+
+/*******************************************************************************
+* Name:    storeCas
+* Purpose: Stores a value under a key only if the key still has the version
+*          the caller expects (compare-and-swap); a copy of the value, or the
+*          blob holding it
+* Input:   st      - the store
+*          key     - the key
+*          keyLen  - the length of the key
+*          val     - the value, or NULL for a blob
+*          valLen  - the length of the value
+*          blob    - the blob (the store takes over the caller's reference), or
+*                    NULL
+*          expires - when the key expires (see storeNow()), or 0 for never
+*          version - the version the key must have now (0 for the key not to
+*                    exist), set to the new value's version
+* Output:  0 on success, -1 on failure, or -2 if the key had some other
+*          version (either way, the old value is kept)
+*******************************************************************************/
+int storeCas( struct store* st, char* key, size_t keyLen, char* val,
+ size_t valLen, struct blob* blob, uint64_t expires, uint64_t* version ){
+
+	// VARIABLE DEFINITIONS
+	char* newVal;
+
+	// (see storeSet() & storeSetBlob())
+	if( blob != NULL ){
+		if( blobMap( blob ) == -1 ){
+			blobUnref( blob );
+			return -1;
+		}
+		valLen = blob->len;
+	} else if( storeKind( keyLen, valLen ) == VAL_HEAP ){
+		newVal = malloc( valLen );
+		if( newVal == NULL )
+			return -1;
+		memcpy( newVal, val, valLen );
+		val = newVal;
+	}
+
+	return storeReplace( st, key, keyLen, val, valLen, blob, expires, version );
+
+}
+
+/*******************************************************************************
+* Name:    storeGet
+* Purpose: Looks up a key &, while its stripe is still read locked, hands the
+*          value to the caller's copy function (so that it can be copied
+*          straight into a response without an intermediate buffer), & marks
+*          it used. A key that has expired isn't found, & is deleted on the
+*          way out.
+* Input:   st      - the store
+*          key     - the key
+*          keyLen  - the length of the key
+*          copyOut - called with (arg, value, length of value, blob, version)
+*                    if the key exists; for a blob, value is NULL & copyOut must
+*                    blobRef() the blob if it keeps it. returns 0 on success or
+*                    -1.
+*          arg     - passed through to copyOut
+* Output:  1 if the key was found & copied, 0 if it wasn't found, or -1 if
+*          copyOut failed
+*******************************************************************************/
+int storeGet( struct store* st, char* key, size_t keyLen,
+ int (*copyOut)( void* arg, char* val, size_t valLen, struct blob* blob,
+ uint64_t version ), void* arg ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t hash = storeHash( key, keyLen );
+	struct stripe* s = storeStripe( st, hash );
+	struct entry* e;
+	uint64_t now = storeNow();
+	int status = 0;
+	int expired = 0;
+
+	pthread_rwlock_rdlock( &s->lock );
+
+	e = *storeFind( s, hash, key, keyLen );
+	if( e != NULL && storeExpired( e, now ) )
+		expired = 1;
+	else if( e != NULL ){
+		// (only write when the clock's moved on; racing GETs all write the
+		// same thing)
+		if( e->atime != (uint32_t)now )
+			__atomic_store_n( &e->atime, (uint32_t)now, __ATOMIC_RELAXED );
+		status = copyOut( arg, e->kind == VAL_BLOB ? NULL : entryVal( e ),
+		 e->valLen, entryBlob( e ), e->version ) == -1 ? -1 : 1;
+	}
+
+	pthread_rwlock_unlock( &s->lock );
+
+	// delete it (unless someone set it again in between)
+	if( expired && storeDelete( st, key, keyLen, 1 ) )
+		__atomic_fetch_add( &st->expiredLazy, 1, __ATOMIC_RELAXED );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    storeGroup
+* Purpose: Hashes a batch of keys & sorts them by stripe
+* Input:   keys  - the batch (hash & next are filled in)
+*          n     - the number of keys in it
+*          heads - set to the index of each stripe's first key (or -1 for
+*                  none); the rest follow through next, in the batch's order
+* Output:  none
+*******************************************************************************/
+void storeGroup( struct storekey* keys, int n, int heads[STORESTRIPES] ){
+
+	// VARIABLE DEFINITIONS
+	int b;
+
+	for( b = 0; b < STORESTRIPES; b++ )
+		heads[b] = -1;
+
+	// (backwards, so that each stripe's list comes out in the batch's order)
+	for( int i = n - 1; i >= 0; i-- ){
+		keys[i].hash = storeHash( keys[i].key, keys[i].keyLen );
+		b = keys[i].hash & (STORESTRIPES-1);
+		keys[i].next = heads[b];
+		heads[b] = i;
+	}
+
+}
+
+/*******************************************************************************
+* Name:    storeGetMany
+* Purpose: Looks up a batch of keys, read locking each stripe once for all of
+*          its keys, & hands each value found to the caller's copy function
+*          while it's still locked. Keys that have expired aren't found, & are
+*          deleted on the way out (as with storeGet()).
+* Input:   st      - the store
+*          keys    - the keys (only key & keyLen need be set)
+*          n       - the number of keys
+*          copyOut - called with (arg, the key's index in keys, value, length
+*                    of value) for each key that exists, in stripe order; a
+*                    blob's value is its mapping. returns 0 on success or -1.
+*          arg     - passed through to copyOut
+* Output:  the number of keys found, or -1 if copyOut failed
+*******************************************************************************/
+int storeGetMany( struct store* st, struct storekey* keys, int n,
+ int (*copyOut)( void* arg, int i, char* val, size_t valLen ), void* arg ){
+
+	// VARIABLE DEFINITIONS
+	int heads[STORESTRIPES];
+	struct stripe* s;
+	struct entry* e;
+	uint64_t now = storeNow();
+	int found = 0, expired;
+
+	storeGroup( keys, n, heads );
+
+	for( int b = 0; b < STORESTRIPES; b++ ){
+
+		if( heads[b] == -1 )
+			continue;
+
+		s = &st->stripes[b];
+		expired = 0;
+
+		pthread_rwlock_rdlock( &s->lock );
+
+		for( int i = heads[b]; i != -1 && found != -1; i = keys[i].next ){
+
+			e = *storeFind( s, keys[i].hash, keys[i].key, keys[i].keyLen );
+			if( e == NULL )
+				continue;
+			if( storeExpired( e, now ) ){
+				expired++;
+				continue;
+			}
+
+			// (see storeGet())
+			if( e->atime != (uint32_t)now )
+				__atomic_store_n( &e->atime, (uint32_t)now, __ATOMIC_RELAXED );
+			found = copyOut( arg, i, entryVal( e ), e->valLen ) == -1 ? -1 :
+			 found + 1;
+
+		}
+
+		pthread_rwlock_unlock( &s->lock );
+
+		// delete the expired ones (unless someone set them again in between)
+		for( int i = heads[b]; expired > 0 && i != -1; i = keys[i].next )
+			if( storeDelete( st, keys[i].key, keys[i].keyLen, 1 ) ){
+				__atomic_fetch_add( &st->expiredLazy, 1, __ATOMIC_RELAXED );
+				expired--;
+			}
+
+		if( found == -1 )
+			return -1;
+
+	}
+
+	return found;
+
+}
+
+/*******************************************************************************
+* Name:    storeSetMany
+* Purpose: Stores copies of a batch of values, write locking each stripe once
+*          for all of its keys. If a key appears more than once, its last
+*          value wins.
+* Input:   st      - the store
+*          keys    - the keys & their values (key, keyLen, val & valLen)
+*          n       - the number of keys
+*          expires - when the keys expire (see storeNow()), or 0 for never
+* Output:  0 on success, -1 if we ran out of memory for some of them (those
+*          keep their old values; the rest are stored)
+*******************************************************************************/
+int storeSetMany( struct store* st, struct storekey* keys, int n,
+ uint64_t expires ){
+
+	// VARIABLE DEFINITIONS
+	int heads[STORESTRIPES];
+	struct stripe* s;
+	struct entry* freed;
+	char* val;
+	int status = 0;
+
+	storeGroup( keys, n, heads );
+
+	for( int b = 0; b < STORESTRIPES; b++ ){
+
+		if( heads[b] == -1 )
+			continue;
+
+		s = &st->stripes[b];
+		freed = NULL;
+
+		pthread_rwlock_wrlock( &s->lock );
+
+		for( int i = heads[b]; i != -1; i = keys[i].next ){
+
+			// a value too big for its entry is copied under the lock here,
+			// unlike storeSet(): the stripe is ours for the whole batch anyway
+			val = keys[i].val;
+			if( storeKind( keys[i].keyLen, keys[i].valLen ) == VAL_HEAP ){
+				val = malloc( keys[i].valLen );
+				if( val == NULL ){
+					status = -1;
+					continue;
+				}
+				memcpy( val, keys[i].val, keys[i].valLen );
+			}
+
+			if( storePut( st, s, keys[i].hash, keys[i].key, keys[i].keyLen, val,
+			 keys[i].valLen, NULL, expires, &freed, NULL ) == -1 )
+				status = -1;
+
+		}
+
+		pthread_rwlock_unlock( &s->lock );
+
+		storeFreeList( st, freed );
+
+	}
+
+	// are we over our memory?
+	if( st->maxMemory > 0 &&
+	 __atomic_load_n( &st->memUsed, __ATOMIC_RELAXED ) > st->maxMemory )
+		storeEvict( st );
+
+	return status;
+
+}
+
+/*******************************************************************************
+* Name:    storeSweep
+* Purpose: Deletes expired keys, stripe after stripe, until it has been round
+*          them all once or its time is up. The stripes are taken in turn
+*          from one cursor shared by every sweeper, & each stripe remembers
+*          how far through it the last sweep got, so any number of threads
+*          can sweep now & then & between them they cover the whole store.
+*          Buckets are checked under the read lock, a chunk at a time, & only
+*          write locked when there's something to delete, so a sweep holds up
+*          GETs as little as it can.
+* Input:   st     - the store
+*          budget - how long we may take, in nanoseconds
+* Output:  the number of keys deleted
+*******************************************************************************/
+size_t storeSweep( struct store* st, uint64_t budget ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t deadline = statsNow() + budget;
+	uint64_t now = storeNow();
+	uint64_t min;
+	struct stripe* s;
+	struct entry** link;
+	struct entry* dead;
+	struct entry* e;
+	size_t expired = 0;
+	size_t numBuckets, bucket, end, b;
+	int found;
+
+	for( int i = 0; i < STORESTRIPES && statsNow() < deadline; i++ ){
+
+		s = &st->stripes[ __atomic_fetch_add( &st->sweepNext, 1,
+		 __ATOMIC_RELAXED ) & (STORESTRIPES-1) ];
+
+		// is anything due to expire in this stripe? (& is nobody else on it?)
+		if( __atomic_load_n( &s->numExpiring, __ATOMIC_RELAXED ) == 0 ||
+		 __atomic_load_n( &s->nextExpiry, __ATOMIC_RELAXED ) > now ||
+		 __atomic_exchange_n( &s->sweeping, 1, __ATOMIC_ACQUIRE ) )
+			continue;
+
+		bucket = s->sweepAt;
+
+		do {
+
+			// look for some under the read lock (& note when the rest expire)
+			found = 0;
+			min = UINT64_MAX;
+			pthread_rwlock_rdlock( &s->lock );
+			numBuckets = s->numBuckets;
+			if( bucket >= numBuckets )
+				bucket = 0;
+			end = bucket + SWEEPCHUNK < numBuckets ? bucket + SWEEPCHUNK :
+			 numBuckets;
+			for( b = bucket; b < end; b++ ){
+				for( e = s->buckets[b]; e != NULL; e = e->next ){
+					if( storeExpired( e, now ) )
+						found = 1;
+					else if( e->expires != 0 && e->expires < min )
+						min = e->expires;
+				}
+			}
+			storeLower( &s->sweepMin, min );
+			pthread_rwlock_unlock( &s->lock );
+
+			// & delete them under the write lock
+			dead = NULL;
+			if( found ){
+				pthread_rwlock_wrlock( &s->lock );
+				if( end > s->numBuckets )
+					end = s->numBuckets;
+				for( b = bucket; b < end; b++ ){
+					link = &s->buckets[b];
+					while( *link != NULL ){
+						if( storeExpired( *link, now ) ){
+							e = storeUnlink( st, s, link );
+							e->next = dead;
+							dead = e;
+							expired++;
+						} else
+							link = &(*link)->next;
+					}
+				}
+				pthread_rwlock_unlock( &s->lock );
+			}
+
+			// free them outside of the lock
+			for( ; dead != NULL; dead = e ){
+				e = dead->next;
+				storeFree( st, dead );
+			}
+
+			// have we been all the way through? then we know when the next
+			// key is due (any set since have lowered sweepMin themselves, &
+			// if the stripe's grown since, its new buckets hold keys from the
+			// ones we've been through)
+			bucket = end;
+			if( bucket >= numBuckets ){
+				pthread_rwlock_wrlock( &s->lock );
+				__atomic_store_n( &s->nextExpiry, s->sweepMin, __ATOMIC_RELAXED );
+				__atomic_store_n( &s->sweepMin, UINT64_MAX, __ATOMIC_RELAXED );
+				pthread_rwlock_unlock( &s->lock );
+				bucket = 0;
+			}
+
+		} while( bucket != 0 && statsNow() < deadline );
+
+		s->sweepAt = bucket;
+		__atomic_store_n( &s->sweeping, 0, __ATOMIC_RELEASE );
+
+	}
+
+	return expired;
+
+}
+
+/*******************************************************************************
+* Name:    storePrint
+* Purpose: Reports how many keys the store holds & how much memory it's using
+* Input:   st - the store
+* Output:  none. the report is printed directly to Standard Out
+*******************************************************************************/
+void storePrint( struct store* st ){
+
+	// VARIABLE DEFINITIONS
+	size_t keys = __atomic_load_n( &st->numKeys, __ATOMIC_RELAXED );
+	size_t used = __atomic_load_n( &st->memUsed, __ATOMIC_RELAXED );
+
+	printf( "server: store: %zu keys (%zu with an expiry), %zu bytes (%.1f per "
+	 "key), %zu expired on access\n", keys,
+	 __atomic_load_n( &st->numExpiring, __ATOMIC_RELAXED ), used,
+	 keys ? (double)used / keys : 0.0,
+	 __atomic_load_n( &st->expiredLazy, __ATOMIC_RELAXED ) );
+
+	if( st->maxMemory > 0 )
+		printf( "server: store: limit %zu bytes; %zu keys (%zu bytes) evicted, "
+		 "%d samples each\n", st->maxMemory,
+		 __atomic_load_n( &st->evicted, __ATOMIC_RELAXED ),
+		 __atomic_load_n( &st->evictedBytes, __ATOMIC_RELAXED ),
+		 st->evictSamples );
+
+	slabPrint( &st->slabs, "store" );
+
+}
+
+#endif
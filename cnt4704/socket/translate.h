@@ -0,0 +1,201 @@
+/*******************************************************************************
+* File:       translate.h
+* Version:    0.1
+* Purpose:    The ASCII uppercase conversion behind TRANSLATE
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      translate() converts 'a'-'z' to 'A'-'Z' & copies every other byte
+              as is (the same as toupper() in the "C" locale), reading from one
+              buffer & writing to another in a single pass.
+
+              There are three versions: plain C, SSE2 (16 bytes at a time) &
+              AVX2 (32 bytes at a time). translateInit() picks the best one the
+              CPU we're running on supports; on anything other than x86 only
+              the plain C version exists.
+*******************************************************************************/
+
+#ifndef TRANSLATE_H
+#define TRANSLATE_H
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANSLATE_X86 1
+#include <immintrin.h>
+#endif
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+void translateScalar( char* dst, char* src, size_t len );
+
+// the version of translate() picked by translateInit()
+void (*translateFn)( char* dst, char* src, size_t len ) = translateScalar;
+
+// the name of that version (for logging)
+char* translateName = "scalar";
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    translateScalar
+* Purpose: Converts ASCII to uppercase one byte at a time, without branching
+* Input:   dst - where to write the converted bytes (may be the same as src)
+*          src - the bytes to convert
+*          len - the number of bytes to convert
+* Output:  none (dst is a pointer, so it is edited directly)
+*******************************************************************************/
+void translateScalar( char* dst, char* src, size_t len ){
+
+	for( size_t i = 0; i < len; i++ ){
+
+		// VARIABLE DEFINITIONS
+		unsigned char c = src[i];
+
+		// (c - 'a') < 26 is only true for 'a' to 'z' (unsigned math)
+		dst[i] = c - ( ((unsigned char)(c - 'a') < 26) << 5 );
+
+	}
+
+}
+
+#ifdef TRANSLATE_X86
+
+/*******************************************************************************
+* Name:    translateSSE2
+* Purpose: Converts ASCII to uppercase 16 bytes at a time. Adding (128 - 'a')
+*          moves 'a' to 'z' down to the very bottom of the signed byte range,
+*          so one signed compare finds all of them; we then subtract 0x20 from
+*          just those bytes. Converting is idempotent, so the leftover bytes
+*          are done by one more (overlapping) block ending at the last byte.
+* Input:   dst - where to write the converted bytes (may be the same as src)
+*          src - the bytes to convert
+*          len - the number of bytes to convert
+* Output:  none (dst is a pointer, so it is edited directly)
+*******************************************************************************/
+__attribute__(( target("sse2") ))
+void translateSSE2( char* dst, char* src, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	__m128i shift = _mm_set1_epi8( (char)(128 - 'a') );
+	__m128i limit = _mm_set1_epi8( (char)(-128 + 26) );
+	__m128i diff  = _mm_set1_epi8( 0x20 );
+	__m128i v, mask;
+	size_t i = 0;
+
+	// too short for even one block?
+	if( len < 16 ){
+		translateScalar( dst, src, len );
+		return;
+	}
+
+	while(1){
+
+		v = _mm_loadu_si128( (__m128i*)(src + i) );
+		mask = _mm_cmplt_epi8( _mm_add_epi8( v, shift ), limit );
+		v = _mm_sub_epi8( v, _mm_and_si128( mask, diff ) );
+		_mm_storeu_si128( (__m128i*)(dst + i), v );
+
+		if( i + 16 == len )
+			break;
+
+		// the last block may overlap the one before it
+		i = ( i + 32 <= len ) ? i + 16 : len - 16;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    translateAVX2
+* Purpose: Converts ASCII to uppercase 32 bytes at a time (the same trick as
+*          translateSSE2(), on registers twice as wide)
+* Input:   dst - where to write the converted bytes (may be the same as src)
+*          src - the bytes to convert
+*          len - the number of bytes to convert
+* Output:  none (dst is a pointer, so it is edited directly)
+*******************************************************************************/
+__attribute__(( target("avx2") ))
+void translateAVX2( char* dst, char* src, size_t len ){
+
+	// VARIABLE DEFINITIONS
+	__m256i shift = _mm256_set1_epi8( (char)(128 - 'a') );
+	__m256i limit = _mm256_set1_epi8( (char)(-128 + 26) );
+	__m256i diff  = _mm256_set1_epi8( 0x20 );
+	__m256i v, mask;
+	size_t i = 0;
+
+	// too short for even one block?
+	if( len < 32 ){
+		translateSSE2( dst, src, len );
+		return;
+	}
+
+	while(1){
+
+		v = _mm256_loadu_si256( (__m256i*)(src + i) );
+		// there's no "less than" for bytes, so flip the compare around
+		mask = _mm256_cmpgt_epi8( limit, _mm256_add_epi8( v, shift ) );
+		v = _mm256_sub_epi8( v, _mm256_and_si256( mask, diff ) );
+		_mm256_storeu_si256( (__m256i*)(dst + i), v );
+
+		if( i + 32 == len )
+			break;
+
+		// the last block may overlap the one before it
+		i = ( i + 64 <= len ) ? i + 32 : len - 32;
+
+	}
+
+}
+
+#endif
+
+/*******************************************************************************
+* Name:    translateInit
+* Purpose: Picks the fastest version of translate() that this CPU supports
+* Input:   none
+* Output:  none (sets translateFn & translateName)
+*******************************************************************************/
+void translateInit(){
+
+#ifdef TRANSLATE_X86
+
+	__builtin_cpu_init();
+
+	if( __builtin_cpu_supports( "avx2" ) ){
+		translateFn = translateAVX2;
+		translateName = "avx2";
+	} else if( __builtin_cpu_supports( "sse2" ) ){
+		translateFn = translateSSE2;
+		translateName = "sse2";
+	}
+
+#endif
+
+}
+
+/*******************************************************************************
+* Name:    translate
+* Purpose: Converts ASCII to uppercase, using the version picked by
+*          translateInit()
+* Input:   dst - where to write the converted bytes (may be the same as src)
+*          src - the bytes to convert
+*          len - the number of bytes to convert
+* Output:  none (dst is a pointer, so it is edited directly)
+*******************************************************************************/
+void translate( char* dst, char* src, size_t len ){
+	translateFn( dst, src, len );
+}
+
+#endif
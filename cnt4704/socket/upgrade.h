@@ -0,0 +1,256 @@
+/*******************************************************************************
+* File:       upgrade.h
+* Version:    0.2
+* Purpose:    Hands a running server's listening sockets over to a new server
+*             (e.g. a new build) without ever closing them, so that no client
+*             is refused while one replaces the other
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      The old server makes a Unix socketpair & fork()s & exec()s its own
+              command line (so whatever binary is at that path now), telling
+              the new server which descriptor is its end of the pair in
+              UPGRADEENV. The child closes every other descriptor before the
+              exec(), so the new server holds none of the old one's clients.
+
+              The old server then sends every listener it has (one per worker,
+              the Unix socket & the one for replicas) in a single SCM_RIGHTS
+              message, with a struct handoff saying what they are. The new
+              server gets the very same sockets, not copies bound to the same
+              port (or path): their accept queues, & any connections already
+              waiting in them, are shared until the old server closes its
+              descriptors, & the sockets stay open for as long as the new
+              server has them. A client connecting at any moment in between is
+              accepted by one server or the other, & is never refused.
+
+              What else goes over the socketpair is up to the servers (see
+              server.c & repl.h).
+*******************************************************************************/
+
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define UPGRADEENV "KVSERVER_UPGRADE" // the new server's end of the socketpair
+#define MAXHANDOFF 250 // most listeners handed over (the kernel's limit per
+                       // SCM_RIGHTS message is 253)
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// what the last of the listeners are, after one per worker (flags)
+#define HANDOFF_REPL  1 // the last takes replicas, not clients
+#define HANDOFF_LOCAL 2 // the one before that (or the last) is a Unix socket
+
+// what comes with the listeners
+struct handoff {
+	uint32_t numFds;  // number of listeners
+	uint32_t flags;   // HANDOFF_REPL & HANDOFF_LOCAL
+	uint64_t gen;     // the generation of log the new server starts at (0 if
+	                  // the old one has no log)
+} __attribute__(( packed ));
+
+/*******************************************************************************
+                           GLOBAL VARIABLE DEFINITIONS
+*******************************************************************************/
+
+extern char** environ;
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    upgradeSpawn
+* Purpose: Starts the new server: fork()s & exec()s a command line, with a
+*          socketpair between us
+* Input:   args - the command line (args[0] is looked for in the PATH, like a
+*                 shell would)
+*          fd   - set to our end of the socketpair
+* Output:  the new server's pid, or -1 on failure
+*******************************************************************************/
+pid_t upgradeSpawn( char** args, int* fd ){
+
+	// VARIABLE DEFINITIONS
+	int sv[2];
+	char var[64];
+	char** env;
+	size_t n = 0;
+	pid_t pid;
+
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) == -1 ){
+		perror( "socketpair" );
+		return -1;
+	}
+
+	// its environment is ours, plus where to find its end
+	snprintf( var, sizeof(var), "%s=%d", UPGRADEENV, sv[1] );
+	while( environ[n] != NULL )
+		n++;
+	env = malloc( ( n + 2 ) * sizeof(char*) );
+	if( env == NULL ){
+		perror( "malloc" );
+		close( sv[0] );
+		close( sv[1] );
+		return -1;
+	}
+	memcpy( env, environ, n * sizeof(char*) );
+	env[n] = var;
+	env[n+1] = NULL;
+
+	pid = fork();
+
+	// are we the child? (a copy of just this thread, in a copy of a process
+	// full of others' locks, so do nothing but close & exec())
+	if( pid == 0 ){
+		if( sv[1] > 3 )
+			close_range( 3, sv[1] - 1, 0 );
+		close_range( sv[1] + 1, ~0U, 0 );
+		execvpe( args[0], args, env );
+		_exit( 127 );
+	}
+
+	free( env );
+	close( sv[1] );
+
+	if( pid == -1 ){
+		perror( "fork" );
+		close( sv[0] );
+		return -1;
+	}
+
+	*fd = sv[0];
+	return pid;
+
+}
+
+/*******************************************************************************
+* Name:    upgradeSend
+* Purpose: Sends the new server our listeners
+* Input:   fd  - our end of the socketpair
+*          h   - what they are (h->numFds of them)
+*          fds - the listeners
+* Output:  0 on success, -1 on failure
+*******************************************************************************/
+int upgradeSend( int fd, struct handoff* h, int* fds ){
+
+	// VARIABLE DEFINITIONS
+	char control[ CMSG_SPACE( MAXHANDOFF * sizeof(int) ) ];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	ssize_t numbytes;
+
+	iov.iov_base = h;
+	iov.iov_len = sizeof(*h);
+
+	memset( &msg, 0, sizeof(msg) );
+	memset( control, 0, sizeof(control) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = CMSG_SPACE( h->numFds * sizeof(int) );
+
+	cmsg = CMSG_FIRSTHDR( &msg );
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN( h->numFds * sizeof(int) );
+	memcpy( CMSG_DATA( cmsg ), fds, h->numFds * sizeof(int) );
+
+	do {
+		numbytes = sendmsg( fd, &msg, MSG_NOSIGNAL );
+	} while( numbytes == -1 && errno == EINTR );
+
+	// (it's far smaller than the socket's buffer, so it all goes at once)
+	if( numbytes != sizeof(*h) ){
+		perror( "sendmsg listeners" );
+		return -1;
+	}
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    upgradeRecv
+* Purpose: Finds out whether we're a new server taking over from an old one,
+*          & if so takes its listeners
+* Input:   h   - set to what they are
+*          fds - set to the listeners (room for MAXHANDOFF)
+* Output:  our end of the socketpair, or -1 if we weren't started by an old
+*          server (perror() & exit() program on fail)
+*******************************************************************************/
+int upgradeRecv( struct handoff* h, int* fds ){
+
+	// VARIABLE DEFINITIONS
+	char control[ CMSG_SPACE( MAXHANDOFF * sizeof(int) ) ];
+	char* var = getenv( UPGRADEENV );
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+	ssize_t numbytes;
+	int fd;
+
+	if( var == NULL )
+		return -1;
+
+	// (so that it isn't passed on to our own new server one day)
+	fd = atoi( var );
+	unsetenv( UPGRADEENV );
+	fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+	iov.iov_base = h;
+	iov.iov_len = sizeof(*h);
+
+	memset( &msg, 0, sizeof(msg) );
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do {
+		numbytes = recvmsg( fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL );
+	} while( numbytes == -1 && errno == EINTR );
+
+	if( numbytes == -1 ){
+		perror( "recvmsg listeners" );
+		exit(1);
+	}
+
+	cmsg = CMSG_FIRSTHDR( &msg );
+	if( numbytes != sizeof(*h) || ( msg.msg_flags & MSG_CTRUNC ) ||
+	 cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS || h->numFds == 0 ||
+	 h->numFds > MAXHANDOFF ||
+	 cmsg->cmsg_len != CMSG_LEN( h->numFds * sizeof(int) ) ){
+		fprintf( stderr, "server: the old server didn't hand over its "
+		 "listeners\n" );
+		exit(1);
+	}
+
+	memcpy( fds, CMSG_DATA( cmsg ), h->numFds * sizeof(int) );
+	return fd;
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+/*******************************************************************************
+* File:       uring.h
+* Version:    0.1
+* Purpose:    A thin wrapper around the raw io_uring system calls, for the
+*             server's io_uring backend (-u)
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      io_uring is a pair of rings shared with the kernel: we put
+              requests (SQEs) on the submission queue, make one io_uring_enter()
+              call to submit all of them & wait, then read the results (CQEs)
+              off the completion queue. One io_uring_enter() can replace many
+              accept()/recv()/send() calls.
+
+              Reads use a provided buffer ring: a pool of buffers that we hand
+              to the kernel up front. A multishot recv() picks a buffer from the
+              pool each time data arrives, so no memory sits idle in a recv()
+              that's waiting on a quiet connection; we give each buffer back
+              once we've copied out of it.
+
+              This talks to the kernel directly (no liburing), so it only needs
+              the kernel's own <linux/io_uring.h>. It needs Linux 6.0 or newer
+              (for multishot recv()). uringWait() can time out; any SQEs it
+              submitted still count.
+*******************************************************************************/
+
+#ifndef URING_H
+#define URING_H
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one io_uring instance & the provided buffers for its recv()s
+struct uring {
+	int       fd;        // the io_uring file descriptor
+	unsigned  toSubmit;  // number of SQEs filled in but not yet submitted
+
+	// the submission queue (shared with the kernel)
+	unsigned* sqHead;
+	unsigned* sqTail;
+	unsigned  sqMask;
+	unsigned* sqArray;
+	struct io_uring_sqe* sqes;
+
+	// the completion queue (shared with the kernel)
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned  cqMask;
+	struct io_uring_cqe* cqes;
+
+	// the provided buffer ring (shared with the kernel)
+	struct io_uring_buf_ring* br;
+	unsigned  brMask;   // number of buffers - 1
+	unsigned short brTail; // our copy of the tail we hand buffers back at
+	char*     bufs;     // the buffers themselves, one after another
+	unsigned  bufSize;  // size of each buffer
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    uringInit
+* Purpose: Creates an io_uring instance & maps its rings. Must be called from
+*          the (one) thread that will submit to it.
+* Input:   u       - the struct uring to set up
+*          entries - size of the submission queue (the completion queue is
+*                    made four times bigger, since multishot requests complete
+*                    many times each)
+* Output:  0 on success, -1 on failure (with errno set)
+*******************************************************************************/
+int uringInit( struct uring* u, unsigned entries ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_params p;
+	size_t sqSize, cqSize;
+	char* sq;
+	char* cq;
+
+	memset( u, 0, sizeof(*u) );
+
+	// only this thread submits, & it only wants completions when it asks for
+	// them; this lets the kernel skip a lot of locking & interrupting
+	memset( &p, 0, sizeof(p) );
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+	 IORING_SETUP_DEFER_TASKRUN;
+	p.cq_entries = entries * 4;
+
+	u->fd = syscall( __NR_io_uring_setup, entries, &p );
+
+	// is this an older kernel (before 6.1)? then do without
+	if( u->fd == -1 && errno == EINVAL ){
+		memset( &p, 0, sizeof(p) );
+		p.flags = IORING_SETUP_CQSIZE;
+		p.cq_entries = entries * 4;
+		u->fd = syscall( __NR_io_uring_setup, entries, &p );
+	}
+
+	if( u->fd == -1 )
+		return -1;
+
+	// the two rings share one mapping on any kernel we could run on (5.4+)
+	sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if( cqSize > sqSize )
+		sqSize = cqSize;
+
+	sq = mmap( NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	 u->fd, IORING_OFF_SQ_RING );
+	if( sq == MAP_FAILED ){
+		close( u->fd );
+		return -1;
+	}
+	cq = sq;
+
+	u->sqes = mmap( NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+	 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES );
+	if( u->sqes == MAP_FAILED ){
+		close( u->fd );
+		return -1;
+	}
+
+	u->sqHead  = (unsigned*)( sq + p.sq_off.head );
+	u->sqTail  = (unsigned*)( sq + p.sq_off.tail );
+	u->sqMask  = *(unsigned*)( sq + p.sq_off.ring_mask );
+	u->sqArray = (unsigned*)( sq + p.sq_off.array );
+
+	u->cqHead  = (unsigned*)( cq + p.cq_off.head );
+	u->cqTail  = (unsigned*)( cq + p.cq_off.tail );
+	u->cqMask  = *(unsigned*)( cq + p.cq_off.ring_mask );
+	u->cqes    = (struct io_uring_cqe*)( cq + p.cq_off.cqes );
+
+	// SQE i always sits in slot i of the array, so fill that in once
+	for( unsigned i = 0; i < p.sq_entries; i++ )
+		u->sqArray[i] = i;
+
+	return 0;
+
+}
+
+/*******************************************************************************
+* Name:    uringEnter
+* Purpose: Submits every SQE filled in so far &, optionally, waits for at
+*          least one completion
+* Input:   u    - the io_uring
+*          wait - 1 to wait for a completion, 0 to just submit
+* Output:  0 on success, -1 on failure (with errno set)
+*******************************************************************************/
+int uringEnter( struct uring* u, int wait ){
+
+	// VARIABLE DEFINITIONS
+	int submitted;
+
+	while(1){
+
+		// (with DEFER_TASKRUN, completions are only ever posted from in here)
+		submitted = syscall( __NR_io_uring_enter, u->fd, u->toSubmit, wait,
+		 IORING_ENTER_GETEVENTS, NULL, 0 );
+
+		if( submitted == -1 ){
+			if( errno == EINTR )
+				continue;
+			// a full completion queue can hold up submission; the caller
+			// just needs to reap some completions & try again
+			if( errno == EBUSY || errno == EAGAIN )
+				return 0;
+			return -1;
+		}
+
+		u->toSubmit -= submitted;
+		return 0;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    uringWait
+* Purpose: Like uringEnter( u, 1 ), but gives up waiting after a timeout
+* Input:   u  - the io_uring
+*          ns - the most nanoseconds to wait for a completion
+* Output:  0 on success (or timeout), -1 on failure (with errno set)
+*******************************************************************************/
+int uringWait( struct uring* u, uint64_t ns ){
+
+	// VARIABLE DEFINITIONS
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	int submitted;
+
+	ts.tv_sec = ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	memset( &arg, 0, sizeof(arg) );
+	arg.ts = (unsigned long)&ts;
+
+	while(1){
+
+		submitted = syscall( __NR_io_uring_enter, u->fd, u->toSubmit, 1,
+		 IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg) );
+
+		if( submitted == -1 ){
+			if( errno == EINTR )
+				continue;
+			// (the kernel only reports ETIME if it submitted nothing)
+			if( errno == ETIME || errno == EBUSY || errno == EAGAIN )
+				return 0;
+			return -1;
+		}
+
+		u->toSubmit -= submitted;
+		return 0;
+
+	}
+
+}
+
+/*******************************************************************************
+* Name:    uringSqe
+* Purpose: Gets the next free SQE, submitting the ones before it if the
+*          submission queue is full
+* Input:   u - the io_uring
+* Output:  a zeroed SQE for the caller to fill in
+*******************************************************************************/
+struct io_uring_sqe* uringSqe( struct uring* u ){
+
+	// VARIABLE DEFINITIONS
+	unsigned tail = *u->sqTail;
+	struct io_uring_sqe* sqe;
+
+	// is the submission queue full?
+	while( tail - __atomic_load_n( u->sqHead, __ATOMIC_ACQUIRE ) > u->sqMask ){
+		if( uringEnter( u, 0 ) == -1 ){
+			perror( "io_uring_enter" );
+			exit(1);
+		}
+	}
+
+	sqe = &u->sqes[ tail & u->sqMask ];
+	memset( sqe, 0, sizeof(*sqe) );
+
+	// (without SQPOLL the kernel only reads SQEs inside io_uring_enter(), so
+	// it's safe to move the tail before the caller has filled this one in)
+	__atomic_store_n( u->sqTail, tail + 1, __ATOMIC_RELEASE );
+	u->toSubmit++;
+
+	return sqe;
+
+}
+
+/*******************************************************************************
+* Name:    uringCqe
+* Purpose: Looks at the oldest completion waiting on the completion queue
+* Input:   u - the io_uring
+* Output:  the CQE, or NULL if there isn't one. call uringSeen() when done
+*          with it
+*******************************************************************************/
+struct io_uring_cqe* uringCqe( struct uring* u ){
+
+	// VARIABLE DEFINITIONS
+	unsigned head = *u->cqHead;
+
+	if( head == __atomic_load_n( u->cqTail, __ATOMIC_ACQUIRE ) )
+		return NULL;
+
+	return &u->cqes[ head & u->cqMask ];
+
+}
+
+/*******************************************************************************
+* Name:    uringSeen
+* Purpose: Hands the CQE returned by uringCqe() back to the kernel
+* Input:   u - the io_uring
+* Output:  none
+*******************************************************************************/
+void uringSeen( struct uring* u ){
+	__atomic_store_n( u->cqHead, *u->cqHead + 1, __ATOMIC_RELEASE );
+}
+
+/*******************************************************************************
+* Name:    uringBufPut
+* Purpose: Gives a buffer (back) to the provided buffer ring
+* Input:   u   - the io_uring
+*          bid - the buffer's ID (its index in u->bufs)
+* Output:  none
+*******************************************************************************/
+void uringBufPut( struct uring* u, unsigned short bid ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_buf* buf = &u->br->bufs[ u->brTail & u->brMask ];
+
+	buf->addr = (unsigned long)( u->bufs + (size_t)bid * u->bufSize );
+	buf->len = u->bufSize;
+	buf->bid = bid;
+
+	u->brTail++;
+	__atomic_store_n( &u->br->tail, u->brTail, __ATOMIC_RELEASE );
+
+}
+
+/*******************************************************************************
+* Name:    uringBufGet
+* Purpose: Finds the memory of a buffer picked by the kernel
+* Input:   u   - the io_uring
+*          bid - the buffer's ID (from the CQE's flags)
+* Output:  a pointer to the buffer
+*******************************************************************************/
+char* uringBufGet( struct uring* u, unsigned short bid ){
+	return u->bufs + (size_t)bid * u->bufSize;
+}
+
+/*******************************************************************************
+* Name:    uringBufInit
+* Purpose: Creates a provided buffer ring full of buffers & registers it as
+*          buffer group 0
+* Input:   u       - the io_uring
+*          count   - the number of buffers (a power of 2, at most 32768)
+*          bufSize - the size of each buffer
+* Output:  0 on success, -1 on failure (with errno set)
+*******************************************************************************/
+int uringBufInit( struct uring* u, unsigned count, unsigned bufSize ){
+
+	// VARIABLE DEFINITIONS
+	struct io_uring_buf_reg reg;
+
+	// the ring itself must be page aligned, so get it from mmap()
+	u->br = mmap( NULL, count * sizeof(struct io_uring_buf),
+	 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( u->br == MAP_FAILED )
+		return -1;
+
+	u->bufs = malloc( (size_t)count * bufSize );
+	if( u->bufs == NULL ){
+		errno = ENOMEM;
+		return -1;
+	}
+
+	u->brMask = count - 1;
+	u->brTail = 0;
+	u->bufSize = bufSize;
+
+	memset( &reg, 0, sizeof(reg) );
+	reg.ring_addr = (unsigned long)u->br;
+	reg.ring_entries = count;
+	reg.bgid = 0;
+
+	if( syscall( __NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING,
+	 &reg, 1 ) == -1 )
+		return -1;
+
+	for( unsigned i = 0; i < count; i++ )
+		uringBufPut( u, i );
+
+	return 0;
+
+}
+
+#endif
@@ -0,0 +1,242 @@
+/*******************************************************************************
+* File:       wheel.h
+* Version:    0.1
+* Purpose:    A hierarchical timing wheel, for the server's connection timeouts
+* Author:     Michael Altfield <maltfield@knights.ucf.edu>
+* Course:     CNT4707
+* Assignment: 1
+* Created:    2026-10-18
+* Updated:    2026-10-18
+* Notes:      Time is counted in ticks of WHEELTICK milliseconds. The wheel has
+              WHEELLEVELS levels of WHEELSLOTS slots each; a slot on level 0
+              holds the timers that expire on one tick, a slot on level 1 those
+              that expire in one run of WHEELSLOTS ticks, & so on. When level 0
+              wraps around, the next slot up is emptied back down into the
+              levels below it ("cascading"), so every timer reaches level 0 in
+              time to expire on the right tick.
+
+              Each slot is a doubly linked list of timers, so arming & cancelling
+              a timer are both O(1), however many timers there are. A
+              connection re-arms its timer whenever it does anything, which
+              usually just moves it from one slot to another.
+
+              With 4 levels of 64 slots & 100ms ticks, the wheel reaches 64^4
+              ticks (about 19 days) ahead; anything further out is clamped.
+*******************************************************************************/
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+/*******************************************************************************
+                                   SETTINGS
+*******************************************************************************/
+
+#define WHEELTICK 100     // milliseconds per tick
+#define WHEELBITS 6       // log2 of WHEELSLOTS
+#define WHEELSLOTS (1 << WHEELBITS)
+#define WHEELLEVELS 4
+
+/*******************************************************************************
+                                   INCLUDES
+*******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************************************************
+                              STRUCTURE DEFINITIONS
+*******************************************************************************/
+
+// one timer; embed it in whatever it's timing
+struct timer {
+	struct timer*  next;    // the next timer in our slot
+	struct timer** prev;    // whatever points at us (NULL when not armed)
+	uint64_t       expires; // the tick we expire on
+};
+
+// one timing wheel (only ever used by one thread)
+struct wheel {
+	struct timer* slots[WHEELLEVELS][WHEELSLOTS];
+	uint64_t      now;      // the last tick we've run
+	size_t        armed;    // number of timers armed
+};
+
+/*******************************************************************************
+                                   FUNCTIONS
+*******************************************************************************/
+
+/*******************************************************************************
+* Name:    wheelTicks
+* Purpose: Converts a time to ticks
+* Input:   ns - the time in nanoseconds (e.g. from statsNow())
+* Output:  the time in ticks
+*******************************************************************************/
+uint64_t wheelTicks( uint64_t ns ){
+	return ns / ( (uint64_t)WHEELTICK * 1000000 );
+}
+
+/*******************************************************************************
+* Name:    wheelInit
+* Purpose: Sets up an empty wheel
+* Input:   wh  - the wheel
+*          now - the current tick
+* Output:  none
+*******************************************************************************/
+void wheelInit( struct wheel* wh, uint64_t now ){
+
+	memset( wh, 0, sizeof(*wh) );
+	wh->now = now;
+
+}
+
+/*******************************************************************************
+* Name:    wheelInsert
+* Purpose: Puts an (unlinked) timer in the slot for its expiry tick
+* Input:   wh - the wheel
+*          t  - the timer (expires filled in)
+* Output:  none
+*******************************************************************************/
+void wheelInsert( struct wheel* wh, struct timer* t ){
+
+	// VARIABLE DEFINITIONS
+	uint64_t delta = t->expires - wh->now;
+	int level = 0;
+	struct timer** slot;
+
+	// the furthest out we can go (the top level's slots are WHEELSLOTS^3
+	// ticks each, so it covers WHEELSLOTS^4 ticks)
+	if( delta >= (uint64_t)1 << ( WHEELBITS * WHEELLEVELS ) ){
+		delta = ( (uint64_t)1 << ( WHEELBITS * WHEELLEVELS ) ) - 1;
+		t->expires = wh->now + delta;
+	}
+
+	// the lowest level that reaches far enough
+	while( delta >= (uint64_t)1 << ( WHEELBITS * (level+1) ) )
+		level++;
+
+	slot = &wh->slots[level][ ( t->expires >> ( WHEELBITS * level ) ) &
+	 (WHEELSLOTS-1) ];
+
+	t->next = *slot;
+	if( t->next != NULL )
+		t->next->prev = &t->next;
+	t->prev = slot;
+	*slot = t;
+
+}
+
+/*******************************************************************************
+* Name:    timerCancel
+* Purpose: Disarms a timer (if it's armed)
+* Input:   wh - the wheel it's on
+*          t  - the timer
+* Output:  none
+*******************************************************************************/
+void timerCancel( struct wheel* wh, struct timer* t ){
+
+	if( t->prev == NULL )
+		return;
+
+	*t->prev = t->next;
+	if( t->next != NULL )
+		t->next->prev = t->prev;
+
+	t->prev = NULL;
+	wh->armed--;
+
+}
+
+/*******************************************************************************
+* Name:    timerArm
+* Purpose: Arms a timer (re-arming it if it's already armed)
+* Input:   wh    - the wheel
+*          t     - the timer
+*          ticks - how many ticks from now it should expire (at least 1)
+* Output:  none
+*******************************************************************************/
+void timerArm( struct wheel* wh, struct timer* t, uint64_t ticks ){
+
+	timerCancel( wh, t );
+
+	t->expires = wh->now + ( ticks > 0 ? ticks : 1 );
+	wheelInsert( wh, t );
+	wh->armed++;
+
+}
+
+/*******************************************************************************
+* Name:    wheelCascade
+* Purpose: Empties one slot of a level above 0 back into the wheel, where its
+*          timers now fall into lower levels
+* Input:   wh    - the wheel
+*          level - the level
+* Output:  none
+*******************************************************************************/
+void wheelCascade( struct wheel* wh, int level ){
+
+	// VARIABLE DEFINITIONS
+	struct timer** slot = &wh->slots[level][ ( wh->now >> ( WHEELBITS * level ) )
+	 & (WHEELSLOTS-1) ];
+	struct timer* t = *slot;
+	struct timer* next;
+
+	*slot = NULL;
+
+	for( ; t != NULL; t = next ){
+		next = t->next;
+		wheelInsert( wh, t );
+	}
+
+}
+
+/*******************************************************************************
+* Name:    wheelAdvance
+* Purpose: Runs the wheel up to the current tick, calling expire() on every
+*          timer that expires along the way (each is disarmed first, so
+*          expire() may re-arm it, or free it)
+* Input:   wh     - the wheel
+*          now    - the current tick
+*          expire - what to call for each expired timer
+* Output:  the number of timers that expired
+*******************************************************************************/
+int wheelAdvance( struct wheel* wh, uint64_t now,
+ void (*expire)( struct timer* t ) ){
+
+	// VARIABLE DEFINITIONS
+	struct timer* t;
+	int level;
+	int expired = 0;
+
+	while( wh->now < now ){
+
+		// with nothing armed, there's nothing to step through
+		if( wh->armed == 0 ){
+			wh->now = now;
+			break;
+		}
+
+		wh->now++;
+
+		// has level 0 (& maybe more levels) wrapped around? then bring the
+		// next slot of each wrapped level down, highest first
+		for( level = 0; level+1 < WHEELLEVELS &&
+		 ( wh->now & ( ( (uint64_t)1 << ( WHEELBITS * (level+1) ) ) - 1 ) ) == 0;
+		 level++ );
+		for( ; level > 0; level-- )
+			wheelCascade( wh, level );
+
+		// expire everything in this tick's slot
+		while( (t = wh->slots[0][ wh->now & (WHEELSLOTS-1) ]) != NULL ){
+			timerCancel( wh, t );
+			expire( t );
+			expired++;
+		}
+
+	}
+
+	return expired;
+
+}
+
+#endif